@@ -0,0 +1,175 @@
+/**
+ * @file activemqmessagesource.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Source of alarm server messages received from an Apache ActiveMQ message broker
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ACTIVEMQMESSAGESOURCE_H
+#define ACTIVEMQMESSAGESOURCE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cms/CMSException.h>
+#include <cms/ExceptionListener.h>
+#include <cms/MessageListener.h>
+
+#include "messagesource.h"
+
+/**
+ * 
+ * @brief C++ Messaging Service
+ * 
+ * This namespace is owned by the Apache ActiveMQ C++ library, it is included here just to do some forward declarations.
+ */
+namespace cms
+{
+// Forward declarations
+class Connection;
+class Destination;
+class MessageConsumer;
+class Session;
+}
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Messages from the Apache ActiveMQ message broker
+ *
+ * This class encapsulates the C++ API of the Apache ActiveMQ library. Apache ActiceMQ is an implementation of the Java Messaging Service standard used by the CSS (Control System Studio) Alarm Server. The activemq-cpp library's API is therefore called C++ Messaging Service (CMS).
+ *
+ * This class connects to the Apache ActiveMQ message broker configured in the AlarmConfiguration, subscribes to the topic of the CSS alarm server and receives all the messages there. Their fields are copied into an AlarmServerMessage that is passed to the receiver. This is the only part of AlarmNotifications that depends on the ActiveMQ library.
+ */
+class ActiveMQMessageSource final : public MessageSource, public cms::MessageListener, public cms::ExceptionListener
+{
+private:
+    /**
+     * @brief CMS connection
+     *
+     * Connection to the C++ Messaging Service
+     */
+    cms::Connection* _connection;
+    /**
+     * @brief CMS session
+     *
+     * Session on the C++ Messaging Service
+     */
+    cms::Session* _session;
+    /**
+     * @brief CMS topic
+     *
+     * Topic on the message broker, i.e. "name" of the "chatroom" where the CSS Alarm Server publishes its messages.
+     */
+    cms::Destination* _topicServer;
+    /**
+     * @brief CMS receiver
+     *
+     * Class to receive and parse the messages received from the ActiveMQ message broker
+     */
+    cms::MessageConsumer* _consumerServer;
+    /**
+     * @brief Message callback
+     *
+     * Set by start().
+     */
+    MessageSource::Receiver _receiver;
+    /**
+     * @brief Stop flag
+     *
+     * Set by stop() after the session and the connection have been closed.
+     */
+    bool _stopped;
+
+    /**
+     * @brief Message listener
+     *
+     * This method will be called by the ActiveMQ library if a message is received from the message broker.
+     * @param message CMS message object
+     * @return Nothing
+     */
+    virtual void onMessage ( const cms::Message* message ) noexcept;
+    /**
+     * @brief Exception listener
+     *
+     * This method will be called by the ActiveMQ library if an exception occurs in the messaging system
+     * @param ex The CMS exception
+     * @return Nothing
+     */
+    virtual void onException ( const cms::CMSException& ex ) noexcept;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates the necessary objects and connects to the Apache ActiveMQ message broker. Messages are delivered after start() has been called.
+     * @exception cms::CMSException Something went wrong within Apache ActiveMQ
+     * @exception std::runtime_error Initialization error
+     */
+    ActiveMQMessageSource();
+    /**
+     * @brief Destructor
+     * 
+     * Closes the connection to the message broker and cleans everything up.
+     */
+    virtual ~ActiveMQMessageSource();
+    /**
+     * @brief Copy constructor (deleted)
+     * 
+     * This class cannot be copied.
+     * @param other Another instance of ActiveMQMessageSource
+     */
+    ActiveMQMessageSource ( const ActiveMQMessageSource& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     * 
+     * This class cannot be copied.
+     * @param other Another instance of ActiveMQMessageSource
+     * @return Nothing (deleted)
+     */
+    ActiveMQMessageSource& operator= ( const ActiveMQMessageSource& other ) = delete;
+    /**
+     * @brief Start the delivery
+     *
+     * Registers this instance as message listener of the consumer. The receiver is called from the threads of the ActiveMQ library.
+     * @param receiver The callback
+     * @return Nothing
+     */
+    virtual void start ( const MessageSource::Receiver& receiver );
+    /**
+     * @brief Stop the delivery
+     *
+     * Closes the session and the connection. Closing the session waits for a running onMessage() to return.
+     * @return Nothing
+     */
+    virtual void stop() noexcept;
+};
+
+}
+
+#endif // ACTIVEMQMESSAGESOURCE_H
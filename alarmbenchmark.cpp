@@ -0,0 +1,358 @@
+/**
+ * @file alarmbenchmark.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Benchmarks of the alarm pipeline
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmbenchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/thread.hpp>
+
+#include "alarmconfiguration.h"
+#include "alarmloadgenerator.h"
+#include "alarmserverconnector.h"
+#include "clock.h"
+#include "inprocessmessagesource.h"
+#include "jsonencoding.h"
+#include "metrics.h"
+
+using namespace AlarmNotifications;
+
+// Number of simulated seconds used to determine the cost of an escalation scan
+static const unsigned int scanSamples = 9;
+
+// E-mail notification timeout in seconds during measurePipeline()
+static const unsigned int benchmarkEMailTimeout = 60;
+
+// Number of latencies kept by measureWorkload(), allocated before the memory is measured
+static const size_t latencySamples = 1 << 20;
+
+// Number of times each PV is raised and cleared by measureScaling()
+static const unsigned int scalingRounds = 10;
+
+// Capacity of the queue between the benchmark and AlarmServerConnector in measureWorkload(), kept small so its messages hardly count in the memory growth
+static const size_t workloadQueueCapacity = 4096;
+
+namespace
+{
+
+// Passes the messages of an InProcessMessageSource on and records how long the receiver needs for each of them
+class TimedMessageSource final : public MessageSource
+{
+public:
+    explicit TimedMessageSource ( std::unique_ptr<InProcessMessageSource> source )
+        : _source ( std::move ( source ) ),
+          _samples ( latencySamples ),
+          _count ( 0 ),
+          _random ( 1 )
+    {
+    }
+    virtual void start ( const MessageSource::Receiver& receiver )
+    {
+        _source->start ( [this, receiver] ( const AlarmServerMessage & message, const int64_t received )
+        {
+            receiver ( message, received );
+            record ( Metrics::now() - received );
+        } );
+    }
+    virtual void stop() noexcept
+    {
+        _source->stop();
+    }
+    InProcessMessageSource& source() noexcept
+    {
+        return *_source;
+    }
+    // The recorded latencies in nanoseconds, only to be called after InProcessMessageSource::waitUntilDelivered()
+    std::vector<int64_t> latencies() const
+    {
+        return std::vector<int64_t> ( _samples.begin(), _samples.begin() + static_cast<std::ptrdiff_t> ( std::min<uint64_t> ( _count, _samples.size() ) ) );
+    }
+private:
+    // Reservoir sampling: Once the buffer is full, each latency replaces a random one with the probability that keeps the sample uniform
+    void record ( const int64_t latency ) noexcept
+    {
+        if ( _count < _samples.size() )
+            _samples[_count] = latency;
+        else
+        {
+            const uint64_t slot = _random() % ( _count + 1 );
+            if ( slot < _samples.size() )
+                _samples[slot] = latency;
+        }
+        _count++;
+    }
+    std::unique_ptr<InProcessMessageSource> _source;
+    std::vector<int64_t> _samples;
+    uint64_t _count;
+    std::mt19937_64 _random;
+};
+
+}
+
+// Returns the given quantile of the sorted latencies in microseconds
+static double quantileMicroseconds ( const std::vector<int64_t>& sorted, const double quantile )
+{
+    if ( sorted.empty() )
+        return 0;
+    const size_t index = std::min ( static_cast<size_t> ( quantile * static_cast<double> ( sorted.size() ) ), sorted.size() - 1 );
+    return static_cast<double> ( sorted[index] ) * 1e-3;
+}
+
+// Applies one message per PV with the given severity and status and returns the messages per second
+static double applyAll ( AlarmServerConnector& asc, const std::vector<std::string>& pvnames, const std::string& severity, const std::string& status, int64_t& sequence )
+{
+    const int64_t started = Metrics::now();
+    for ( auto i = pvnames.begin(); i != pvnames.end(); i++ )
+    {
+        AlarmStatusEntry ase ( *i, severity, status );
+        // update() uses the reception time to find out which message is newer, a sequence number is as good and cheaper
+        AlarmStatusEntry::PipelineTimes times = AlarmStatusEntry::PipelineTimes();
+        times.received = ++sequence;
+        ase.setPipelineTimes ( times );
+        asc.notifyStatusChange ( ase );
+    }
+    const int64_t elapsed = std::max<int64_t> ( Metrics::now() - started, 1 );
+    return static_cast<double> ( pvnames.size() ) * 1e9 / static_cast<double> ( elapsed );
+}
+
+// Lets one simulated second pass and returns the real time in microseconds the sleeping threads needed for it
+static double advanceOneSecond ( SimulatedClock& clock )
+{
+    const int64_t started = Metrics::now();
+    clock.advance ( 1000000000 );
+    return static_cast<double> ( Metrics::now() - started ) * 1e-3;
+}
+
+// Names of the PVs used by measurePipeline() and measureScaling()
+static std::vector<std::string> benchmarkPVNames ( const size_t pvCount )
+{
+    std::vector<std::string> pvnames;
+    pvnames.reserve ( pvCount );
+    for ( size_t i = 0; i < pvCount; i++ )
+    {
+        char name[32];
+        snprintf ( name, sizeof ( name ), "BENCH:PV%08lu", static_cast<unsigned long> ( i ) );
+        pvnames.push_back ( name );
+    }
+    return pvnames;
+}
+
+// Body of a thread of measureScaling(): Waits for the others, then raises and clears its PVs scalingRounds times
+static void raiseAndClear ( AlarmServerConnector& asc, const std::vector<std::string>& pvnames, boost::barrier& start )
+{
+    int64_t sequence = 0;
+    start.wait();
+    for ( unsigned int round = 0; round < scalingRounds; round++ )
+    {
+        applyAll ( asc, pvnames, "MAJOR", "HIHI", sequence );
+        applyAll ( asc, pvnames, "OK", "NO_ALARM", sequence );
+    }
+}
+
+void AlarmBenchmark::isolateConfiguration()
+{
+    AlarmConfiguration& configuration = AlarmConfiguration::instance();
+    configuration.setJournalDirectory ( "" );
+    configuration.setHistoryDirectory ( "" );
+    configuration.setCaptureDirectory ( "" );
+    configuration.setSnapshotFileLocation ( "" );
+    configuration.setMetricsEndpoint ( "" );
+    configuration.setSharedTableName ( "" );
+    configuration.setChangeFeedEndpoint ( "" );
+    configuration.setDashboardEndpoint ( "" );
+    configuration.setLaboratoryNotificationTimeout ( 0 );
+    configuration.setDesktopNotificationTimeout ( 0 );
+    configuration.setEMailNotificationTimeout ( 0 );
+    configuration.setDebounceRaiseDelay ( 0 );
+    configuration.setDebounceClearDelay ( 0 );
+}
+
+int64_t AlarmBenchmark::residentSetSize() noexcept
+{
+    FILE*const statm = fopen ( "/proc/self/statm", "r" );
+    if ( statm == nullptr )
+        return 0;
+    long long total = 0;
+    long long resident = 0;
+    const int fields = fscanf ( statm, "%lld %lld", &total, &resident );
+    fclose ( statm );
+    if ( fields != 2 )
+        return 0;
+    return static_cast<int64_t> ( resident ) * sysconf ( _SC_PAGESIZE );
+}
+
+AlarmBenchmark::PipelineResult AlarmBenchmark::measurePipeline ( const size_t pvCount )
+{
+    PipelineResult result = PipelineResult();
+    result.pvCount = pvCount;
+    const std::vector<std::string> pvnames = benchmarkPVNames ( pvCount );
+
+    AlarmConfiguration::instance().setEMailNotificationTimeout ( benchmarkEMailTimeout );
+    SimulatedClock clock ( static_cast<int64_t> ( std::time ( nullptr ) ) * 1000000000 );
+    Clock::setInstance ( &clock );
+    try
+    {
+        int64_t sequence = 0;
+        AlarmServerConnector asc ( false, false, std::unique_ptr<MessageSource> ( new InProcessMessageSource() ) );
+        clock.waitForSleepers ( 4 ); // Watcher, flash light, snapshot and debounce thread
+
+        const int64_t memoryBefore = residentSetSize();
+        result.raisePerSecond = applyAll ( asc, pvnames, "MAJOR", "HIHI", sequence );
+        result.bytesPerAlarm = static_cast<double> ( residentSetSize() - memoryBefore ) / static_cast<double> ( std::max<size_t> ( pvCount, 1 ) );
+
+        std::vector<double> scans;
+        for ( unsigned int i = 0; i < scanSamples; i++ )
+            scans.push_back ( advanceOneSecond ( clock ) );
+        std::sort ( scans.begin(), scans.end() );
+        result.scanMicroseconds = scans[scans.size() / 2];
+        // The alarms have been raised within the same simulated second, so the e-mail is due exactly benchmarkEMailTimeout seconds later
+        clock.advance ( static_cast<int64_t> ( benchmarkEMailTimeout - scanSamples - 1 ) * 1000000000 );
+        result.batchMicroseconds = std::max ( advanceOneSecond ( clock ) - result.scanMicroseconds, 0.0 );
+
+        result.updatePerSecond = applyAll ( asc, pvnames, "MINOR", "HIGH", sequence );
+        result.clearPerSecond = applyAll ( asc, pvnames, "OK", "NO_ALARM", sequence );
+    }
+    catch ( ... )
+    {
+        Clock::setInstance ( nullptr );
+        AlarmConfiguration::instance().setEMailNotificationTimeout ( 0 );
+        throw;
+    }
+    Clock::setInstance ( nullptr );
+    AlarmConfiguration::instance().setEMailNotificationTimeout ( 0 );
+    return result;
+}
+
+AlarmBenchmark::WorkloadResult AlarmBenchmark::measureWorkload ( const AlarmLoadModel& model, const int64_t duration )
+{
+    WorkloadResult result = WorkloadResult();
+    std::vector<AlarmServerMessage> messages;
+    {
+        AlarmLoadGenerator generator ( model, Clock::instance().wallNow() );
+        AlarmServerMessage message;
+        while ( generator.next ( message ) <= duration )
+            messages.push_back ( message );
+    }
+    result.messages = messages.size();
+
+    TimedMessageSource* source = new TimedMessageSource ( std::unique_ptr<InProcessMessageSource> ( new InProcessMessageSource ( workloadQueueCapacity ) ) );
+    const int64_t memoryBefore = residentSetSize();
+    AlarmServerConnector asc ( false, false, std::unique_ptr<MessageSource> ( source ) ); // Takes ownership of the source
+    const int64_t started = Metrics::now();
+    for ( auto i = messages.begin(); i != messages.end(); i++ )
+        source->source().push ( *i );
+    source->source().waitUntilDelivered();
+    const int64_t elapsed = std::max<int64_t> ( Metrics::now() - started, 1 );
+    result.memoryGrowth = residentSetSize() - memoryBefore;
+    result.activeAlarms = asc.getNumberOfAlarms();
+
+    result.seconds = static_cast<double> ( elapsed ) * 1e-9;
+    result.messagesPerSecond = static_cast<double> ( result.messages ) / result.seconds;
+    std::vector<int64_t> latencies = source->latencies();
+    std::sort ( latencies.begin(), latencies.end() );
+    result.p50Microseconds = quantileMicroseconds ( latencies, 0.5 );
+    result.p99Microseconds = quantileMicroseconds ( latencies, 0.99 );
+    result.p999Microseconds = quantileMicroseconds ( latencies, 0.999 );
+    return result;
+}
+
+AlarmBenchmark::ScalingResult AlarmBenchmark::measureScaling ( const size_t pvCount, const unsigned int threads, const unsigned int shards )
+{
+    ScalingResult result = ScalingResult();
+    result.pvCount = pvCount;
+    result.threads = std::max ( threads, 1u );
+    result.shards = std::max ( shards, 1u );
+    // Each PV belongs to one thread, so the messages of a PV stay in order
+    std::vector<std::vector<std::string>> pvnames ( result.threads );
+    const std::vector<std::string> all = benchmarkPVNames ( pvCount );
+    for ( size_t i = 0; i < all.size(); i++ )
+        pvnames[i % result.threads].push_back ( all[i] );
+
+    AlarmConfiguration& configuration = AlarmConfiguration::instance();
+    const unsigned int configuredShards = configuration.getStatusMapShards();
+    configuration.setStatusMapShards ( result.shards );
+    SimulatedClock clock ( static_cast<int64_t> ( std::time ( nullptr ) ) * 1000000000 );
+    Clock::setInstance ( &clock );
+    try
+    {
+        AlarmServerConnector asc ( false, false, std::unique_ptr<MessageSource> ( new InProcessMessageSource() ) );
+        clock.waitForSleepers ( 4 ); // Watcher, flash light, snapshot and debounce thread, they stay asleep as the simulated time stands still
+
+        boost::barrier start ( result.threads + 1 );
+        boost::thread_group senders;
+        for ( unsigned int i = 0; i < result.threads; i++ )
+            senders.create_thread ( boost::bind ( &raiseAndClear, boost::ref ( asc ), boost::cref ( pvnames[i] ), boost::ref ( start ) ) );
+        start.wait();
+        const int64_t started = Metrics::now();
+        senders.join_all();
+        const int64_t elapsed = std::max<int64_t> ( Metrics::now() - started, 1 );
+        result.messagesPerSecond = static_cast<double> ( pvCount ) * 2 * scalingRounds * 1e9 / static_cast<double> ( elapsed );
+    }
+    catch ( ... )
+    {
+        Clock::setInstance ( nullptr );
+        configuration.setStatusMapShards ( configuredShards );
+        throw;
+    }
+    Clock::setInstance ( nullptr );
+    configuration.setStatusMapShards ( configuredShards );
+    return result;
+}
+
+std::string AlarmBenchmark::toJSON ( const AlarmBenchmark::PipelineResult& result, const std::string& label )
+{
+    char numbers[512];
+    snprintf ( numbers, sizeof ( numbers ),
+               "\"pvs\":%lu,\"raise_per_s\":%.0f,\"update_per_s\":%.0f,\"clear_per_s\":%.0f,\"scan_us\":%.1f,\"email_batch_us\":%.1f,\"bytes_per_alarm\":%.0f",
+               static_cast<unsigned long> ( result.pvCount ), result.raisePerSecond, result.updatePerSecond, result.clearPerSecond,
+               result.scanMicroseconds, result.batchMicroseconds, result.bytesPerAlarm );
+    return "{\"benchmark\":\"pipeline\",\"label\":" + quoteJSON ( label ) + "," + numbers + "}";
+}
+
+std::string AlarmBenchmark::toJSON ( const AlarmBenchmark::ScalingResult& result, const std::string& label )
+{
+    char numbers[256];
+    snprintf ( numbers, sizeof ( numbers ),
+               "\"pvs\":%lu,\"threads\":%u,\"shards\":%u,\"messages_per_s\":%.0f",
+               static_cast<unsigned long> ( result.pvCount ), result.threads, result.shards, result.messagesPerSecond );
+    return "{\"benchmark\":\"scaling\",\"label\":" + quoteJSON ( label ) + "," + numbers + "}";
+}
+
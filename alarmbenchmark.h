@@ -0,0 +1,236 @@
+/**
+ * @file alarmbenchmark.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Benchmarks of the alarm pipeline
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMBENCHMARK_H
+#define ALARMBENCHMARK_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace AlarmNotifications
+{
+
+struct AlarmLoadModel;
+
+/**
+ * @brief Benchmarks of the alarm pipeline
+ *
+ * Measures the cost of the parts of AlarmServerConnector that grow with the number of active alarms, using the real class without a message broker, journal, history, snapshot, e-mail server or flash light: See isolateConfiguration(). The results are written as JSON, one object per line, so the results of different builds or machines can be compared with standard tools.
+ */
+class AlarmBenchmark
+{
+public:
+    /**
+     * @brief Results of measurePipeline()
+     */
+    struct PipelineResult
+    {
+        /**
+         * @brief Number of PVs in alarm
+         */
+        size_t pvCount;
+        /**
+         * @brief Raised alarms applied per second
+         *
+         * AlarmServerConnector::notifyStatusChange() for PVs not yet in the map of active alarms.
+         */
+        double raisePerSecond;
+        /**
+         * @brief Updated alarms applied per second
+         *
+         * AlarmServerConnector::notifyStatusChange() changing the severity of PVs already in alarm.
+         */
+        double updatePerSecond;
+        /**
+         * @brief Cleared alarms applied per second
+         *
+         * AlarmServerConnector::notifyStatusChange() with severity OK for PVs in alarm.
+         */
+        double clearPerSecond;
+        /**
+         * @brief Cost of one escalation scan
+         *
+         * Microseconds the watcher threads of AlarmServerConnector need for one second in which no notification is due, median of several seconds.
+         */
+        double scanMicroseconds;
+        /**
+         * @brief Cost of batching the alarms into an e-mail notification
+         *
+         * Microseconds the watcher thread needs in the second the e-mail notification timeout expires for all alarms, minus scanMicroseconds.
+         */
+        double batchMicroseconds;
+        /**
+         * @brief Memory per active alarm
+         *
+         * Growth of the resident set size while raising the alarms, divided by their number.
+         */
+        double bytesPerAlarm;
+    };
+    /**
+     * @brief Results of measureWorkload()
+     */
+    struct WorkloadResult
+    {
+        /**
+         * @brief Number of messages processed
+         *
+         * STATE, CONFIG and IDLE messages of the synthetic workload.
+         */
+        uint64_t messages;
+        /**
+         * @brief Real time in seconds needed for all messages
+         */
+        double seconds;
+        /**
+         * @brief Messages processed per second
+         */
+        double messagesPerSecond;
+        /**
+         * @brief Median latency of applying a message
+         *
+         * Microseconds from handing a message to the receiver until AlarmServerConnector has applied or discarded it, the time the message waited in the queue is not included.
+         */
+        double p50Microseconds;
+        /**
+         * @brief 99th percentile of the latency of applying a message
+         */
+        double p99Microseconds;
+        /**
+         * @brief 99.9th percentile of the latency of applying a message
+         */
+        double p999Microseconds;
+        /**
+         * @brief Growth of the resident set size
+         *
+         * Bytes of physical memory the process needed while AlarmServerConnector processed the workload.
+         */
+        int64_t memoryGrowth;
+        /**
+         * @brief Number of active alarms at the end of the workload
+         */
+        size_t activeAlarms;
+    };
+    /**
+     * @brief Results of measureScaling()
+     */
+    struct ScalingResult
+    {
+        /**
+         * @brief Number of PVs raised and cleared
+         */
+        size_t pvCount;
+        /**
+         * @brief Number of threads calling AlarmServerConnector::notifyStatusChange() at the same time
+         */
+        unsigned int threads;
+        /**
+         * @brief Number of shards of the map of active alarms, see AlarmConfiguration::getStatusMapShards()
+         */
+        unsigned int shards;
+        /**
+         * @brief Messages applied per second by all threads together
+         */
+        double messagesPerSecond;
+    };
+
+    /**
+     * @brief Constructor (deleted)
+     *
+     * This class only has static methods.
+     */
+    AlarmBenchmark() = delete;
+    /**
+     * @brief Keep the benchmark away from the outside world
+     *
+     * Changes the AlarmConfiguration in memory only, the configuration file is not written: Journal, history, capture, snapshot, shared alarm table, change feed, dashboard and metrics endpoint are disabled, as are the flash light, desktop and e-mail notifications and the debouncing, which would hold the messages back.
+     * @return Nothing
+     */
+    static void isolateConfiguration();
+    /**
+     * @brief Resident set size of this process
+     *
+     * Read from /proc/self/statm.
+     *
+     * This method cannot throw exceptions.
+     * @return Bytes of physical memory used, 0 if unknown
+     */
+    static int64_t residentSetSize() noexcept;
+    /**
+     * @brief Measure the alarm pipeline at a given number of active alarms
+     *
+     * Creates a server version of AlarmServerConnector running on a SimulatedClock, raises pvCount alarms, lets simulated seconds pass until the e-mail notification of all alarms is prepared, updates and finally clears all alarms, measuring each step in real time. isolateConfiguration() has to be called before, the e-mail notification timeout is set by this method. The program has to be linked with the dummy EMailSender, so no e-mail is sent.
+     * @param pvCount Number of PVs in alarm
+     * @return The results
+     */
+    static PipelineResult measurePipeline ( const size_t pvCount );
+    /**
+     * @brief Measure the alarm pipeline with a synthetic workload
+     *
+     * Generates the messages of the workload in advance, then feeds them as fast as possible through an InProcessMessageSource into a server version of AlarmServerConnector running on the system clock, just like the messages of the broker would arrive at an-daemon. The latencies are recorded by the benchmark itself, for more than a million messages they are a uniform random sample. isolateConfiguration() has to be called before, so neither the broker nor the e-mail server nor the flash light is used.
+     * @param model The workload
+     * @param duration Simulated time the workload covers in nanoseconds
+     * @return The results
+     */
+    static WorkloadResult measureWorkload ( const AlarmLoadModel& model, const int64_t duration );
+    /**
+     * @brief Measure how the alarm pipeline scales with the number of receiving threads
+     *
+     * Creates a server version of AlarmServerConnector with the given number of shards running on a SimulatedClock, distributes the PVs over the threads and lets each thread raise and clear its own PVs several times as fast as possible, all threads starting at the same moment. With a single shard, the threads mostly wait for each other's map lock, with more shards they only meet there when their PVs share a shard. The lock of AlarmStatistics is taken by all threads regardless of the shards. isolateConfiguration() has to be called before, the number of shards is restored afterwards.
+     * @param pvCount Number of PVs, at least the number of threads
+     * @param threads Number of threads
+     * @param shards Number of shards
+     * @return The results
+     */
+    static ScalingResult measureScaling ( const size_t pvCount, const unsigned int threads, const unsigned int shards );
+    /**
+     * @brief Format results as JSON
+     * @param result Results of measurePipeline()
+     * @param label Label identifying the build or machine, e.g. a version number, may be empty
+     * @return A JSON object on a single line, without line break
+     */
+    static std::string toJSON ( const PipelineResult& result, const std::string& label );
+    /**
+     * @brief Format results as JSON
+     * @param result Results of measureScaling()
+     * @param label Label identifying the build or machine, may be empty
+     * @return A JSON object on a single line, without line break
+     */
+    static std::string toJSON ( const ScalingResult& result, const std::string& label );
+};
+
+}
+
+#endif // ALARMBENCHMARK_H
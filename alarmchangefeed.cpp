@@ -0,0 +1,320 @@
+/**
+ * @file alarmchangefeed.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Sequence-numbered feed of alarm changes for local clients
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmchangefeed.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#include "clock.h"
+
+using namespace AlarmNotifications;
+
+const size_t AlarmChangeFeed::maximumSubscribers;
+const unsigned int AlarmChangeFeed::idleInterval;
+const size_t AlarmChangeFeed::batchSize;
+
+// Maximum length of the SUBSCRIBE line
+static const size_t maximumRequestLength = 256;
+
+// Names of the transition types in the protocol, indexed by AlarmTransition::TransitionType
+static const char*const transitionNames[] = { "", "RAISED", "UPDATED", "CLEARED" };
+
+AlarmChangeFeed::AlarmChangeFeed ( const std::string& endpoint, const size_t capacity, const SnapshotProvider& snapshot )
+    : _epoch ( Clock::instance().wallNow() ),
+      _snapshot ( snapshot ),
+      _ring ( capacity ),
+      _last ( 0 ),
+      _run ( true ),
+      _nextsubscriber ( 0 )
+{
+    if ( capacity == 0 )
+        throw std::invalid_argument ( "The ring buffer of the change feed must hold at least one change." );
+    _server.reset ( new LocalSocketServer ( endpoint, [this] ( int fd )
+    {
+        accept ( fd );
+    } ) );
+}
+
+AlarmChangeFeed::~AlarmChangeFeed()
+{
+    stop();
+}
+
+void AlarmChangeFeed::append ( const AlarmTransition& transition )
+{
+    {
+        boost::lock_guard<boost::mutex> lock ( _mutex );
+        _last++;
+        Change& change = _ring[_last % _ring.size()];
+        change.sequence = _last;
+        change.transition = transition;
+    }
+    _changed.notify_all();
+}
+
+uint64_t AlarmChangeFeed::lastSequence() const noexcept
+{
+    boost::lock_guard<boost::mutex> lock ( _mutex );
+    return _last;
+}
+
+void AlarmChangeFeed::stop() noexcept
+{
+    {
+        boost::lock_guard<boost::mutex> lock ( _mutex );
+        _run = false;
+    }
+    _changed.notify_all();
+    _server.reset(); // No new subscribers from here on
+    std::map<unsigned int, Subscriber> subscribers;
+    {
+        boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+        subscribers.swap ( _subscribers );
+        _finished.clear();
+    }
+    for ( auto i = subscribers.begin(); i != subscribers.end(); i++ )
+        shutdown ( ( *i ).second.fd, SHUT_RDWR ); // Wakes up threads waiting for the client
+    for ( auto i = subscribers.begin(); i != subscribers.end(); i++ )
+    {
+        ( *i ).second.thread.join();
+        close ( ( *i ).second.fd );
+    }
+}
+
+void AlarmChangeFeed::accept ( const int fd )
+{
+    boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+    reapSubscribers();
+    if ( !_run )
+        return;
+    if ( _subscribers.size() >= maximumSubscribers )
+    {
+        send ( fd, "BUSY\n" );
+        return;
+    }
+    // The server closes fd when this method returns, the subscriber thread needs a connection of its own
+    const int connection = fcntl ( fd, F_DUPFD_CLOEXEC, 0 );
+    if ( connection < 0 )
+        throw std::runtime_error ( std::string ( "Cannot duplicate the connection of a change feed subscriber: " ) + strerror ( errno ) );
+    const unsigned int id = _nextsubscriber++;
+    try
+    {
+        Subscriber& subscriber = _subscribers[id];
+        subscriber.fd = connection;
+        subscriber.thread = boost::thread ( boost::bind ( &AlarmChangeFeed::serve, this, connection, id ) );
+    }
+    catch ( ... )
+    {
+        _subscribers.erase ( id );
+        close ( connection );
+        throw;
+    }
+}
+
+void AlarmChangeFeed::reapSubscribers() noexcept
+{
+    for ( auto i = _finished.begin(); i != _finished.end(); i++ )
+    {
+        auto subscriber = _subscribers.find ( *i );
+        if ( subscriber == _subscribers.end() )
+            continue;
+        ( *subscriber ).second.thread.join(); // Has returned from serve() already
+        close ( ( *subscriber ).second.fd );
+        _subscribers.erase ( subscriber );
+    }
+    _finished.clear();
+}
+
+void AlarmChangeFeed::serve ( const int fd, const unsigned int id ) noexcept
+{
+    try
+    {
+        std::string request;
+        char buffer[64];
+        while ( request.find ( '\n' ) == std::string::npos )
+        {
+            const ssize_t received = recv ( fd, buffer, sizeof ( buffer ), 0 );
+            if ( received <= 0 || request.length() > maximumRequestLength )
+                throw std::runtime_error ( "The change feed subscriber has not sent a complete request." );
+            request.append ( buffer, static_cast<size_t> ( received ) );
+        }
+        std::istringstream parser ( request );
+        std::string command;
+        int64_t epoch = 0;
+        uint64_t sequence = 0;
+        std::string format;
+        parser >> command >> epoch >> sequence;
+        const bool complete = !parser.fail();
+        parser >> format;
+        if ( !complete || command != "SUBSCRIBE" || ( !format.empty() && format != "BINARY" ) )
+        {
+            send ( fd, "ERROR\tExpected SUBSCRIBE <epoch> <sequence> [BINARY]\n" );
+            throw std::runtime_error ( "The change feed subscriber has sent an invalid request." );
+        }
+        std::unique_ptr<AlarmWireEncoder> encoder;
+        if ( !format.empty() )
+            encoder.reset ( new AlarmWireEncoder() );
+        // Resume if the client has seen changes of this run and the ring buffer still has the ones it has missed
+        std::vector<Change> changes;
+        if ( epoch != _epoch || sequence == 0 || !read ( sequence, changes ) )
+        {
+            changes.clear();
+            sequence = sendSnapshot ( fd, encoder.get() );
+        }
+        while ( _run )
+        {
+            if ( changes.empty() && !read ( sequence, changes ) )
+            {
+                changes.clear();
+                sequence = sendSnapshot ( fd, encoder.get() ); // The client has fallen behind the ring buffer
+                continue;
+            }
+            if ( changes.empty() )
+            {
+                if ( !waitForChange ( sequence ) && _run )
+                    sendIdle ( fd, sequence, encoder.get() );
+                continue;
+            }
+            sendChanges ( fd, changes, encoder.get() );
+            sequence = changes.back().sequence;
+            changes.clear();
+        }
+    }
+    catch ( ... )
+    {
+        // The client has disconnected or misbehaved, which is nothing to report
+    }
+    boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+    _finished.push_back ( id );
+}
+
+bool AlarmChangeFeed::read ( const uint64_t after, std::vector<Change>& changes ) const
+{
+    boost::lock_guard<boost::mutex> lock ( _mutex );
+    if ( after > _last )
+        return false; // Not a sequence number of this run
+    const uint64_t oldest = _last >= _ring.size() ? _last - _ring.size() + 1 : 1;
+    if ( after + 1 < oldest )
+        return false;
+    for ( uint64_t sequence = after + 1; sequence <= _last && changes.size() < batchSize; sequence++ )
+        changes.push_back ( _ring[sequence % _ring.size()] );
+    return true;
+}
+
+bool AlarmChangeFeed::waitForChange ( const uint64_t after )
+{
+    boost::unique_lock<boost::mutex> lock ( _mutex );
+    return _changed.timed_wait ( lock, boost::posix_time::seconds ( idleInterval ), [this, after]()
+    {
+        return !_run || _last > after;
+    } ) && _run;
+}
+
+uint64_t AlarmChangeFeed::sendSnapshot ( const int fd, AlarmWireEncoder*const encoder ) const
+{
+    std::vector<AlarmTransition> active;
+    const uint64_t sequence = _snapshot ( active );
+    if ( encoder )
+    {
+        std::string frame;
+        for ( auto i = active.begin(); i != active.end(); i++ )
+            encoder->add ( *i );
+        encoder->finishSnapshot ( frame, _epoch, sequence );
+        send ( fd, frame );
+        return sequence;
+    }
+    std::ostringstream lines;
+    lines << "SNAPSHOT\t" << _epoch << "\t" << sequence << "\t" << active.size() << "\n";
+    for ( auto i = active.begin(); i != active.end(); i++ )
+        lines << "ACTIVE\t" << ( *i ).wallTime << "\t" << ( *i ).pvname << "\t" << AlarmStatusEntry::severityLevelToString ( ( *i ).severity ) << "\t" << ( *i ).status << "\n";
+    send ( fd, lines.str() );
+    return sequence;
+}
+
+void AlarmChangeFeed::sendChanges ( const int fd, const std::vector<Change>& changes, AlarmWireEncoder*const encoder )
+{
+    if ( encoder )
+    {
+        std::string frame;
+        for ( auto i = changes.begin(); i != changes.end(); i++ )
+            encoder->add ( ( *i ).transition );
+        encoder->finishChanges ( frame, changes.front().sequence );
+        send ( fd, frame );
+        return;
+    }
+    std::ostringstream lines;
+    for ( auto i = changes.begin(); i != changes.end(); i++ )
+    {
+        const AlarmTransition& transition = ( *i ).transition;
+        lines << "CHANGE\t" << ( *i ).sequence << "\t" << transitionNames[transition.type] << "\t" << transition.wallTime << "\t"
+              << transition.pvname << "\t" << AlarmStatusEntry::severityLevelToString ( transition.severity ) << "\t" << transition.status << "\n";
+    }
+    send ( fd, lines.str() );
+}
+
+void AlarmChangeFeed::sendIdle ( const int fd, const uint64_t sequence, AlarmWireEncoder*const encoder ) const
+{
+    if ( encoder )
+    {
+        std::string frame;
+        encoder->appendIdle ( frame, _epoch, sequence );
+        send ( fd, frame );
+        return;
+    }
+    std::ostringstream idle;
+    idle << "IDLE\t" << _epoch << "\t" << sequence << "\n";
+    send ( fd, idle.str() );
+}
+
+void AlarmChangeFeed::send ( const int fd, const std::string& text )
+{
+    size_t sent = 0;
+    while ( sent < text.length() )
+    {
+        const ssize_t result = ::send ( fd, text.data() + sent, text.length() - sent, MSG_NOSIGNAL );
+        if ( result < 0 && errno == EINTR )
+            continue;
+        if ( result <= 0 )
+            throw std::runtime_error ( std::string ( "Cannot send to change feed subscriber: " ) + strerror ( errno ) );
+        sent += static_cast<size_t> ( result );
+    }
+}
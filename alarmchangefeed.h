@@ -0,0 +1,334 @@
+/**
+ * @file alarmchangefeed.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Sequence-numbered feed of alarm changes for local clients
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMCHANGEFEED_H
+#define ALARMCHANGEFEED_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alarmtransition.h"
+#include "alarmwireencoding.h"
+#include "localsocketserver.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Sequence-numbered feed of alarm changes for local clients
+ *
+ * Every change AlarmServerConnector applies to its map of active alarms gets the next sequence number and is kept in a ring buffer of the most recent changes. Local clients, e.g. dashboards or scripts, connect to the endpoint of the feed and subscribe from the last sequence number they have seen. They receive the changes they have missed and then every new change as it happens, so after a reconnect they never have to download the full list of alarms again. A client that is new, that has fallen behind the ring buffer or that was connected to a previous run of the daemon receives a snapshot of all active alarms first, followed by the changes after the snapshot.
+ *
+ * The protocol is line-based text with tab-separated fields. The client sends a single line
+ *
+ *     SUBSCRIBE <epoch> <sequence>
+ *
+ * with both numbers 0 on its first connection. The epoch identifies the run of the daemon, sequence numbers of different runs must not be mixed. The daemon answers with
+ *
+ *     SNAPSHOT <epoch> <sequence> <count>
+ *     ACTIVE <trigger time> <PV name> <severity> <status>    (count times)
+ *
+ * if the client cannot resume, followed by the changes after the given or the snapshot sequence number:
+ *
+ *     CHANGE <sequence> RAISED|UPDATED|CLEARED <time> <PV name> <severity> <status>
+ *
+ * Times are nanoseconds since the Unix epoch. While nothing changes, the line "IDLE <epoch> <sequence>" is sent every idleInterval seconds, so both sides notice a broken connection. A snapshot may be repeated at any time if the client has not kept up with the ring buffer.
+ *
+ * With "SUBSCRIBE <epoch> <sequence> BINARY", the same content is sent in the much more compact encoding of AlarmWireEncoder instead, with all changes read from the ring buffer at once in a single frame.
+ *
+ * Each subscriber is served by a thread of its own, which only takes the lock of the ring buffer while copying changes from it. The snapshot is taken by a callback of AlarmServerConnector under the lock of its map, so it matches the sequence number exactly.
+ */
+class AlarmChangeFeed final
+{
+public:
+    /**
+     * @brief A change with its sequence number
+     */
+    struct Change
+    {
+        /**
+         * @brief Sequence number, the first change of a run has number 1
+         */
+        uint64_t sequence;
+        /**
+         * @brief The change
+         */
+        AlarmTransition transition;
+    };
+    /**
+     * @brief Snapshot callback
+     *
+     * Fills the vector with one AlarmTransition of type AlarmTransition::Raised per active alarm, its wall clock time being the trigger time of the alarm, and returns lastSequence() taken at the same time.
+     */
+    typedef std::function<uint64_t ( std::vector<AlarmTransition>& ) > SnapshotProvider;
+    /**
+     * @brief Maximum number of subscribers
+     *
+     * Further clients are turned away with the line "BUSY".
+     */
+    static const size_t maximumSubscribers = 64;
+    /**
+     * @brief Interval of the IDLE lines in seconds
+     */
+    static const unsigned int idleInterval = 10;
+    /**
+     * @brief Maximum number of changes sent in one write
+     */
+    static const size_t batchSize = 1024;
+private:
+    /**
+     * @brief A connected client
+     */
+    struct Subscriber
+    {
+        /**
+         * @brief Connection, closed after the thread has been joined
+         */
+        int fd;
+        /**
+         * @brief Thread running serve()
+         */
+        boost::thread thread;
+    };
+    /**
+     * @brief Identification of this run of the daemon
+     *
+     * Wall clock time in nanoseconds when the feed has been created.
+     */
+    const int64_t _epoch;
+    /**
+     * @brief Callback taking a snapshot of the active alarms
+     */
+    const SnapshotProvider _snapshot;
+    /**
+     * @brief Ring buffer of the most recent changes
+     *
+     * The change with sequence number n is stored at index n modulo the size. Protected by _mutex.
+     */
+    std::vector<Change> _ring;
+    /**
+     * @brief Sequence number of the newest change
+     *
+     * 0 as long as there has not been any change. Protected by _mutex.
+     */
+    uint64_t _last;
+    /**
+     * @brief Protects _ring and _last
+     */
+    mutable boost::mutex _mutex;
+    /**
+     * @brief Signalled when a change has been appended or the feed is stopped
+     */
+    boost::condition_variable _changed;
+    /**
+     * @brief Run flag
+     *
+     * Set to false by stop(), after which the subscriber threads end their loops. It is written under _mutex so that waitForChange() cannot miss it. Atomic, as accept() and serve() also read it without _mutex.
+     */
+    std::atomic<bool> _run;
+    /**
+     * @brief Connected clients by ID
+     *
+     * Protected by _subscribersmutex.
+     */
+    std::map<unsigned int, Subscriber> _subscribers;
+    /**
+     * @brief IDs of subscribers whose thread has finished
+     *
+     * Their threads are joined and their connections closed when the next client connects or the feed is stopped. Protected by _subscribersmutex.
+     */
+    std::vector<unsigned int> _finished;
+    /**
+     * @brief ID of the next subscriber
+     */
+    unsigned int _nextsubscriber;
+    /**
+     * @brief Protects _subscribers and _finished
+     */
+    boost::mutex _subscribersmutex;
+    /**
+     * @brief Server accepting the clients
+     *
+     * Created last in the constructor, so no client connects to a partially constructed feed.
+     */
+    std::unique_ptr<LocalSocketServer> _server;
+
+    /**
+     * @brief Take over an accepted connection
+     *
+     * Handler of the LocalSocketServer. Duplicates the connection, as the server closes it after this method has returned, and starts a subscriber thread for it.
+     * @param fd The accepted connection
+     * @return Nothing
+     */
+    void accept ( const int fd );
+    /**
+     * @brief Join the threads of finished subscribers
+     *
+     * Has to be called with _subscribersmutex locked.
+     * @return Nothing
+     */
+    void reapSubscribers() noexcept;
+    /**
+     * @brief Serve a subscriber
+     *
+     * Reads the SUBSCRIBE line, sends a snapshot if necessary and then the changes until the client disconnects or the feed is stopped.
+     * @param fd The connection
+     * @param id ID of the subscriber in _subscribers
+     * @return Nothing
+     */
+    void serve ( const int fd, const unsigned int id ) noexcept;
+    /**
+     * @brief Copy changes from the ring buffer
+     *
+     * @param after Sequence number of the last change the client has
+     * @param changes Receives up to batchSize changes following after
+     * @return false if the changes following after are not in the ring buffer anymore, or after is newer than the newest change
+     */
+    bool read ( const uint64_t after, std::vector<Change>& changes ) const;
+    /**
+     * @brief Wait for a new change
+     *
+     * @param after Sequence number of the last change the client has
+     * @return true if there is a change following after, false after idleInterval seconds without change or if the feed is being stopped
+     */
+    bool waitForChange ( const uint64_t after );
+    /**
+     * @brief Send a snapshot of all active alarms
+     *
+     * @param fd The connection
+     * @param encoder Encoder of a binary session, a null pointer for a text session
+     * @return Sequence number of the snapshot
+     * @exception std::runtime_error The client has disconnected
+     */
+    uint64_t sendSnapshot ( const int fd, AlarmWireEncoder*const encoder ) const;
+    /**
+     * @brief Send changes
+     *
+     * @param fd The connection
+     * @param changes Consecutive changes read from the ring buffer
+     * @param encoder Encoder of a binary session, a null pointer for a text session
+     * @return Nothing
+     * @exception std::runtime_error The client has disconnected
+     */
+    static void sendChanges ( const int fd, const std::vector<Change>& changes, AlarmWireEncoder*const encoder );
+    /**
+     * @brief Send the idle notice
+     *
+     * @param fd The connection
+     * @param sequence Sequence number of the last change the client has
+     * @param encoder Encoder of a binary session, a null pointer for a text session
+     * @return Nothing
+     * @exception std::runtime_error The client has disconnected
+     */
+    void sendIdle ( const int fd, const uint64_t sequence, AlarmWireEncoder*const encoder ) const;
+    /**
+     * @brief Send data to a client
+     *
+     * @param fd The connection
+     * @param text Complete lines or frames
+     * @return Nothing
+     * @exception std::runtime_error The client has disconnected or not accepted the data within LocalSocketServer::connectionTimeout seconds
+     */
+    static void send ( const int fd, const std::string& text );
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates the ring buffer and starts accepting clients.
+     * @param endpoint Path of a Unix domain socket or TCP port on the loopback interface, see LocalSocketServer
+     * @param capacity Number of changes kept in the ring buffer, at least 1
+     * @param snapshot Callback taking a snapshot of the active alarms
+     * @exception std::invalid_argument The capacity is 0
+     * @exception std::runtime_error The socket cannot be created
+     */
+    AlarmChangeFeed ( const std::string& endpoint, const size_t capacity, const SnapshotProvider& snapshot );
+    /**
+     * @brief Destructor
+     *
+     * Calls stop().
+     */
+    ~AlarmChangeFeed();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmChangeFeed
+     */
+    AlarmChangeFeed ( const AlarmChangeFeed& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmChangeFeed
+     * @return Nothing (deleted)
+     */
+    AlarmChangeFeed& operator= ( const AlarmChangeFeed& other ) = delete;
+    /**
+     * @brief Append a change
+     *
+     * Assigns the next sequence number and wakes up the subscribers. AlarmServerConnector calls it under the lock of its map of active alarms, so the order of the sequence numbers is the order in which the changes have been applied.
+     * @param transition The change
+     * @return Nothing
+     */
+    void append ( const AlarmTransition& transition );
+    /**
+     * @brief Sequence number of the newest change
+     *
+     * This method cannot throw exceptions.
+     * @return The sequence number, 0 if there has not been any change
+     */
+    uint64_t lastSequence() const noexcept;
+    /**
+     * @brief Stop serving clients
+     *
+     * Closes the endpoint and disconnects all subscribers. After this method has returned, the snapshot callback is not called anymore. append() can still be called.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void stop() noexcept;
+};
+
+}
+
+#endif // ALARMCHANGEFEED_H
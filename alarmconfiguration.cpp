@@ -67,6 +67,9 @@ AlarmConfiguration::AlarmConfiguration()
       _skeleton ( _backend )
 {
     CreateActiveMQConnectivitySettings();
+    CreatePersistenceSettings();
+    CreateMonitoringSettings();
+    CreateLocalClientSettings();
 }
 
 AlarmConfiguration::~AlarmConfiguration()
@@ -81,6 +84,7 @@ const std::string& AlarmConfiguration::getConfigFileLocation() const noexcept
 
 void AlarmConfiguration::ReReadConfiguration()
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _backend->markAsClean();
     _backend->reparseConfiguration();
     _skeleton.readConfig();
@@ -88,6 +92,7 @@ void AlarmConfiguration::ReReadConfiguration()
 
 void AlarmConfiguration::WriteConfiguration()
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _skeleton.writeConfig();
     _backend->sync();
 }
@@ -102,6 +107,10 @@ void AlarmConfiguration::CreateActiveMQConnectivitySettings()
     _laboratorynotificationtimeoutitem = _skeleton.addItemUInt ( "LaboratoryNotificationTimeout", _laboratorynotificationtimeout, 0 );
     _desktopnotificationtimeoutitem = _skeleton.addItemUInt ( "DesktopNotificationTimeout", _desktopnotificationtimeout, 0 );
     _emailnotificationtimeoutitem = _skeleton.addItemUInt ( "EMailNotificationTimeout", _emailnotificationtimeout, 0 );
+    _stormthresholditem = _skeleton.addItemUInt ( "StormThreshold", _stormthreshold, 50 );
+    _debounceraisedelayitem = _skeleton.addItemUInt ( "DebounceRaiseDelay", _debounceraisedelay, 0 );
+    _debouncecleardelayitem = _skeleton.addItemUInt ( "DebounceClearDelay", _debouncecleardelay, 0 );
+    _statusmapshardsitem = _skeleton.addItemUInt ( "StatusMapShards", _statusmapshards, 1 );
     _emailnotificationfromitem = _skeleton.addItemString ( "EMailNotificationFrom", _emailnotificationfrom );
     _emailnotificationtoitem = _skeleton.addItemString ( "EMailNotificationTo", _emailnotificationto );
     _emailnotificationservernameitem = _skeleton.addItemString ( "EMailNotificationServerName", _emailnotificationservername );
@@ -111,126 +120,397 @@ void AlarmConfiguration::CreateActiveMQConnectivitySettings()
     _flashlightrelaisdevicenodeitem = _skeleton.addItemString ( "FlashLightRelaisDeviceNode", _flashlightrelaisdevicenode );
 }
 
+void AlarmConfiguration::CreatePersistenceSettings()
+{
+    _skeleton.setCurrentGroup ( QString::fromUtf8 ( "Persistence" ) );
+    _snapshotfilelocationitem = _skeleton.addItemString ( "SnapshotFileLocation", _snapshotfilelocation );
+    _snapshotmaximumageitem = _skeleton.addItemUInt ( "SnapshotMaximumAge", _snapshotmaximumage, 3600 );
+    _journaldirectoryitem = _skeleton.addItemString ( "JournalDirectory", _journaldirectory );
+    _journalsegmentsizeitem = _skeleton.addItemUInt ( "JournalSegmentSize", _journalsegmentsize, 16384 );
+    _journalsegmentsizeitem->setMinValue ( 1 );
+    _journalretainedsegmentsitem = _skeleton.addItemUInt ( "JournalRetainedSegments", _journalretainedsegments, 64 );
+    _historydirectoryitem = _skeleton.addItemString ( "HistoryDirectory", _historydirectory );
+    _capturedirectoryitem = _skeleton.addItemString ( "CaptureDirectory", _capturedirectory );
+}
+
+void AlarmConfiguration::CreateMonitoringSettings()
+{
+    _skeleton.setCurrentGroup ( QString::fromUtf8 ( "Monitoring" ) );
+    _metricsendpointitem = _skeleton.addItemString ( "MetricsEndpoint", _metricsendpoint );
+    _desktopmetricsdirectoryitem = _skeleton.addItemString ( "DesktopMetricsDirectory", _desktopmetricsdirectory );
+    _controlsocketitem = _skeleton.addItemString ( "ControlSocket", _controlsocket );
+}
+
+void AlarmConfiguration::CreateLocalClientSettings()
+{
+    _skeleton.setCurrentGroup ( QString::fromUtf8 ( "LocalClients" ) );
+    _sharedtablenameitem = _skeleton.addItemString ( "SharedTableName", _sharedtablename, "/an-alarm-table" );
+    _changefeedendpointitem = _skeleton.addItemString ( "ChangeFeedEndpoint", _changefeedendpoint );
+    _changefeedcapacityitem = _skeleton.addItemUInt ( "ChangeFeedCapacity", _changefeedcapacity, 65536 );
+    _changefeedcapacityitem->setMinValue ( 1 );
+    _dashboardendpointitem = _skeleton.addItemString ( "DashboardEndpoint", _dashboardendpoint );
+}
+
 std::string AlarmConfiguration::getActiveMQURI() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _activemquri.toUtf8().data() );
 }
 
 void AlarmConfiguration::setActiveMQURI ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _activemquriitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
 std::string AlarmConfiguration::getActiveMQUsername() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _activemqusername.toUtf8().data() );
 }
 
 void AlarmConfiguration::setActiveMQUsername ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _activemqusernameitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
 std::string AlarmConfiguration::getActiveMQPassword() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _activemqpassword.toUtf8().data() );
 }
 
 void AlarmConfiguration::setActiveMQPassword ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _activemqpassworditem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
 std::string AlarmConfiguration::getActiveMQTopicName() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _activemqtopicname.toUtf8().data() );
 }
 
 void AlarmConfiguration::setActiveMQTopicName ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _activemqtopicnameitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
 unsigned int AlarmConfiguration::getLaboratoryNotificationTimeout() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return _laboratorynotificationtimeout;
 }
 
 void AlarmConfiguration::setLaboratoryNotificationTimeout ( const unsigned int newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _laboratorynotificationtimeoutitem->setValue ( newSetting );
 }
 
 unsigned int AlarmConfiguration::getDesktopNotificationTimeout() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return _desktopnotificationtimeout;
 }
 
 void AlarmConfiguration::setDesktopNotificationTimeout ( const unsigned int newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _desktopnotificationtimeoutitem->setValue ( newSetting );
 }
 
 unsigned int AlarmConfiguration::getEMailNotificationTimeout() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return _emailnotificationtimeout;
 }
 
 void AlarmConfiguration::setEMailNotificationTimeout ( const unsigned int newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _emailnotificationtimeoutitem->setValue ( newSetting );
 }
 
+unsigned int AlarmConfiguration::getStormThreshold() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _stormthreshold;
+}
+
+void AlarmConfiguration::setStormThreshold ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _stormthresholditem->setValue ( newSetting );
+}
+
+unsigned int AlarmConfiguration::getDebounceRaiseDelay() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _debounceraisedelay;
+}
+
+void AlarmConfiguration::setDebounceRaiseDelay ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _debounceraisedelayitem->setValue ( newSetting );
+}
+
+unsigned int AlarmConfiguration::getDebounceClearDelay() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _debouncecleardelay;
+}
+
+void AlarmConfiguration::setDebounceClearDelay ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _debouncecleardelayitem->setValue ( newSetting );
+}
+
+unsigned int AlarmConfiguration::getStatusMapShards() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _statusmapshards;
+}
+
+void AlarmConfiguration::setStatusMapShards ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _statusmapshardsitem->setValue ( newSetting );
+}
+
 std::string AlarmConfiguration::getEMailNotificationFrom() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _emailnotificationfrom.toUtf8().data() );
 }
 
 void AlarmConfiguration::setEMailNotificationFrom ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _emailnotificationfromitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
 std::string AlarmConfiguration::getEMailNotificationTo() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _emailnotificationto.toUtf8().data() );
 }
 
 void AlarmConfiguration::setEMailNotificationTo ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _emailnotificationtoitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
 std::string AlarmConfiguration::getEMailNotificationServerName() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _emailnotificationservername.toUtf8().data() );
 }
 
 void AlarmConfiguration::setEMailNotificationServerName ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _emailnotificationservernameitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
 unsigned int AlarmConfiguration::getEMailNotificationServerPort() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return _emailnotificationserverport;
 }
 
 void AlarmConfiguration::setEMailNotificationServerPort ( const unsigned int newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _emailnotificationserverportitem->setValue ( newSetting );
 }
 
 std::string AlarmConfiguration::getFlashLightRelaisDeviceNode() const noexcept
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     return std::string ( _flashlightrelaisdevicenode.toUtf8().data() );
 }
 
 void AlarmConfiguration::setFlashLightRelaisDevideNode ( const std::string& newSetting )
 {
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
     _flashlightrelaisdevicenodeitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
 }
 
+std::string AlarmConfiguration::getSnapshotFileLocation() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _snapshotfilelocation.toUtf8().data() );
+}
+
+void AlarmConfiguration::setSnapshotFileLocation ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _snapshotfilelocationitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+unsigned int AlarmConfiguration::getSnapshotMaximumAge() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _snapshotmaximumage;
+}
+
+void AlarmConfiguration::setSnapshotMaximumAge ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _snapshotmaximumageitem->setValue ( newSetting );
+}
+
+std::string AlarmConfiguration::getJournalDirectory() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _journaldirectory.toUtf8().data() );
+}
+
+void AlarmConfiguration::setJournalDirectory ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _journaldirectoryitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+unsigned int AlarmConfiguration::getJournalSegmentSize() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _journalsegmentsize;
+}
+
+void AlarmConfiguration::setJournalSegmentSize ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _journalsegmentsizeitem->setValue ( newSetting );
+}
+
+unsigned int AlarmConfiguration::getJournalRetainedSegments() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _journalretainedsegments;
+}
+
+void AlarmConfiguration::setJournalRetainedSegments ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _journalretainedsegmentsitem->setValue ( newSetting );
+}
+
+std::string AlarmConfiguration::getHistoryDirectory() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _historydirectory.toUtf8().data() );
+}
+
+void AlarmConfiguration::setHistoryDirectory ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _historydirectoryitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+std::string AlarmConfiguration::getCaptureDirectory() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _capturedirectory.toUtf8().data() );
+}
+
+void AlarmConfiguration::setCaptureDirectory ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _capturedirectoryitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+std::string AlarmConfiguration::getMetricsEndpoint() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _metricsendpoint.toUtf8().data() );
+}
+
+void AlarmConfiguration::setMetricsEndpoint ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _metricsendpointitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+std::string AlarmConfiguration::getDesktopMetricsDirectory() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _desktopmetricsdirectory.toUtf8().data() );
+}
+
+void AlarmConfiguration::setDesktopMetricsDirectory ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _desktopmetricsdirectoryitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+std::string AlarmConfiguration::getControlSocket() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _controlsocket.toUtf8().data() );
+}
+
+void AlarmConfiguration::setControlSocket ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _controlsocketitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+std::string AlarmConfiguration::getSharedTableName() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _sharedtablename.toUtf8().data() );
+}
+
+void AlarmConfiguration::setSharedTableName ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _sharedtablenameitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+std::string AlarmConfiguration::getChangeFeedEndpoint() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _changefeedendpoint.toUtf8().data() );
+}
+
+void AlarmConfiguration::setChangeFeedEndpoint ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _changefeedendpointitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
+unsigned int AlarmConfiguration::getChangeFeedCapacity() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _changefeedcapacity;
+}
+
+void AlarmConfiguration::setChangeFeedCapacity ( const unsigned int newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _changefeedcapacityitem->setValue ( newSetting );
+}
+
+std::string AlarmConfiguration::getDashboardEndpoint() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return std::string ( _dashboardendpoint.toUtf8().data() );
+}
+
+void AlarmConfiguration::setDashboardEndpoint ( const std::string& newSetting )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _dashboardendpointitem->setValue ( QString::fromUtf8 ( newSetting.c_str() ) );
+}
+
 KSharedConfigPtr AlarmConfiguration::internal()
 {
     return _backend;
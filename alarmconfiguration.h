@@ -38,6 +38,7 @@
 
 #include <deque>
 #include <vector>
+#include <boost/thread.hpp>
 #include <QtCore/QString>
 #include <KDE/KSharedConfig>
 #include <KDE/KConfigGroup>
@@ -76,6 +77,12 @@ private:
      * The skeleton class keeps the information about all established configuration options and their memory locations.
      **/
     KConfigSkeleton _skeleton;
+    /**
+     * @brief Mutex protecting the settings
+     *
+     * an-daemon rereads the configuration on the thread of its control socket while the watcher, flash light and message threads read the settings. Every get and set method, ReReadConfiguration() and WriteConfiguration() therefore lock this mutex. Only the ConfigScreen bypasses it, as it edits the settings through internal_skel() in the GUI thread of the desktop version.
+     **/
+    mutable boost::mutex _mutex;
     /**
      * @brief ActiveMQ URI
      *
@@ -124,6 +131,30 @@ private:
      * If an alarm lasts for longer than this value in seconds, an e-mail will be send to a specific mailing list.
      */
     unsigned int _emailnotificationtimeout;
+    /**
+     * @brief Rate of alarm changes that starts storm mode
+     *
+     * If more alarm changes per second than this value arrive, notifications are summarised and sent less often until the rate has fallen again.
+     */
+    unsigned int _stormthreshold;
+    /**
+     * @brief Time a new alarm must persist before it counts
+     *
+     * Milliseconds, 0 disables this part of the debouncing.
+     */
+    unsigned int _debounceraisedelay;
+    /**
+     * @brief Time an alarm must be clear before it is removed
+     *
+     * Milliseconds, 0 disables this part of the debouncing.
+     */
+    unsigned int _debouncecleardelay;
+    /**
+     * @brief Number of shards of the map of active alarms
+     *
+     * Each shard has its own map lock, so threads applying messages about PVs in different shards do not wait for each other's map lock. The statistics, journal, history, shared table and change feed locks stay shared by all shards.
+     */
+    unsigned int _statusmapshards;
     /**
      * @brief Sender address for alarm e-mail notifications
      *
@@ -154,6 +185,90 @@ private:
      * The relais controlled via this device node is used in the class FlashLight to operate a red flashing light that notifies staff in the lab about an alarm.
      */
     QString _flashlightrelaisdevicenode;
+    /**
+     * @brief Location of the alarm state snapshot file
+     *
+     * AlarmServerConnector regularly writes the map of active alarms to this file and reads it back on startup, so notifications are not sent twice after a restart. An empty string disables the snapshot.
+     */
+    QString _snapshotfilelocation;
+    /**
+     * @brief Age in seconds after which the alarm state snapshot is ignored
+     *
+     * 0 restores the snapshot regardless of its age.
+     */
+    unsigned int _snapshotmaximumage;
+    /**
+     * @brief Directory of the alarm journal
+     *
+     * AlarmServerConnector records every change of the alarm status in a journal located in this directory. An empty string disables the journal.
+     */
+    QString _journaldirectory;
+    /**
+     * @brief Size of a journal segment
+     *
+     * Size in kibibytes after which the AlarmJournal starts a new segment file.
+     */
+    unsigned int _journalsegmentsize;
+    /**
+     * @brief Number of retained journal segments
+     *
+     * If the AlarmJournal has more closed segments, the oldest ones are folded into the base snapshot.
+     */
+    unsigned int _journalretainedsegments;
+    /**
+     * @brief Directory of the alarm history
+     *
+     * AlarmServerConnector stores every change of the alarm status in the columnar AlarmHistoryStore located in this directory for long-term analysis. An empty string disables the history.
+     */
+    QString _historydirectory;
+    /**
+     * @brief Directory of the message captures
+     *
+     * CMSClient records every message received from the message broker in a MessageCapture file in this directory, so the traffic can be replayed later with an-replay. An empty string disables the capture.
+     */
+    QString _capturedirectory;
+    /**
+     * @brief Endpoint for metrics scrapes
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves its runtime metrics in the Prometheus text format. An empty string disables the metrics endpoint.
+     */
+    QString _metricsendpoint;
+    /**
+     * @brief Directory for the metrics sockets of the desktop widgets
+     *
+     * Each desktop widget serves its runtime metrics on the Unix domain socket an-desktop-UID.sock in this directory, UID being the numeric ID of the user. An empty string disables the metrics of the desktop widgets.
+     */
+    QString _desktopmetricsdirectory;
+    /**
+     * @brief Path of the control socket
+     *
+     * Path of the Unix domain socket where an-daemon answers queries and commands, see DaemonControl. An empty string disables the control socket.
+     */
+    QString _controlsocket;
+    /**
+     * @brief Name of the shared alarm table
+     *
+     * an-daemon publishes the active alarms in the POSIX shared memory segment with this name, the desktop widgets on the same machine read them from there instead of connecting to the message broker. An empty string disables the shared table.
+     */
+    QString _sharedtablename;
+    /**
+     * @brief Endpoint of the change feed
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves the AlarmChangeFeed. An empty string disables the change feed.
+     */
+    QString _changefeedendpoint;
+    /**
+     * @brief Capacity of the change feed
+     *
+     * Number of recent changes the AlarmChangeFeed keeps, so reconnecting clients can resume without a snapshot.
+     */
+    unsigned int _changefeedcapacity;
+    /**
+     * @brief Endpoint of the dashboard
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves the AlarmEventStream for browser dashboards. An empty string disables the dashboard.
+     */
+    QString _dashboardendpoint;
     /**
      * @brief KConfig item for _activemquri setting
      *
@@ -196,6 +311,30 @@ private:
      * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
      */
     KConfigSkeleton::ItemUInt* _emailnotificationtimeoutitem;
+    /**
+     * @brief KConfig item for _stormthreshold setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _stormthresholditem;
+    /**
+     * @brief KConfig item for _debounceraisedelay setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _debounceraisedelayitem;
+    /**
+     * @brief KConfig item for _debouncecleardelay setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _debouncecleardelayitem;
+    /**
+     * @brief KConfig item for _statusmapshards setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _statusmapshardsitem;
     /**
      * @brief KConfig item for _emailnotificationfrom setting
      *
@@ -226,6 +365,90 @@ private:
      * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
      */
     KConfigSkeleton::ItemString* _flashlightrelaisdevicenodeitem;
+    /**
+     * @brief KConfig item for _snapshotfilelocation setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _snapshotfilelocationitem;
+    /**
+     * @brief KConfig item for _snapshotmaximumage setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _snapshotmaximumageitem;
+    /**
+     * @brief KConfig item for _journaldirectory setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _journaldirectoryitem;
+    /**
+     * @brief KConfig item for _journalsegmentsize setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _journalsegmentsizeitem;
+    /**
+     * @brief KConfig item for _journalretainedsegments setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _journalretainedsegmentsitem;
+    /**
+     * @brief KConfig item for _historydirectory setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _historydirectoryitem;
+    /**
+     * @brief KConfig item for _capturedirectory setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _capturedirectoryitem;
+    /**
+     * @brief KConfig item for _metricsendpoint setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _metricsendpointitem;
+    /**
+     * @brief KConfig item for _desktopmetricsdirectory setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _desktopmetricsdirectoryitem;
+    /**
+     * @brief KConfig item for _controlsocket setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _controlsocketitem;
+    /**
+     * @brief KConfig item for _sharedtablename setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _sharedtablenameitem;
+    /**
+     * @brief KConfig item for _changefeedendpoint setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _changefeedendpointitem;
+    /**
+     * @brief KConfig item for _changefeedcapacity setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemUInt* _changefeedcapacityitem;
+    /**
+     * @brief KConfig item for _dashboardendpoint setting
+     *
+     * KConfig subclass to represent one setting in the configuration file. It reads the configuration from the file, stores it in the aforementioned variable and is also used to correctly change the setting within the KConfig framework.
+     */
+    KConfigSkeleton::ItemString* _dashboardendpointitem;
     /**
      * @brief Establish location of the configuration file
      *
@@ -250,6 +473,27 @@ private:
      * @return Nothing
      */
     void CreateActiveMQConnectivitySettings();
+    /**
+     * @brief Create persistence settings
+     *
+     * Creates the KConfig items for the settings regarding the files the AlarmNotifications daemon keeps on disk between two runs.
+     * @return Nothing
+     */
+    void CreatePersistenceSettings();
+    /**
+     * @brief Create monitoring settings
+     *
+     * Creates the KConfig items for the settings regarding the monitoring of the AlarmNotifications daemon itself.
+     * @return Nothing
+     */
+    void CreateMonitoringSettings();
+    /**
+     * @brief Create local client settings
+     *
+     * Creates the KConfig items for the settings regarding the programs on the same machine that obtain the alarms from the AlarmNotifications daemon.
+     * @return Nothing
+     */
+    void CreateLocalClientSettings();
 public:
     /**
      * @brief Get singleton instance
@@ -434,6 +678,74 @@ public:
      * @return Nothing
      */
     void setEMailNotificationTimeout ( const unsigned int newSetting );
+    /**
+     * @brief Rate of alarm changes that starts storm mode
+     *
+     * If the average number of alarm changes per second exceeds this value, e.g. because an IOC has rebooted, desktop and e-mail notifications are sent at most every 30 seconds and desktop notifications summarise the alarms by area instead of listing every PV. Storm mode ends when the rate has fallen below half of this value. A value of 0 disables storm detection.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getStormThreshold() const noexcept;
+    /**
+     * @brief Change the rate of alarm changes that starts storm mode
+     *
+     * If the average number of alarm changes per second exceeds this value, notifications are summarised and sent less often. A value of 0 disables storm detection. Takes effect at the next start of the application.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setStormThreshold ( const unsigned int newSetting );
+    /**
+     * @brief Time a new alarm must persist before it counts
+     *
+     * A PV going into alarm is only added to the active alarms after it has stayed in alarm for this number of milliseconds, so a PV flapping around a limit does not raise an alarm with every message. A value of 0 disables this part of the debouncing.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getDebounceRaiseDelay() const noexcept;
+    /**
+     * @brief Change the time a new alarm must persist before it counts
+     *
+     * A PV going into alarm is only added to the active alarms after it has stayed in alarm for this number of milliseconds. A value of 0 disables this part of the debouncing. Takes effect at the next start of the application.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setDebounceRaiseDelay ( const unsigned int newSetting );
+    /**
+     * @brief Time an alarm must be clear before it is removed
+     *
+     * An active alarm is only removed after its PV has stayed clear for this number of milliseconds, so a PV flapping around a limit does not clear and raise its alarm again with every message. A value of 0 disables this part of the debouncing.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getDebounceClearDelay() const noexcept;
+    /**
+     * @brief Change the time an alarm must be clear before it is removed
+     *
+     * An active alarm is only removed after its PV has stayed clear for this number of milliseconds. A value of 0 disables this part of the debouncing. Takes effect at the next start of the application.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setDebounceClearDelay ( const unsigned int newSetting );
+    /**
+     * @brief Number of shards of the map of active alarms
+     *
+     * AlarmServerConnector distributes the PVs over this number of maps by a hash of their name, each with its own lock, so messages injected on several threads only wait for each other's map lock if their PVs share a shard. The ActiveMQ client delivers on a single thread. A value of 0 is treated as 1, which keeps all alarms in a single map.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getStatusMapShards() const noexcept;
+    /**
+     * @brief Change the number of shards of the map of active alarms
+     *
+     * A value of 0 is treated as 1. Takes effect at the next start of the application.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setStatusMapShards ( const unsigned int newSetting );
     /**
      * @brief Sender address for alarm e-mail notifications
      *
@@ -519,6 +831,244 @@ public:
      * @return Nothing
      */
     void setFlashLightRelaisDevideNode ( const std::string& newSetting );
+    /**
+     * @brief Location of the alarm state snapshot file
+     *
+     * AlarmServerConnector regularly writes the map of active alarms to this file and reads it back on startup, so notifications are not sent twice after a restart. An empty string disables the snapshot.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getSnapshotFileLocation() const noexcept;
+    /**
+     * @brief Change the location of the alarm state snapshot file
+     *
+     * AlarmServerConnector regularly writes the map of active alarms to this file and reads it back on startup, so notifications are not sent twice after a restart. An empty string disables the snapshot.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setSnapshotFileLocation ( const std::string& newSetting );
+    /**
+     * @brief Age after which the alarm state snapshot is ignored
+     *
+     * The CSS alarm server does not repeat the state of PVs that have been cleared while an-daemon was not running, so the alarms of an old snapshot would stay active for good. A snapshot written more than this number of seconds before the start is therefore not restored. A value of 0 restores the snapshot regardless of its age.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getSnapshotMaximumAge() const noexcept;
+    /**
+     * @brief Change the age after which the alarm state snapshot is ignored
+     *
+     * A value of 0 restores the snapshot regardless of its age. Takes effect at the next start of the application.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setSnapshotMaximumAge ( const unsigned int newSetting );
+    /**
+     * @brief Directory of the alarm journal
+     *
+     * AlarmServerConnector records every change of the alarm status in a journal located in this directory. An empty string disables the journal.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getJournalDirectory() const noexcept;
+    /**
+     * @brief Change the directory of the alarm journal
+     *
+     * AlarmServerConnector records every change of the alarm status in a journal located in this directory. An empty string disables the journal.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setJournalDirectory ( const std::string& newSetting );
+    /**
+     * @brief Size of a journal segment
+     *
+     * Size in kibibytes after which the AlarmJournal starts a new segment file.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getJournalSegmentSize() const noexcept;
+    /**
+     * @brief Change the size of a journal segment
+     *
+     * Size in kibibytes after which the AlarmJournal starts a new segment file.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setJournalSegmentSize ( const unsigned int newSetting );
+    /**
+     * @brief Number of retained journal segments
+     *
+     * If the AlarmJournal has more closed segments, the oldest ones are folded into the base snapshot.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getJournalRetainedSegments() const noexcept;
+    /**
+     * @brief Change the number of retained journal segments
+     *
+     * If the AlarmJournal has more closed segments, the oldest ones are folded into the base snapshot.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setJournalRetainedSegments ( const unsigned int newSetting );
+    /**
+     * @brief Directory of the alarm history
+     *
+     * AlarmServerConnector stores every change of the alarm status in the columnar AlarmHistoryStore located in this directory for long-term analysis. An empty string disables the history.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getHistoryDirectory() const noexcept;
+    /**
+     * @brief Change the directory of the alarm history
+     *
+     * AlarmServerConnector stores every change of the alarm status in the columnar AlarmHistoryStore located in this directory for long-term analysis. An empty string disables the history.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setHistoryDirectory ( const std::string& newSetting );
+    /**
+     * @brief Directory of the message captures
+     *
+     * CMSClient records every message received from the message broker in a MessageCapture file in this directory, so the traffic can be replayed later with an-replay. An empty string disables the capture.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getCaptureDirectory() const noexcept;
+    /**
+     * @brief Change the directory of the message captures
+     *
+     * CMSClient records every message received from the message broker in a MessageCapture file in this directory, so the traffic can be replayed later with an-replay. An empty string disables the capture.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setCaptureDirectory ( const std::string& newSetting );
+    /**
+     * @brief Endpoint for metrics scrapes
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves its runtime metrics in the Prometheus text format. An empty string disables the metrics endpoint.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getMetricsEndpoint() const noexcept;
+    /**
+     * @brief Change the endpoint for metrics scrapes
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves its runtime metrics in the Prometheus text format. An empty string disables the metrics endpoint.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setMetricsEndpoint ( const std::string& newSetting );
+    /**
+     * @brief Directory for the metrics sockets of the desktop widgets
+     *
+     * Each desktop widget serves its runtime metrics on the Unix domain socket an-desktop-UID.sock in this directory, UID being the numeric ID of the user. An empty string disables the metrics of the desktop widgets.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getDesktopMetricsDirectory() const noexcept;
+    /**
+     * @brief Change the directory for the metrics sockets of the desktop widgets
+     *
+     * Each desktop widget serves its runtime metrics on the Unix domain socket an-desktop-UID.sock in this directory, UID being the numeric ID of the user. An empty string disables the metrics of the desktop widgets.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setDesktopMetricsDirectory ( const std::string& newSetting );
+    /**
+     * @brief Path of the control socket
+     *
+     * Path of the Unix domain socket where an-daemon answers queries and commands, see DaemonControl. An empty string disables the control socket.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getControlSocket() const noexcept;
+    /**
+     * @brief Change the path of the control socket
+     *
+     * Path of the Unix domain socket where an-daemon answers queries and commands, see DaemonControl. An empty string disables the control socket.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setControlSocket ( const std::string& newSetting );
+    /**
+     * @brief Name of the shared alarm table
+     *
+     * an-daemon publishes the active alarms in the POSIX shared memory segment with this name, the desktop widgets on the same machine read them from there instead of connecting to the message broker. An empty string disables the shared table.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getSharedTableName() const noexcept;
+    /**
+     * @brief Change the name of the shared alarm table
+     *
+     * an-daemon publishes the active alarms in the POSIX shared memory segment with this name, the desktop widgets on the same machine read them from there instead of connecting to the message broker. An empty string disables the shared table.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setSharedTableName ( const std::string& newSetting );
+    /**
+     * @brief Endpoint of the change feed
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves the AlarmChangeFeed. An empty string disables the change feed.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getChangeFeedEndpoint() const noexcept;
+    /**
+     * @brief Change the endpoint of the change feed
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves the AlarmChangeFeed. An empty string disables the change feed.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setChangeFeedEndpoint ( const std::string& newSetting );
+    /**
+     * @brief Capacity of the change feed
+     *
+     * Number of recent changes the AlarmChangeFeed keeps, so reconnecting clients can resume without a snapshot.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    unsigned int getChangeFeedCapacity() const noexcept;
+    /**
+     * @brief Change the capacity of the change feed
+     *
+     * Number of recent changes the AlarmChangeFeed keeps, so reconnecting clients can resume without a snapshot.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setChangeFeedCapacity ( const unsigned int newSetting );
+    /**
+     * @brief Endpoint of the dashboard
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves the AlarmEventStream for browser dashboards. An empty string disables the dashboard.
+     *
+     * This method cannot throw exceptions.
+     * @return The requested setting
+     */
+    std::string getDashboardEndpoint() const noexcept;
+    /**
+     * @brief Change the endpoint of the dashboard
+     *
+     * Path of a Unix domain socket or TCP port on the loopback interface where an-daemon serves the AlarmEventStream for browser dashboards. An empty string disables the dashboard.
+     * @param newSetting New configuration value
+     * @return Nothing
+     */
+    void setDashboardEndpoint ( const std::string& newSetting );
     /**
      * @brief INTERNAL METHOD: Shared pointer to KConfig instance
      *
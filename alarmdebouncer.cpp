@@ -0,0 +1,135 @@
+/**
+ * @file alarmdebouncer.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Debouncing of flapping alarms
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmdebouncer.h"
+
+using namespace AlarmNotifications;
+
+AlarmDebouncer::AlarmDebouncer ( const unsigned int raiseDelay, const unsigned int clearDelay ) noexcept
+    : _raisedelay ( static_cast<int64_t> ( raiseDelay ) * 1000000 ),
+      _cleardelay ( static_cast<int64_t> ( clearDelay ) * 1000000 )
+{
+}
+
+bool AlarmDebouncer::enabled() const noexcept
+{
+    return _raisedelay != 0 || _cleardelay != 0;
+}
+
+int64_t AlarmDebouncer::shortestDelay() const noexcept
+{
+    if ( _raisedelay == 0 || _cleardelay == 0 )
+        return _raisedelay + _cleardelay;
+    return _raisedelay < _cleardelay ? _raisedelay : _cleardelay;
+}
+
+void AlarmDebouncer::hold ( const AlarmStatusEntry& status, const bool clearing, const int64_t now )
+{
+    auto entry = _pending.find ( status.getPVName() );
+    if ( entry != _pending.end() )
+    {
+        const time_t triggertime = ( *entry ).second.message.getTriggerTime();
+        ( *entry ).second.message = status;
+        if ( !clearing )
+            ( *entry ).second.message.setTriggerTime ( triggertime );
+        return;
+    }
+    const int64_t deadline = now + ( clearing ? _cleardelay : _raisedelay );
+    Pending pending = { status, deadline, clearing };
+    _pending.insert ( std::make_pair ( status.getPVName(), std::move ( pending ) ) );
+    _deadlines.push ( Deadline ( deadline, status.getPVName() ) );
+}
+
+bool AlarmDebouncer::admit ( const AlarmStatusEntry& status, const bool clearing, const bool active, const int64_t now )
+{
+    if ( !enabled() )
+        return true;
+    auto entry = _pending.find ( status.getPVName() );
+    if ( entry != _pending.end() && ( *entry ).second.clearing != clearing )
+    {
+        // The PV has flipped back before the delay has passed: An active alarm stays, a new one never counts
+        _pending.erase ( entry );
+        return active;
+    }
+    if ( clearing )
+    {
+        if ( !active || _cleardelay == 0 )
+            return true;
+        hold ( status, true, now );
+        return false;
+    }
+    if ( active || _raisedelay == 0 )
+        return true;
+    hold ( status, false, now );
+    return false;
+}
+
+int64_t AlarmDebouncer::due ( const int64_t now, std::vector<std::string>& pvnames )
+{
+    pvnames.clear();
+    while ( !_deadlines.empty() )
+    {
+        const Deadline& next = _deadlines.top();
+        auto entry = _pending.find ( next.second );
+        if ( entry == _pending.end() || ( *entry ).second.deadline != next.first )
+        {
+            _deadlines.pop(); // Cancelled
+            continue;
+        }
+        if ( next.first > now )
+            return next.first;
+        pvnames.push_back ( next.second );
+        _deadlines.pop();
+    }
+    return 0;
+}
+
+bool AlarmDebouncer::release ( const std::string& pvname, const int64_t now, AlarmStatusEntry& status )
+{
+    auto entry = _pending.find ( pvname );
+    if ( entry == _pending.end() || ( *entry ).second.deadline > now )
+        return false;
+    status = std::move ( ( *entry ).second.message );
+    _pending.erase ( entry );
+    return true;
+}
+
+bool AlarmDebouncer::holds ( const std::string& pvname ) const noexcept
+{
+    return !_pending.empty() && _pending.find ( pvname ) != _pending.end();
+}
+
+size_t AlarmDebouncer::size() const noexcept
+{
+    return _pending.size();
+}
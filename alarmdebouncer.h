@@ -0,0 +1,203 @@
+/**
+ * @file alarmdebouncer.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Debouncing of flapping alarms
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMDEBOUNCER_H
+#define ALARMDEBOUNCER_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "alarmstatusentry.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Debouncing of flapping alarms
+ *
+ * A PV oscillating around an alarm limit raises and clears its alarm with every message. Without debouncing, every message inserts the PV into the map of active alarms of AlarmServerConnector or erases it again, which churns the map, the journal and all local clients, and restarts the notification timeouts.
+ *
+ * With debouncing, a new alarm is held back here until it has persisted for the raise delay, and the clearing of an active alarm is held back until the PV has stayed clear for the clear delay. A message cancelling a held-back change before its delay has passed is applied immediately if the PV is in alarm, or dropped together with the held-back change. If several messages for the same held-back change arrive, the latest one is applied when the delay has passed, but the delay still counts from the first one.
+ *
+ * The held-back messages are kept in a table by PV name, and their deadlines in a priority queue, so the next deadline is known in constant time and a thread can sleep exactly until then instead of scanning the table. Entries of the queue whose change has been cancelled are skipped when they come up. This class does not lock: AlarmServerConnector keeps one instance per shard of its map of active alarms and only uses it under the lock of that shard.
+ */
+class AlarmDebouncer final
+{
+private:
+    /**
+     * @brief A held-back change
+     */
+    struct Pending
+    {
+        /**
+         * @brief The latest message of the change
+         */
+        AlarmStatusEntry message;
+        /**
+         * @brief Monotonic time in nanoseconds the change is applied
+         */
+        int64_t deadline;
+        /**
+         * @brief true if the change clears an active alarm, false if it raises a new alarm
+         */
+        bool clearing;
+    };
+    /**
+     * @brief Deadline and PV name in the priority queue
+     */
+    typedef std::pair<int64_t, std::string> Deadline;
+    /**
+     * @brief Time in nanoseconds a new alarm must persist before it is applied, 0 to apply it immediately
+     */
+    const int64_t _raisedelay;
+    /**
+     * @brief Time in nanoseconds an active alarm must stay clear before it is removed, 0 to remove it immediately
+     */
+    const int64_t _cleardelay;
+    /**
+     * @brief Held-back changes by PV name
+     */
+    std::unordered_map<std::string, Pending> _pending;
+    /**
+     * @brief Deadlines of the held-back changes, the earliest first
+     *
+     * May contain deadlines of changes that have been cancelled, see due().
+     */
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> _deadlines;
+
+    /**
+     * @brief Hold a change back
+     *
+     * Replaces the message of a change already held back for the PV, keeping its deadline and, for an alarm, the trigger time of the first message, so the notification timeouts count from the first alarm message.
+     * @param status The message
+     * @param clearing true if the message clears an active alarm
+     * @param now Current monotonic time in nanoseconds
+     * @return Nothing
+     */
+    void hold ( const AlarmStatusEntry& status, const bool clearing, const int64_t now );
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param raiseDelay Milliseconds a new alarm must persist before it is applied, 0 to apply new alarms immediately
+     * @param clearDelay Milliseconds an active alarm must stay clear before it is removed, 0 to remove cleared alarms immediately
+     */
+    AlarmDebouncer ( const unsigned int raiseDelay, const unsigned int clearDelay ) noexcept;
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmDebouncer
+     */
+    AlarmDebouncer ( const AlarmDebouncer& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmDebouncer
+     * @return Nothing (deleted)
+     */
+    AlarmDebouncer& operator= ( const AlarmDebouncer& other ) = delete;
+    /**
+     * @brief Check whether debouncing is enabled
+     *
+     * This method cannot throw exceptions.
+     * @return true if at least one of the delays is not 0
+     */
+    bool enabled() const noexcept;
+    /**
+     * @brief Shortest delay in nanoseconds
+     *
+     * A change held back from now on is not due before this time has passed, so a thread waiting for due changes can sleep that long when no change is held back. 0 if debouncing is disabled.
+     *
+     * This method cannot throw exceptions.
+     * @return The shorter one of the delays that are not 0
+     */
+    int64_t shortestDelay() const noexcept;
+    /**
+     * @brief Decide whether a message is applied now
+     *
+     * Holds the message back, cancels a held-back change or lets the message through, as described above.
+     * @param status The message
+     * @param clearing true if the message clears the alarm of the PV
+     * @param active true if the PV is in the map of active alarms
+     * @param now Current monotonic time in nanoseconds
+     * @return true if the message is to be applied now, false if it has been held back or dropped
+     */
+    bool admit ( const AlarmStatusEntry& status, const bool clearing, const bool active, const int64_t now );
+    /**
+     * @brief Collect the PVs whose held-back change is due
+     *
+     * The changes stay in the table until release() is called for each PV.
+     * @param now Current monotonic time in nanoseconds
+     * @param pvnames Receives the PV names, previous content is removed
+     * @return Deadline of the next change that is not due yet, 0 if no other change is held back
+     */
+    int64_t due ( const int64_t now, std::vector<std::string>& pvnames );
+    /**
+     * @brief Take a due change out of the table
+     *
+     * @param pvname PV name returned by due()
+     * @param now Current monotonic time in nanoseconds
+     * @param status Receives the message to be applied
+     * @return true if a change is held back for the PV and due, false if it has been cancelled in the meantime
+     */
+    bool release ( const std::string& pvname, const int64_t now, AlarmStatusEntry& status );
+    /**
+     * @brief Check whether a change is held back for a PV
+     *
+     * This method cannot throw exceptions.
+     * @param pvname PV name
+     * @return true if a change of the PV is in the table
+     */
+    bool holds ( const std::string& pvname ) const noexcept;
+    /**
+     * @brief Number of held-back changes
+     *
+     * This method cannot throw exceptions.
+     * @return Number of PVs in the table
+     */
+    size_t size() const noexcept;
+};
+
+}
+
+#endif // ALARMDEBOUNCER_H
@@ -0,0 +1,373 @@
+/**
+ * @file alarmeventstream.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Live alarm stream for browser dashboards
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmeventstream.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#include "jsonencoding.h"
+
+using namespace AlarmNotifications;
+
+const unsigned int AlarmEventStream::tickInterval;
+const unsigned int AlarmEventStream::keepAliveInterval;
+const size_t AlarmEventStream::maximumSubscribers;
+const size_t AlarmEventStream::maximumBacklog;
+
+// Maximum length of the HTTP request header
+static const size_t maximumRequestLength = 8192;
+
+// Names of the transition types in the changes event, indexed by AlarmTransition::TransitionType
+static const char*const transitionNames[] = { "", "raised", "updated", "cleared" };
+
+// The built-in dashboard, served for every path except /events
+static const char dashboardPage[] =
+    "<!DOCTYPE html>\n"
+    "<html><head><meta charset=\"utf-8\"><title>Active alarms</title><style>\n"
+    "body{font-family:sans-serif;background:#111;color:#eee;margin:1em}table{border-collapse:collapse;width:100%}\n"
+    "th,td{padding:.3em .6em;text-align:left}.MINOR{background:#a60}.MAJOR{background:#a00}.INVALID{background:#609}\n"
+    "</style></head><body><h1 id=\"title\">Connecting...</h1><table><thead><tr><th>PV</th><th>Severity</th><th>Status</th><th>Since</th></tr></thead>\n"
+    "<tbody id=\"alarms\"></tbody></table><script>\n"
+    "var alarms={};\n"
+    "function render(){var body=document.getElementById('alarms'),names=Object.keys(alarms).sort();body.innerHTML='';\n"
+    "names.forEach(function(pv){var a=alarms[pv],row=document.createElement('tr');row.className=a.severity.replace('_ACK','');\n"
+    "[pv,a.severity,a.status,new Date(a.since).toLocaleString()].forEach(function(text){var cell=document.createElement('td');cell.textContent=text;row.appendChild(cell);});\n"
+    "body.appendChild(row);});document.getElementById('title').textContent=names.length+' active alarms';}\n"
+    "var source=new EventSource('/events');\n"
+    "source.addEventListener('snapshot',function(e){alarms={};JSON.parse(e.data).alarms.forEach(function(a){alarms[a.pv]=a;});render();});\n"
+    "source.addEventListener('changes',function(e){JSON.parse(e.data).changes.forEach(function(c){if(c.type==='cleared')delete alarms[c.pv];\n"
+    "else alarms[c.pv]={pv:c.pv,severity:c.severity,status:c.status,since:alarms[c.pv]?alarms[c.pv].since:c.time};});render();});\n"
+    "source.onerror=function(){document.getElementById('title').textContent='Connection to an-daemon lost, reconnecting...';};\n"
+    "</script></body></html>\n";
+
+AlarmEventStream::AlarmEventStream ( const std::string& endpoint, const SnapshotProvider& snapshot )
+    : _snapshot ( snapshot ),
+      _nextsubscriber ( 0 ),
+      _run ( true ),
+      _ticker ( boost::bind ( &AlarmEventStream::tick, this ) )
+{
+    try
+    {
+        _server.reset ( new LocalSocketServer ( endpoint, [this] ( int fd )
+        {
+            accept ( fd );
+        } ) );
+    }
+    catch ( ... )
+    {
+        stop();
+        throw;
+    }
+}
+
+AlarmEventStream::~AlarmEventStream()
+{
+    stop();
+}
+
+void AlarmEventStream::append ( const AlarmTransition& transition )
+{
+    boost::lock_guard<boost::mutex> lock ( _pendingmutex );
+    _pending[transition.pvname] = transition;
+}
+
+void AlarmEventStream::stop() noexcept
+{
+    _server.reset(); // No new subscribers from here on
+    {
+        boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+        _run = false;
+    }
+    _stopping.notify_all();
+    if ( _ticker.joinable() )
+        _ticker.join();
+    std::map<unsigned int, std::unique_ptr<Subscriber> > subscribers;
+    {
+        boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+        for ( auto i = _subscribers.begin(); i != _subscribers.end(); i++ )
+        {
+            ( *i ).second->closed = true;
+            ( *i ).second->ready.notify_all();
+            shutdown ( ( *i ).second->fd, SHUT_RDWR ); // Wakes up a thread blocked in send()
+        }
+        subscribers.swap ( _subscribers );
+        _finished.clear();
+    }
+    for ( auto i = subscribers.begin(); i != subscribers.end(); i++ )
+    {
+        ( *i ).second->thread.join();
+        close ( ( *i ).second->fd );
+    }
+}
+
+void AlarmEventStream::tick() noexcept
+{
+    unsigned int quietTicks = 0;
+    while ( true )
+    {
+        {
+            boost::unique_lock<boost::mutex> lock ( _subscribersmutex );
+            if ( _run )
+                _stopping.timed_wait ( lock, boost::posix_time::milliseconds ( tickInterval ) );
+            if ( !_run )
+                return;
+            reapSubscribers();
+        }
+        try
+        {
+            const bool keepAlive = ++quietTicks >= keepAliveInterval * 1000 / tickInterval;
+            if ( publish ( keepAlive ) )
+                quietTicks = 0;
+        }
+        catch ( ... )
+        {
+            // Out of memory or the snapshot has failed, the next tick tries again
+        }
+    }
+}
+
+bool AlarmEventStream::publish ( const bool keepAlive )
+{
+    std::unordered_map<std::string, AlarmTransition> pending;
+    {
+        boost::lock_guard<boost::mutex> lock ( _pendingmutex );
+        pending.swap ( _pending );
+    }
+    std::shared_ptr<const std::string> changes;
+    if ( !pending.empty() )
+    {
+        std::string data ( "event: changes\ndata: {\"changes\":[" );
+        for ( auto i = pending.begin(); i != pending.end(); i++ )
+        {
+            if ( i != pending.begin() )
+                data.push_back ( ',' );
+            data.append ( changeToJSON ( ( *i ).second ) );
+        }
+        data.append ( "]}\n\n" );
+        changes = std::make_shared<const std::string> ( std::move ( data ) );
+    }
+    bool newcomers = false;
+    {
+        boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+        for ( auto i = _subscribers.begin(); i != _subscribers.end() && !newcomers; i++ )
+            newcomers = ! ( *i ).second->active;
+    }
+    // Taken after the changes have been collected, so later changes go into the next event
+    std::shared_ptr<const std::string> snapshot;
+    if ( newcomers )
+    {
+        std::vector<AlarmTransition> active;
+        _snapshot ( active );
+        std::ostringstream data;
+        data << "event: snapshot\ndata: {\"alarms\":[";
+        for ( auto i = active.begin(); i != active.end(); i++ )
+        {
+            if ( i != active.begin() )
+                data << ",";
+            data << "{\"pv\":" << quoteJSON ( ( *i ).pvname )
+                 << ",\"severity\":\"" << AlarmStatusEntry::severityLevelToString ( ( *i ).severity )
+                 << "\",\"status\":" << quoteJSON ( ( *i ).status )
+                 << ",\"since\":" << ( *i ).wallTime / 1000000 << "}";
+        }
+        data << "]}\n\n";
+        snapshot = std::make_shared<const std::string> ( data.str() );
+    }
+    static const std::shared_ptr<const std::string> comment = std::make_shared<const std::string> ( ": keep-alive\n\n" );
+    const std::shared_ptr<const std::string>& update = changes ? changes : ( keepAlive ? comment : changes );
+    bool queued = false;
+    boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+    for ( auto i = _subscribers.begin(); i != _subscribers.end(); i++ )
+    {
+        Subscriber& subscriber = * ( *i ).second;
+        if ( subscriber.closed )
+            continue;
+        if ( !subscriber.active )
+        {
+            if ( !snapshot )
+                continue; // Has connected after the snapshot, gets the next one
+            subscriber.queue.push_back ( snapshot );
+            subscriber.active = true;
+        }
+        else if ( update )
+        {
+            if ( subscriber.queue.size() >= maximumBacklog )
+            {
+                // Too slow for the changes, the browser reconnects and starts over with a snapshot
+                subscriber.closed = true;
+                shutdown ( subscriber.fd, SHUT_RDWR );
+            }
+            else
+                subscriber.queue.push_back ( update );
+        }
+        else
+            continue;
+        subscriber.ready.notify_one();
+        queued = true;
+    }
+    return queued;
+}
+
+void AlarmEventStream::reapSubscribers() noexcept
+{
+    for ( auto i = _finished.begin(); i != _finished.end(); i++ )
+    {
+        auto subscriber = _subscribers.find ( *i );
+        if ( subscriber == _subscribers.end() )
+            continue;
+        ( *subscriber ).second->thread.join(); // Has returned from serve() already
+        close ( ( *subscriber ).second->fd );
+        _subscribers.erase ( subscriber );
+    }
+    _finished.clear();
+}
+
+void AlarmEventStream::accept ( const int fd )
+{
+    std::string request;
+    char buffer[1024];
+    while ( request.find ( "\r\n\r\n" ) == std::string::npos && request.find ( "\n\n" ) == std::string::npos )
+    {
+        const ssize_t received = recv ( fd, buffer, sizeof ( buffer ), 0 );
+        if ( received <= 0 || request.length() > maximumRequestLength )
+            return; // Not a complete HTTP request
+        request.append ( buffer, static_cast<size_t> ( received ) );
+    }
+    std::istringstream parser ( request );
+    std::string method;
+    std::string path;
+    parser >> method >> path;
+    if ( method != "GET" )
+    {
+        send ( fd, "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n" );
+        return;
+    }
+    if ( path != "/events" )
+    {
+        std::ostringstream response;
+        response << "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: " << sizeof ( dashboardPage ) - 1
+                 << "\r\nConnection: close\r\n\r\n" << dashboardPage;
+        send ( fd, response.str() );
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+    if ( !_run || _subscribers.size() >= maximumSubscribers )
+    {
+        send ( fd, "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 10\r\nContent-Length: 0\r\nConnection: close\r\n\r\n" );
+        return;
+    }
+    // The server closes fd when this method returns, the subscriber thread needs a connection of its own
+    const int connection = fcntl ( fd, F_DUPFD_CLOEXEC, 0 );
+    if ( connection < 0 )
+        throw std::runtime_error ( std::string ( "Cannot duplicate the connection of a dashboard: " ) + strerror ( errno ) );
+    const unsigned int id = _nextsubscriber++;
+    try
+    {
+        std::unique_ptr<Subscriber>& subscriber = _subscribers[id];
+        subscriber.reset ( new Subscriber() );
+        subscriber->fd = connection;
+        subscriber->active = false;
+        subscriber->closed = false;
+        // Sent by the thread, so a slow browser does not hold up the server
+        subscriber->queue.push_back ( std::make_shared<const std::string> (
+                                          "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\nretry: 2000\n\n" ) );
+        subscriber->thread = boost::thread ( boost::bind ( &AlarmEventStream::serve, this, boost::ref ( *subscriber ), id ) );
+    }
+    catch ( ... )
+    {
+        _subscribers.erase ( id );
+        close ( connection );
+        throw;
+    }
+}
+
+void AlarmEventStream::serve ( Subscriber& subscriber, const unsigned int id ) noexcept
+{
+    try
+    {
+        while ( true )
+        {
+            std::shared_ptr<const std::string> event;
+            {
+                boost::unique_lock<boost::mutex> lock ( _subscribersmutex );
+                while ( subscriber.queue.empty() && !subscriber.closed )
+                    subscriber.ready.wait ( lock );
+                if ( subscriber.closed )
+                    break;
+                event = subscriber.queue.front();
+                subscriber.queue.pop_front();
+            }
+            send ( subscriber.fd, *event );
+        }
+    }
+    catch ( ... )
+    {
+        // The browser has been closed, which is nothing to report
+    }
+    boost::lock_guard<boost::mutex> lock ( _subscribersmutex );
+    subscriber.closed = true;
+    _finished.push_back ( id );
+}
+
+std::string AlarmEventStream::changeToJSON ( const AlarmTransition& transition )
+{
+    std::ostringstream json;
+    json << "{\"pv\":" << quoteJSON ( transition.pvname )
+         << ",\"type\":\"" << transitionNames[transition.type]
+         << "\",\"severity\":\"" << AlarmStatusEntry::severityLevelToString ( transition.severity )
+         << "\",\"status\":" << quoteJSON ( transition.status )
+         << ",\"time\":" << transition.wallTime / 1000000 << "}";
+    return json.str();
+}
+
+void AlarmEventStream::send ( const int fd, const std::string& text )
+{
+    size_t sent = 0;
+    while ( sent < text.length() )
+    {
+        const ssize_t result = ::send ( fd, text.data() + sent, text.length() - sent, MSG_NOSIGNAL );
+        if ( result < 0 && errno == EINTR )
+            continue;
+        if ( result <= 0 )
+            throw std::runtime_error ( std::string ( "Cannot send to dashboard: " ) + strerror ( errno ) );
+        sent += static_cast<size_t> ( result );
+    }
+}
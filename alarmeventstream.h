@@ -0,0 +1,284 @@
+/**
+ * @file alarmeventstream.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Live alarm stream for browser dashboards
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMEVENTSTREAM_H
+#define ALARMEVENTSTREAM_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alarmtransition.h"
+#include "localsocketserver.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Live alarm stream for browser dashboards
+ *
+ * A minimal HTTP server on a LocalSocketServer, so dashboards only need a browser and no further services. The path /events is a stream of Server-Sent Events: A new subscriber first receives the event "snapshot" with all active alarms and then the event "changes" whenever alarms have been raised, updated or cleared. Any other path is answered with a small built-in dashboard page showing the active alarms, which runs in any browser.
+ *
+ * AlarmServerConnector passes every change to append() under the lock of its map. The changes are collected per PV, only the latest one of each PV is kept, and a ticker thread serializes them every tickInterval milliseconds into a single event, so an alarm storm results in ten events per second at most. The serialized event is shared by the queues of all subscribers, each of which has a thread of its own writing to its connection, so a slow browser does not delay the others. A subscriber falling more than maximumBacklog events behind is disconnected, the EventSource of the browser reconnects and receives a new snapshot.
+ *
+ * The snapshot for new subscribers is taken by the ticker right after it has collected the changes of the tick, so every change is either contained in the snapshot or sent with a later event. Changes carry the complete state of the PV, so receiving a change the snapshot already contains does no harm.
+ *
+ * The event data is JSON: {"alarms":[{"pv":..., "severity":..., "status":..., "since":...}]} for snapshots and {"changes":[{"pv":..., "type":"raised"|"updated"|"cleared", "severity":..., "status":..., "time":...}]} for changes, times being milliseconds since the Unix epoch, as used by JavaScript.
+ */
+class AlarmEventStream final
+{
+public:
+    /**
+     * @brief Snapshot callback
+     *
+     * Fills the vector with one AlarmTransition per active alarm, its wall clock time being the trigger time of the alarm.
+     */
+    typedef std::function<void ( std::vector<AlarmTransition>& ) > SnapshotProvider;
+    /**
+     * @brief Interval in milliseconds in which changes are collected into one event
+     */
+    static const unsigned int tickInterval = 100;
+    /**
+     * @brief Interval in seconds of the comments sent while nothing changes
+     *
+     * Keeps proxies from closing the connection and lets the daemon notice closed browsers.
+     */
+    static const unsigned int keepAliveInterval = 15;
+    /**
+     * @brief Maximum number of subscribers
+     */
+    static const size_t maximumSubscribers = 64;
+    /**
+     * @brief Maximum number of events waiting for a subscriber before it is disconnected
+     */
+    static const size_t maximumBacklog = 100;
+private:
+    /**
+     * @brief A connected browser
+     */
+    struct Subscriber
+    {
+        /**
+         * @brief Connection, closed after the thread has been joined
+         */
+        int fd;
+        /**
+         * @brief Set once the snapshot has been queued, changes are only queued after it
+         */
+        bool active;
+        /**
+         * @brief Set to end the thread
+         */
+        bool closed;
+        /**
+         * @brief Serialized events waiting to be written, shared with the other subscribers
+         */
+        std::deque<std::shared_ptr<const std::string> > queue;
+        /**
+         * @brief Signalled when an event has been queued or the subscriber is closed
+         */
+        boost::condition_variable ready;
+        /**
+         * @brief Thread running serve()
+         */
+        boost::thread thread;
+    };
+    /**
+     * @brief Callback taking a snapshot of the active alarms
+     */
+    const SnapshotProvider _snapshot;
+    /**
+     * @brief Latest change of each PV since the last tick
+     *
+     * Protected by _pendingmutex.
+     */
+    std::unordered_map<std::string, AlarmTransition> _pending;
+    /**
+     * @brief Protects _pending
+     */
+    boost::mutex _pendingmutex;
+    /**
+     * @brief Connected browsers by ID
+     *
+     * The subscribers and their queues are protected by _subscribersmutex.
+     */
+    std::map<unsigned int, std::unique_ptr<Subscriber> > _subscribers;
+    /**
+     * @brief IDs of subscribers whose thread has finished
+     *
+     * Their threads are joined and their connections closed by the next tick. Protected by _subscribersmutex.
+     */
+    std::vector<unsigned int> _finished;
+    /**
+     * @brief ID of the next subscriber
+     */
+    unsigned int _nextsubscriber;
+    /**
+     * @brief Protects _subscribers, _finished, _nextsubscriber and _run
+     */
+    boost::mutex _subscribersmutex;
+    /**
+     * @brief Signalled by stop() to wake up the ticker
+     */
+    boost::condition_variable _stopping;
+    /**
+     * @brief Run flag of the ticker
+     */
+    bool _run;
+    /**
+     * @brief Thread running tick()
+     */
+    boost::thread _ticker;
+    /**
+     * @brief Server accepting the connections
+     *
+     * Created last in the constructor.
+     */
+    std::unique_ptr<LocalSocketServer> _server;
+
+    /**
+     * @brief Ticker thread
+     *
+     * Calls publish() every tickInterval milliseconds until stop() is called.
+     * @return Nothing
+     */
+    void tick() noexcept;
+    /**
+     * @brief Send the changes of one tick
+     *
+     * Serializes the pending changes and, if there are new subscribers, a snapshot, and queues them for the subscribers.
+     * @param keepAlive true to send a comment to all subscribers if there are no changes
+     * @return true if an event or comment has been queued
+     */
+    bool publish ( const bool keepAlive );
+    /**
+     * @brief Join the threads of finished subscribers
+     *
+     * Has to be called with _subscribersmutex locked.
+     * @return Nothing
+     */
+    void reapSubscribers() noexcept;
+    /**
+     * @brief Answer an HTTP request
+     *
+     * Handler of the LocalSocketServer. Answers with the dashboard page or, for /events, registers a subscriber and starts its thread.
+     * @param fd The accepted connection
+     * @return Nothing
+     */
+    void accept ( const int fd );
+    /**
+     * @brief Write the events of a subscriber
+     *
+     * @param subscriber The subscriber
+     * @param id ID of the subscriber in _subscribers
+     * @return Nothing
+     */
+    void serve ( Subscriber& subscriber, const unsigned int id ) noexcept;
+    /**
+     * @brief Serialize a transition for the changes event
+     *
+     * @param transition The transition
+     * @return A JSON object
+     */
+    static std::string changeToJSON ( const AlarmTransition& transition );
+    /**
+     * @brief Send data to a browser
+     *
+     * @param fd The connection
+     * @param text The data
+     * @return Nothing
+     * @exception std::runtime_error The browser has disconnected or not accepted the data within LocalSocketServer::connectionTimeout seconds
+     */
+    static void send ( const int fd, const std::string& text );
+public:
+    /**
+     * @brief Constructor
+     *
+     * Starts the ticker and accepting connections.
+     * @param endpoint Path of a Unix domain socket or TCP port on the loopback interface, see LocalSocketServer
+     * @param snapshot Callback taking a snapshot of the active alarms
+     * @exception std::runtime_error The socket cannot be created
+     */
+    AlarmEventStream ( const std::string& endpoint, const SnapshotProvider& snapshot );
+    /**
+     * @brief Destructor
+     *
+     * Calls stop().
+     */
+    ~AlarmEventStream();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmEventStream
+     */
+    AlarmEventStream ( const AlarmEventStream& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmEventStream
+     * @return Nothing (deleted)
+     */
+    AlarmEventStream& operator= ( const AlarmEventStream& other ) = delete;
+    /**
+     * @brief Record a change
+     *
+     * Replaces a change of the same PV that has not been sent yet. AlarmServerConnector calls it under the lock of its map of active alarms.
+     * @param transition The change
+     * @return Nothing
+     */
+    void append ( const AlarmTransition& transition );
+    /**
+     * @brief Stop serving browsers
+     *
+     * Closes the endpoint, stops the ticker and disconnects all subscribers. After this method has returned, the snapshot callback is not called anymore. append() can still be called.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void stop() noexcept;
+};
+
+}
+
+#endif // ALARMEVENTSTREAM_H
@@ -0,0 +1,83 @@
+/**
+ * @file alarmfingerprints.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Fingerprints of the last alarm state of each PV
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmfingerprints.h"
+
+#include "alarmsketches.h"
+
+using namespace AlarmNotifications;
+
+const size_t AlarmFingerprints::stripeCount;
+
+AlarmFingerprints::AlarmFingerprints()
+{
+}
+
+uint64_t AlarmFingerprints::fingerprint ( const std::string& severity, const std::string& status )
+{
+    std::string state;
+    state.reserve ( severity.size() + status.size() + 1 );
+    state += severity;
+    state += '\0'; // Separates "AB" + "C" from "A" + "BC"
+    state += status;
+    return sketchHash ( state );
+}
+
+AlarmFingerprints::Stripe& AlarmFingerprints::stripeOf ( const std::string& pvname ) const
+{
+    return _stripes[sketchHash ( pvname ) % stripeCount];
+}
+
+bool AlarmFingerprints::repeats ( const AlarmStatusEntry& status ) const
+{
+    const uint64_t state = fingerprint ( status.getSeverity(), status.getStatus() );
+    Stripe& stripe = stripeOf ( status.getPVName() );
+    boost::lock_guard<boost::mutex> concurrencylock ( stripe.mutex );
+    auto entry = stripe.fingerprints.find ( status.getPVName() );
+    return entry != stripe.fingerprints.end() && ( *entry ).second == state;
+}
+
+void AlarmFingerprints::record ( const AlarmStatusEntry& status )
+{
+    const uint64_t state = fingerprint ( status.getSeverity(), status.getStatus() );
+    Stripe& stripe = stripeOf ( status.getPVName() );
+    boost::lock_guard<boost::mutex> concurrencylock ( stripe.mutex );
+    stripe.fingerprints[status.getPVName()] = state;
+}
+
+void AlarmFingerprints::forget ( const std::string& pvname )
+{
+    Stripe& stripe = stripeOf ( pvname );
+    boost::lock_guard<boost::mutex> concurrencylock ( stripe.mutex );
+    stripe.fingerprints.erase ( pvname );
+}
@@ -0,0 +1,151 @@
+/**
+ * @file alarmfingerprints.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Fingerprints of the last alarm state of each PV
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMFINGERPRINTS_H
+#define ALARMFINGERPRINTS_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <boost/thread.hpp>
+
+#include "alarmstatusentry.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Fingerprints of the active alarm states
+ *
+ * The CSS alarm server re-sends identical STATE messages, e.g. after it has reconnected to the message broker or updated its annunciations. A repeated alarm finds its PV in the map of active alarms with the same severity and status and cannot change anything. AlarmServerConnector therefore checks every message here and drops exact repeats before it takes the lock of its map. Repeated clears are dropped by AlarmPresenceFilter instead.
+ *
+ * For each PV in the map of active alarms, a 64 bit fingerprint of the severity and status of its entry is kept. AlarmServerConnector writes it with record() after it has applied a change, and removes it with forget() when the alarm is cleared or a change of the PV is held back by AlarmDebouncer, all under the lock of the shard of the PV. Messages rejected by AlarmStatusEntry::update() or held back never write their own fingerprint, so the table only contains states that are in the map, and it is not larger than the map. A PV without a fingerprint always passes.
+ *
+ * repeats() is called without the lock of the shard. A message checked while a change of the same PV is being applied by another thread may be compared with the state before that change. The ActiveMQ message source delivers all messages on one thread, so this only concerns message sources injecting the changes of a PV from several threads.
+ *
+ * The table is split into stripes with a mutex each, chosen by the hash of the PV name, so threads checking messages of different PVs rarely wait for each other.
+ */
+class AlarmFingerprints final
+{
+public:
+    /**
+     * @brief Number of stripes
+     */
+    static const size_t stripeCount = 64;
+private:
+    /**
+     * @brief Part of the table with its own mutex
+     */
+    struct Stripe
+    {
+        /**
+         * @brief Mutex protecting the fingerprints of this stripe
+         */
+        boost::mutex mutex;
+        /**
+         * @brief Fingerprint of the last state by PV name
+         */
+        std::unordered_map<std::string, uint64_t> fingerprints;
+    };
+    /**
+     * @brief The stripes of the table
+     */
+    mutable Stripe _stripes[stripeCount];
+    /**
+     * @brief Stripe of a PV
+     *
+     * @param pvname Name of the PV
+     * @return The stripe holding the fingerprint of the PV
+     */
+    Stripe& stripeOf ( const std::string& pvname ) const;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates an empty table.
+     */
+    AlarmFingerprints();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmFingerprints
+     */
+    AlarmFingerprints ( const AlarmFingerprints& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmFingerprints
+     * @return Nothing (deleted)
+     */
+    AlarmFingerprints& operator= ( const AlarmFingerprints& other ) = delete;
+    /**
+     * @brief Fingerprint of an alarm state
+     *
+     * @param severity Alarm severity
+     * @param status Alarm status
+     * @return 64 bit hash of both strings, see sketchHash()
+     */
+    static uint64_t fingerprint ( const std::string& severity, const std::string& status );
+    /**
+     * @brief Check whether a message repeats the active alarm state of its PV
+     *
+     * Does not change the table.
+     * @param status The message
+     * @return true if the PV is in alarm with the same severity and status as the message
+     */
+    bool repeats ( const AlarmStatusEntry& status ) const;
+    /**
+     * @brief Record the active alarm state of a PV
+     *
+     * Called under the lock of the shard of the PV after a change has been applied to the map of active alarms.
+     * @param status The entry of the PV in the map of active alarms
+     */
+    void record ( const AlarmStatusEntry& status );
+    /**
+     * @brief Remove the fingerprint of a PV
+     *
+     * Called under the lock of the shard of the PV when its alarm has been cleared or a change of it is held back, so the following messages of the PV reach the map.
+     * @param pvname Name of the PV
+     */
+    void forget ( const std::string& pvname );
+};
+
+}
+
+#endif // ALARMFINGERPRINTS_H
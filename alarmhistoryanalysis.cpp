@@ -0,0 +1,283 @@
+/**
+ * @file alarmhistoryanalysis.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Parallel statistics over the alarm history
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmhistoryanalysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <boost/thread.hpp>
+
+#include "alarmhistorystore.h"
+#include "alarmtransition.h"
+
+using namespace AlarmNotifications;
+
+namespace
+{
+
+// Everything a single block contributes to the statistics of one PV
+struct BlockSummary
+{
+    uint64_t alarms;
+    uint64_t updates;
+    uint64_t flaps; // Only flaps within the block
+    int64_t timeInAlarm; // Only alarms raised and cleared within the block
+    uint8_t worstSeverity;
+    bool startsInAlarm; // The first transition is not Raised, so the PV was in alarm before the block
+    bool hasLeadingClear; // An alarm raised before the block has been cleared at leadingClear
+    int64_t leadingClear;
+    bool hasFirstRaise; // An alarm has been raised at firstRaise before any alarm was cleared in this block
+    int64_t firstRaise;
+    bool hasClear; // The last alarm cleared within the block was cleared at lastClear
+    int64_t lastClear;
+    bool open; // The block ends with an alarm raised at openSince
+    int64_t openSince;
+};
+
+// One block to be decoded by a worker thread, and the result
+struct BlockTask
+{
+    const AlarmHistorySegment* segment;
+    size_t blockNumber;
+    std::vector<std::pair<uint32_t, BlockSummary>> summaries; // Dictionary ID of the PV and its summary
+};
+
+// Running statistics of one PV while the block summaries are combined
+struct PVState
+{
+    PVStatistics statistics;
+    bool open;
+    int64_t openSince;
+    bool hasClear;
+    int64_t lastClear;
+};
+
+void summariseBlock ( BlockTask& task, AlarmHistorySegment::Block& block, const int64_t from, const int64_t to, const int64_t flapWindow )
+{
+    task.segment->readBlock ( task.blockNumber, block );
+    std::unordered_map<uint32_t, size_t> positions;
+    for ( size_t i = 0; i < block.time.size(); i++ )
+    {
+        const int64_t time = block.time[i];
+        if ( time < from || time > to )
+            continue;
+        auto position = positions.find ( block.pv[i] );
+        if ( position == positions.end() )
+        {
+            BlockSummary summary;
+            memset ( &summary, 0, sizeof ( summary ) );
+            summary.startsInAlarm = block.type[i] != AlarmTransition::Raised;
+            position = positions.insert ( std::make_pair ( block.pv[i], task.summaries.size() ) ).first;
+            task.summaries.push_back ( std::make_pair ( block.pv[i], summary ) );
+        }
+        BlockSummary& summary = task.summaries[ ( *position ).second].second;
+        switch ( block.type[i] )
+        {
+        case AlarmTransition::Raised:
+            summary.alarms++;
+            if ( summary.hasClear && time - summary.lastClear <= flapWindow )
+                summary.flaps++;
+            if ( !summary.hasClear && !summary.hasFirstRaise )
+            {
+                summary.hasFirstRaise = true;
+                summary.firstRaise = time;
+            }
+            summary.open = true;
+            summary.openSince = time;
+            break;
+        case AlarmTransition::Updated:
+            summary.updates++;
+            break;
+        case AlarmTransition::Cleared:
+            if ( summary.open )
+                summary.timeInAlarm += time - summary.openSince;
+            else if ( !summary.hasClear && !summary.hasFirstRaise )
+            {
+                summary.hasLeadingClear = true;
+                summary.leadingClear = time;
+            }
+            summary.open = false;
+            summary.hasClear = true;
+            summary.lastClear = time;
+            break;
+        }
+        if ( block.type[i] != AlarmTransition::Cleared && block.severity[i] < AlarmStatusEntry::SeverityUnknown )
+            summary.worstSeverity = std::max ( summary.worstSeverity, block.severity[i] );
+    }
+}
+
+void combineSummary ( PVState& state, const BlockSummary& summary, const int64_t from, const int64_t flapWindow )
+{
+    PVStatistics& statistics = state.statistics;
+    if ( statistics.alarms == 0 && statistics.updates == 0 && !state.open && !state.hasClear && summary.startsInAlarm )
+    {
+        // First transition of this PV in the time range, the alarm was raised before the range
+        state.open = true;
+        state.openSince = from;
+    }
+    if ( state.open && ( summary.hasLeadingClear || summary.hasFirstRaise ) )
+    {
+        // Close the alarm of the previous blocks, a second Raised without Cleared cannot happen in a consistent history but is handled the same way
+        statistics.timeInAlarm += ( summary.hasLeadingClear ? summary.leadingClear : summary.firstRaise ) - state.openSince;
+        state.open = false;
+    }
+    if ( summary.hasFirstRaise && !summary.hasLeadingClear && state.hasClear && summary.firstRaise - state.lastClear <= flapWindow )
+        statistics.flaps++;
+    statistics.alarms += summary.alarms;
+    statistics.updates += summary.updates;
+    statistics.flaps += summary.flaps;
+    statistics.timeInAlarm += summary.timeInAlarm;
+    if ( summary.worstSeverity > statistics.worstSeverity )
+        statistics.worstSeverity = static_cast<AlarmStatusEntry::SeverityLevel> ( summary.worstSeverity );
+    if ( summary.hasClear )
+    {
+        state.hasClear = true;
+        state.lastClear = summary.lastClear;
+    }
+    if ( summary.open )
+    {
+        state.open = true;
+        state.openSince = summary.openSince;
+    }
+    else if ( summary.hasClear )
+        state.open = false;
+}
+
+}
+
+std::vector<PVStatistics> AlarmHistoryAnalysis::analyse ( const std::string& directory, const int64_t from, const int64_t to, const int64_t flapWindow, const unsigned int threads )
+{
+    // Open the segments and collect the relevant blocks in chronological order
+    const std::string firstDay = AlarmHistorySegment::dayOf ( from );
+    const std::string lastDay = AlarmHistorySegment::dayOf ( to );
+    const std::vector<std::string> days = AlarmHistorySegment::listSegments ( directory );
+    std::vector<std::unique_ptr<AlarmHistorySegment>> segments;
+    std::vector<BlockTask> tasks;
+    for ( auto day = days.begin(); day != days.end(); day++ )
+    {
+        if ( *day < firstDay || *day > lastDay )
+            continue;
+        segments.push_back ( std::unique_ptr<AlarmHistorySegment> ( new AlarmHistorySegment ( directory, *day ) ) );
+        const std::vector<AlarmHistorySegment::IndexEntry>& index = segments.back()->getIndex();
+        for ( size_t n = 0; n < index.size(); n++ )
+            if ( index[n].maxTime >= from && index[n].minTime <= to )
+            {
+                BlockTask task;
+                task.segment = segments.back().get();
+                task.blockNumber = n;
+                tasks.push_back ( std::move ( task ) );
+            }
+    }
+
+    // Scan: Each thread takes the next block that nobody has taken yet
+    std::atomic<size_t> nextTask ( 0 );
+    boost::mutex errormutex;
+    std::string error;
+    auto worker = [&]()
+    {
+        AlarmHistorySegment::Block block;
+        try
+        {
+            for ( size_t n = nextTask++; n < tasks.size(); n = nextTask++ )
+                summariseBlock ( tasks[n], block, from, to, flapWindow );
+        }
+        catch ( std::exception& e )
+        {
+            boost::lock_guard<boost::mutex> concurrencylock ( errormutex );
+            error = e.what();
+            nextTask = tasks.size(); // Make the other threads stop as well
+        }
+    };
+    boost::thread_group workers;
+    for ( unsigned int i = 1; i < std::max ( threads, 1u ); i++ )
+        workers.create_thread ( worker );
+    worker();
+    workers.join_all();
+    if ( !error.empty() )
+        throw std::runtime_error ( error );
+
+    // Reduce: Combine the summaries in chronological order, so alarms spanning several blocks are tracked correctly
+    std::unordered_map<std::string, PVState> states;
+    const AlarmHistorySegment* currentSegment = nullptr;
+    std::vector<PVState*> segmentStates; // Lookup by dictionary ID of the current segment
+    for ( auto task = tasks.begin(); task != tasks.end(); task++ )
+    {
+        if ( ( *task ).segment != currentSegment )
+        {
+            currentSegment = ( *task ).segment;
+            segmentStates.assign ( currentSegment->getDictionarySize(), nullptr );
+        }
+        for ( auto summary = ( *task ).summaries.begin(); summary != ( *task ).summaries.end(); summary++ )
+        {
+            PVState*& state = segmentStates[ ( *summary ).first];
+            if ( state == nullptr )
+            {
+                const std::string& pvname = currentSegment->getString ( ( *summary ).first );
+                auto known = states.find ( pvname );
+                if ( known == states.end() )
+                {
+                    PVState newState;
+                    newState.statistics.pvname = pvname;
+                    newState.statistics.alarms = 0;
+                    newState.statistics.updates = 0;
+                    newState.statistics.flaps = 0;
+                    newState.statistics.timeInAlarm = 0;
+                    newState.statistics.worstSeverity = AlarmStatusEntry::SeverityOK;
+                    newState.open = false;
+                    newState.openSince = 0;
+                    newState.hasClear = false;
+                    newState.lastClear = 0;
+                    known = states.insert ( std::make_pair ( pvname, newState ) ).first;
+                }
+                state = & ( *known ).second;
+            }
+            combineSummary ( *state, ( *summary ).second, from, flapWindow );
+        }
+        std::vector<std::pair<uint32_t, BlockSummary>>().swap ( ( *task ).summaries ); // Release memory early
+    }
+
+    std::vector<PVStatistics> result;
+    result.reserve ( states.size() );
+    for ( auto i = states.begin(); i != states.end(); i++ )
+    {
+        if ( ( *i ).second.open )
+            ( *i ).second.statistics.timeInAlarm += to - ( *i ).second.openSince; // Still in alarm at the end of the range
+        result.push_back ( std::move ( ( *i ).second.statistics ) );
+    }
+    return result;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file alarmhistoryanalysis.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Parallel statistics over the alarm history
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMHISTORYANALYSIS_H
+#define ALARMHISTORYANALYSIS_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "alarmstatusentry.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Alarm statistics of a single PV
+ *
+ * Result of AlarmHistoryAnalysis::analyse() for one PV within the analysed time range.
+ */
+struct PVStatistics
+{
+    /**
+     * @brief Name of the PV
+     */
+    std::string pvname;
+    /**
+     * @brief Number of alarms
+     *
+     * Counts how often the PV went into alarm, i.e. the number of AlarmTransition::Raised transitions.
+     */
+    uint64_t alarms;
+    /**
+     * @brief Number of changes during an alarm
+     *
+     * Counts the AlarmTransition::Updated transitions, e.g. an acknowledgement or a change from MINOR to MAJOR.
+     */
+    uint64_t updates;
+    /**
+     * @brief Number of flaps
+     *
+     * Counts the alarms that were raised within the flap window after the previous alarm of this PV had been cleared.
+     */
+    uint64_t flaps;
+    /**
+     * @brief Total time in alarm
+     *
+     * Time in nanoseconds between the alarms being raised and cleared, limited to the analysed time range. An alarm that is still active at the end of the range is counted up to the end.
+     */
+    int64_t timeInAlarm;
+    /**
+     * @brief Worst severity
+     *
+     * The highest SeverityLevel the PV had in the analysed time range.
+     */
+    AlarmStatusEntry::SeverityLevel worstSeverity;
+};
+
+/**
+ * @brief Offline statistics over the alarm history
+ *
+ * Computes per-PV statistics over the files written by AlarmHistoryStore. The blocks of the history are decoded in parallel by several threads, each one reducing its block to a small summary per PV. The summaries are then combined in chronological order, which keeps track of the alarms that span several blocks or days.
+ *
+ * The same rules as in AlarmServerConnector apply: A PV is in alarm from the AlarmTransition::Raised transition to the AlarmTransition::Cleared transition, so the results match what the live daemon has seen.
+ */
+class AlarmHistoryAnalysis final
+{
+public:
+    /**
+     * @brief Constructor (deleted)
+     *
+     * This class only has static methods.
+     */
+    AlarmHistoryAnalysis() = delete;
+    /**
+     * @brief Compute statistics over a time range
+     *
+     * Maps all history blocks overlapping with the time range into memory and computes the statistics of every PV that had at least one transition in the range. If the first transition of a PV in the range is not AlarmTransition::Raised, the PV is considered to be in alarm since the beginning of the range.
+     * @param directory History directory
+     * @param from Beginning of the time range in nanoseconds since the Unix epoch
+     * @param to End of the time range in nanoseconds since the Unix epoch
+     * @param flapWindow Maximum time in nanoseconds between clearing and raising an alarm to count it as flap
+     * @param threads Number of threads decoding the blocks, at least one
+     * @return The statistics of all PVs, in no particular order
+     * @exception std::runtime_error The history cannot be read.
+     */
+    static std::vector<PVStatistics> analyse ( const std::string& directory, const int64_t from, const int64_t to, const int64_t flapWindow, const unsigned int threads );
+};
+
+}
+
+#endif // ALARMHISTORYANALYSIS_H
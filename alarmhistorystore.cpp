@@ -0,0 +1,521 @@
+/**
+ * @file alarmhistorystore.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Columnar long-term storage of alarm state transitions
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmhistorystore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binaryencoding.h"
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+const size_t AlarmHistoryStore::blockSize;
+const unsigned int AlarmHistoryStore::flushInterval;
+
+// Nanoseconds per day, used to find the segment a transition belongs to
+static const int64_t nanosecondsPerDay = static_cast<int64_t> ( 86400 ) * 1000000000;
+
+static std::string segmentFileName ( const std::string& directory, const std::string& day, const char*const extension )
+{
+    return directory + "/history-" + day + "." + extension;
+}
+
+// Reads a complete file into memory, returns an empty string if the file does not exist
+static std::string readWholeFile ( const std::string& filename )
+{
+    std::string content;
+    const int fd = open ( filename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+    {
+        if ( errno == ENOENT )
+            return content;
+        throw std::runtime_error ( "Cannot open history file " + filename + ": " + strerror ( errno ) );
+    }
+    char buffer[65536];
+    while ( true )
+    {
+        const ssize_t result = read ( fd, buffer, sizeof ( buffer ) );
+        if ( result < 0 && errno == EINTR )
+            continue;
+        if ( result < 0 )
+        {
+            close ( fd );
+            throw std::runtime_error ( "Cannot read history file " + filename + ": " + strerror ( errno ) );
+        }
+        if ( result == 0 )
+            break;
+        content.append ( buffer, static_cast<size_t> ( result ) );
+    }
+    close ( fd );
+    return content;
+}
+
+// Writes the buffer at the given position of a file, or appends it if the position is negative
+static void writeToFile ( const std::string& filename, const std::string& data, const off_t position )
+{
+    const int fd = open ( filename.c_str(), O_WRONLY | O_CREAT | ( position < 0 ? O_APPEND : 0 ), 0644 );
+    if ( fd < 0 )
+        throw std::runtime_error ( "Cannot open history file " + filename + ": " + strerror ( errno ) );
+    size_t written = 0;
+    while ( written < data.size() )
+    {
+        const ssize_t result = ( position < 0 )
+                               ? write ( fd, data.data() + written, data.size() - written )
+                               : pwrite ( fd, data.data() + written, data.size() - written, position + static_cast<off_t> ( written ) );
+        if ( result < 0 && errno == EINTR )
+            continue;
+        if ( result < 0 )
+        {
+            close ( fd );
+            throw std::runtime_error ( "Cannot write history file " + filename + ": " + strerror ( errno ) );
+        }
+        written += static_cast<size_t> ( result );
+    }
+    close ( fd );
+}
+
+// Decodes a dictionary file, returns the size of the complete entries
+static size_t parseDictionary ( const std::string& content, std::vector<std::string>& dictionary )
+{
+    const char* position = content.data();
+    const char*const end = position + content.size();
+    const char* complete = position;
+    uint64_t length = 0;
+    while ( readVarint ( position, end, length ) && length <= static_cast<uint64_t> ( end - position ) )
+    {
+        dictionary.push_back ( std::string ( position, length ) );
+        position += length;
+        complete = position;
+    }
+    return static_cast<size_t> ( complete - content.data() );
+}
+
+// Decodes the index file, only entries describing completely written blocks are returned
+static std::vector<AlarmHistorySegment::IndexEntry> parseIndex ( const std::string& content, const uint64_t blockFileSize )
+{
+    std::vector<AlarmHistorySegment::IndexEntry> index;
+    uint64_t expectedOffset = 0;
+    for ( size_t position = 0; position + sizeof ( AlarmHistorySegment::IndexEntry ) <= content.size(); position += sizeof ( AlarmHistorySegment::IndexEntry ) )
+    {
+        AlarmHistorySegment::IndexEntry entry;
+        memcpy ( &entry, content.data() + position, sizeof ( entry ) );
+        if ( entry.offset != expectedOffset || entry.offset + entry.length > blockFileSize )
+            break;
+        index.push_back ( entry );
+        expectedOffset = entry.offset + entry.length;
+    }
+    return index;
+}
+
+static uint64_t fileSize ( const std::string& filename )
+{
+    struct stat filestatus;
+    if ( stat ( filename.c_str(), &filestatus ) < 0 )
+    {
+        if ( errno == ENOENT )
+            return 0;
+        throw std::runtime_error ( "Cannot determine size of history file " + filename + ": " + strerror ( errno ) );
+    }
+    return static_cast<uint64_t> ( filestatus.st_size );
+}
+
+AlarmHistorySegment::AlarmHistorySegment ( const std::string& directory, const std::string& day )
+    : _blockfilename ( segmentFileName ( directory, day, "anh" ) )
+{
+    parseDictionary ( readWholeFile ( segmentFileName ( directory, day, "dict" ) ), _dictionary );
+    _index = parseIndex ( readWholeFile ( segmentFileName ( directory, day, "idx" ) ), fileSize ( _blockfilename ) );
+}
+
+const std::vector<AlarmHistorySegment::IndexEntry>& AlarmHistorySegment::getIndex() const noexcept
+{
+    return _index;
+}
+
+const std::string& AlarmHistorySegment::getString ( const uint32_t id ) const
+{
+    return _dictionary.at ( id );
+}
+
+size_t AlarmHistorySegment::getDictionarySize() const noexcept
+{
+    return _dictionary.size();
+}
+
+void AlarmHistorySegment::readBlock ( const size_t blockNumber, AlarmHistorySegment::Block& block ) const
+{
+    const IndexEntry& entry = _index.at ( blockNumber );
+    const int fd = open ( _blockfilename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        throw std::runtime_error ( "Cannot open history file " + _blockfilename + ": " + strerror ( errno ) );
+    // mmap() requires an offset aligned to the page size, so map from the beginning of the page containing the block
+    const uint64_t pageSize = static_cast<uint64_t> ( sysconf ( _SC_PAGESIZE ) );
+    const uint64_t mapOffset = entry.offset - entry.offset % pageSize;
+    const size_t mapLength = static_cast<size_t> ( entry.offset - mapOffset ) + entry.length;
+    void*const mapping = mmap ( nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t> ( mapOffset ) );
+    close ( fd ); // The mapping stays valid after closing the file descriptor
+    if ( mapping == MAP_FAILED )
+        throw std::runtime_error ( "Cannot map history file " + _blockfilename + " into memory: " + strerror ( errno ) );
+    const char*const start = static_cast<const char*> ( mapping ) + ( entry.offset - mapOffset );
+
+    try
+    {
+        BlockHeader header;
+        memcpy ( &header, start, sizeof ( header ) );
+        const char* position = start + sizeof ( header );
+        const char*const end = start + entry.length;
+        if ( header.count != entry.count
+                || static_cast<uint64_t> ( header.timeColumnSize ) + header.pvColumnSize + header.count + header.statusColumnSize + sizeof ( header ) != entry.length
+                || checksumFNV1a ( position, entry.length - sizeof ( header ) ) != header.checksum )
+            throw std::runtime_error ( "Damaged block in history file " + _blockfilename );
+
+        block.time.resize ( header.count );
+        block.pv.resize ( header.count );
+        block.type.resize ( header.count );
+        block.severity.resize ( header.count );
+        block.status.resize ( header.count );
+        bool valid = true;
+        int64_t time = entry.minTime;
+        for ( uint32_t i = 0; valid && i < header.count; i++ )
+        {
+            int64_t delta = 0;
+            valid = readSignedVarint ( position, end, delta );
+            time += delta;
+            block.time[i] = time;
+        }
+        for ( uint32_t i = 0; valid && i < header.count; i++ )
+        {
+            uint64_t id = 0;
+            valid = readVarint ( position, end, id ) && id < _dictionary.size();
+            block.pv[i] = static_cast<uint32_t> ( id );
+        }
+        for ( uint32_t i = 0; valid && i < header.count; i++ )
+        {
+            const uint8_t code = static_cast<uint8_t> ( *position++ );
+            block.type[i] = static_cast<uint8_t> ( code >> 4 );
+            block.severity[i] = static_cast<uint8_t> ( code & 0x0f );
+        }
+        for ( uint32_t i = 0; valid && i < header.count; i++ )
+        {
+            uint64_t id = 0;
+            valid = readVarint ( position, end, id ) && id < _dictionary.size();
+            block.status[i] = static_cast<uint32_t> ( id );
+        }
+        if ( !valid )
+            throw std::runtime_error ( "Damaged block in history file " + _blockfilename );
+    }
+    catch ( ... )
+    {
+        munmap ( mapping, mapLength );
+        throw;
+    }
+    munmap ( mapping, mapLength );
+}
+
+std::vector<std::string> AlarmHistorySegment::listSegments ( const std::string& directory )
+{
+    DIR*const dir = opendir ( directory.c_str() );
+    if ( dir == nullptr )
+        throw std::runtime_error ( "Cannot open history directory " + directory + ": " + strerror ( errno ) );
+    std::vector<std::string> days;
+    for ( dirent* entry = readdir ( dir ); entry != nullptr; entry = readdir ( dir ) )
+    {
+        char day[9] = { 0 };
+        char suffix[5] = { 0 };
+        if ( sscanf ( entry->d_name, "history-%8[0-9].%4s", day, suffix ) == 2 && strlen ( day ) == 8 && strcmp ( suffix, "anh" ) == 0 )
+            days.push_back ( day );
+    }
+    closedir ( dir );
+    std::sort ( days.begin(), days.end() ); // YYYYMMDD sorts chronologically
+    return days;
+}
+
+std::string AlarmHistorySegment::dayOf ( const int64_t time )
+{
+    const time_t seconds = static_cast<time_t> ( time / 1000000000 );
+    tm utc;
+    gmtime_r ( &seconds, &utc );
+    char day[16];
+    strftime ( day, sizeof ( day ), "%Y%m%d", &utc );
+    return std::string ( day );
+}
+
+AlarmHistoryStore::AlarmHistoryStore ( const std::string& directory )
+    : _directory ( directory ),
+      _run ( true ),
+      _blockfilesize ( 0 )
+{
+    AlarmHistorySegment::listSegments ( _directory ); // Fails early if the directory is not accessible
+    _writerthread = boost::thread ( boost::bind ( &AlarmHistoryStore::startWriter, this ) );
+}
+
+AlarmHistoryStore::~AlarmHistoryStore()
+{
+    {
+        boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+        _run = false;
+    }
+    _pendingcondition.notify_all();
+    _writerthread.join();
+}
+
+void AlarmHistoryStore::append ( const AlarmTransition& transition )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+    _pending.push_back ( transition );
+    if ( _pending.size() == blockSize )
+        _pendingcondition.notify_all(); // A full block can be written right away
+}
+
+size_t AlarmHistoryStore::getQueueDepth() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+    return _pending.size();
+}
+
+void AlarmHistoryStore::startWriter()
+{
+    bool run = true;
+    std::vector<AlarmTransition> incoming;
+    std::vector<AlarmTransition> block;
+    block.reserve ( blockSize );
+    int64_t blockDayStart = 0;
+    time_t lastFlush = std::time ( nullptr );
+    while ( run )
+    {
+        {
+            boost::unique_lock<boost::mutex> concurrencylock ( _pendingmutex );
+            if ( _run && _pending.size() < blockSize )
+                _pendingcondition.timed_wait ( concurrencylock, boost::posix_time::seconds ( 1 ) );
+            incoming.swap ( _pending );
+            run = _run;
+        }
+        for ( auto i = incoming.begin(); i != incoming.end(); i++ )
+        {
+            // A block must not contain transitions of different days, as each day has its own segment
+            const bool otherDay = ( *i ).wallTime < blockDayStart || ( *i ).wallTime >= blockDayStart + nanosecondsPerDay;
+            if ( !block.empty() && ( otherDay || block.size() >= blockSize ) )
+            {
+                writeBlock ( block );
+                block.clear();
+                lastFlush = std::time ( nullptr );
+            }
+            if ( block.empty() )
+                blockDayStart = ( *i ).wallTime - ( *i ).wallTime % nanosecondsPerDay;
+            block.push_back ( std::move ( *i ) );
+        }
+        incoming.clear();
+        if ( !block.empty() && ( !run || block.size() >= blockSize || std::time ( nullptr ) - lastFlush >= flushInterval ) )
+        {
+            writeBlock ( block );
+            block.clear();
+            lastFlush = std::time ( nullptr );
+        }
+    }
+}
+
+void AlarmHistoryStore::writeBlock ( const std::vector<AlarmTransition>& transitions ) noexcept
+{
+    try
+    {
+        const std::string day = AlarmHistorySegment::dayOf ( transitions.front().wallTime );
+        if ( day != _day )
+            openSegment ( day );
+
+        AlarmHistorySegment::IndexEntry entry;
+        entry.minTime = transitions.front().wallTime;
+        entry.maxTime = transitions.front().wallTime;
+        for ( auto i = transitions.begin(); i != transitions.end(); i++ )
+        {
+            entry.minTime = std::min ( entry.minTime, ( *i ).wallTime );
+            entry.maxTime = std::max ( entry.maxTime, ( *i ).wallTime );
+        }
+
+        std::string newStrings;
+        std::string timeColumn;
+        std::string pvColumn;
+        std::string codeColumn;
+        std::string statusColumn;
+        int64_t previousTime = entry.minTime;
+        for ( auto i = transitions.begin(); i != transitions.end(); i++ )
+        {
+            // The wall clock may be set back, so the differences are signed
+            appendSignedVarint ( timeColumn, ( *i ).wallTime - previousTime );
+            previousTime = ( *i ).wallTime;
+            const std::string* strings[2] = { & ( *i ).pvname, & ( *i ).status };
+            std::string* columns[2] = { &pvColumn, &statusColumn };
+            for ( int n = 0; n < 2; n++ )
+            {
+                auto known = _dictionary.find ( *strings[n] );
+                if ( known == _dictionary.end() )
+                {
+                    known = _dictionary.insert ( std::make_pair ( *strings[n], static_cast<uint32_t> ( _dictionary.size() ) ) ).first;
+                    appendVarint ( newStrings, strings[n]->length() );
+                    newStrings.append ( *strings[n] );
+                }
+                appendVarint ( *columns[n], ( *known ).second );
+            }
+            codeColumn.push_back ( static_cast<char> ( ( ( *i ).type << 4 ) | ( ( *i ).severity & 0x0f ) ) );
+        }
+
+        AlarmHistorySegment::BlockHeader header;
+        header.count = static_cast<uint32_t> ( transitions.size() );
+        header.timeColumnSize = static_cast<uint32_t> ( timeColumn.size() );
+        header.pvColumnSize = static_cast<uint32_t> ( pvColumn.size() );
+        header.statusColumnSize = static_cast<uint32_t> ( statusColumn.size() );
+        header.reserved = 0;
+        std::string data ( sizeof ( header ), '\0' );
+        data += timeColumn;
+        data += pvColumn;
+        data += codeColumn;
+        data += statusColumn;
+        header.checksum = checksumFNV1a ( data.data() + sizeof ( header ), data.size() - sizeof ( header ) );
+        memcpy ( &data[0], &header, sizeof ( header ) );
+
+        entry.offset = _blockfilesize;
+        entry.length = static_cast<uint32_t> ( data.size() );
+        entry.count = header.count;
+        const std::string indexEntry ( reinterpret_cast<const char*> ( &entry ), sizeof ( entry ) );
+
+        // Dictionary first, then the block, then the index entry: Readers only trust the index, so they never see anything incomplete
+        if ( !newStrings.empty() )
+            writeToFile ( segmentFileName ( _directory, _day, "dict" ), newStrings, -1 );
+        writeToFile ( segmentFileName ( _directory, _day, "anh" ), data, static_cast<off_t> ( _blockfilesize ) );
+        writeToFile ( segmentFileName ( _directory, _day, "idx" ), indexEntry, -1 );
+        _blockfilesize += data.size();
+    }
+    catch ( std::exception& e )
+    {
+        _day.clear(); // The dictionary in memory may not match the file anymore, so reread it on the next block
+        ExceptionHandler ( e, "writing to the alarm history." );
+    }
+    catch ( ... )
+    {
+        _day.clear();
+        ExceptionHandler ( "writing to the alarm history." );
+    }
+}
+
+void AlarmHistoryStore::openSegment ( const std::string& day )
+{
+    _day.clear();
+    _dictionary.clear();
+    const std::string blockname = segmentFileName ( _directory, day, "anh" );
+    const std::string indexname = segmentFileName ( _directory, day, "idx" );
+    const std::string dictionaryname = segmentFileName ( _directory, day, "dict" );
+
+    // Continue an existing segment, e.g. after a restart, and cut off everything a crash may have left incomplete
+    std::vector<std::string> dictionary;
+    const std::string dictionaryContent = readWholeFile ( dictionaryname );
+    const size_t dictionarySize = parseDictionary ( dictionaryContent, dictionary );
+    if ( dictionarySize != dictionaryContent.size() && truncate ( dictionaryname.c_str(), static_cast<off_t> ( dictionarySize ) ) < 0 )
+        throw std::runtime_error ( "Cannot repair history file " + dictionaryname + ": " + strerror ( errno ) );
+    for ( size_t i = 0; i < dictionary.size(); i++ )
+        _dictionary.insert ( std::make_pair ( dictionary[i], static_cast<uint32_t> ( i ) ) );
+
+    const std::string indexContent = readWholeFile ( indexname );
+    const std::vector<AlarmHistorySegment::IndexEntry> index = parseIndex ( indexContent, fileSize ( blockname ) );
+    const size_t indexSize = index.size() * sizeof ( AlarmHistorySegment::IndexEntry );
+    if ( indexSize != indexContent.size() && truncate ( indexname.c_str(), static_cast<off_t> ( indexSize ) ) < 0 )
+        throw std::runtime_error ( "Cannot repair history file " + indexname + ": " + strerror ( errno ) );
+    _blockfilesize = index.empty() ? 0 : index.back().offset + index.back().length;
+    _day = day;
+}
+
+std::vector<AlarmTransition> AlarmHistoryStore::query ( const std::string& directory, const int64_t from, const int64_t to, const std::string& pvpattern, const uint32_t severityMask )
+{
+    std::vector<AlarmTransition> result;
+    const std::string firstDay = AlarmHistorySegment::dayOf ( from );
+    const std::string lastDay = AlarmHistorySegment::dayOf ( to );
+    const std::vector<std::string> days = AlarmHistorySegment::listSegments ( directory );
+    AlarmHistorySegment::Block block;
+    for ( auto day = days.begin(); day != days.end(); day++ )
+    {
+        if ( *day < firstDay || *day > lastDay )
+            continue;
+        const AlarmHistorySegment segment ( directory, *day );
+        // Evaluate the pattern once per dictionary entry instead of once per transition
+        std::vector<bool> matching ( segment.getDictionarySize() );
+        for ( uint32_t id = 0; id < matching.size(); id++ )
+            matching[id] = fnmatch ( pvpattern.c_str(), segment.getString ( id ).c_str(), 0 ) == 0;
+        const std::vector<AlarmHistorySegment::IndexEntry>& index = segment.getIndex();
+        for ( size_t n = 0; n < index.size(); n++ )
+        {
+            if ( index[n].maxTime < from || index[n].minTime > to )
+                continue; // Block is outside the time range and not even mapped into memory
+            segment.readBlock ( n, block );
+            for ( size_t i = 0; i < block.time.size(); i++ )
+            {
+                if ( block.time[i] < from || block.time[i] > to || !matching[block.pv[i]] || ( severityMask & ( 1u << block.severity[i] ) ) == 0 )
+                    continue;
+                AlarmTransition transition;
+                transition.type = static_cast<AlarmTransition::TransitionType> ( block.type[i] );
+                transition.pvname = segment.getString ( block.pv[i] );
+                transition.severity = static_cast<AlarmStatusEntry::SeverityLevel> ( block.severity[i] );
+                transition.status = segment.getString ( block.status[i] );
+                transition.monotonicTime = 0;
+                transition.wallTime = block.time[i];
+                result.push_back ( std::move ( transition ) );
+            }
+        }
+    }
+    std::stable_sort ( result.begin(), result.end(), [] ( const AlarmTransition & a, const AlarmTransition & b )
+    {
+        return a.wallTime < b.wallTime;
+    } );
+    return result;
+}
+
+bool AlarmHistoryStore::parseTime ( const std::string& text, int64_t& time )
+{
+    tm local;
+    memset ( &local, 0, sizeof ( local ) );
+    const char*const end = strptime ( text.c_str(), "%Y-%m-%d %H:%M:%S", &local );
+    if ( end == nullptr || *end != '\0' )
+        return false;
+    local.tm_isdst = -1; // Let mktime() determine whether daylight saving time applies
+    time = static_cast<int64_t> ( mktime ( &local ) ) * 1000000000;
+    return true;
+}
@@ -0,0 +1,458 @@
+/**
+ * @file alarmhistorystore.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Columnar long-term storage of alarm state transitions
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMHISTORYSTORE_H
+#define ALARMHISTORYSTORE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alarmtransition.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Reader for one segment of the alarm history
+ *
+ * The AlarmHistoryStore writes one segment per day (UTC), consisting of three files in the history directory:
+ * - history-YYYYMMDD.anh contains the blocks of transitions,
+ * - history-YYYYMMDD.idx contains one IndexEntry per block with its position and the time range it covers,
+ * - history-YYYYMMDD.dict contains the dictionary of the segment, i.e. all PV names and status strings, each one preceded by its length as variable-length integer. The ID of a string is its position in this file.
+ *
+ * Within a block, the transitions are stored column by column: First the timestamps as differences to the previous one, then the dictionary IDs of the PV names, then one byte per transition with the transition type in the upper and the severity level in the lower four bits, and last the dictionary IDs of the status strings. All numbers are variable-length integers. As neighbouring values within a column are similar, this layout needs far less space than storing complete transitions one after the other, and a scan that only needs some of the columns does not have to decode the others.
+ *
+ * The constructor only reads the small index and dictionary files. The blocks are mapped into memory individually by readBlock(), so a query for a short time range only touches the few blocks that overlap with it.
+ */
+class AlarmHistorySegment
+{
+public:
+    /**
+     * @brief Entry of the block index
+     *
+     * Describes one block in the segment. The index file is a plain array of these entries.
+     */
+    struct IndexEntry
+    {
+        /**
+         * @brief Earliest transition in the block
+         *
+         * Nanoseconds since the Unix epoch.
+         */
+        int64_t minTime;
+        /**
+         * @brief Latest transition in the block
+         *
+         * Nanoseconds since the Unix epoch.
+         */
+        int64_t maxTime;
+        /**
+         * @brief Position of the block
+         *
+         * Offset of the block header within the block file.
+         */
+        uint64_t offset;
+        /**
+         * @brief Size of the block
+         *
+         * Size in bytes including the block header.
+         */
+        uint32_t length;
+        /**
+         * @brief Number of transitions
+         *
+         * The number of transitions stored in the block.
+         */
+        uint32_t count;
+    };
+    /**
+     * @brief Header of a block
+     *
+     * Located in front of the columns of each block.
+     */
+    struct BlockHeader
+    {
+        /**
+         * @brief Number of transitions
+         *
+         * Equal to IndexEntry::count.
+         */
+        uint32_t count;
+        /**
+         * @brief Size of the timestamp column
+         *
+         * In bytes.
+         */
+        uint32_t timeColumnSize;
+        /**
+         * @brief Size of the PV name column
+         *
+         * In bytes.
+         */
+        uint32_t pvColumnSize;
+        /**
+         * @brief Size of the status column
+         *
+         * In bytes. The type and severity column always has count bytes.
+         */
+        uint32_t statusColumnSize;
+        /**
+         * @brief Checksum
+         *
+         * FNV-1a hash over all columns.
+         */
+        uint32_t checksum;
+        /**
+         * @brief Padding
+         *
+         * Always zero.
+         */
+        uint32_t reserved;
+    };
+    /**
+     * @brief Decoded block
+     *
+     * The columns of a block after decoding. All vectors have the same size.
+     */
+    struct Block
+    {
+        /**
+         * @brief Timestamps
+         *
+         * Nanoseconds since the Unix epoch.
+         */
+        std::vector<int64_t> time;
+        /**
+         * @brief PV names
+         *
+         * Dictionary IDs, see getString().
+         */
+        std::vector<uint32_t> pv;
+        /**
+         * @brief Transition types
+         *
+         * Values of AlarmTransition::TransitionType.
+         */
+        std::vector<uint8_t> type;
+        /**
+         * @brief Severity levels
+         *
+         * Values of AlarmStatusEntry::SeverityLevel.
+         */
+        std::vector<uint8_t> severity;
+        /**
+         * @brief Status strings
+         *
+         * Dictionary IDs, see getString().
+         */
+        std::vector<uint32_t> status;
+    };
+private:
+    /**
+     * @brief Path of the block file
+     *
+     * The index and dictionary files are located next to it.
+     */
+    const std::string _blockfilename;
+    /**
+     * @brief Block index
+     *
+     * Read from the index file by the constructor.
+     */
+    std::vector<IndexEntry> _index;
+    /**
+     * @brief Dictionary
+     *
+     * Read from the dictionary file by the constructor.
+     */
+    std::vector<std::string> _dictionary;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Reads the index and the dictionary of the segment. Index entries pointing to blocks that have not been written completely are ignored.
+     * @param directory History directory
+     * @param day Day of the segment as YYYYMMDD
+     * @exception std::runtime_error The segment files cannot be read.
+     */
+    AlarmHistorySegment ( const std::string& directory, const std::string& day );
+    /**
+     * @brief Query the block index
+     *
+     * Can be used to select the blocks relevant for a time range before reading them.
+     * @return Read-only reference to the block index
+     */
+    const std::vector<IndexEntry>& getIndex() const noexcept;
+    /**
+     * @brief Look up a dictionary string
+     *
+     * Translates a dictionary ID from a decoded Block into the PV name or status string.
+     * @param id Dictionary ID
+     * @return Read-only reference to the string
+     * @exception std::out_of_range The ID is not in the dictionary.
+     */
+    const std::string& getString ( const uint32_t id ) const;
+    /**
+     * @brief Query the dictionary size
+     *
+     * All valid dictionary IDs are lower than this value.
+     * @return Number of strings in the dictionary
+     */
+    size_t getDictionarySize() const noexcept;
+    /**
+     * @brief Read a block
+     *
+     * Maps only the pages of the block file that contain the requested block into memory, verifies the checksum and decodes the columns.
+     * @param blockNumber Position of the block in the index
+     * @param block The decoded columns, previous content is replaced
+     * @return Nothing
+     * @exception std::runtime_error The block cannot be read or is damaged.
+     */
+    void readBlock ( const size_t blockNumber, Block& block ) const;
+    /**
+     * @brief List the segments in a history directory
+     *
+     * Returns the days of all segments in the history directory, in chronological order.
+     * @param directory History directory
+     * @return Days as YYYYMMDD
+     * @exception std::runtime_error The directory cannot be read.
+     */
+    static std::vector<std::string> listSegments ( const std::string& directory );
+    /**
+     * @brief Day of a timestamp
+     *
+     * Converts a timestamp into the name of the segment it belongs to.
+     * @param time Nanoseconds since the Unix epoch
+     * @return Day in UTC as YYYYMMDD
+     */
+    static std::string dayOf ( const int64_t time );
+};
+
+/**
+ * @brief Long-term storage of all applied alarm state transitions
+ *
+ * While the AlarmJournal is meant to reconstruct the course of recent incidents, this class keeps the history of all alarms in a format suitable for queries over long time ranges, e.g. for shift reports. It receives every transition applied by AlarmServerConnector via append().
+ *
+ * The transitions are collected in memory and written as a block in the columnar format described in AlarmHistorySegment when blockSize transitions have been collected or flushInterval seconds have passed. The encoding and all disk access happens in a background thread, append() only locks a mutex to put the transition into a queue. The block is written before its index entry, so a crash in between never leads to an index entry pointing to garbage.
+ *
+ * Stored transitions can be retrieved with query().
+ */
+class AlarmHistoryStore
+{
+private:
+    /**
+     * @brief Maximum number of transitions per block
+     *
+     * Larger blocks compress better, smaller blocks allow more precise selection of the blocks relevant for a query.
+     */
+    static const size_t blockSize = 4096;
+    /**
+     * @brief Maximum time between two blocks
+     *
+     * Time in seconds after which the collected transitions are written even if the block is not full, so queries also find recent transitions.
+     */
+    static const unsigned int flushInterval = 60;
+    /**
+     * @brief History directory
+     *
+     * All segment files are located here.
+     */
+    const std::string _directory;
+    /**
+     * @brief Queue of transitions waiting to be written
+     *
+     * Filled by append(), emptied by the background thread. Protected by _pendingmutex.
+     */
+    std::vector<AlarmTransition> _pending;
+    /**
+     * @brief Mutex to protect _pending
+     *
+     * Only held for the time needed to add a transition or to swap the whole queue.
+     */
+    mutable boost::mutex _pendingmutex;
+    /**
+     * @brief Wake-up condition of the background thread
+     *
+     * Used to wake up the background thread when a block is full or the store is closed.
+     */
+    boost::condition_variable _pendingcondition;
+    /**
+     * @brief Background thread abortion flag
+     *
+     * The destructor will set this flag to false, so the background thread will exit its loop. Protected by _pendingmutex.
+     */
+    bool _run;
+    /**
+     * @brief Day of the current segment
+     *
+     * As YYYYMMDD, empty if no segment has been opened yet. Only used by the background thread.
+     */
+    std::string _day;
+    /**
+     * @brief Dictionary of the current segment
+     *
+     * Maps PV names and status strings to their IDs. Only used by the background thread.
+     */
+    std::unordered_map<std::string, uint32_t> _dictionary;
+    /**
+     * @brief Size of the block file of the current segment
+     *
+     * Offset of the next block. Only used by the background thread.
+     */
+    uint64_t _blockfilesize;
+    /**
+     * @brief Writer thread
+     *
+     * This thread object will run the startWriter() method.
+     */
+    boost::thread _writerthread;
+
+    /**
+     * @brief Writer loop
+     *
+     * Collects the transitions from the queue and passes them to writeBlock() whenever a block is full, a new day begins or flushInterval has passed. Loops until _run is set to false and writes the remaining transitions afterwards.
+     * @return Nothing
+     */
+    void startWriter();
+    /**
+     * @brief Write a block
+     *
+     * Appends new dictionary entries, the encoded block and its index entry to the segment of the day of the transitions, opening that segment if necessary. All transitions must belong to the same day.
+     *
+     * This method cannot throw exceptions, errors are forwarded to the global ExceptionHandler().
+     * @param transitions The transitions of the block
+     * @return Nothing
+     */
+    void writeBlock ( const std::vector<AlarmTransition>& transitions ) noexcept;
+    /**
+     * @brief Open the segment of a day
+     *
+     * Reads the dictionary of an existing segment for that day and cuts off any incompletely written block at the end of its block file.
+     * @param day Day as YYYYMMDD
+     * @return Nothing
+     * @exception std::runtime_error The segment files cannot be read.
+     */
+    void openSegment ( const std::string& day );
+public:
+    /**
+     * @brief Constructor
+     *
+     * Starts the writer thread.
+     * @param directory History directory, must exist and be writable
+     * @exception std::runtime_error The history directory cannot be accessed.
+     */
+    AlarmHistoryStore ( const std::string& directory );
+    /**
+     * @brief Destructor
+     *
+     * Stops the writer thread after all queued transitions have been written.
+     */
+    ~AlarmHistoryStore();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmHistoryStore
+     */
+    AlarmHistoryStore ( const AlarmHistoryStore& other ) = delete;
+    /**
+     * @brief Move constructor (C++11, deleted)
+     *
+     * This class cannot be moved.
+     * @param other Another instance of AlarmHistoryStore
+     */
+    AlarmHistoryStore ( AlarmHistoryStore&& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmHistoryStore
+     * @return Nothing (deleted)
+     */
+    AlarmHistoryStore& operator= ( const AlarmHistoryStore& other ) = delete;
+    /**
+     * @brief Move assignment (C++11, deleted)
+     *
+     * This class cannot be moved.
+     * @param other Another instance of AlarmHistoryStore
+     * @return Nothing (deleted)
+     */
+    AlarmHistoryStore& operator= ( AlarmHistoryStore&& other ) = delete;
+    /**
+     * @brief Add transition to the history
+     *
+     * The transition is queued and written by the background thread. AlarmTransition::wallTime must be set.
+     * @param transition The transition that has been applied
+     * @return Nothing
+     */
+    void append ( const AlarmTransition& transition );
+    /**
+     * @brief Number of queued transitions
+     *
+     * Transitions passed to append() that have not been taken over by the writer thread yet.
+     * @return Length of the queue
+     */
+    size_t getQueueDepth() const noexcept;
+    /**
+     * @brief Query the history
+     *
+     * Returns all stored transitions within a time range whose PV name matches a shell wildcard pattern (as understood by fnmatch(), e.g. "HV:*") and whose severity level is selected in a bit mask. Only segments of days overlapping with the time range are opened, and only blocks overlapping with it according to the block index are read. The PV name pattern is evaluated once per dictionary entry, not once per transition.
+     * @param directory History directory
+     * @param from Beginning of the time range in nanoseconds since the Unix epoch
+     * @param to End of the time range in nanoseconds since the Unix epoch
+     * @param pvpattern Shell wildcard pattern for the PV names, "*" selects all PVs
+     * @param severityMask Bit n is set if transitions to severity level n should be returned
+     * @return The selected transitions in chronological order
+     * @exception std::runtime_error The history cannot be read.
+     */
+    static std::vector<AlarmTransition> query ( const std::string& directory, const int64_t from, const int64_t to, const std::string& pvpattern, const uint32_t severityMask );
+    /**
+     * @brief Parse a point in time given by the user
+     *
+     * Used by the command line tools to parse the limits of a time range. The time has to be given as "YYYY-MM-DD HH:MM:SS" in local time.
+     * @param text The time as entered by the user
+     * @param time The time in nanoseconds since the Unix epoch, only changed if the text could be parsed
+     * @return True if the text has the correct format
+     */
+    static bool parseTime ( const std::string& text, int64_t& time );
+};
+
+}
+
+#endif // ALARMHISTORYSTORE_H
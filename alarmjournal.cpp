@@ -0,0 +1,433 @@
+/**
+ * @file alarmjournal.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Append-only journal of alarm state transitions
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmjournal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alarmstatesnapshot.h"
+#include "binaryencoding.h"
+#include "clock.h"
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+const char AlarmJournal::segmentMagic[9] = "ANJRNL01";
+const unsigned int AlarmJournal::groupCommitInterval;
+
+// Size of the batch header: marker byte, 32 bit payload length and 32 bit checksum
+static const size_t batchHeaderSize = 9;
+
+static std::string segmentFileName ( const std::string& directory, const uint64_t segmentNumber )
+{
+    char name[32];
+    snprintf ( name, sizeof ( name ), "journal-%010llu.anj", static_cast<unsigned long long> ( segmentNumber ) );
+    return directory + "/" + name;
+}
+
+static std::string baseSnapshotFileName ( const std::string& directory )
+{
+    return directory + "/journal-base.ans";
+}
+
+// Returns the sequence numbers of all segment files in the directory, sorted in ascending order
+static std::vector<uint64_t> listSegments ( const std::string& directory )
+{
+    DIR*const dir = opendir ( directory.c_str() );
+    if ( dir == nullptr )
+        throw std::runtime_error ( "Cannot open journal directory " + directory + ": " + strerror ( errno ) );
+    std::vector<uint64_t> segments;
+    for ( dirent* entry = readdir ( dir ); entry != nullptr; entry = readdir ( dir ) )
+    {
+        unsigned long long number = 0;
+        char suffix[5] = { 0 };
+        if ( sscanf ( entry->d_name, "journal-%llu.%4s", &number, suffix ) == 2 && strcmp ( suffix, "anj" ) == 0 )
+            segments.push_back ( number );
+    }
+    closedir ( dir );
+    std::sort ( segments.begin(), segments.end() );
+    return segments;
+}
+
+AlarmJournal::AlarmJournal ( const std::string& directory, const uint64_t segmentSize, const unsigned int retainedSegments )
+    : _directory ( directory ),
+      _segmentsize ( segmentSize ),
+      _retainedsegments ( retainedSegments ),
+      _run ( true ),
+      _fd ( -1 ),
+      _segmentnumber ( 0 ),
+      _segmentbytes ( 0 ),
+      _lasttimestamp ( 0 )
+{
+    const std::vector<uint64_t> segments = listSegments ( _directory );
+    _closedsegments.assign ( segments.begin(), segments.end() );
+    if ( !segments.empty() )
+        _segmentnumber = segments.back();
+    compact();
+    openSegment();
+    // The thread is started last, so it never sees a partially constructed journal
+    _committhread = boost::thread ( boost::bind ( &AlarmJournal::startCommitter, this ) );
+}
+
+AlarmJournal::~AlarmJournal()
+{
+    {
+        boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+        _run = false;
+    }
+    _pendingcondition.notify_all();
+    _committhread.join();
+    closeSegment();
+}
+
+void AlarmJournal::append ( AlarmTransition&& transition )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+    _pending.push_back ( std::move ( transition ) );
+}
+
+size_t AlarmJournal::getQueueDepth() const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+    return _pending.size();
+}
+
+int64_t AlarmJournal::monotonicNow() noexcept
+{
+    return Clock::instance().monotonicNow();
+}
+
+void AlarmJournal::startCommitter()
+{
+    bool run = true;
+    std::vector<AlarmTransition> transitions;
+    while ( run )
+    {
+        {
+            boost::unique_lock<boost::mutex> concurrencylock ( _pendingmutex );
+            if ( _run )
+                _pendingcondition.timed_wait ( concurrencylock, boost::posix_time::milliseconds ( groupCommitInterval ) );
+            transitions.swap ( _pending );
+            run = _run;
+        }
+        commit ( transitions );
+        transitions.clear(); // Keeps the capacity, so the next swap hands an already allocated vector to append()
+    }
+}
+
+void AlarmJournal::commit ( const std::vector<AlarmTransition>& transitions ) noexcept
+{
+    if ( transitions.empty() )
+        return;
+    try
+    {
+        if ( _fd < 0 )
+            openSegment();
+        std::string batch ( batchHeaderSize, '\0' ); // Header is filled in after the payload is complete
+        for ( auto i = transitions.begin(); i != transitions.end(); i++ )
+        {
+            const uint64_t pvid = dictionaryID ( batch, ( *i ).pvname );
+            const uint64_t statusid = dictionaryID ( batch, ( *i ).status );
+            // Transitions queued before the segment was opened are recorded at the segment start
+            const int64_t delta = std::max<int64_t> ( ( *i ).monotonicTime - _lasttimestamp, 0 );
+            _lasttimestamp += delta;
+            batch.push_back ( static_cast<char> ( transitionRecord ) );
+            appendVarint ( batch, static_cast<uint64_t> ( delta ) );
+            appendVarint ( batch, pvid );
+            batch.push_back ( static_cast<char> ( ( *i ).type ) );
+            batch.push_back ( static_cast<char> ( ( *i ).severity ) );
+            appendVarint ( batch, statusid );
+        }
+        const uint32_t payloadLength = static_cast<uint32_t> ( batch.size() - batchHeaderSize );
+        const uint32_t checksum = checksumFNV1a ( batch.data() + batchHeaderSize, payloadLength );
+        batch[0] = static_cast<char> ( batchMarker );
+        memcpy ( &batch[1], &payloadLength, sizeof ( payloadLength ) );
+        memcpy ( &batch[5], &checksum, sizeof ( checksum ) );
+
+        size_t written = 0;
+        while ( written < batch.size() )
+        {
+            const ssize_t result = ::write ( _fd, batch.data() + written, batch.size() - written );
+            if ( result < 0 && errno == EINTR )
+                continue;
+            if ( result < 0 )
+                throw std::runtime_error ( std::string ( "Cannot write to journal segment: " ) + strerror ( errno ) );
+            written += static_cast<size_t> ( result );
+        }
+        if ( fdatasync ( _fd ) < 0 )
+            throw std::runtime_error ( std::string ( "Cannot flush journal segment to disk: " ) + strerror ( errno ) );
+        _segmentbytes += batch.size();
+
+        if ( _segmentbytes >= _segmentsize )
+        {
+            closeSegment();
+            openSegment();
+            compact();
+        }
+    }
+    catch ( std::exception& e )
+    {
+        // The dictionary may now contain IDs that never made it to disk, so the segment must not be continued
+        closeSegment();
+        ExceptionHandler ( e, "writing to the alarm journal." );
+    }
+    catch ( ... )
+    {
+        closeSegment();
+        ExceptionHandler ( "writing to the alarm journal." );
+    }
+}
+
+uint64_t AlarmJournal::dictionaryID ( std::string& batch, const std::string& text )
+{
+    auto entry = _dictionary.find ( text );
+    if ( entry != _dictionary.end() )
+        return ( *entry ).second;
+    const uint64_t id = _dictionary.size();
+    _dictionary.insert ( std::make_pair ( text, id ) );
+    batch.push_back ( static_cast<char> ( dictionaryRecord ) );
+    appendVarint ( batch, id );
+    appendVarint ( batch, text.length() );
+    batch.append ( text );
+    return id;
+}
+
+void AlarmJournal::openSegment()
+{
+    _segmentnumber++;
+    const std::string filename = segmentFileName ( _directory, _segmentnumber );
+    _fd = open ( filename.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644 );
+    if ( _fd < 0 )
+        throw std::runtime_error ( "Cannot create journal segment " + filename + ": " + strerror ( errno ) );
+    SegmentHeader header;
+    memcpy ( header.magic, segmentMagic, sizeof ( header.magic ) );
+    header.segmentNumber = _segmentnumber;
+    header.wallClockBase = Clock::instance().wallNow();
+    header.monotonicClockBase = monotonicNow();
+    if ( ::write ( _fd, &header, sizeof ( header ) ) != sizeof ( header ) )
+    {
+        close ( _fd );
+        _fd = -1;
+        unlink ( filename.c_str() );
+        throw std::runtime_error ( "Cannot write header of journal segment " + filename + ": " + strerror ( errno ) );
+    }
+    _segmentbytes = sizeof ( header );
+    _lasttimestamp = header.monotonicClockBase;
+    _dictionary.clear();
+}
+
+void AlarmJournal::closeSegment() noexcept
+{
+    if ( _fd < 0 )
+        return;
+    close ( _fd );
+    _fd = -1;
+    if ( _segmentbytes <= sizeof ( SegmentHeader ) )
+        unlink ( segmentFileName ( _directory, _segmentnumber ).c_str() ); // Nothing has been written, so don't keep an empty segment
+    else
+        _closedsegments.push_back ( _segmentnumber );
+}
+
+void AlarmJournal::compact()
+{
+    while ( _closedsegments.size() > _retainedsegments )
+    {
+        const std::string basename = baseSnapshotFileName ( _directory );
+        const std::string segmentname = segmentFileName ( _directory, _closedsegments.front() );
+        std::map<std::string, AlarmStatusEntry> state;
+        const std::vector<AlarmStatusEntry> base = AlarmStateSnapshot::read ( basename );
+        for ( auto i = base.begin(); i != base.end(); i++ )
+            state.insert ( std::make_pair ( ( *i ).getPVName(), *i ) );
+
+        std::vector<AlarmTransition> transitions;
+        readSegment ( segmentname, transitions );
+        for ( auto i = transitions.begin(); i != transitions.end(); i++ )
+        {
+            auto entry = state.find ( ( *i ).pvname );
+            if ( ( *i ).type == AlarmTransition::Cleared )
+            {
+                if ( entry != state.end() )
+                    state.erase ( entry );
+            }
+            else if ( entry == state.end() )
+            {
+                AlarmStatusEntry ase ( ( *i ).pvname, AlarmStatusEntry::severityLevelToString ( ( *i ).severity ), ( *i ).status );
+                ase.setTriggerTime ( static_cast<time_t> ( ( *i ).wallTime / 1000000000 ) );
+                state.insert ( std::make_pair ( ( *i ).pvname, std::move ( ase ) ) );
+            }
+            else
+            {
+                ( *entry ).second.setSeverity ( AlarmStatusEntry::severityLevelToString ( ( *i ).severity ) );
+                ( *entry ).second.setStatus ( ( *i ).status );
+            }
+        }
+
+        std::vector<AlarmStatusEntry> folded;
+        folded.reserve ( state.size() );
+        for ( auto i = state.begin(); i != state.end(); i++ )
+            folded.push_back ( ( *i ).second );
+        AlarmStateSnapshot::write ( basename, folded );
+        unlink ( segmentname.c_str() );
+        _closedsegments.pop_front();
+    }
+}
+
+void AlarmJournal::readSegment ( const std::string& filename, std::vector<AlarmTransition>& transitions )
+{
+    const int fd = open ( filename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        throw std::runtime_error ( "Cannot open journal segment " + filename + ": " + strerror ( errno ) );
+    struct stat filestatus;
+    if ( fstat ( fd, &filestatus ) < 0 )
+    {
+        close ( fd );
+        throw std::runtime_error ( "Cannot determine size of journal segment " + filename + ": " + strerror ( errno ) );
+    }
+    const size_t fileSize = static_cast<size_t> ( filestatus.st_size );
+    if ( fileSize < sizeof ( SegmentHeader ) )
+    {
+        close ( fd );
+        return; // The segment was created, but the header never made it to disk
+    }
+    void*const mapping = mmap ( nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close ( fd ); // The mapping stays valid after closing the file descriptor
+    if ( mapping == MAP_FAILED )
+        throw std::runtime_error ( "Cannot map journal segment " + filename + " into memory: " + strerror ( errno ) );
+    const char*const base = static_cast<const char*> ( mapping );
+    const char*const end = base + fileSize;
+
+    SegmentHeader header;
+    memcpy ( &header, base, sizeof ( header ) );
+    if ( memcmp ( header.magic, segmentMagic, sizeof ( header.magic ) ) != 0 )
+    {
+        munmap ( mapping, fileSize );
+        throw std::runtime_error ( "File " + filename + " is not a journal segment or has an unsupported format version." );
+    }
+
+    std::vector<std::string> dictionary;
+    int64_t timestamp = header.monotonicClockBase;
+    const char* batch = base + sizeof ( header );
+    while ( batch + batchHeaderSize <= end && static_cast<uint8_t> ( *batch ) == batchMarker )
+    {
+        uint32_t payloadLength = 0;
+        uint32_t checksum = 0;
+        memcpy ( &payloadLength, batch + 1, sizeof ( payloadLength ) );
+        memcpy ( &checksum, batch + 5, sizeof ( checksum ) );
+        const char* position = batch + batchHeaderSize;
+        if ( payloadLength > static_cast<size_t> ( end - position ) || checksumFNV1a ( position, payloadLength ) != checksum )
+            break; // Incomplete batch written during a crash
+        const char*const batchEnd = position + payloadLength;
+        bool valid = true;
+        while ( valid && position < batchEnd )
+        {
+            const uint8_t recordType = static_cast<uint8_t> ( *position++ );
+            if ( recordType == dictionaryRecord )
+            {
+                uint64_t id = 0;
+                uint64_t length = 0;
+                valid = readVarint ( position, batchEnd, id ) && readVarint ( position, batchEnd, length )
+                        && id == dictionary.size() && length <= static_cast<uint64_t> ( batchEnd - position );
+                if ( valid )
+                {
+                    dictionary.push_back ( std::string ( position, length ) );
+                    position += length;
+                }
+            }
+            else if ( recordType == transitionRecord )
+            {
+                uint64_t delta = 0;
+                uint64_t pvid = 0;
+                uint64_t statusid = 0;
+                valid = readVarint ( position, batchEnd, delta ) && readVarint ( position, batchEnd, pvid ) && batchEnd - position >= 2;
+                if ( !valid )
+                    break;
+                const uint8_t type = static_cast<uint8_t> ( *position++ );
+                const uint8_t severity = static_cast<uint8_t> ( *position++ );
+                valid = readVarint ( position, batchEnd, statusid ) && pvid < dictionary.size() && statusid < dictionary.size()
+                        && type >= AlarmTransition::Raised && type <= AlarmTransition::Cleared && severity <= AlarmStatusEntry::SeverityUnknown;
+                if ( valid )
+                {
+                    timestamp += static_cast<int64_t> ( delta );
+                    AlarmTransition transition;
+                    transition.type = static_cast<AlarmTransition::TransitionType> ( type );
+                    transition.pvname = dictionary[pvid];
+                    transition.severity = static_cast<AlarmStatusEntry::SeverityLevel> ( severity );
+                    transition.status = dictionary[statusid];
+                    transition.monotonicTime = timestamp;
+                    transition.wallTime = header.wallClockBase + ( timestamp - header.monotonicClockBase );
+                    transitions.push_back ( std::move ( transition ) );
+                }
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+        if ( !valid )
+            break; // A batch with a valid checksum but invalid content cannot be trusted, and neither can anything behind it
+        batch = batchEnd;
+    }
+    munmap ( mapping, fileSize );
+}
+
+std::vector<AlarmTransition> AlarmJournal::readTimeline ( const std::string& directory )
+{
+    std::vector<AlarmTransition> timeline;
+    const std::vector<AlarmStatusEntry> base = AlarmStateSnapshot::read ( baseSnapshotFileName ( directory ) );
+    for ( auto i = base.begin(); i != base.end(); i++ )
+    {
+        AlarmTransition transition;
+        transition.type = AlarmTransition::Raised;
+        transition.pvname = ( *i ).getPVName();
+        transition.severity = ( *i ).getSeverityLevel();
+        transition.status = ( *i ).getStatus();
+        transition.monotonicTime = 0;
+        transition.wallTime = static_cast<int64_t> ( ( *i ).getTriggerTime() ) * 1000000000;
+        timeline.push_back ( std::move ( transition ) );
+    }
+    const std::vector<uint64_t> segments = listSegments ( directory );
+    for ( auto i = segments.begin(); i != segments.end(); i++ )
+        readSegment ( segmentFileName ( directory, *i ), timeline );
+    return timeline;
+}
@@ -0,0 +1,354 @@
+/**
+ * @file alarmjournal.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Append-only journal of alarm state transitions
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMJOURNAL_H
+#define ALARMJOURNAL_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alarmtransition.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Write-ahead journal of all applied alarm state transitions
+ *
+ * AlarmServerConnector only knows the alarms that are currently active, once an alarm is cleared it is gone. To be able to reconstruct the timeline of an incident afterwards, every transition applied to the map of active alarms is handed to this class via append() and written to a journal on disk.
+ *
+ * Writing a file for every single message would slow down the reception of messages considerably, especially during an alarm storm. Therefore append() only puts the transition into a queue, and a background thread collects all queued transitions every groupCommitInterval milliseconds and writes them with a single write() and fdatasync() call ("group commit").
+ *
+ * The journal is split into segment files named journal-NNNNNNNNNN.anj in the journal directory. Each segment begins with a header that contains the wall clock and the monotonic clock at the time it was opened, followed by batches of records, one batch per group commit. Every batch carries its length and a checksum, so a batch that was only partially written when the machine crashed is recognized and ignored by the reader. Within a batch, PV names and status strings are replaced by numeric IDs from a dictionary that is built up for each segment individually: The first time a string is used in a segment, a dictionary record assigning the ID is written before the transition record. Timestamps are stored as the difference to the previous record on the monotonic clock. With these measures, a typical transition needs less than ten bytes on disk.
+ *
+ * When a segment has grown beyond the configured size, it is closed and a new one is opened. If more than the configured number of closed segments exist afterwards, the oldest ones are folded by the compactor into the base snapshot journal-base.ans: The transitions of the segment are applied to the alarms stored in the snapshot and the segment is deleted. The snapshot uses the file format of AlarmStateSnapshot. This way, the disk usage of the journal is limited while the alarm state at the beginning of the oldest segment is still known.
+ */
+class AlarmJournal
+{
+private:
+    /**
+     * @brief Interval of group commits
+     *
+     * Time in milliseconds the background thread waits between two group commits. This is the maximum time a transition can get lost when the machine crashes.
+     */
+    static const unsigned int groupCommitInterval = 100;
+    /**
+     * @brief Magic string at the beginning of a segment file
+     *
+     * Used to recognize a segment file, the last two characters are the format version.
+     */
+    static const char segmentMagic[9];
+    /**
+     * @brief Marker byte at the beginning of a batch
+     *
+     * Used to detect garbage at the end of a segment.
+     */
+    static const uint8_t batchMarker = 0xb7;
+    /**
+     * @brief Record type for dictionary entries
+     *
+     * A dictionary record is followed by the numeric ID, the string length and the string itself.
+     */
+    static const uint8_t dictionaryRecord = 1;
+    /**
+     * @brief Record type for transitions
+     *
+     * A transition record is followed by the time difference to the previous record, the ID of the PV name, the transition type, the severity level and the ID of the status string.
+     */
+    static const uint8_t transitionRecord = 2;
+    /**
+     * @brief Segment file header
+     *
+     * The header is located at the very beginning of each segment file.
+     */
+    struct SegmentHeader
+    {
+        /**
+         * @brief Magic string
+         *
+         * Copy of segmentMagic without the terminating null character.
+         */
+        char magic[8];
+        /**
+         * @brief Sequence number of the segment
+         *
+         * Also part of the file name.
+         */
+        uint64_t segmentNumber;
+        /**
+         * @brief Wall clock when the segment was opened
+         *
+         * Nanoseconds since the Unix epoch.
+         */
+        int64_t wallClockBase;
+        /**
+         * @brief Monotonic clock when the segment was opened
+         *
+         * Nanoseconds on CLOCK_MONOTONIC, taken at the same time as wallClockBase.
+         */
+        int64_t monotonicClockBase;
+    };
+    /**
+     * @brief Journal directory
+     *
+     * All segment files and the base snapshot are located here.
+     */
+    const std::string _directory;
+    /**
+     * @brief Maximum segment size
+     *
+     * Size in bytes after which a segment is closed and a new one is opened.
+     */
+    const uint64_t _segmentsize;
+    /**
+     * @brief Number of closed segments to keep
+     *
+     * If there are more closed segments, the oldest ones are folded into the base snapshot.
+     */
+    const unsigned int _retainedsegments;
+    /**
+     * @brief Queue of transitions waiting for the next group commit
+     *
+     * Filled by append(), emptied by the background thread. Protected by _pendingmutex.
+     */
+    std::vector<AlarmTransition> _pending;
+    /**
+     * @brief Mutex to protect _pending
+     *
+     * Only held for the time needed to add a transition or to swap the whole queue.
+     */
+    mutable boost::mutex _pendingmutex;
+    /**
+     * @brief Wake-up condition of the background thread
+     *
+     * Used to wake up the background thread early when the journal is closed.
+     */
+    boost::condition_variable _pendingcondition;
+    /**
+     * @brief Background thread abortion flag
+     *
+     * The destructor will set this flag to false, so the background thread will exit its loop. Protected by _pendingmutex.
+     */
+    bool _run;
+    /**
+     * @brief File descriptor of the current segment
+     *
+     * Only used by the background thread. -1 if no segment is open.
+     */
+    int _fd;
+    /**
+     * @brief Sequence number of the current segment
+     *
+     * Only used by the background thread.
+     */
+    uint64_t _segmentnumber;
+    /**
+     * @brief Size of the current segment
+     *
+     * Number of bytes written to the current segment so far. Only used by the background thread.
+     */
+    uint64_t _segmentbytes;
+    /**
+     * @brief Timestamp of the last transition record
+     *
+     * Monotonic time of the last record written to the current segment, the next record only stores the difference to it. Only used by the background thread.
+     */
+    int64_t _lasttimestamp;
+    /**
+     * @brief Dictionary of the current segment
+     *
+     * Maps PV names and status strings to their IDs within the current segment. Only used by the background thread.
+     */
+    std::unordered_map<std::string, uint64_t> _dictionary;
+    /**
+     * @brief Closed segments on disk
+     *
+     * Sequence numbers of all closed segments in the journal directory, oldest first. Only used by the background thread.
+     */
+    std::deque<uint64_t> _closedsegments;
+    /**
+     * @brief Group commit thread
+     *
+     * This thread object will run the startCommitter() method.
+     */
+    boost::thread _committhread;
+
+    /**
+     * @brief Group commit loop
+     *
+     * Swaps the queue of pending transitions every groupCommitInterval milliseconds and passes the transitions to commit(). Loops until _run is set to false and writes the remaining transitions afterwards.
+     * @return Nothing
+     */
+    void startCommitter();
+    /**
+     * @brief Write a batch of transitions
+     *
+     * Encodes the transitions into a single batch, writes it to the current segment and flushes it to disk. Opens a new segment and starts the compactor if the segment has grown too large.
+     *
+     * This method cannot throw exceptions, errors are forwarded to the global ExceptionHandler().
+     * @param transitions The transitions to be written
+     * @return Nothing
+     */
+    void commit ( const std::vector<AlarmTransition>& transitions ) noexcept;
+    /**
+     * @brief Look up or create a dictionary ID
+     *
+     * If the string is not yet in the dictionary of the current segment, a new ID is assigned and a dictionary record is appended to the batch.
+     * @param batch The batch being encoded
+     * @param text PV name or status string
+     * @return ID of the string within the current segment
+     */
+    uint64_t dictionaryID ( std::string& batch, const std::string& text );
+    /**
+     * @brief Open a new segment
+     *
+     * Creates the segment file with the next sequence number, writes the header and resets the dictionary.
+     * @return Nothing
+     * @exception std::runtime_error The segment file could not be created.
+     */
+    void openSegment();
+    /**
+     * @brief Close the current segment
+     *
+     * Closes the file descriptor and adds the segment to _closedsegments. A segment without any batch is deleted instead.
+     * @return Nothing
+     */
+    void closeSegment() noexcept;
+    /**
+     * @brief Fold old segments into the base snapshot
+     *
+     * As long as there are more than _retainedsegments closed segments, the transitions of the oldest one are applied to the base snapshot, which is then written back, and the segment is deleted.
+     * @return Nothing
+     * @exception std::runtime_error A file could not be read or written.
+     */
+    void compact();
+public:
+    /**
+     * @brief Constructor
+     *
+     * Looks for segments of a previous run in the journal directory, opens a new segment and starts the group commit thread.
+     * @param directory Journal directory, must exist and be writable
+     * @param segmentSize Size in bytes after which a new segment is started
+     * @param retainedSegments Number of closed segments kept before they are folded into the base snapshot
+     * @exception std::runtime_error The journal directory cannot be read or the segment file cannot be created.
+     */
+    AlarmJournal ( const std::string& directory, const uint64_t segmentSize, const unsigned int retainedSegments );
+    /**
+     * @brief Destructor
+     *
+     * Stops the group commit thread after all queued transitions have been written and closes the current segment.
+     */
+    ~AlarmJournal();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmJournal
+     */
+    AlarmJournal ( const AlarmJournal& other ) = delete;
+    /**
+     * @brief Move constructor (C++11, deleted)
+     *
+     * This class cannot be moved.
+     * @param other Another instance of AlarmJournal
+     */
+    AlarmJournal ( AlarmJournal&& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmJournal
+     * @return Nothing (deleted)
+     */
+    AlarmJournal& operator= ( const AlarmJournal& other ) = delete;
+    /**
+     * @brief Move assignment (C++11, deleted)
+     *
+     * This class cannot be moved.
+     * @param other Another instance of AlarmJournal
+     * @return Nothing (deleted)
+     */
+    AlarmJournal& operator= ( AlarmJournal&& other ) = delete;
+    /**
+     * @brief Add transition to the journal
+     *
+     * The transition is queued and written by the next group commit. This method only locks a mutex for a very short time and never touches the disk, so it can be called from the message reception path.
+     * @param transition The transition that has been applied
+     * @return Nothing
+     */
+    void append ( AlarmTransition&& transition );
+    /**
+     * @brief Number of queued transitions
+     *
+     * Transitions passed to append() that have not been handed to the next group commit yet.
+     * @return Length of the queue
+     */
+    size_t getQueueDepth() const noexcept;
+    /**
+     * @brief Read monotonic clock
+     *
+     * Reads Clock::instance(), the same clock AlarmServerConnector stamps AlarmTransition::monotonicTime with, so segment headers and transitions agree under a SimulatedClock as well.
+     * @return Nanoseconds on the monotonic clock of Clock::instance()
+     */
+    static int64_t monotonicNow() noexcept;
+    /**
+     * @brief Read the transitions of a segment file
+     *
+     * Maps the segment file into memory and decodes all complete batches. Decoding stops at the first incomplete or damaged batch, which usually is the last batch of a segment written during a crash. The wall clock time of each transition is calculated from its monotonic time and the clock values in the segment header.
+     * @param filename Path of the segment file
+     * @param transitions The decoded transitions are appended to this vector
+     * @return Nothing
+     * @exception std::runtime_error The file cannot be read or is not a journal segment.
+     */
+    static void readSegment ( const std::string& filename, std::vector<AlarmTransition>& transitions );
+    /**
+     * @brief Read the complete timeline of a journal directory
+     *
+     * Returns the alarms stored in the base snapshot as Raised transitions at their trigger time, followed by the transitions of all segments in the directory in chronological order.
+     * @param directory Journal directory
+     * @return All transitions known to the journal
+     * @exception std::runtime_error A file cannot be read.
+     */
+    static std::vector<AlarmTransition> readTimeline ( const std::string& directory );
+};
+
+}
+
+#endif // ALARMJOURNAL_H
@@ -0,0 +1,355 @@
+/**
+ * @file alarmloadgenerator.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Synthetic message streams of the CSS Alarm Server
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmloadgenerator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <ostream>
+#include <stdexcept>
+
+using namespace AlarmNotifications;
+
+AlarmLoadModel::AlarmLoadModel()
+    : pvCount ( 1000 ),
+      pvsPerIOC ( 50 ),
+      prefix ( "LOADGEN" ),
+      alarmRate ( 1.0 / 24 ),
+      alarmDuration ( 300 ),
+      flappingFraction ( 0.01 ),
+      flapPeriod ( 20 ),
+      stormRate ( 1 ),
+      stormFraction ( 0.2 ),
+      stormSpread ( 5 ),
+      rebootRate ( 1 ),
+      rebootDuration ( 60 ),
+      cascadeProbability ( 0.3 ),
+      idleInterval ( 10 ),
+      configRate ( 0.5 ),
+      seed ( 1 )
+{
+}
+
+bool AlarmLoadModel::setOption ( const std::string& option, const char*const value )
+{
+    const double number = atof ( value );
+    if ( option == "--pvs" && atoi ( value ) > 0 )
+        pvCount = static_cast<unsigned int> ( atoi ( value ) );
+    else if ( option == "--pvs-per-ioc" && atoi ( value ) > 0 )
+        pvsPerIOC = static_cast<unsigned int> ( atoi ( value ) );
+    else if ( option == "--prefix" )
+        prefix = value;
+    else if ( option == "--seed" )
+        seed = static_cast<uint64_t> ( strtoull ( value, nullptr, 10 ) );
+    else if ( option == "--alarm-rate" && number >= 0 )
+        alarmRate = number;
+    else if ( option == "--alarm-duration" && number >= 0 )
+        alarmDuration = number;
+    else if ( option == "--flapping" && number >= 0 && number <= 1 )
+        flappingFraction = number;
+    else if ( option == "--flap-period" && number >= 0 )
+        flapPeriod = number;
+    else if ( option == "--storm-rate" && number >= 0 )
+        stormRate = number;
+    else if ( option == "--storm-fraction" && number >= 0 && number <= 1 )
+        stormFraction = number;
+    else if ( option == "--storm-spread" && number >= 0 )
+        stormSpread = number;
+    else if ( option == "--reboot-rate" && number >= 0 )
+        rebootRate = number;
+    else if ( option == "--reboot-duration" && number >= 0 )
+        rebootDuration = number;
+    else if ( option == "--cascade" && number >= 0 && number <= 1 )
+        cascadeProbability = number;
+    else if ( option == "--idle-interval" && number >= 0 )
+        idleInterval = number;
+    else if ( option == "--config-rate" && number >= 0 )
+        configRate = number;
+    else
+        return false;
+    return true;
+}
+
+void AlarmLoadModel::printOptions ( std::ostream& stream )
+{
+    stream << "Model options (rates per hour, durations in seconds):" << std::endl;
+    stream << "  --pvs N --pvs-per-ioc N --prefix NAME --seed N" << std::endl;
+    stream << "  --alarm-rate RATE --alarm-duration SECONDS            independent alarms per PV" << std::endl;
+    stream << "  --flapping FRACTION --flap-period SECONDS             flapping PVs" << std::endl;
+    stream << "  --storm-rate RATE --storm-fraction FRACTION --storm-spread SECONDS" << std::endl;
+    stream << "  --reboot-rate RATE --reboot-duration SECONDS --cascade PROBABILITY" << std::endl;
+    stream << "  --idle-interval SECONDS --config-rate RATE" << std::endl;
+}
+
+bool AlarmLoadGenerator::Event::operator> ( const AlarmLoadGenerator::Event& other ) const noexcept
+{
+    if ( time != other.time )
+        return time > other.time;
+    return sequence > other.sequence;
+}
+
+AlarmLoadGenerator::AlarmLoadGenerator ( const AlarmLoadModel& model, const int64_t startWallTime )
+    : _model ( model ),
+      _startwalltime ( startWallTime ),
+      _random ( model.seed ),
+      _sequence ( 0 )
+{
+    if ( _model.pvCount == 0 || _model.pvsPerIOC == 0 )
+        throw std::invalid_argument ( "The load model needs at least one PV and one PV per IOC." );
+    if ( _model.alarmRate < 0 || _model.alarmDuration < 0 || _model.flappingFraction < 0 || _model.flapPeriod < 0
+            || _model.stormRate < 0 || _model.stormFraction < 0 || _model.stormSpread < 0 || _model.rebootRate < 0
+            || _model.rebootDuration < 0 || _model.cascadeProbability < 0 || _model.idleInterval < 0 || _model.configRate < 0 )
+        throw std::invalid_argument ( "Rates and durations of the load model must not be negative." );
+
+    std::uniform_real_distribution<double> chance ( 0, 1 );
+    _pvs.resize ( _model.pvCount );
+    for ( unsigned int i = 0; i < _model.pvCount; i++ )
+    {
+        char name[64];
+        snprintf ( name, sizeof ( name ), ":IOC%03u:PV%06u", i / _model.pvsPerIOC, i );
+        _pvs[i].name = "epics://" + _model.prefix + name;
+        _pvs[i].inAlarm = false;
+        _pvs[i].disconnected = false;
+        _pvs[i].flapping = chance ( _random ) < _model.flappingFraction;
+        _pvs[i].generation = 0;
+        scheduleNextAlarm ( 0, i );
+    }
+    if ( _model.stormRate > 0 )
+        schedule ( exponential ( 3600 / _model.stormRate ), StormEvent, 0 );
+    if ( _model.rebootRate > 0 )
+        schedule ( exponential ( 3600 / _model.rebootRate ), RebootEvent, 0 );
+    if ( _model.idleInterval > 0 )
+        schedule ( static_cast<int64_t> ( _model.idleInterval * 1e9 ), IdleEvent, 0 );
+    if ( _model.configRate > 0 )
+        schedule ( exponential ( 3600 / _model.configRate ), ConfigEvent, 0 );
+}
+
+void AlarmLoadGenerator::schedule ( const int64_t time, const AlarmLoadGenerator::EventType type, const unsigned int target )
+{
+    Event event;
+    event.time = time;
+    event.sequence = _sequence++;
+    event.type = type;
+    event.target = target;
+    event.generation = ( type == RaiseEvent || type == ClearEvent ) ? _pvs[target].generation : 0;
+    _events.push ( event );
+}
+
+int64_t AlarmLoadGenerator::exponential ( const double mean )
+{
+    if ( mean <= 0 )
+        return 0;
+    std::exponential_distribution<double> distribution ( 1 / mean );
+    return static_cast<int64_t> ( distribution ( _random ) * 1e9 );
+}
+
+int64_t AlarmLoadGenerator::uniform ( const double maximum )
+{
+    std::uniform_real_distribution<double> distribution ( 0, maximum );
+    return static_cast<int64_t> ( distribution ( _random ) * 1e9 );
+}
+
+void AlarmLoadGenerator::scheduleNextAlarm ( const int64_t now, const unsigned int pv )
+{
+    if ( _pvs[pv].flapping && _model.flapPeriod > 0 )
+        schedule ( now + exponential ( _model.flapPeriod / 2 ), RaiseEvent, pv );
+    else if ( _model.alarmRate > 0 )
+        schedule ( now + exponential ( 3600 / _model.alarmRate ), RaiseEvent, pv );
+}
+
+void AlarmLoadGenerator::makeState ( const int64_t time, const unsigned int pv, const char*const severity, const char*const status, AlarmServerMessage& message ) const
+{
+    message.text = "STATE";
+    message.name = _pvs[pv].name;
+    message.severity = severity;
+    message.status = status;
+    const int64_t wallTime = _startwalltime + time;
+    const time_t seconds = static_cast<time_t> ( wallTime / 1000000000 );
+    tm local;
+    localtime_r ( &seconds, &local );
+    char text[32];
+    const size_t length = strftime ( text, sizeof ( text ), "%Y-%m-%d %H:%M:%S", &local );
+    snprintf ( text + length, sizeof ( text ) - length, ".%03d", static_cast<int> ( ( wallTime / 1000000 ) % 1000 ) );
+    message.eventTime = text;
+    message.brokerTime = 0; // Set by the message broker
+}
+
+void AlarmLoadGenerator::raise ( const int64_t time, const unsigned int pv, AlarmServerMessage& message )
+{
+    static const char*const severities[] = { "MINOR", "MINOR", "MINOR", "MAJOR", "MAJOR", "INVALID" };
+    static const char*const statuses[] = { "HIGH_ALARM", "LOW_ALARM", "STATE_ALARM", "HIHI_ALARM", "LOLO_ALARM", "UDF_ALARM" };
+    std::uniform_int_distribution<int> choice ( 0, 5 );
+    const int kind = choice ( _random );
+    PVState& state = _pvs[pv];
+    state.inAlarm = true;
+    state.generation++;
+    makeState ( time, pv, severities[kind], statuses[kind], message );
+    if ( state.flapping && _model.flapPeriod > 0 )
+        schedule ( time + exponential ( _model.flapPeriod / 2 ), ClearEvent, pv );
+    else
+        schedule ( time + exponential ( _model.alarmDuration ), ClearEvent, pv );
+}
+
+void AlarmLoadGenerator::reboot ( const int64_t time, const unsigned int ioc )
+{
+    const unsigned int first = ioc * _model.pvsPerIOC;
+    if ( first >= _pvs.size() || _pvs[first].disconnected )
+        return; // Already rebooting
+    const int64_t back = time + static_cast<int64_t> ( _model.rebootDuration * 1e9 );
+    for ( unsigned int pv = first; pv < first + _model.pvsPerIOC && pv < _pvs.size(); pv++ )
+    {
+        // The channel access timeouts of the alarm server notice the PVs one after the other
+        schedule ( time + uniform ( 1 ), DisconnectEvent, pv );
+        schedule ( back + uniform ( 2 ), ReconnectEvent, pv );
+    }
+    std::uniform_real_distribution<double> chance ( 0, 1 );
+    if ( chance ( _random ) < _model.cascadeProbability )
+    {
+        const unsigned int iocCount = static_cast<unsigned int> ( ( _pvs.size() + _model.pvsPerIOC - 1 ) / _model.pvsPerIOC );
+        schedule ( time + uniform ( 30 ), CascadeEvent, ( ioc + 1 ) % iocCount );
+    }
+}
+
+bool AlarmLoadGenerator::process ( const AlarmLoadGenerator::Event& event, AlarmServerMessage& message )
+{
+    switch ( event.type )
+    {
+    case RaiseEvent:
+    {
+        PVState& state = _pvs[event.target];
+        if ( event.generation != state.generation || state.inAlarm || state.disconnected )
+            return false; // Outdated, the PV has changed in the meantime
+        raise ( event.time, event.target, message );
+        return true;
+    }
+    case ClearEvent:
+    {
+        PVState& state = _pvs[event.target];
+        if ( event.generation != state.generation || !state.inAlarm || state.disconnected )
+            return false;
+        state.inAlarm = false;
+        state.generation++;
+        makeState ( event.time, event.target, "OK", "NO_ALARM", message );
+        scheduleNextAlarm ( event.time, event.target );
+        return true;
+    }
+    case StormEvent:
+    {
+        std::uniform_real_distribution<double> chance ( 0, 1 );
+        for ( unsigned int pv = 0; pv < _pvs.size(); pv++ )
+            if ( chance ( _random ) < _model.stormFraction )
+                schedule ( event.time + uniform ( _model.stormSpread ), StormRaiseEvent, pv );
+        schedule ( event.time + exponential ( 3600 / _model.stormRate ), StormEvent, 0 );
+        return false;
+    }
+    case StormRaiseEvent:
+    {
+        const PVState& state = _pvs[event.target];
+        if ( state.inAlarm || state.disconnected )
+            return false;
+        raise ( event.time, event.target, message );
+        return true;
+    }
+    case RebootEvent:
+    {
+        const unsigned int iocCount = static_cast<unsigned int> ( ( _pvs.size() + _model.pvsPerIOC - 1 ) / _model.pvsPerIOC );
+        std::uniform_int_distribution<unsigned int> choice ( 0, iocCount - 1 );
+        reboot ( event.time, choice ( _random ) );
+        schedule ( event.time + exponential ( 3600 / _model.rebootRate ), RebootEvent, 0 );
+        return false;
+    }
+    case CascadeEvent:
+        reboot ( event.time, event.target );
+        return false;
+    case DisconnectEvent:
+    {
+        PVState& state = _pvs[event.target];
+        if ( state.disconnected )
+            return false;
+        state.disconnected = true;
+        state.inAlarm = true;
+        state.generation++; // Pending raise and clear events are void now
+        makeState ( event.time, event.target, "INVALID", "Disconnected", message );
+        return true;
+    }
+    case ReconnectEvent:
+    {
+        PVState& state = _pvs[event.target];
+        if ( !state.disconnected )
+            return false;
+        state.disconnected = false;
+        state.inAlarm = false;
+        state.generation++;
+        makeState ( event.time, event.target, "OK", "NO_ALARM", message );
+        scheduleNextAlarm ( event.time, event.target );
+        return true;
+    }
+    case IdleEvent:
+        message = AlarmServerMessage();
+        message.text = "IDLE";
+        schedule ( event.time + static_cast<int64_t> ( _model.idleInterval * 1e9 ), IdleEvent, 0 );
+        return true;
+    case ConfigEvent:
+    {
+        std::uniform_int_distribution<unsigned int> choice ( 0, static_cast<unsigned int> ( _pvs.size() - 1 ) );
+        message = AlarmServerMessage();
+        message.text = "CONFIG";
+        message.name = _pvs[choice ( _random )].name;
+        schedule ( event.time + exponential ( 3600 / _model.configRate ), ConfigEvent, 0 );
+        return true;
+    }
+    }
+    return false;
+}
+
+int64_t AlarmLoadGenerator::next ( AlarmServerMessage& message )
+{
+    while ( !_events.empty() )
+    {
+        const Event event = _events.top();
+        _events.pop();
+        if ( process ( event, message ) )
+            return event.time;
+    }
+    throw std::runtime_error ( "The load model does not produce any more messages." );
+}
+
+size_t AlarmLoadGenerator::getActiveAlarms() const noexcept
+{
+    size_t active = 0;
+    for ( auto i = _pvs.begin(); i != _pvs.end(); i++ )
+        if ( ( *i ).inAlarm )
+            active++;
+    return active;
+}
@@ -0,0 +1,284 @@
+/**
+ * @file alarmloadgenerator.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Synthetic message streams of the CSS Alarm Server
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMLOADGENERATOR_H
+#define ALARMLOADGENERATOR_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <iosfwd>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "alarmservermessage.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Parameters of the synthetic alarm load
+ *
+ * Describes the PV population and the rates of the alarm model used by AlarmLoadGenerator. Rates are given per hour, durations in seconds. The constructor sets a moderate default load.
+ */
+struct AlarmLoadModel
+{
+    unsigned int pvCount; ///< Number of PVs
+    unsigned int pvsPerIOC; ///< Number of PVs hosted by each IOC, the PVs are assigned to the IOCs in order
+    std::string prefix; ///< Prefix of the PV names, the names are PREFIX:IOCnnn:PVnnnnnn
+    double alarmRate; ///< Alarms per PV and hour, Poisson-distributed
+    double alarmDuration; ///< Mean time until an alarm clears, exponentially distributed
+    double flappingFraction; ///< Fraction of the PVs that flap, i.e. toggle between alarm and OK all the time
+    double flapPeriod; ///< Mean time of a complete alarm/OK cycle of a flapping PV
+    double stormRate; ///< Alarm storms per hour
+    double stormFraction; ///< Fraction of the PVs raising an alarm in a storm
+    double stormSpread; ///< Time over which the alarms of a storm are spread
+    double rebootRate; ///< IOC reboots per hour, all PVs of the IOC become disconnected
+    double rebootDuration; ///< Time until a rebooted IOC is back
+    double cascadeProbability; ///< Probability that a reboot causes the next IOC to reboot shortly after
+    double idleInterval; ///< Interval of the IDLE heartbeat messages of the alarm server, 0 disables them
+    double configRate; ///< CONFIG messages per hour
+    uint64_t seed; ///< Seed of the random number generator, the same seed gives the same stream
+
+    /**
+     * @brief Constructor
+     *
+     * Sets the default model: 1000 PVs on 20 IOCs, one alarm per PV and day lasting 5 minutes on average, 1 % flapping PVs, one storm per hour involving 20 % of the PVs and one IOC reboot per hour.
+     */
+    AlarmLoadModel();
+    /**
+     * @brief Set a parameter from a command line option
+     *
+     * Shared by the programs generating a synthetic load, so they understand the same options.
+     * @param option Name of the option including the leading dashes, e.g. "--storm-rate"
+     * @param value Value given for the option
+     * @return true if the option is a parameter of the model and the value is valid, false otherwise
+     */
+    bool setOption ( const std::string& option, const char*const value );
+    /**
+     * @brief Describe the options understood by setOption()
+     *
+     * @param stream Stream the description is written to, one line per group of options
+     * @return Nothing
+     */
+    static void printOptions ( std::ostream& stream );
+};
+
+/**
+ * @brief Generator of synthetic alarm server messages
+ *
+ * Simulates a population of PVs according to an AlarmLoadModel and produces the STATE, CONFIG and IDLE messages the CSS Alarm Server would publish for it, in chronological order. The simulation is a discrete event simulation on a simulated time axis, so the stream can be replayed at any speed, also much faster than real time.
+ *
+ * Besides independent alarms the model contains flapping PVs, alarm storms where a large part of the PVs raises an alarm within a short time, and IOC reboots where all PVs of an IOC become disconnected and come back later, possibly causing a cascade of reboots of further IOCs.
+ *
+ * This class is not thread-safe.
+ */
+class AlarmLoadGenerator final
+{
+private:
+    /**
+     * @brief Kind of a simulation event
+     */
+    enum EventType
+    {
+        RaiseEvent, ///< A PV raises an alarm
+        ClearEvent, ///< The alarm of a PV clears
+        StormEvent, ///< An alarm storm starts
+        StormRaiseEvent, ///< A PV raises an alarm as part of a storm
+        RebootEvent, ///< An IOC reboots, the next reboot is scheduled
+        CascadeEvent, ///< An IOC reboots as a consequence of the reboot of another IOC
+        DisconnectEvent, ///< A PV of a rebooting IOC becomes disconnected
+        ReconnectEvent, ///< A PV of a rebooted IOC is back
+        IdleEvent, ///< Heartbeat of the alarm server
+        ConfigEvent ///< Configuration change of the alarm server
+    };
+    /**
+     * @brief Scheduled simulation event
+     */
+    struct Event
+    {
+        int64_t time; ///< Simulated time in nanoseconds since the start
+        uint64_t sequence; ///< Order of scheduling, keeps events at the same time in order
+        EventType type; ///< Kind of event
+        unsigned int target; ///< Index of the PV or IOC, depending on the type
+        uint32_t generation; ///< Generation of the PV when the event has been scheduled, outdated events are ignored
+
+        /**
+         * @brief Priority of the event
+         *
+         * @param other Another event
+         * @return True if this event is later than the other one
+         */
+        bool operator> ( const Event& other ) const noexcept;
+    };
+    /**
+     * @brief Simulated state of a PV
+     */
+    struct PVState
+    {
+        std::string name; ///< Name including the "epics://" prefix
+        bool inAlarm; ///< An alarm is active
+        bool disconnected; ///< The IOC of the PV is rebooting
+        bool flapping; ///< The PV flaps
+        uint32_t generation; ///< Incremented with every change of the state, invalidates pending events
+    };
+    /**
+     * @brief The model
+     */
+    const AlarmLoadModel _model;
+    /**
+     * @brief Wall clock time of the start of the simulation
+     *
+     * Nanoseconds since the Unix epoch, used for the EVENTTIME of the messages.
+     */
+    const int64_t _startwalltime;
+    /**
+     * @brief Random number generator
+     */
+    std::mt19937_64 _random;
+    /**
+     * @brief State of all PVs
+     */
+    std::vector<PVState> _pvs;
+    /**
+     * @brief Pending events, earliest first
+     */
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event> > _events;
+    /**
+     * @brief Number of scheduled events
+     */
+    uint64_t _sequence;
+
+    /**
+     * @brief Schedule an event
+     *
+     * @param time Simulated time in nanoseconds
+     * @param type Kind of event
+     * @param target Index of the PV or IOC
+     * @return Nothing
+     */
+    void schedule ( const int64_t time, const EventType type, const unsigned int target );
+    /**
+     * @brief Exponentially distributed delay
+     *
+     * @param mean Mean delay in seconds
+     * @return Delay in nanoseconds
+     */
+    int64_t exponential ( const double mean );
+    /**
+     * @brief Uniformly distributed delay
+     *
+     * @param maximum Maximum delay in seconds
+     * @return Delay in nanoseconds between 0 and maximum
+     */
+    int64_t uniform ( const double maximum );
+    /**
+     * @brief Schedule the next alarm of a PV
+     *
+     * The next independent alarm, or the next cycle of a flapping PV.
+     * @param now Current simulated time
+     * @param pv Index of the PV
+     * @return Nothing
+     */
+    void scheduleNextAlarm ( const int64_t now, const unsigned int pv );
+    /**
+     * @brief Fill in a STATE message
+     *
+     * @param time Simulated time of the event
+     * @param pv Index of the PV
+     * @param severity Severity string
+     * @param status Status string
+     * @param message The message to be filled
+     * @return Nothing
+     */
+    void makeState ( const int64_t time, const unsigned int pv, const char*const severity, const char*const status, AlarmServerMessage& message ) const;
+    /**
+     * @brief Raise an alarm on a PV
+     *
+     * Chooses a severity and status and schedules the clearing of the alarm, which is the next toggle for a flapping PV.
+     * @param time Simulated time
+     * @param pv Index of the PV
+     * @param message The message to be filled
+     * @return Nothing
+     */
+    void raise ( const int64_t time, const unsigned int pv, AlarmServerMessage& message );
+    /**
+     * @brief Reboot an IOC
+     *
+     * Schedules the disconnection and the return of all PVs of the IOC, and possibly the reboot of the next IOC.
+     * @param time Simulated time
+     * @param ioc Index of the IOC
+     * @return Nothing
+     */
+    void reboot ( const int64_t time, const unsigned int ioc );
+    /**
+     * @brief Process an event
+     *
+     * @param event The event
+     * @param message Filled if the event produces a message
+     * @return True if a message has been produced
+     */
+    bool process ( const Event& event, AlarmServerMessage& message );
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates the PV population and schedules the first events.
+     * @param model Parameters of the load
+     * @param startWallTime Wall clock time the simulation starts at, in nanoseconds since the Unix epoch
+     * @exception std::invalid_argument The model has no PVs or a negative rate or duration
+     */
+    AlarmLoadGenerator ( const AlarmLoadModel& model, const int64_t startWallTime );
+    /**
+     * @brief Produce the next message
+     *
+     * @param message Filled with the next message
+     * @return Simulated time of the message in nanoseconds since the start of the simulation
+     * @exception std::runtime_error The model does not produce any more messages, i.e. all its rates are 0
+     */
+    int64_t next ( AlarmServerMessage& message );
+    /**
+     * @brief Number of PVs currently in alarm
+     *
+     * Includes the disconnected PVs of rebooting IOCs.
+     * @return Number of PVs in alarm according to the simulation
+     */
+    size_t getActiveAlarms() const noexcept;
+};
+
+}
+
+#endif // ALARMLOADGENERATOR_H
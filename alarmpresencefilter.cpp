@@ -0,0 +1,95 @@
+/**
+ * @file alarmpresencefilter.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Approximate set of the PVs in alarm
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmpresencefilter.h"
+
+#include "alarmsketches.h"
+
+using namespace AlarmNotifications;
+
+const size_t AlarmPresenceFilter::counterCount;
+const unsigned int AlarmPresenceFilter::hashCount;
+
+// A counter that has reached this value is never decremented again
+static const uint8_t saturated = 255;
+
+AlarmPresenceFilter::AlarmPresenceFilter()
+    : _counters ( new std::atomic<uint8_t>[counterCount] )
+{
+    static_assert ( ( counterCount & ( counterCount - 1 ) ) == 0, "The number of counters must be a power of two" );
+    for ( size_t i = 0; i < counterCount; i++ )
+        _counters[i].store ( 0, std::memory_order_relaxed );
+}
+
+size_t AlarmPresenceFilter::position ( const uint64_t hash, const unsigned int i ) noexcept
+{
+    // The odd step visits hashCount different counters, as counterCount is a power of two
+    const uint64_t step = ( hash >> 32 ) | 1;
+    return static_cast<size_t> ( ( hash + i * step ) & ( counterCount - 1 ) );
+}
+
+void AlarmPresenceFilter::add ( const std::string& pvname ) noexcept
+{
+    const uint64_t hash = sketchHash ( pvname );
+    for ( unsigned int i = 0; i < hashCount; i++ )
+    {
+        std::atomic<uint8_t>& counter = _counters[position ( hash, i )];
+        uint8_t value = counter.load ( std::memory_order_relaxed );
+        // A failed exchange reloads value, another shard of AlarmServerConnector has changed the counter
+        while ( value != saturated && !counter.compare_exchange_weak ( value, value + 1, std::memory_order_release, std::memory_order_relaxed ) )
+            ;
+    }
+}
+
+void AlarmPresenceFilter::remove ( const std::string& pvname ) noexcept
+{
+    const uint64_t hash = sketchHash ( pvname );
+    for ( unsigned int i = 0; i < hashCount; i++ )
+    {
+        std::atomic<uint8_t>& counter = _counters[position ( hash, i )];
+        uint8_t value = counter.load ( std::memory_order_relaxed );
+        while ( value != saturated && value != 0 && !counter.compare_exchange_weak ( value, value - 1, std::memory_order_release, std::memory_order_relaxed ) )
+            ;
+    }
+}
+
+bool AlarmPresenceFilter::mayContain ( const std::string& pvname ) const noexcept
+{
+    const uint64_t hash = sketchHash ( pvname );
+    for ( unsigned int i = 0; i < hashCount; i++ )
+    {
+        if ( _counters[position ( hash, i )].load ( std::memory_order_acquire ) == 0 )
+            return false;
+    }
+    return true;
+}
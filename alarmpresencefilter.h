@@ -0,0 +1,141 @@
+/**
+ * @file alarmpresencefilter.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Approximate set of the PVs in alarm
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMPRESENCEFILTER_H
+#define ALARMPRESENCEFILTER_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Approximate set of the PVs in alarm
+ *
+ * Most messages of the alarm server report severity OK for PVs that are not in alarm at all, and AlarmServerConnector used to take the lock of its map of active alarms for each of them only to find nothing to remove. This counting Bloom filter answers "definitely not in alarm" without any lock, so these messages can be dropped right away.
+ *
+ * Each PV name is mapped to hashCount of counterCount 8 bit counters, which are incremented when the PV is added and decremented when it is removed. A PV with a zero among its counters has certainly not been added, while a PV with all counters above zero has probably been added: The filter has false positives, which only cost the lookup it saves, but no false negatives. A counter that has reached 255 stays there, so an overflow can only cause false positives.
+ *
+ * The counters are changed by compare-and-swap, so add(), remove() and mayContain() can all be called concurrently by any number of threads: AlarmServerConnector calls add() and remove() under the locks of the shards of its map, which do not exclude each other.
+ */
+class AlarmPresenceFilter final
+{
+public:
+    /**
+     * @brief Number of counters
+     *
+     * A power of two. With 10000 PVs in alarm, about one in 2000 messages about other PVs is a false positive.
+     */
+    static const size_t counterCount = 1 << 18;
+    /**
+     * @brief Number of counters per PV
+     */
+    static const unsigned int hashCount = 4;
+private:
+    /**
+     * @brief The counters
+     */
+    std::unique_ptr<std::atomic<uint8_t>[]> _counters;
+
+    /**
+     * @brief Position of a counter of a PV
+     *
+     * Derived from one hash of the PV name by double hashing.
+     * @param hash sketchHash() of the PV name
+     * @param i Number of the counter, less than hashCount
+     * @return Index into _counters
+     */
+    static size_t position ( const uint64_t hash, const unsigned int i ) noexcept;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates an empty filter.
+     */
+    AlarmPresenceFilter();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmPresenceFilter
+     */
+    AlarmPresenceFilter ( const AlarmPresenceFilter& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmPresenceFilter
+     * @return Nothing (deleted)
+     */
+    AlarmPresenceFilter& operator= ( const AlarmPresenceFilter& other ) = delete;
+    /**
+     * @brief Add a PV
+     *
+     * Can be called concurrently with all other methods.
+     *
+     * This method cannot throw exceptions.
+     * @param pvname PV name
+     * @return Nothing
+     */
+    void add ( const std::string& pvname ) noexcept;
+    /**
+     * @brief Remove a PV added before
+     *
+     * Can be called concurrently with all other methods, but only for PVs that have been added and not removed since.
+     *
+     * This method cannot throw exceptions.
+     * @param pvname PV name
+     * @return Nothing
+     */
+    void remove ( const std::string& pvname ) noexcept;
+    /**
+     * @brief Check whether a PV may have been added
+     *
+     * Does not lock and can be called concurrently with all other methods.
+     *
+     * This method cannot throw exceptions.
+     * @param pvname PV name
+     * @return false if the PV has certainly not been added, true if it probably has
+     */
+    bool mayContain ( const std::string& pvname ) const noexcept;
+};
+
+}
+
+#endif // ALARMPRESENCEFILTER_H
@@ -33,6 +33,7 @@
 
 #include "alarmserverconnector.h"
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
@@ -44,26 +45,57 @@
 #endif
 
 #include "alarmconfiguration.h"
+#include "alarmsketches.h"
+#include "alarmstatesnapshot.h"
 #include "beedo.h"
+#include "clock.h"
 #include "cmsclient.h"
 #include "emailsender.h"
 #include "exceptionhandler.h"
 #include "flashlight.h"
+#include "metrics.h"
+#include "sharedtablemessagesource.h"
+#include "tracepoints.h"
 
 using namespace AlarmNotifications;
 
-AlarmServerConnector::AlarmServerConnector ( const bool desktopVersion, const bool activateBeedo )
+// Orders copies of the active alarms taken from several shards like the entries of a single map
+static bool byPVName ( const AlarmStatusEntry& a, const AlarmStatusEntry& b )
+{
+    return a.getPVName() < b.getPVName();
+}
+
+AlarmServerConnector::AlarmServerConnector ( const bool desktopVersion, const bool activateBeedo, std::unique_ptr<MessageSource> source )
     : _desktopVersion ( desktopVersion ),
       _activateBeedo ( activateBeedo ),
-      _cmsclient ( *this ),
+      _journal ( createJournal ( desktopVersion ) ),
+      _history ( createHistoryStore ( desktopVersion ) ),
+      _sharedtable ( createSharedTable ( desktopVersion ) ),
+      _stormdetector ( AlarmConfiguration::instance().getStormThreshold() ),
+      _alarmcount ( 0 ),
+      _oldestAlarm ( noAlarmActive ),
+      _snapshotdirty ( false ),
+      _shards ( createShards ( desktopVersion ) ),
+      _cmsclient ( *this, createMessageSource ( desktopVersion, std::move ( source ) ), createCapture ( desktopVersion ) ),
       _runwatcher ( true ),
       _flashlighton ( false ),
+      _stormnotificationdue ( 0 ),
       _watcher ( boost::bind ( &AlarmServerConnector::startWatcher, this ) ),
       _flashlightthread ( boost::bind ( &AlarmServerConnector::operateFlashLight, this ) ),
-      _oldestAlarm ( noAlarmActive )
+      _snapshotthread ( boost::bind ( &AlarmServerConnector::startSnapshotWriter, this ) ),
+      _debouncethread ( boost::bind ( &AlarmServerConnector::startDebounceTimer, this ) )
 {
     if ( !_desktopVersion && _activateBeedo )
         throw std::logic_error ( "The \"beedo\" optoacoustic alarm can only be used in desktop mode!" );
+    if ( !_desktopVersion )
+    {
+        createChangeFeed();
+        createEventStream();
+    }
+    _metricsgauges = Metrics::addGaugeProvider ( [this] ( std::ostream & stream )
+    {
+        writeGauges ( stream );
+    } );
 #ifndef NOTUSELIBNOTIFY
     notify_init ( "DCS Alarm System" );
 #endif
@@ -71,9 +103,24 @@ AlarmServerConnector::AlarmServerConnector ( const bool desktopVersion, const bo
 
 AlarmServerConnector::~AlarmServerConnector()
 {
+    // Their subscribers must not take snapshots of a map being destroyed
+    if ( _changefeed )
+        _changefeed->stop();
+    if ( _eventstream )
+        _eventstream->stop();
+    Metrics::removeGaugeProvider ( _metricsgauges );
     _runwatcher = false;
+    // Wake the threads up from their sleep, on a SimulatedClock they would never wake up otherwise
+    _watcher.interrupt();
+    _flashlightthread.interrupt();
+    _snapshotthread.interrupt();
+    _debouncethread.interrupt();
     _watcher.join();
     _flashlightthread.join();
+    _snapshotthread.join();
+    _debouncethread.join();
+    if ( !_desktopVersion )
+        writeSnapshot ( true ); // Keep the final state for the next start, with the time of the shutdown
 #ifndef NOTUSELIBNOTIFY
     notify_uninit();
 #endif
@@ -81,22 +128,169 @@ AlarmServerConnector::~AlarmServerConnector()
 
 void AlarmServerConnector::notifyStatusChange ( const AlarmStatusEntry status )
 {
-    boost::lock_guard<boost::mutex> concurrencylock ( _statusmapmutex );
-    const std::string& pvname = status.getPVName();
-    auto entry = _statusmap.find ( pvname );
-    if ( checkSeverityString ( status.getSeverity() ) )
+    if ( checkSeverityString ( status.getSeverity() ) && !_presence.mayContain ( status.getPVName() ) )
     {
-        if ( entry != _statusmap.end() )
-            _statusmap.erase ( entry );
+        Metrics::increment ( Metrics::MessagesSkipped );
+        return; // Nothing to clear
     }
-    else
+    if ( _fingerprints.repeats ( status ) )
     {
-        if ( entry == _statusmap.end() )
-            _statusmap.insert ( std::pair<std::string, AlarmStatusEntry> ( pvname, status ) );
+        Metrics::increment ( Metrics::MessagesDeduplicated );
+        return;
+    }
+    applyStatusChange ( status, false );
+}
+
+void AlarmServerConnector::applyStatusChange ( AlarmStatusEntry status, const bool debounced )
+{
+    AlarmTransition transition;
+    bool record = false; // Set if the map of the shard has changed and a journal, history, change feed or dashboard is kept
+    bool changed = false; // Set if the map of the shard has changed, transition.type tells how
+    AlarmStatusEntry::SeverityLevel clearedSeverity = AlarmStatusEntry::SeverityUnknown;
+    time_t clearedTriggerTime = 0;
+    {
+        Shard& shard = shardOf ( status.getPVName() );
+        InstrumentedMutex::ScopedLock concurrencylock ( shard.mutex, Metrics::NotifyStatusChangeLockWait, Metrics::NotifyStatusChangeLockHold );
+        if ( debounced && !shard.debouncer.release ( status.getPVName(), Clock::instance().monotonicNow(), status ) )
+        {
+            // The alarm in the map stays as it is, so its fingerprint may be used again
+            auto entry = shard.statusmap.find ( status.getPVName() );
+            if ( entry != shard.statusmap.end() && !shard.debouncer.holds ( status.getPVName() ) )
+                _fingerprints.record ( ( *entry ).second );
+            return; // Cancelled by a newer message in the meantime
+        }
+        const std::string& pvname = status.getPVName();
+        auto entry = shard.statusmap.find ( pvname );
+        const bool clearing = checkSeverityString ( status.getSeverity() );
+        const bool held = !debounced && shard.debouncer.holds ( pvname );
+        if ( !debounced && !shard.debouncer.admit ( status, clearing, entry != shard.statusmap.end(), Clock::instance().monotonicNow() ) )
+        {
+            // A held-back alarm must stay in _presence, so the message clearing it is not skipped
+            if ( entry == shard.statusmap.end() && held != shard.debouncer.holds ( pvname ) )
+            {
+                if ( held )
+                    _presence.remove ( pvname );
+                else
+                    _presence.add ( pvname );
+            }
+            // While a change is held back, a message repeating the alarm in the map has to reach the debouncer to cancel it
+            if ( entry != shard.statusmap.end() )
+            {
+                if ( shard.debouncer.holds ( pvname ) )
+                    _fingerprints.forget ( pvname );
+                else
+                    _fingerprints.record ( ( *entry ).second );
+            }
+            return; // Held back until it has persisted long enough, or dropped together with the change it cancels
+        }
+        if ( clearing )
+        {
+            if ( entry != shard.statusmap.end() )
+            {
+                clearedSeverity = ( *entry ).second.getSeverityLevel();
+                clearedTriggerTime = ( *entry ).second.getTriggerTime();
+                shard.statusmap.erase ( entry );
+                _alarmcount.fetch_sub ( 1, std::memory_order_relaxed );
+                _presence.remove ( pvname );
+                _fingerprints.forget ( pvname );
+                if ( _sharedtable )
+                {
+                    boost::lock_guard<boost::mutex> tablelock ( _sharedtablemutex );
+                    _sharedtable->remove ( pvname );
+                }
+                markSnapshotDirty();
+                transition.type = AlarmTransition::Cleared;
+                changed = true;
+                if ( _journal || _history || _changefeed || _eventstream )
+                {
+                    transition = makeTransition ( AlarmTransition::Cleared, status );
+                    record = true;
+                }
+            }
+        }
         else
-            ( *entry ).second.update ( status );
-        if ( _oldestAlarm == noAlarmActive )
-            _oldestAlarm = status.getTriggerTime();
+        {
+            if ( entry == shard.statusmap.end() )
+            {
+                AlarmStatusEntry applied ( status );
+                applied.setAppliedTime ( Metrics::now() );
+                shard.statusmap.insert ( std::pair<std::string, AlarmStatusEntry> ( pvname, std::move ( applied ) ) );
+                _alarmcount.fetch_add ( 1, std::memory_order_relaxed );
+                if ( !debounced )
+                    _presence.add ( pvname ); // A released alarm has been added when it was held back
+                _fingerprints.record ( status );
+                if ( _sharedtable )
+                {
+                    boost::lock_guard<boost::mutex> tablelock ( _sharedtablemutex );
+                    _sharedtable->publish ( pvname, status.getSeverity(), status.getStatus() );
+                }
+                transition.type = AlarmTransition::Raised;
+                changed = true;
+                if ( _journal || _history || _changefeed || _eventstream )
+                {
+                    transition = makeTransition ( AlarmTransition::Raised, status );
+                    record = true;
+                }
+            }
+            else
+            {
+                const bool differs = ( *entry ).second.getSeverity() != status.getSeverity() || ( *entry ).second.getStatus() != status.getStatus();
+                ( *entry ).second.update ( status );
+                // update() ignores messages that are not newer than the entry, so check if the change has really been applied
+                const bool applied = ( *entry ).second.getSeverity() == status.getSeverity() && ( *entry ).second.getStatus() == status.getStatus();
+                if ( applied )
+                    _fingerprints.record ( ( *entry ).second );
+                if ( differs && applied )
+                {
+                    if ( _sharedtable )
+                    {
+                        boost::lock_guard<boost::mutex> tablelock ( _sharedtablemutex );
+                        _sharedtable->publish ( pvname, status.getSeverity(), status.getStatus() );
+                    }
+                    transition.type = AlarmTransition::Updated;
+                    changed = true;
+                    if ( _journal || _history || _changefeed || _eventstream )
+                    {
+                        transition = makeTransition ( AlarmTransition::Updated, ( *entry ).second );
+                        record = true;
+                    }
+                }
+            }
+            markSnapshotDirty();
+            noteTriggerTime ( status.getTriggerTime() );
+        }
+        if ( record && _changefeed )
+            _changefeed->append ( transition ); // Under the lock, so the sequence numbers follow the order of the changes of each PV
+        if ( record && _eventstream )
+            _eventstream->append ( transition );
+    }
+    // Outside of the lock, the statistics, the journal and the history have their own
+    if ( changed )
+    {
+        Metrics::increment ( Metrics::MessagesApplied );
+        _stormdetector.record();
+        const time_t now = Clock::instance().wallTime();
+        switch ( transition.type )
+        {
+        case AlarmTransition::Raised:
+            _statistics.recordAlarm ( status.getPVName(), now );
+            break;
+        case AlarmTransition::Updated:
+            _statistics.recordUpdate ( status.getPVName(), now );
+            break;
+        case AlarmTransition::Cleared:
+            _statistics.recordClear ( clearedSeverity, static_cast<uint64_t> ( std::max ( now - clearedTriggerTime, static_cast<time_t> ( 0 ) ) ) );
+            break;
+        }
+    }
+    if ( changed )
+        AN_TRACE4 ( alarm__apply, status.getPVName().c_str(), static_cast<int> ( transition.type ), static_cast<int> ( status.getSeverityLevel() ), status.getPipelineTimes().received );
+    if ( record )
+    {
+        if ( _history )
+            _history->append ( transition );
+        if ( _journal )
+            _journal->append ( std::move ( transition ) );
     }
 }
 
@@ -109,40 +303,120 @@ bool AlarmServerConnector::checkSeverityString ( const std::string& severity )
     return false;
 }
 
+const unsigned int AlarmServerConnector::snapshotHeartbeat;
+
+AlarmServerConnector::Shard::Shard ( const unsigned int raiseDelay, const unsigned int clearDelay )
+    : debouncer ( raiseDelay, clearDelay )
+{
+}
+
+AlarmServerConnector::AllShardsLock::AllShardsLock ( AlarmServerConnector& connector, const Metrics::Histogram waitHistogram, const Metrics::Histogram holdHistogram )
+{
+    _locks.reserve ( connector._shards.size() );
+    for ( auto i = connector._shards.begin(); i != connector._shards.end(); i++ )
+        _locks.push_back ( std::unique_ptr<InstrumentedMutex::ScopedLock> ( new InstrumentedMutex::ScopedLock ( ( *i )->mutex, waitHistogram, holdHistogram ) ) );
+}
+
+size_t AlarmServerConnector::shardIndex ( const std::string& pvname, const size_t count ) noexcept
+{
+    if ( count == 1 )
+        return 0; // Saves hashing the PV name in the default configuration
+    return static_cast<size_t> ( sketchHash ( pvname ) % count );
+}
+
+AlarmServerConnector::Shard& AlarmServerConnector::shardOf ( const std::string& pvname ) noexcept
+{
+    return *_shards[shardIndex ( pvname, _shards.size() )];
+}
+
+std::vector<std::unique_ptr<AlarmServerConnector::Shard>> AlarmServerConnector::createShards ( const bool desktopVersion )
+{
+    const unsigned int count = std::max ( AlarmConfiguration::instance().getStatusMapShards(), 1u );
+    std::vector<std::unique_ptr<Shard>> shards;
+    shards.reserve ( count );
+    for ( unsigned int i = 0; i < count; i++ )
+        shards.push_back ( std::unique_ptr<Shard> ( new Shard ( AlarmConfiguration::instance().getDebounceRaiseDelay(), AlarmConfiguration::instance().getDebounceClearDelay() ) ) );
+    if ( !desktopVersion )
+        restoreSnapshot ( shards );
+    return shards;
+}
+
+void AlarmServerConnector::markSnapshotDirty() noexcept
+{
+    if ( !_snapshotdirty.load ( std::memory_order_relaxed ) )
+        _snapshotdirty.store ( true, std::memory_order_relaxed );
+}
+
+void AlarmServerConnector::noteTriggerTime ( const time_t triggerTime ) noexcept
+{
+    time_t oldest = _oldestAlarm.load ( std::memory_order_relaxed );
+    // A failed exchange reloads oldest, another shard has raised an alarm in the meantime
+    while ( ( oldest == noAlarmActive || triggerTime < oldest ) && !_oldestAlarm.compare_exchange_weak ( oldest, triggerTime, std::memory_order_relaxed ) )
+        ;
+}
+
 void AlarmServerConnector::startWatcher()
 {
     while ( _runwatcher )
     {
-        sleep ( 1 );
+        Clock::instance().sleepFor ( 1000000000 );
+        if ( _sharedtable )
+            _sharedtable->heartbeat();
+        if ( _stormdetector.update ( Clock::instance().monotonicNow() ) )
+        {
+            if ( _stormdetector.inStorm() )
+                std::cout << "Alarm storm: " << static_cast<unsigned long> ( _stormdetector.getRate() ) << " changes per second, notifications are summarised." << std::endl;
+            else
+                std::cout << "Alarm storm over, notifications are back to normal." << std::endl;
+        }
         checkStatusMap();
     }
 }
 
 void AlarmServerConnector::checkStatusMap()
 {
-    boost::lock_guard<boost::mutex> concurrencylock ( _statusmapmutex );
-    if ( _statusmap.size() == 0 && _oldestAlarm != noAlarmActive )
+    if ( _alarmcount.load ( std::memory_order_relaxed ) == 0 && _oldestAlarm.load ( std::memory_order_relaxed ) != noAlarmActive )
     {
-        _oldestAlarm = noAlarmActive;
-        if ( _activateBeedo )
+        bool reset = false;
+        {
+            // No alarm can be raised while all shards are locked, so _oldestAlarm is not reset behind its back
+            AllShardsLock concurrencylock ( *this, Metrics::CheckStatusMapLockWait, Metrics::CheckStatusMapLockHold );
+            if ( _alarmcount.load ( std::memory_order_relaxed ) == 0 )
+            {
+                _oldestAlarm.store ( noAlarmActive, std::memory_order_relaxed );
+                reset = true;
+            }
+        }
+        if ( reset && _activateBeedo )
             Beedo::stop();
     }
-    /*for ( auto i = _statusmap.begin(); i != _statusmap.end(); i++ )
-        std::cout << ( *i ).second << std::endl;*/
+    const bool storm = _stormdetector.inStorm();
+    const time_t now = Clock::instance().wallTime();
+    const time_t oldest = _oldestAlarm.load ( std::memory_order_relaxed );
+    const bool active = _alarmcount.load ( std::memory_order_relaxed ) != 0 && oldest != noAlarmActive;
+    // During a storm, the per-PV desktop selection is skipped until the next notification is due
     if (
-        _statusmap.size() != 0
-        && _oldestAlarm + AlarmConfiguration::instance().getDesktopNotificationTimeout() <= std::time ( nullptr )
+        active
+        && oldest + AlarmConfiguration::instance().getDesktopNotificationTimeout() <= now
+        && ( !storm || now >= _stormnotificationdue )
     )
     {
-        prepareDesktopNotification();
+        AN_TRACE2 ( deadline__expired, "desktop", oldest );
+        prepareDesktopNotification ( storm );
         if ( _activateBeedo )
             Beedo::start();
+        if ( storm )
+            _stormnotificationdue = now + StormDetector::notificationInterval;
     }
+    // E-mails escalate the alarms, so they are never deferred, only summarised
     if (
-        _statusmap.size() != 0
-        && _oldestAlarm + AlarmConfiguration::instance().getEMailNotificationTimeout() <= std::time ( nullptr )
+        active
+        && oldest + AlarmConfiguration::instance().getEMailNotificationTimeout() <= now
     )
-        prepareEMailNotification();
+    {
+        AN_TRACE2 ( deadline__expired, "email", oldest );
+        prepareEMailNotification ( storm );
+    }
 }
 
 void AlarmServerConnector::operateFlashLight()
@@ -151,14 +425,19 @@ void AlarmServerConnector::operateFlashLight()
         return; // Desktop version does not have a flashlight
     while ( _runwatcher )
     {
-        sleep ( 1 );
+        Clock::instance().sleepFor ( 1000000000 );
+        const time_t oldest = _oldestAlarm.load ( std::memory_order_relaxed );
         if (
             !_flashlighton
-            && _statusmap.size() != 0
-            && _oldestAlarm + AlarmConfiguration::instance().getLaboratoryNotificationTimeout() <= std::time ( nullptr )
+            && _alarmcount.load ( std::memory_order_relaxed ) != 0
+            && oldest != noAlarmActive
+            && oldest + AlarmConfiguration::instance().getLaboratoryNotificationTimeout() <= Clock::instance().wallTime()
         )
+        {
+            AN_TRACE2 ( deadline__expired, "flashlight", oldest );
             switchFlashLightOn();
-        if ( _flashlighton && _statusmap.size() == 0 )
+        }
+        if ( _flashlighton && _alarmcount.load ( std::memory_order_relaxed ) == 0 )
             switchFlashLightOff();
     }
 }
@@ -167,9 +446,28 @@ void AlarmServerConnector::switchFlashLightOn()
 {
     if ( AlarmConfiguration::instance().getLaboratoryNotificationTimeout() == 0 )
         return; // A value of 0 disables the notification via flash light
+    const int64_t scheduled = Metrics::now();
+    // The flash light is switched on for the oldest alarm, so its latency is the one to record
+    AlarmStatusEntry::PipelineTimes times = AlarmStatusEntry::PipelineTimes();
+    time_t oldest = noAlarmActive;
+    for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
+    {
+        InstrumentedMutex::ScopedLock concurrencylock ( ( *shard )->mutex, Metrics::SwitchFlashLightOnLockWait, Metrics::SwitchFlashLightOnLockHold );
+        for ( auto i = ( *shard )->statusmap.begin(); i != ( *shard )->statusmap.end(); i++ )
+        {
+            if ( oldest == noAlarmActive || ( *i ).second.getTriggerTime() < oldest )
+            {
+                oldest = ( *i ).second.getTriggerTime();
+                times = ( *i ).second.getPipelineTimes();
+            }
+        }
+    }
     _flashlighton = true;
     std::cout << "Flash light on!" << std::endl;
-    FlashLight::switchOn();
+    AN_TRACE3 ( notification__dispatch, "flashlight", 1, scheduled );
+    const int64_t dispatched = Metrics::now();
+    if ( FlashLight::switchOn() )
+        recordNotificationLatency ( Metrics::FlashLightApplyToSchedule, times, scheduled, dispatched, Metrics::now() );
 }
 
 void AlarmServerConnector::switchFlashLightOff()
@@ -181,35 +479,52 @@ void AlarmServerConnector::switchFlashLightOff()
     FlashLight::switchOff();
 }
 
-void AlarmServerConnector::prepareDesktopNotification()
+void AlarmServerConnector::prepareDesktopNotification ( const bool summarise )
 {
     if ( AlarmConfiguration::instance().getDesktopNotificationTimeout() == 0 )
         return; // A timeout of 0 disables desktop notifications
+    const int64_t scheduled = Metrics::now();
     std::vector<AlarmStatusEntry> alarmsToUse;
-    for ( auto i = _statusmap.begin(); i != _statusmap.end(); i++ )
+    for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
     {
-        if ( ( *i ).second.getTriggerTime() + AlarmConfiguration::instance().getDesktopNotificationTimeout() <= std::time ( nullptr ) )
+        InstrumentedMutex::ScopedLock concurrencylock ( ( *shard )->mutex, Metrics::CheckStatusMapLockWait, Metrics::CheckStatusMapLockHold );
+        for ( auto i = ( *shard )->statusmap.begin(); i != ( *shard )->statusmap.end(); i++ )
         {
-            if ( ! ( *i ).second.getDesktopNotificationSent() )
+            if ( ( *i ).second.getTriggerTime() + AlarmConfiguration::instance().getDesktopNotificationTimeout() <= Clock::instance().wallTime() )
             {
-                ( *i ).second.setDesktopNotificationSent ( true );
-                alarmsToUse.push_back ( AlarmStatusEntry ( ( *i ).second ) );
+                if ( ! ( *i ).second.getDesktopNotificationSent() )
+                {
+                    ( *i ).second.setDesktopNotificationSent ( true );
+                    markSnapshotDirty();
+                    alarmsToUse.push_back ( AlarmStatusEntry ( ( *i ).second ) );
+                }
             }
         }
     }
     if ( alarmsToUse.size() > 0 )
     {
-        boost::thread send ( boost::bind ( &AlarmServerConnector::sendDesktopNotification, this, std::move ( alarmsToUse ) ) );
+        if ( _shards.size() > 1 )
+            std::sort ( alarmsToUse.begin(), alarmsToUse.end(), byPVName );
+        boost::thread send ( boost::bind ( &AlarmServerConnector::sendDesktopNotification, this, std::move ( alarmsToUse ), scheduled, summarise ) );
         send.detach();
     }
+    InstrumentedMutex::recordSection ( Metrics::PrepareDesktopNotificationLockHold, scheduled );
 }
 
-void AlarmServerConnector::sendDesktopNotification ( const std::vector<AlarmStatusEntry> alarm )
+void AlarmServerConnector::sendDesktopNotification ( const std::vector<AlarmStatusEntry> alarm, const int64_t scheduled, const bool summarise )
 {
-    std::string alarmtext = "Alarm on this/these PV(s):\n";
-    for ( auto i = alarm.begin(); i != alarm.end(); i++ )
+    AN_TRACE3 ( notification__dispatch, "desktop", alarm.size(), scheduled );
+    const int64_t dispatched = Metrics::now();
+    std::string alarmtext;
+    if ( summarise )
+        alarmtext = StormDetector::summarise ( alarm );
+    else
     {
-        alarmtext += ( *i ).getPVName() + "\n";
+        alarmtext = "Alarm on this/these PV(s):\n";
+        for ( auto i = alarm.begin(); i != alarm.end(); i++ )
+        {
+            alarmtext += ( *i ).getPVName() + "\n";
+        }
     }
 #ifndef NOTUSELIBNOTIFY
     NotifyNotification* n = notify_notification_new (
@@ -229,39 +544,473 @@ void AlarmServerConnector::sendDesktopNotification ( const std::vector<AlarmStat
     command += std::string ( "'" );
     system ( command.c_str() );
 #endif
+    Metrics::increment ( Metrics::DesktopNotificationsSent );
+    const int64_t delivered = Metrics::now();
+    for ( auto i = alarm.begin(); i != alarm.end(); i++ )
+        recordNotificationLatency ( Metrics::DesktopApplyToSchedule, ( *i ).getPipelineTimes(), scheduled, dispatched, delivered );
 }
 
-void AlarmServerConnector::prepareEMailNotification()
+void AlarmServerConnector::prepareEMailNotification ( const bool summarise )
 {
     if ( _desktopVersion )
         return; // The desktop version does not send e-mails
     if ( AlarmConfiguration::instance().getEMailNotificationTimeout() == 0 )
         return; // A timeout of 0 disables e-mail notifications
+    const int64_t scheduled = Metrics::now();
     std::vector<AlarmStatusEntry> alarmsToUse;
-    for ( auto i = _statusmap.begin(); i != _statusmap.end(); i++ )
+    for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
     {
-        //if ( ( *i ).second.getTriggerTime() + AlarmConfiguration::instance().getEMailNotificationTimeout() <= std::time ( nullptr ) )
-        //{
-        if ( ! ( *i ).second.getEmailNotificationSent() )
+        InstrumentedMutex::ScopedLock concurrencylock ( ( *shard )->mutex, Metrics::CheckStatusMapLockWait, Metrics::CheckStatusMapLockHold );
+        for ( auto i = ( *shard )->statusmap.begin(); i != ( *shard )->statusmap.end(); i++ )
         {
-            ( *i ).second.setEmailNotificationSent ( true );
-            alarmsToUse.push_back ( AlarmStatusEntry ( ( *i ).second ) );
+            //if ( ( *i ).second.getTriggerTime() + AlarmConfiguration::instance().getEMailNotificationTimeout() <= Clock::instance().wallTime() )
+            //{
+            if ( ! ( *i ).second.getEmailNotificationSent() )
+            {
+                ( *i ).second.setEmailNotificationSent ( true );
+                markSnapshotDirty();
+                alarmsToUse.push_back ( AlarmStatusEntry ( ( *i ).second ) );
+            }
+            //}
         }
-        //}
     }
     if ( alarmsToUse.size() > 0 )
     {
-        boost::thread send ( boost::bind ( &AlarmServerConnector::sendEMailNotification, this, std::move ( alarmsToUse ) ) );
+        if ( _shards.size() > 1 )
+            std::sort ( alarmsToUse.begin(), alarmsToUse.end(), byPVName );
+        boost::thread send ( boost::bind ( &AlarmServerConnector::sendEMailNotification, this, std::move ( alarmsToUse ), scheduled, summarise ) );
         send.detach();
     }
+    InstrumentedMutex::recordSection ( Metrics::PrepareEMailNotificationLockHold, scheduled );
+}
+
+void AlarmServerConnector::sendEMailNotification ( const std::vector<AlarmStatusEntry> alarm, const int64_t scheduled, const bool summarise )
+{
+    AN_TRACE3 ( notification__dispatch, "email", alarm.size(), scheduled );
+    const int64_t dispatched = Metrics::now();
+    if ( !EMailSender::sendAlarmNotification ( alarm, summarise ) )
+        return; // Failures are counted by EMailSender, there is no delivery to measure
+    const int64_t delivered = Metrics::now();
+    for ( auto i = alarm.begin(); i != alarm.end(); i++ )
+        recordNotificationLatency ( Metrics::EMailApplyToSchedule, ( *i ).getPipelineTimes(), scheduled, dispatched, delivered );
+}
+
+void AlarmServerConnector::recordNotificationLatency ( const Metrics::Histogram firstStage, const AlarmStatusEntry::PipelineTimes& times, const int64_t scheduled, const int64_t dispatched, const int64_t delivered ) noexcept
+{
+    // The histograms of a channel follow each other in the order ApplyToSchedule, ScheduleToDispatch, DispatchToDelivered, EndToEnd
+    if ( times.applied != 0 )
+        Metrics::observe ( firstStage, scheduled - times.applied );
+    Metrics::observe ( static_cast<Metrics::Histogram> ( firstStage + 1 ), dispatched - scheduled );
+    Metrics::observe ( static_cast<Metrics::Histogram> ( firstStage + 2 ), delivered - dispatched );
+    if ( times.origin != 0 )
+        Metrics::observe ( static_cast<Metrics::Histogram> ( firstStage + 3 ), delivered - times.origin );
+}
+
+void AlarmServerConnector::startSnapshotWriter()
+{
+    if ( _desktopVersion )
+        return; // Desktop versions share the configuration file with the daemon, so they must not overwrite its snapshot
+    time_t written = 0; // Renew the file right after the start, so a restored snapshot does not age any further
+    while ( _runwatcher )
+    {
+        Clock::instance().sleepFor ( 1000000000 );
+        const time_t now = Clock::instance().wallTime();
+        if ( writeSnapshot ( now - written >= static_cast<time_t> ( snapshotHeartbeat ) ) )
+            written = now;
+    }
+}
+
+void AlarmServerConnector::startDebounceTimer()
+{
+    if ( !_shards.front()->debouncer.enabled() )
+    {
+        // Stay asleep on the clock anyway, so the number of threads sleeping on a SimulatedClock does not depend on the configuration
+        while ( _runwatcher )
+            Clock::instance().sleepFor ( 3600LL * 1000000000 );
+        return;
+    }
+    std::vector<std::string> due;
+    while ( _runwatcher )
+    {
+        int64_t next = 0;
+        for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
+        {
+            int64_t shardnext;
+            {
+                InstrumentedMutex::ScopedLock concurrencylock ( ( *shard )->mutex, Metrics::DebounceTimerLockWait, Metrics::DebounceTimerLockHold );
+                shardnext = ( *shard )->debouncer.due ( Clock::instance().monotonicNow(), due );
+            }
+            for ( auto i = due.begin(); i != due.end(); i++ )
+                applyStatusChange ( AlarmStatusEntry ( *i, "", "" ), true );
+            if ( shardnext != 0 && ( next == 0 || shardnext < next ) )
+                next = shardnext;
+        }
+        // A change held back from now on is not due before the shortest delay, so never sleep longer than that
+        const int64_t now = Clock::instance().monotonicNow();
+        int64_t sleep = _shards.front()->debouncer.shortestDelay();
+        if ( next != 0 && next - now < sleep )
+            sleep = next - now;
+        if ( sleep > 0 )
+            Clock::instance().sleepFor ( sleep );
+    }
+}
+
+bool AlarmServerConnector::writeSnapshot ( const bool force ) noexcept
+{
+    try
+    {
+        const std::string filename = AlarmConfiguration::instance().getSnapshotFileLocation();
+        if ( filename.empty() )
+            return false; // An empty file location disables the snapshot
+        // Reset before the copy is taken, so a change made while waiting for the locks sets it again
+        if ( !_snapshotdirty.exchange ( false ) && !force )
+            return false;
+        std::vector<AlarmStatusEntry> alarms;
+        alarms.reserve ( _alarmcount.load ( std::memory_order_relaxed ) );
+        {
+            // All shards at once, so the snapshot is a state the map has really been in
+            AllShardsLock concurrencylock ( *this, Metrics::WriteSnapshotLockWait, Metrics::WriteSnapshotLockHold );
+            for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
+            {
+                for ( auto i = ( *shard )->statusmap.begin(); i != ( *shard )->statusmap.end(); i++ )
+                    alarms.push_back ( ( *i ).second );
+            }
+        }
+        // The disk access happens without the lock, so the CMSClient is never blocked by it
+        AlarmStateSnapshot::write ( filename, alarms );
+        return true;
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "writing the alarm state snapshot." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "writing the alarm state snapshot." );
+    }
+    return false;
+}
+
+void AlarmServerConnector::restoreSnapshot ( std::vector<std::unique_ptr<Shard>>& shards ) noexcept
+{
+    try
+    {
+        const std::string filename = AlarmConfiguration::instance().getSnapshotFileLocation();
+        if ( filename.empty() )
+            return; // An empty file location disables the snapshot
+        int64_t creationTime;
+        const std::vector<AlarmStatusEntry> alarms = AlarmStateSnapshot::read ( filename, creationTime );
+        const unsigned int maximumAge = AlarmConfiguration::instance().getSnapshotMaximumAge();
+        const int64_t age = static_cast<int64_t> ( Clock::instance().wallTime() ) - creationTime;
+        if ( maximumAge != 0 && alarms.size() > 0 && age > static_cast<int64_t> ( maximumAge ) )
+        {
+            // Alarms cleared in the meantime would never be removed, as the alarm server does not repeat their state
+            std::cout << "Ignoring snapshot file " << filename << ", it has been written " << age << " seconds ago." << std::endl;
+            return;
+        }
+        // No message is received before the shards are complete, so they need no lock yet
+        const int64_t started = Metrics::now();
+        for ( auto i = alarms.begin(); i != alarms.end(); i++ )
+        {
+            Shard& shard = *shards[shardIndex ( ( *i ).getPVName(), shards.size() )];
+            if ( !shard.statusmap.insert ( std::pair<std::string, AlarmStatusEntry> ( ( *i ).getPVName(), *i ) ).second )
+                continue;
+            _alarmcount.fetch_add ( 1, std::memory_order_relaxed );
+            _presence.add ( ( *i ).getPVName() );
+            _fingerprints.record ( *i );
+            if ( _sharedtable )
+                _sharedtable->publish ( ( *i ).getPVName(), ( *i ).getSeverity(), ( *i ).getStatus() );
+            noteTriggerTime ( ( *i ).getTriggerTime() );
+        }
+        InstrumentedMutex::recordSection ( Metrics::RestoreSnapshotLockHold, started );
+        if ( alarms.size() > 0 )
+            std::cout << "Restored " << alarms.size() << " active alarm(s) from snapshot file " << filename << std::endl;
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "restoring the alarm state snapshot." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "restoring the alarm state snapshot." );
+    }
+}
+
+std::unique_ptr<AlarmJournal> AlarmServerConnector::createJournal ( const bool desktopVersion ) noexcept
+{
+    if ( desktopVersion )
+        return std::unique_ptr<AlarmJournal>(); // Desktop versions share the configuration file with the daemon, so they must not write into its journal
+    const std::string directory = AlarmConfiguration::instance().getJournalDirectory();
+    if ( directory.empty() )
+        return std::unique_ptr<AlarmJournal>(); // An empty directory disables the journal
+    try
+    {
+        return std::unique_ptr<AlarmJournal> ( new AlarmJournal (
+                directory,
+                static_cast<uint64_t> ( AlarmConfiguration::instance().getJournalSegmentSize() ) * 1024,
+                AlarmConfiguration::instance().getJournalRetainedSegments()
+                                               ) );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "opening the alarm journal." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "opening the alarm journal." );
+    }
+    return std::unique_ptr<AlarmJournal>();
+}
+
+std::unique_ptr<AlarmHistoryStore> AlarmServerConnector::createHistoryStore ( const bool desktopVersion ) noexcept
+{
+    if ( desktopVersion )
+        return std::unique_ptr<AlarmHistoryStore>(); // Same as for the journal, the history belongs to the daemon
+    const std::string directory = AlarmConfiguration::instance().getHistoryDirectory();
+    if ( directory.empty() )
+        return std::unique_ptr<AlarmHistoryStore>(); // An empty directory disables the history
+    try
+    {
+        return std::unique_ptr<AlarmHistoryStore> ( new AlarmHistoryStore ( directory ) );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "opening the alarm history." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "opening the alarm history." );
+    }
+    return std::unique_ptr<AlarmHistoryStore>();
+}
+
+std::unique_ptr<MessageCapture> AlarmServerConnector::createCapture ( const bool desktopVersion ) noexcept
+{
+    if ( desktopVersion )
+        return std::unique_ptr<MessageCapture>(); // The desktop versions receive the same messages as the daemon, one capture is enough
+    const std::string directory = AlarmConfiguration::instance().getCaptureDirectory();
+    if ( directory.empty() )
+        return std::unique_ptr<MessageCapture>(); // An empty directory disables the capture
+    try
+    {
+        return std::unique_ptr<MessageCapture> ( new MessageCapture ( directory ) );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "opening the message capture." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "opening the message capture." );
+    }
+    return std::unique_ptr<MessageCapture>();
+}
+
+std::unique_ptr<AlarmSharedTable> AlarmServerConnector::createSharedTable ( const bool desktopVersion ) noexcept
+{
+    if ( desktopVersion )
+        return std::unique_ptr<AlarmSharedTable>(); // The desktop versions read the table
+    const std::string name = AlarmConfiguration::instance().getSharedTableName();
+    if ( name.empty() )
+        return std::unique_ptr<AlarmSharedTable>(); // An empty name disables the shared table
+    try
+    {
+        return std::unique_ptr<AlarmSharedTable> ( new AlarmSharedTable ( name, true ) );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "creating the shared alarm table." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "creating the shared alarm table." );
+    }
+    return std::unique_ptr<AlarmSharedTable>();
+}
+
+void AlarmServerConnector::createChangeFeed() noexcept
+{
+    const std::string endpoint = AlarmConfiguration::instance().getChangeFeedEndpoint();
+    if ( endpoint.empty() )
+        return; // An empty endpoint disables the change feed
+    try
+    {
+        std::unique_ptr<AlarmChangeFeed> feed ( new AlarmChangeFeed ( endpoint, AlarmConfiguration::instance().getChangeFeedCapacity(), [this] ( std::vector<AlarmTransition>& active )
+        {
+            return snapshotForLocalClients ( active );
+        } ) );
+        AllShardsLock concurrencylock ( *this, Metrics::LocalClientSnapshotLockWait, Metrics::LocalClientSnapshotLockHold );
+        _changefeed = std::move ( feed );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "creating the change feed." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "creating the change feed." );
+    }
+}
+
+void AlarmServerConnector::createEventStream() noexcept
+{
+    const std::string endpoint = AlarmConfiguration::instance().getDashboardEndpoint();
+    if ( endpoint.empty() )
+        return; // An empty endpoint disables the dashboard
+    try
+    {
+        std::unique_ptr<AlarmEventStream> stream ( new AlarmEventStream ( endpoint, [this] ( std::vector<AlarmTransition>& active )
+        {
+            snapshotForLocalClients ( active );
+        } ) );
+        AllShardsLock concurrencylock ( *this, Metrics::LocalClientSnapshotLockWait, Metrics::LocalClientSnapshotLockHold );
+        _eventstream = std::move ( stream );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "creating the dashboard event stream." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "creating the dashboard event stream." );
+    }
 }
 
-void AlarmServerConnector::sendEMailNotification ( const std::vector<AlarmStatusEntry> alarm )
+uint64_t AlarmServerConnector::snapshotForLocalClients ( std::vector<AlarmTransition>& active )
 {
-    EMailSender::sendAlarmNotification ( alarm );
+    AllShardsLock concurrencylock ( *this, Metrics::LocalClientSnapshotLockWait, Metrics::LocalClientSnapshotLockHold );
+    active.reserve ( _alarmcount.load ( std::memory_order_relaxed ) );
+    for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
+    {
+        for ( auto i = ( *shard )->statusmap.begin(); i != ( *shard )->statusmap.end(); i++ )
+        {
+            AlarmTransition transition;
+            transition.type = AlarmTransition::Raised;
+            transition.pvname = ( *i ).first;
+            transition.severity = ( *i ).second.getSeverityLevel();
+            transition.status = ( *i ).second.getStatus();
+            transition.monotonicTime = 0;
+            transition.wallTime = static_cast<int64_t> ( ( *i ).second.getTriggerTime() ) * 1000000000;
+            active.push_back ( std::move ( transition ) );
+        }
+    }
+    // Until the constructor has set _changefeed under these locks, no change has been appended to it
+    return _changefeed ? _changefeed->lastSequence() : 0;
+}
+
+std::unique_ptr<MessageSource> AlarmServerConnector::createMessageSource ( const bool desktopVersion, std::unique_ptr<MessageSource> source ) noexcept
+{
+    if ( source || !desktopVersion )
+        return source;
+    const std::string name = AlarmConfiguration::instance().getSharedTableName();
+    if ( name.empty() || !AlarmSharedTable::available ( name ) )
+        return std::unique_ptr<MessageSource>(); // No daemon on this machine, connect to the message broker
+    try
+    {
+        return std::unique_ptr<MessageSource> ( new SharedTableMessageSource ( name ) );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "opening the shared alarm table." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "opening the shared alarm table." );
+    }
+    return std::unique_ptr<MessageSource>();
+}
+
+AlarmTransition AlarmServerConnector::makeTransition ( const AlarmTransition::TransitionType type, const AlarmStatusEntry& status )
+{
+    AlarmTransition transition;
+    transition.type = type;
+    transition.pvname = status.getPVName();
+    transition.severity = status.getSeverityLevel();
+    transition.status = status.getStatus();
+    transition.monotonicTime = Clock::instance().monotonicNow();
+    transition.wallTime = Clock::instance().wallNow();
+    return transition;
 }
 
 size_t AlarmServerConnector::getNumberOfAlarms() const noexcept
 {
-    return _statusmap.size();
+    return _alarmcount.load ( std::memory_order_relaxed );
+}
+
+void AlarmServerConnector::writeGauges ( std::ostream& stream )
+{
+    size_t active[AlarmStatusEntry::SeverityUnknown + 1] = { 0 };
+    size_t pendingDesktop = 0;
+    size_t pendingEMail = 0;
+    size_t pendingDebounce = 0;
+    for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
+    {
+        InstrumentedMutex::ScopedLock concurrencylock ( ( *shard )->mutex, Metrics::WriteGaugesLockWait, Metrics::WriteGaugesLockHold );
+        for ( auto i = ( *shard )->statusmap.begin(); i != ( *shard )->statusmap.end(); i++ )
+        {
+            active[ ( *i ).second.getSeverityLevel()]++;
+            if ( ! ( *i ).second.getDesktopNotificationSent() )
+                pendingDesktop++;
+            if ( ! ( *i ).second.getEmailNotificationSent() )
+                pendingEMail++;
+        }
+        pendingDebounce += ( *shard )->debouncer.size();
+    }
+    stream << "# HELP an_active_alarms Active alarms by severity\n";
+    stream << "# TYPE an_active_alarms gauge\n";
+    for ( int level = AlarmStatusEntry::SeverityMinorAck; level <= AlarmStatusEntry::SeverityUnknown; level++ )
+        stream << "an_active_alarms{severity=\"" << AlarmStatusEntry::severityLevelToString ( static_cast<AlarmStatusEntry::SeverityLevel> ( level ) ) << "\"} " << active[level] << "\n";
+    stream << "# HELP an_pending_notifications Active alarms for which a notification has not been sent yet\n";
+    stream << "# TYPE an_pending_notifications gauge\n";
+    stream << "an_pending_notifications{kind=\"desktop\"} " << pendingDesktop << "\n";
+    stream << "an_pending_notifications{kind=\"email\"} " << pendingEMail << "\n";
+    stream << "# HELP an_debounce_pending Alarm changes held back until they have persisted for the debounce delay\n";
+    stream << "# TYPE an_debounce_pending gauge\n";
+    stream << "an_debounce_pending " << pendingDebounce << "\n";
+    stream << "# HELP an_storm_mode 1 while an alarm storm is going on and notifications are summarised, 0 otherwise\n";
+    stream << "# TYPE an_storm_mode gauge\n";
+    stream << "an_storm_mode " << ( _stormdetector.inStorm() ? 1 : 0 ) << "\n";
+    stream << "# HELP an_change_rate Changes of the active alarms per second, averaged over the last few seconds\n";
+    stream << "# TYPE an_change_rate gauge\n";
+    stream << "an_change_rate " << _stormdetector.getRate() << "\n";
+    if ( _journal )
+    {
+        stream << "# HELP an_journal_queue_depth Transitions waiting for the next group commit of the journal\n";
+        stream << "# TYPE an_journal_queue_depth gauge\n";
+        stream << "an_journal_queue_depth " << _journal->getQueueDepth() << "\n";
+    }
+    if ( _history )
+    {
+        stream << "# HELP an_history_queue_depth Transitions waiting for the writer thread of the history\n";
+        stream << "# TYPE an_history_queue_depth gauge\n";
+        stream << "an_history_queue_depth " << _history->getQueueDepth() << "\n";
+    }
+}
+
+const AlarmStatistics& AlarmServerConnector::getStatistics() const noexcept
+{
+    return _statistics;
+}
+
+std::vector<AlarmStatusEntry> AlarmServerConnector::getActiveAlarms()
+{
+    std::vector<AlarmStatusEntry> alarms;
+    alarms.reserve ( _alarmcount.load ( std::memory_order_relaxed ) );
+    {
+        // All shards at once, so the copy is a state the map has really been in
+        AllShardsLock concurrencylock ( *this, Metrics::GetActiveAlarmsLockWait, Metrics::GetActiveAlarmsLockHold );
+        for ( auto shard = _shards.begin(); shard != _shards.end(); shard++ )
+        {
+            for ( auto i = ( *shard )->statusmap.begin(); i != ( *shard )->statusmap.end(); i++ )
+                alarms.push_back ( ( *i ).second );
+        }
+    }
+    if ( _shards.size() > 1 )
+        std::sort ( alarms.begin(), alarms.end(), byPVName );
+    return alarms;
+}
+
+CMSClient& AlarmServerConnector::getCMSClient() noexcept
+{
+    return _cmsclient;
 }
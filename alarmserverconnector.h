@@ -36,15 +36,32 @@
 
 #include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
 
+#include <atomic>
 #include <map>
 #include <limits>
+#include <memory>
+#include <ostream>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <boost/thread.hpp>
 
+#include "alarmchangefeed.h"
+#include "alarmdebouncer.h"
+#include "alarmfingerprints.h"
+#include "alarmeventstream.h"
+#include "alarmhistorystore.h"
+#include "alarmjournal.h"
+#include "alarmpresencefilter.h"
+#include "alarmsharedtable.h"
+#include "alarmstatistics.h"
 #include "alarmstatusentry.h"
 #include "cmsclient.h"
+#include "instrumentedmutex.h"
+#include "messagesource.h"
+#include "metrics.h"
+#include "stormdetector.h"
 
 #if ( __WORDSIZE < 64 ) || ( LONG_MAX < 9223372036854775807L )
 #warning Using this application on non-64bit architecture may cause it suffer from the year-2038-bug on 19 Jan 2038 03:14:07 UTC. Linux on 64bit is not affected as time_t is a long int and long int is 64bit wide there.
@@ -79,6 +96,87 @@ private:
 #else
     static const time_t noAlarmActive = LONG_MIN; // Fallback to preprocessor macro for old compilers
 #endif
+    /**
+     * @brief Interval of the snapshot heartbeat
+     *
+     * The snapshot file is rewritten after this number of seconds even if nothing has changed, so its creation time tells when the daemon has last been running. Otherwise a snapshot of long-standing alarms would be older than the SnapshotMaximumAge setting at the next start and be discarded.
+     */
+    static const unsigned int snapshotHeartbeat = 60;
+    /**
+     * @brief Part of the map of active alarms
+     *
+     * The active alarms are distributed over the shards by sketchHash() of their PV name, see shardOf(). Each shard has its own lock and its own AlarmDebouncer with the deadlines of the changes held back for its PVs, so messages about PVs in different shards never wait for each other.
+     */
+    struct Shard
+    {
+        /**
+         * @brief Map of the active alarms of this shard
+         *
+         * A string containing the PV name acts as key to the content encapsulated in the AlarmStatusEntry class. As this class uses multithreading, access to this map (both read and write) must ALWAYS be protected by a lock on mutex.
+         */
+        std::map<std::string, AlarmStatusEntry> statusmap;
+        /**
+         * @brief Mutex to protect statusmap and debouncer
+         *
+         * Concurrent insert and erase operations on a std::map are not supported and may result in undefined behaviour or segfaults. Therefore, this mutex is always locked when statusmap is accessed. Methods locking more than one shard at a time lock them in the order of _shards, see AllShardsLock.
+         *
+         * Each method locking it records its wait and hold times in its own Metrics histograms, shared by all shards.
+         */
+        InstrumentedMutex mutex;
+        /**
+         * @brief Changes of the PVs of this shard held back until they have persisted long enough
+         *
+         * Decides for every message whether it is applied to statusmap now, see applyStatusChange(), and holds back the others until startDebounceTimer() releases them. Protected by mutex. If both delays are configured to 0, every message is applied immediately.
+         */
+        AlarmDebouncer debouncer;
+
+        /**
+         * @brief Constructor
+         *
+         * Creates an empty shard.
+         * @param raiseDelay Time in milliseconds a PV must stay in alarm before its alarm is applied, see AlarmDebouncer
+         * @param clearDelay Time in milliseconds a PV must stay clear before its alarm is removed
+         */
+        Shard ( const unsigned int raiseDelay, const unsigned int clearDelay );
+    };
+    /**
+     * @brief Lock on all shards
+     *
+     * Locks all shards in the order of _shards, so two instances never deadlock, and releases them when it goes out of scope. Used where a consistent view of all active alarms is needed: the snapshot of the change feed, getActiveAlarms() and writeSnapshot(), which only copy the entries under it. As it stops the reception of messages completely, all other methods lock one shard at a time.
+     */
+    class AllShardsLock final
+    {
+    private:
+        /**
+         * @brief The locks on the shards
+         */
+        std::vector<std::unique_ptr<InstrumentedMutex::ScopedLock>> _locks;
+    public:
+        /**
+         * @brief Constructor
+         *
+         * Locks all shards of the connector, recording the wait and hold times of each lock.
+         * @param connector The instance whose shards are locked
+         * @param waitHistogram Histogram of the time spent waiting for each lock
+         * @param holdHistogram Histogram of the time each lock is held
+         */
+        AllShardsLock ( AlarmServerConnector& connector, const Metrics::Histogram waitHistogram, const Metrics::Histogram holdHistogram );
+        /**
+         * @brief Copy constructor (deleted)
+         *
+         * This class cannot be copied.
+         * @param other Another instance of AllShardsLock
+         */
+        AllShardsLock ( const AllShardsLock& other ) = delete;
+        /**
+         * @brief Copy assignment (deleted)
+         *
+         * This class cannot be copied.
+         * @param other Another instance of AllShardsLock
+         * @return Nothing (deleted)
+         */
+        AllShardsLock& operator= ( const AllShardsLock& other ) = delete;
+    };
     /**
      * @brief Desktop version flag
      *
@@ -92,25 +190,95 @@ private:
      */
     const bool _activateBeedo;
     /**
-     * @brief ActiveMQ client instance
+     * @brief Journal of state transitions
      *
-     * The instance of CMSClient, the interface to the Apache ActiveMQ message broker and the CSS alarm server.
+     * Every change applied to the map of active alarms is recorded here. Only used by the server version and only if a journal directory is configured, otherwise it is a null pointer. It is created before _cmsclient, so it is available when the first message arrives.
      */
-    CMSClient _cmsclient;
+    std::unique_ptr<AlarmJournal> _journal;
     /**
-     * @brief Map of active alarms
+     * @brief Long-term history of state transitions
      *
-     * All active alarms are listed in this map, where a string containing the PV name acts as key to the content encapsulated in the AlarmStatusEntry class.
-     * 
-     * As this class uses multithreading, access to this map (both read and write) must ALWAYS be protected by a lock on _statusmapmutex.
+     * Every change applied to the map of active alarms is also stored here in a compact columnar format for later analysis. Only used by the server version and only if a history directory is configured, otherwise it is a null pointer. Like _journal, it is created before _cmsclient.
+     */
+    std::unique_ptr<AlarmHistoryStore> _history;
+    /**
+     * @brief Table of the active alarms for the desktop widgets on this machine
+     *
+     * Every change applied to the map of active alarms is also published here, under the lock of the shard of the PV and the lock on _sharedtablemutex. Only used by the server version and only if a name for the shared table is configured, otherwise it is a null pointer.
+     */
+    std::unique_ptr<AlarmSharedTable> _sharedtable;
+    /**
+     * @brief Mutex to protect _sharedtable
+     *
+     * AlarmSharedTable only supports one writer at a time, while changes are applied to different shards in parallel.
+     */
+    boost::mutex _sharedtablemutex;
+    /**
+     * @brief Live statistics
+     *
+     * Updated with every change applied to the map of active alarms, in constant time and memory. Available in all versions, as it neither needs a file nor the configuration.
+     */
+    AlarmStatistics _statistics;
+    /**
+     * @brief Detection of alarm storms
+     *
+     * Counts every change applied to the map of active alarms and is updated by the watcher thread every second. During a storm, checkStatusMap() sends notifications less often and desktop notifications summarise the alarms by area. Like _statistics, it is created before _cmsclient.
+     */
+    StormDetector _stormdetector;
+    /**
+     * @brief Number of active alarms in all shards
+     *
+     * Changed under the lock of the shard whose map is changed and read without a lock. Relaxed atomic operations are enough, as only the number itself is needed and not the entries.
+     */
+    std::atomic<size_t> _alarmcount;
+    /**
+     * @brief Timestamp of oldest alarm in the map of active alarms
+     *
+     * The timestamp of the longest-active alarm is kept here so checkStatusMap() can calculate whether a notification should be fired. If no alarm is active at all, it is set to noAlarmActive. Set by compare-and-swap when an alarm is raised and reset by checkStatusMap() under an AllShardsLock, so it is never reset while an alarm is being raised.
+     */
+    std::atomic<time_t> _oldestAlarm;
+    /**
+     * @brief Snapshot update flag
+     *
+     * Set by markSnapshotDirty() whenever the map of active alarms or the notification flags of its entries are changed, under the lock of the shard concerned. Reset by writeSnapshot() before it locks the shards to take a copy, so a change made in the meantime sets it again.
+     */
+    std::atomic<bool> _snapshotdirty;
+    /**
+     * @brief Last state of each PV
+     *
+     * notifyStatusChange() drops messages repeating the active alarm of their PV here, before it takes the lock of the shard of the PV. Written under the lock of the shard of the PV once a change has been applied, so it only holds states in the map. Has its own locks.
      */
-    std::map<std::string, AlarmStatusEntry> _statusmap;
+    AlarmFingerprints _fingerprints;
     /**
-     * @brief Mutex to protect the _statusmap
+     * @brief Approximate set of the PVs in the map of active alarms
      *
-     * Concurrent insert and erase operations on a std::map are not supported and may result in undefined behaviour or segfaults. Therefore, this mutex is always locked when _statusmap is accessed.
+     * notifyStatusChange() drops messages clearing PVs that are certainly not in here without taking the lock of the shard of the PV. Besides the PVs in the map, it contains the PVs whose alarm is held back by the debouncer of their shard, as a clearing message has to cancel it. Only changed under the lock of the shard of the PV, read without a lock. Shared by all shards, which change it concurrently.
      */
-    boost::mutex _statusmapmutex;
+    AlarmPresenceFilter _presence;
+    /**
+     * @brief Shards of the map of active alarms
+     *
+     * Their number is configured by AlarmConfiguration::getStatusMapShards() and never changes. Created by createShards() after all members used by restoreSnapshot() and before _cmsclient, so the snapshot has been restored when the first message arrives.
+     */
+    std::vector<std::unique_ptr<Shard>> _shards;
+    /**
+     * @brief Feed of the changes for local clients
+     *
+     * Every change applied to the map of active alarms is appended here with a sequence number, under the lock of the shard of the PV. Only used by the server version and only if an endpoint for the feed is configured, otherwise it is a null pointer. Unlike _sharedtable, it is created at the end of the constructor, as its clients may request a snapshot of all shards at any time, and it is stopped at the beginning of the destructor. Declared before _cmsclient, so the pointer is null before the first message arrives and the feed is only destroyed after the message source has been stopped.
+     */
+    std::unique_ptr<AlarmChangeFeed> _changefeed;
+    /**
+     * @brief Live stream of the changes for browser dashboards
+     *
+     * Like _changefeed, every change applied to the map of active alarms is appended here under the lock of the shard of the PV, and it is created at the end of the constructor and stopped at the beginning of the destructor. Only used by the server version and only if an endpoint for the dashboard is configured, otherwise it is a null pointer. Declared before _cmsclient for the same reason as _changefeed.
+     */
+    std::unique_ptr<AlarmEventStream> _eventstream;
+    /**
+     * @brief ActiveMQ client instance
+     *
+     * The instance of CMSClient, the interface to the Apache ActiveMQ message broker and the CSS alarm server.
+     */
+    CMSClient _cmsclient;
     /**
      * @brief Mutex to protect the flashlight accessed
      *
@@ -129,24 +297,42 @@ private:
      * This flag indicates whether the flashlight is currently flashing or not.
      */
     bool _flashlighton;
+    /**
+     * @brief Earliest time of the next notification during a storm
+     *
+     * Set by checkStatusMap() to StormDetector::notificationInterval seconds after a notification has been prepared in storm mode. Only used by the watcher thread, declared before it so it is initialised when the thread starts.
+     */
+    time_t _stormnotificationdue;
     /**
      * @brief Notification thread
      *
-     * This thread object will run the startWatcher() method that checks the _statusmap for alarm being active for longer than the timeout and initiate the corresponding notifications.
+     * This thread object will run the startWatcher() method that checks the map of active alarms for alarm being active for longer than the timeout and initiate the corresponding notifications.
      */
     boost::thread _watcher;
     /**
      * @brief Flashlight operation thread
      *
-     * This thread object will run the operateFlashLight() method that monitors the _statusmap and switch the flashlight on or off accordingly.
+     * This thread object will run the operateFlashLight() method that monitors the number of active alarms and switch the flashlight on or off accordingly.
      */
     boost::thread _flashlightthread;
     /**
-     * @brief Timestamp of oldest alarm in _statusmap
+     * @brief Snapshot thread
+     *
+     * This thread object will run the startSnapshotWriter() method that writes the map of active alarms to the snapshot file after it has been changed, and at least every snapshotHeartbeat seconds.
+     */
+    boost::thread _snapshotthread;
+    /**
+     * @brief Debounce thread
+     *
+     * This thread object will run the startDebounceTimer() method that applies the changes held back by the debouncers of the shards when their time has come.
+     */
+    boost::thread _debouncethread;
+    /**
+     * @brief ID of the gauge callback
      *
-     * The timestamp of the longest-active alarm is kept here so checkStatusMap() can calculate whether a notification should be fired. If no alarm is active at all, it is set to noAlarmActive.
+     * writeGauges() is registered with Metrics in the constructor, this ID is used to remove it in the destructor.
      */
-    time_t _oldestAlarm;
+    unsigned int _metricsgauges;
 
     /**
      * @brief Check severity string in CSS Alarm Server message
@@ -159,14 +345,14 @@ private:
     /**
      * @brief Start the watcher thread
      *
-     * Invokes checkStatusMap every second as long as _runwatcher is true.
+     * Updates _stormdetector and invokes checkStatusMap every second of Clock::instance() as long as _runwatcher is true.
      * @return Nothing
      */
     void startWatcher();
     /**
-     * @brief Check the _statusmap for pending notifications
+     * @brief Check the map of active alarms for pending notifications
      *
-     * Checks if there is any alarm over the timeout and initiates the appropriate notifications if necessary. On desktop versions also controls the Beedo engine.
+     * Checks if there is any alarm over the timeout and initiates the appropriate notifications if necessary. During an alarm storm, the desktop notifications are deferred until StormDetector::notificationInterval seconds have passed since the last one, so the alarms raised in the meantime are collected in a single notification. E-mail notifications are not deferred, as that would delay the escalation, but summarise the alarms by area as well. On desktop versions also controls the Beedo engine.
      * @return Nothing
      */
     void checkStatusMap();
@@ -180,7 +366,7 @@ private:
     /**
      * @brief Switch laboratory flashlight on
      *
-     * Tell the hardware interface to enable the flashlight.
+     * Tell the hardware interface to enable the flashlight. If the relais has been switched, the latency of the oldest active alarm is recorded by recordNotificationLatency().
      * @return Nothing
      */
     void switchFlashLightOn();
@@ -194,51 +380,243 @@ private:
     /**
      * @brief Select alarms to be included in a desktop notification
      *
-     * Iterates over all entries in _statusmap and selects alarms to be included in a desktop notification. The alarm used have the corresponding flag in AlarmStatusEntry set.
+     * Iterates over all entries in the shards and selects alarms to be included in a desktop notification, ordered by PV name. The alarm used have the corresponding flag in AlarmStatusEntry set.
      *
-     * As this method operates under a lock on _statusmapmutex held by checkStatusMap(), it has to be very quick. It therefore does only the selection work. The alarm entries to be used are collected in a vector that is passed to sendDesktopNotification() which is spawned as a separate thread.
+     * As this method operates under the lock of each shard in turn, it has to be very quick. It therefore does only the selection work. The alarm entries to be used are collected in a vector that is passed to sendDesktopNotification() which is spawned as a separate thread.
+     * @param summarise true during an alarm storm, see sendDesktopNotification()
      * @return Nothing
      */
-    void prepareDesktopNotification();
+    void prepareDesktopNotification ( const bool summarise );
     /**
      * @brief Fire desktop notification
      *
      * This class recevies a list of alarm from prepareDesktopNotification() and puts them into a desktop notification. On systems with a libnotify version of at least 0.7, this API is used directly. On older versions, the library method notify_notification_new() requires a "GtkWidget* attach" pointer which is known to cause problems (this is why the parameter was removed from the API). On systems with the old version, a system() call is used to invoke the binary "notify-send" which is part of the libnotify package.
+     *
+     * During an alarm storm, the notification does not list the PV names but only the number of alarms per area, see StormDetector::summarise().
      * @param alarm Alarms to be included in the notification.
+     * @param scheduled Monotonic time prepareDesktopNotification() has selected the alarms, see Metrics::now()
+     * @param summarise true to summarise the alarms instead of listing them
      * @return Nothing
      */
-    void sendDesktopNotification ( const std::vector<AlarmStatusEntry > alarm );
+    void sendDesktopNotification ( const std::vector<AlarmStatusEntry > alarm, const int64_t scheduled, const bool summarise );
     /**
      * @brief Select alarms to be included in an e-mail notification
      *
-     * Iterates over all entries in _statusmap and selects alarms to be included in an e-mail notification. The alarm used have the corresponding flag in AlarmStatusEntry set.
+     * Iterates over all entries in the shards and selects alarms to be included in an e-mail notification, ordered by PV name. The alarm used have the corresponding flag in AlarmStatusEntry set.
      *
-     * As this method operates under a lock on _statusmapmutex held by checkStatusMap(), it has to be very quick. It therefore does only the selection work. The alarm entries to be used are collected in a vector that is passed to sendEMailNotification() which is spawned as a separate thread.
+     * As this method operates under the lock of each shard in turn, it has to be very quick. It therefore does only the selection work. The alarm entries to be used are collected in a vector that is passed to sendEMailNotification() which is spawned as a separate thread.
+     * @param summarise true during an alarm storm, see sendEMailNotification()
      * @return Nothing
      */
-    void prepareEMailNotification();
+    void prepareEMailNotification ( const bool summarise );
     /**
      * @brief Fire desktop notification
      *
      * This class recevies a list of alarm from prepareEMailNotification() and puts them into an e-mail notification. This is done by invoking EMailSender::sendAlarmNotification()
      * @param alarm Alarms to be included in the notification.
+     * @param scheduled Monotonic time prepareEMailNotification() has selected the alarms, see Metrics::now()
+     * @param summarise true to summarise the alarms by area instead of listing them, see StormDetector::summarise()
+     * @return Nothing
+     */
+    void sendEMailNotification ( const std::vector< AlarmStatusEntry > alarm, const int64_t scheduled, const bool summarise );
+    /**
+     * @brief Record the latencies of a delivered notification
+     *
+     * Observes the time between the pipeline stages of one alarm in the histograms of the notification channel: from applying the alarm to scheduling the notification, to dispatching it, to its delivery, and from the origin of the alarm to the delivery. Stages with an unknown start, e.g. of alarms restored from the snapshot, are skipped.
+     * @param firstStage Histogram for the first stage of the channel, i.e. Metrics::FlashLightApplyToSchedule, Metrics::DesktopApplyToSchedule or Metrics::EMailApplyToSchedule; the other stages follow in the enumeration
+     * @param times Pipeline timestamps of the alarm
+     * @param scheduled Monotonic time the notification has been scheduled
+     * @param dispatched Monotonic time the notification has been dispatched
+     * @param delivered Monotonic time the notification has been delivered
      * @return Nothing
      */
-    void sendEMailNotification ( const std::vector< AlarmStatusEntry > alarm );
+    static void recordNotificationLatency ( const Metrics::Histogram firstStage, const AlarmStatusEntry::PipelineTimes& times, const int64_t scheduled, const int64_t dispatched, const int64_t delivered ) noexcept;
+    /**
+     * @brief Start the snapshot thread
+     *
+     * Invokes writeSnapshot() every second as long as _runwatcher is true, forcing it to write if the file has not been written for snapshotHeartbeat seconds. Does nothing on desktop versions, as the desktop widgets share the configuration file with the daemon.
+     * @return Nothing
+     */
+    void startSnapshotWriter();
+    /**
+     * @brief Start the debounce thread
+     *
+     * Sleeps until the next change held back by the debouncer of any shard is due and applies it by applyStatusChange(), as long as _runwatcher is true. If debouncing is disabled, it only sleeps until the connector is destroyed.
+     * @return Nothing
+     */
+    void startDebounceTimer();
+    /**
+     * @brief Apply a message to the shard of its PV
+     *
+     * Unless the message is released by the debounce thread, the debouncer of the shard decides first whether it is applied now. If the message changes the map of the shard, the transition is recorded in the journal, the history and the feeds for local clients. Of the map locks, only the one of this shard is taken. The shared table, change feed and event stream locks are taken under it, and the statistics, journal and history locks after it, so those are still shared by all shards.
+     * @param status Relevant content of the message put into an AlarmStatusEntry, or only the PV name if the message is released by the debouncer
+     * @param debounced true if the change held back by the debouncer for the PV is to be applied
+     * @return Nothing
+     */
+    void applyStatusChange ( AlarmStatusEntry status, const bool debounced );
+    /**
+     * @brief Find the shard of a PV
+     *
+     * This method cannot throw exceptions.
+     * @param pvname PV name
+     * @return The shard chosen by sketchHash() of the PV name
+     */
+    Shard& shardOf ( const std::string& pvname ) noexcept;
+    /**
+     * @brief Number of the shard of a PV
+     *
+     * This method cannot throw exceptions.
+     * @param pvname PV name
+     * @param count Number of shards
+     * @return Index into _shards, derived from sketchHash() of the PV name
+     */
+    static size_t shardIndex ( const std::string& pvname, const size_t count ) noexcept;
+    /**
+     * @brief Create the shards of the map of active alarms
+     *
+     * Creates as many shards as configured in the AlarmConfiguration, at least one, each with a debouncer using the configured delays. The server version fills them from the snapshot file by restoreSnapshot(). Called while _shards is constructed, so before _cmsclient receives the first message.
+     * @param desktopVersion Flag to indicate whether this instance runs as desktop version, which does not restore the snapshot.
+     * @return The shards
+     */
+    std::vector<std::unique_ptr<Shard>> createShards ( const bool desktopVersion );
+    /**
+     * @brief Record that the snapshot file is out of date
+     *
+     * Sets _snapshotdirty unless it is already set, so the shards do not write to the same cache line with every message.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void markSnapshotDirty() noexcept;
+    /**
+     * @brief Record the trigger time of an alarm that has been raised
+     *
+     * Sets _oldestAlarm to the trigger time if no alarm has been active or if the alarm is older than the oldest one known.
+     *
+     * This method cannot throw exceptions.
+     * @param triggerTime Trigger time of the alarm
+     * @return Nothing
+     */
+    void noteTriggerTime ( const time_t triggerTime ) noexcept;
+    /**
+     * @brief Write the map of active alarms to the snapshot file
+     *
+     * If _snapshotdirty or force is set, a copy of all entries is taken under an AllShardsLock, so the file holds a state the map has really been in. The snapshot file is then written by AlarmStateSnapshot::write() after the lock has been released, so the reception of new messages is not delayed by the disk access. An empty file location in the AlarmConfiguration disables the snapshot.
+     *
+     * This method cannot throw exceptions, errors are forwarded to the global ExceptionHandler().
+     * @param force Write the file even if nothing has changed, to renew its creation time
+     * @return true if the file has been written
+     */
+    bool writeSnapshot ( const bool force ) noexcept;
+    /**
+     * @brief Restore the map of active alarms from the snapshot file
+     *
+     * Reads the snapshot file written by a previous run and inserts its entries into the shards, including their trigger time and notification flags. Called by createShards() before any message is received, so a message clearing a restored alarm right after the start finds it. A snapshot older than AlarmConfiguration::getSnapshotMaximumAge() is ignored, as the alarm server does not repeat the state of PVs cleared in the meantime.
+     *
+     * This method cannot throw exceptions, errors are forwarded to the global ExceptionHandler().
+     * @param shards The shards to be filled, not yet stored in _shards
+     * @return Nothing
+     */
+    void restoreSnapshot ( std::vector<std::unique_ptr<Shard>>& shards ) noexcept;
+    /**
+     * @brief Create the journal of state transitions
+     *
+     * Creates the AlarmJournal in the directory configured in the AlarmConfiguration. If the journal cannot be opened, the error is reported and the daemon continues without a journal.
+     * @param desktopVersion Flag to indicate whether this instance runs as desktop version, which does not keep a journal.
+     * @return The journal or a null pointer if no journal should be kept
+     */
+    static std::unique_ptr<AlarmJournal> createJournal ( const bool desktopVersion ) noexcept;
+    /**
+     * @brief Create the long-term history store
+     *
+     * Creates the AlarmHistoryStore in the directory configured in the AlarmConfiguration. If the history cannot be opened, the error is reported and the daemon continues without a history.
+     * @param desktopVersion Flag to indicate whether this instance runs as desktop version, which does not keep a history.
+     * @return The history store or a null pointer if no history should be kept
+     */
+    static std::unique_ptr<AlarmHistoryStore> createHistoryStore ( const bool desktopVersion ) noexcept;
+    /**
+     * @brief Create the capture of received messages
+     *
+     * Creates the MessageCapture in the directory configured in the AlarmConfiguration. If the capture file cannot be created, the error is reported and the daemon continues without capturing.
+     * @param desktopVersion Flag to indicate whether this instance runs as desktop version, which does not capture messages.
+     * @return The capture or a null pointer if no messages should be captured
+     */
+    static std::unique_ptr<MessageCapture> createCapture ( const bool desktopVersion ) noexcept;
+    /**
+     * @brief Create the shared alarm table
+     *
+     * Creates the AlarmSharedTable under the name configured in the AlarmConfiguration. If the table cannot be created, e.g. because another daemon on this machine already publishes it, the error is reported and the daemon continues without it.
+     * @param desktopVersion Flag to indicate whether this instance runs as desktop version, which reads the table instead of publishing it.
+     * @return The table or a null pointer if no table should be published
+     */
+    static std::unique_ptr<AlarmSharedTable> createSharedTable ( const bool desktopVersion ) noexcept;
+    /**
+     * @brief Create the change feed
+     *
+     * Creates the AlarmChangeFeed on the endpoint configured in the AlarmConfiguration and sets _changefeed under an AllShardsLock. If the feed cannot be created, the error is reported and the daemon continues without it. Only called by the server version.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void createChangeFeed() noexcept;
+    /**
+     * @brief Create the dashboard event stream
+     *
+     * Creates the AlarmEventStream on the endpoint configured in the AlarmConfiguration and sets _eventstream under an AllShardsLock. If it cannot be created, the error is reported and the daemon continues without it. Only called by the server version.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void createEventStream() noexcept;
+    /**
+     * @brief Snapshot of the active alarms for the change feed and the dashboards
+     *
+     * Copies all active alarms under an AllShardsLock, together with the sequence number of the last change appended to _changefeed, which is appended under the lock of a shard, so the copy contains exactly the changes up to this number.
+     * @param active Receives one AlarmTransition::Raised per active alarm, its wall clock time being the trigger time
+     * @return The sequence number of the last change contained in the snapshot
+     */
+    uint64_t snapshotForLocalClients ( std::vector<AlarmTransition>& active );
+    /**
+     * @brief Choose the source of the alarm server messages
+     *
+     * A source passed to the constructor is used as it is. Otherwise, the desktop version reads the shared table of an-daemon with a SharedTableMessageSource if a daemon publishes it on this machine, so the widgets do not open a connection to the message broker each.
+     * @param desktopVersion Flag to indicate whether this instance runs as desktop version
+     * @param source The source passed to the constructor, may be a null pointer
+     * @return The source for CMSClient, a null pointer to connect to the message broker
+     */
+    static std::unique_ptr<MessageSource> createMessageSource ( const bool desktopVersion, std::unique_ptr<MessageSource> source ) noexcept;
+    /**
+     * @brief Describe a change of the map of active alarms
+     *
+     * Creates the AlarmTransition to be handed to the journal and the history store.
+     * @param type The kind of change
+     * @param status The entry after the change, or the message that cleared it
+     * @return Transition stamped with the current monotonic time
+     */
+    static AlarmTransition makeTransition ( const AlarmTransition::TransitionType type, const AlarmStatusEntry& status );
+    /**
+     * @brief Write gauges for a metrics scrape
+     *
+     * Registered with Metrics as gauge callback. Writes the number of active alarms per severity, the number of alarms waiting for a desktop or e-mail notification and the queue lengths of the journal and the history.
+     * @param stream Stream receiving the metrics in the Prometheus text format
+     * @return Nothing
+     */
+    void writeGauges ( std::ostream& stream );
 public:
     /**
      * @brief Constructor
      *
-     * Intializes the CMSClient and the libnotify framework on systems with libnotify version >= 0.7. It spawns two additional threads that run startWatcher() and operateFlashLight() respectively.
+     * Intializes the CMSClient and the libnotify framework on systems with libnotify version >= 0.7. It spawns three additional threads that run startWatcher(), operateFlashLight() and startSnapshotWriter() respectively. The server version restores the alarms from the snapshot file of the previous run.
      * @param desktopVersion Flag to indicate whether this instance should run as desktop version (true) or server version (false).
      * @param activateBeedo Flag to indicate whether the Beedo engine should be used. Only possible on a desktop version.
+     * @param source Source of the alarm server messages for CMSClient. If it is a null pointer, the desktop version reads the shared table of an-daemon if available, otherwise CMSClient connects to the Apache ActiveMQ message broker. Tests and benchmarks pass an InProcessMessageSource here.
      * @exception std::logic_error activateBeedo is true but desktopVersion is false. The Beedo engine can only be used with the desktop version.
      */
-    AlarmServerConnector ( const bool desktopVersion = false, const bool activateBeedo = false );
+    AlarmServerConnector ( const bool desktopVersion = false, const bool activateBeedo = false, std::unique_ptr<MessageSource> source = std::unique_ptr<MessageSource>() );
     /**
      * @brief Destructor
      * 
-     * Sets the _runwatcher flag to false and waits for the two threads (_watcher and _flashlightthread) to finish their loops.
+     * Sets the _runwatcher flag to false, interrupts the sleep of the three threads (_watcher, _flashlightthread and _snapshotthread) and waits for them to finish their loops. The server version writes a final snapshot afterwards.
      */
     ~AlarmServerConnector();
     /**
@@ -274,7 +652,7 @@ public:
     /**
      * @brief Notify AlarmServerConnector about alarm status change
      * 
-     * This method is invoked by CMSClient to notify this instance about a message received from the CSS Alarm Server.
+     * This method is invoked by CMSClient to notify this instance about a message received from the CSS Alarm Server. If the message changes the map of active alarms, the transition is recorded in the journal. Messages clearing a PV that is not in alarm and messages repeating the last severity and status of their PV are dropped without taking a lock, see AlarmPresenceFilter and AlarmFingerprints. With debouncing configured, the change may only be applied later or not at all, see AlarmDebouncer.
      * @param status Relevant content of the message put into an AlarmStatusEntry
      * @return Nothing
      */
@@ -282,10 +660,31 @@ public:
     /**
      * @brief Query number of active alarms
      * 
-     * Number of alarm entries in the _statusmap.
+     * Number of alarm entries in all shards, read without a lock.
      * @return Number of active alarms.
      */
     size_t getNumberOfAlarms() const noexcept;
+    /**
+     * @brief Query live statistics
+     *
+     * Gives access to the AlarmStatistics, e.g. the noisiest PVs of the last hours, the number of distinct alarming PVs per hour and the time it takes to clear alarms. AlarmStatistics is thread-safe, so the statistics can be queried at any time.
+     * @return The statistics of this instance
+     */
+    const AlarmStatistics& getStatistics() const noexcept;
+    /**
+     * @brief Copy of all active alarms
+     *
+     * The entries are copied under an AllShardsLock, so the copy is consistent across the shards. The lock is released before the caller processes them, so answering a query never holds up the reception of messages for longer than the copy takes.
+     * @return The active alarms, ordered by PV name
+     */
+    std::vector<AlarmStatusEntry> getActiveAlarms();
+    /**
+     * @brief Access the CMSClient
+     *
+     * Used to feed messages into this instance with CMSClient::inject(), e.g. by the load generator an-loadgen.
+     * @return The CMSClient of this instance
+     */
+    CMSClient& getCMSClient() noexcept;
 };
 
 }
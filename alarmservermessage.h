@@ -0,0 +1,101 @@
+/**
+ * @file alarmservermessage.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Content of a message of the CSS Alarm Server
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMSERVERMESSAGE_H
+#define ALARMSERVERMESSAGE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <string>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Message of the CSS Alarm Server
+ *
+ * The CSS Alarm Server publishes its messages as CMS MapMessages. This structure holds the fields of such a message that are relevant to AlarmNotifications, independently of the ActiveMQ library. CMSClient fills it from the received MapMessage, and CMSClient::inject() accepts it directly, so messages can be fed into the application without a message broker, e.g. by the load generator an-loadgen. It is a pure data container.
+ *
+ * A field that is missing in the MapMessage is an empty string.
+ */
+struct AlarmServerMessage
+{
+    /**
+     * @brief Type of the message (TEXT)
+     *
+     * "STATE" for a change of the alarm state of a PV, "IDLE" for the periodic heartbeat of the alarm server and "CONFIG" for a change of its configuration. Only "STATE" messages are used by AlarmNotifications.
+     */
+    std::string text;
+    /**
+     * @brief Name of the PV (NAME)
+     *
+     * The alarm server prefixes the PV name with the pseudo-protocol "epics://".
+     */
+    std::string name;
+    /**
+     * @brief Alarm severity (SEVERITY)
+     *
+     * E.g. "MAJOR", "MINOR_ACK" or "OK", see AlarmStatusEntry::SeverityLevel.
+     */
+    std::string severity;
+    /**
+     * @brief Alarm status (STATUS)
+     *
+     * E.g. "HIHI_ALARM" or "Disconnected".
+     */
+    std::string status;
+    /**
+     * @brief Time of the event (EVENTTIME)
+     *
+     * "YYYY-MM-DD HH:MM:SS.mmm" in the local time zone of the alarm server.
+     */
+    std::string eventTime;
+    /**
+     * @brief Timestamp of the message broker
+     *
+     * Nanoseconds since the Unix epoch when the broker accepted the message, 0 if unknown.
+     */
+    int64_t brokerTime;
+
+    /**
+     * @brief Constructor
+     *
+     * Creates an empty message without broker timestamp.
+     */
+    AlarmServerMessage() : brokerTime ( 0 ) {}
+};
+
+}
+
+#endif // ALARMSERVERMESSAGE_H
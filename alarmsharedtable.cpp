@@ -0,0 +1,299 @@
+/**
+ * @file alarmsharedtable.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Table of the active alarms in shared memory
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmsharedtable.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/thread.hpp>
+
+#include "clock.h"
+
+using namespace AlarmNotifications;
+
+const char AlarmSharedTable::segmentMagic[9] = "ANSHMT01";
+const uint32_t AlarmSharedTable::defaultCapacity;
+const int64_t AlarmSharedTable::heartbeatTimeout;
+
+// Attempts to copy a row before it is skipped, only reached if the writer has died while changing it
+static const unsigned int maximumReadAttempts = 10000;
+
+// Copies a string into a field of a row, truncating it if necessary
+template<size_t length> static void copyField ( char ( &field ) [length], const std::string& value ) noexcept
+{
+    strncpy ( field, value.c_str(), length );
+}
+
+// Converts a field of a row back into a string
+template<size_t length> static std::string readField ( const char ( &field ) [length] )
+{
+    return std::string ( field, strnlen ( field, length ) );
+}
+
+AlarmSharedTable::AlarmSharedTable ( const std::string& name, const bool writer )
+    : _name ( name ),
+      _writer ( writer ),
+      _size ( 0 ),
+      _header ( nullptr ),
+      _slots ( nullptr )
+{
+    static_assert ( sizeof ( Header ) == 64, "The header of the shared alarm table must fill one cache line" );
+    static_assert ( sizeof ( Slot ) == 256, "The rows of the shared alarm table must have 256 bytes" );
+    if ( !writer )
+    {
+        attach();
+        return;
+    }
+    if ( available ( name ) )
+        throw std::runtime_error ( "Another process already publishes the shared alarm table " + name + "." );
+    shm_unlink ( name.c_str() ); // Left behind by a daemon that has crashed
+    const int fd = shm_open ( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+    if ( fd < 0 )
+        throw std::runtime_error ( "Cannot create shared alarm table " + name + ": " + strerror ( errno ) );
+    fchmod ( fd, 0644 ); // The umask must not hide the table from the desktop widgets of other users
+    _size = sizeof ( Header ) + defaultCapacity * sizeof ( Slot );
+    void* mapping = MAP_FAILED;
+    if ( ftruncate ( fd, static_cast<off_t> ( _size ) ) == 0 )
+        mapping = mmap ( nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if ( mapping == MAP_FAILED )
+    {
+        const std::string error ( strerror ( errno ) );
+        close ( fd );
+        shm_unlink ( name.c_str() );
+        throw std::runtime_error ( "Cannot map shared alarm table " + name + " into memory: " + error );
+    }
+    close ( fd );
+    // ftruncate() has filled the segment with zeros: All rows are free and at version 0
+    _header = static_cast<Header*> ( mapping );
+    _slots = reinterpret_cast<Slot*> ( _header + 1 );
+    memcpy ( _header->magic, segmentMagic, sizeof ( _header->magic ) );
+    _header->capacity = defaultCapacity;
+    _header->heartbeat.store ( static_cast<int64_t> ( Clock::instance().wallTime() ), std::memory_order_relaxed );
+    _header->writerPid.store ( static_cast<int32_t> ( getpid() ), std::memory_order_release );
+}
+
+AlarmSharedTable::~AlarmSharedTable()
+{
+    if ( _header == nullptr )
+        return;
+    if ( _writer )
+    {
+        _header->writerPid.store ( 0, std::memory_order_release );
+        _header->generation.fetch_add ( 1, std::memory_order_release );
+        shm_unlink ( _name.c_str() );
+    }
+    munmap ( _header, _size );
+}
+
+void AlarmSharedTable::attach()
+{
+    const int fd = shm_open ( _name.c_str(), O_RDONLY, 0 );
+    if ( fd < 0 )
+        throw std::runtime_error ( "Cannot open shared alarm table " + _name + ": " + strerror ( errno ) );
+    struct stat status;
+    if ( fstat ( fd, &status ) != 0 )
+    {
+        const std::string error ( strerror ( errno ) );
+        close ( fd );
+        throw std::runtime_error ( "Cannot determine size of shared alarm table " + _name + ": " + error );
+    }
+    if ( static_cast<size_t> ( status.st_size ) < sizeof ( Header ) )
+    {
+        close ( fd );
+        throw std::runtime_error ( "Shared memory segment " + _name + " is too small to be a shared alarm table." );
+    }
+    _size = static_cast<size_t> ( status.st_size );
+    void*const mapping = mmap ( nullptr, _size, PROT_READ, MAP_SHARED, fd, 0 );
+    const std::string error ( strerror ( errno ) );
+    close ( fd );
+    if ( mapping == MAP_FAILED )
+        throw std::runtime_error ( "Cannot map shared alarm table " + _name + " into memory: " + error );
+    _header = static_cast<Header*> ( mapping );
+    _slots = reinterpret_cast<Slot*> ( _header + 1 );
+    if ( memcmp ( _header->magic, segmentMagic, sizeof ( _header->magic ) ) != 0 || sizeof ( Header ) + _header->capacity * sizeof ( Slot ) > _size )
+    {
+        munmap ( _header, _size );
+        _header = nullptr;
+        throw std::runtime_error ( "Shared memory segment " + _name + " is not a shared alarm table of this version." );
+    }
+}
+
+void AlarmSharedTable::writeSlot ( const uint32_t index, const std::string& pvname, const std::string& severity, const std::string& status ) noexcept
+{
+    Slot& slot = _slots[index];
+    const uint32_t version = slot.version.load ( std::memory_order_relaxed );
+    slot.version.store ( version + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence ( std::memory_order_release );
+    slot.occupied = pvname.empty() ? 0 : 1;
+    copyField ( slot.pvname, pvname );
+    copyField ( slot.severity, severity );
+    copyField ( slot.status, status );
+    slot.version.store ( version + 2, std::memory_order_release );
+    _header->generation.fetch_add ( 1, std::memory_order_release );
+}
+
+void AlarmSharedTable::publish ( const std::string& pvname, const std::string& severity, const std::string& status )
+{
+    if ( !_writer )
+        throw std::logic_error ( "Only an-daemon can change the shared alarm table." );
+    auto row = _rows.find ( pvname );
+    if ( row != _rows.end() )
+    {
+        writeSlot ( ( *row ).second, pvname, severity, status );
+        return;
+    }
+    if ( _overflowed.count ( pvname ) != 0 )
+        return; // Already counted
+    const uint32_t used = _header->used.load ( std::memory_order_relaxed );
+    if ( _freerows.empty() && used >= _header->capacity )
+    {
+        _overflowed.insert ( pvname );
+        _header->overflow.store ( static_cast<uint32_t> ( _overflowed.size() ), std::memory_order_relaxed );
+        _header->generation.fetch_add ( 1, std::memory_order_release );
+        return;
+    }
+    const uint32_t index = _freerows.empty() ? used : _freerows.back();
+    _rows.insert ( std::make_pair ( pvname, index ) );
+    if ( _freerows.empty() )
+    {
+        writeSlot ( index, pvname, severity, status );
+        _header->used.store ( used + 1, std::memory_order_release ); // Readers only look at the row after it has been written
+    }
+    else
+    {
+        _freerows.pop_back();
+        writeSlot ( index, pvname, severity, status );
+    }
+}
+
+void AlarmSharedTable::remove ( const std::string& pvname )
+{
+    if ( !_writer )
+        throw std::logic_error ( "Only an-daemon can change the shared alarm table." );
+    auto row = _rows.find ( pvname );
+    if ( row != _rows.end() )
+    {
+        _freerows.push_back ( ( *row ).second );
+        writeSlot ( ( *row ).second, "", "", "" );
+        _rows.erase ( row );
+    }
+    else if ( _overflowed.erase ( pvname ) != 0 )
+    {
+        _header->overflow.store ( static_cast<uint32_t> ( _overflowed.size() ), std::memory_order_relaxed );
+        _header->generation.fetch_add ( 1, std::memory_order_release );
+    }
+}
+
+void AlarmSharedTable::heartbeat() noexcept
+{
+    if ( _writer )
+        _header->heartbeat.store ( static_cast<int64_t> ( Clock::instance().wallTime() ), std::memory_order_relaxed );
+}
+
+uint64_t AlarmSharedTable::generation() const noexcept
+{
+    return _header->generation.load ( std::memory_order_acquire );
+}
+
+bool AlarmSharedTable::writerAlive() const noexcept
+{
+    return writerAlive ( *_header );
+}
+
+bool AlarmSharedTable::writerAlive ( const AlarmSharedTable::Header& header ) noexcept
+{
+    const int32_t pid = header.writerPid.load ( std::memory_order_acquire );
+    if ( pid <= 0 )
+        return false;
+    if ( kill ( static_cast<pid_t> ( pid ), 0 ) != 0 && errno == ESRCH )
+        return false; // EPERM means the process exists but belongs to another user
+    return static_cast<int64_t> ( Clock::instance().wallTime() ) - header.heartbeat.load ( std::memory_order_relaxed ) <= heartbeatTimeout;
+}
+
+uint32_t AlarmSharedTable::read ( std::map<std::string, AlarmSharedTable::Row>& rows ) const
+{
+    rows.clear();
+    const uint32_t used = std::min ( _header->used.load ( std::memory_order_acquire ), _header->capacity );
+    for ( uint32_t i = 0; i < used; i++ )
+    {
+        const Slot& slot = _slots[i];
+        char pvname[sizeof ( slot.pvname )];
+        char severity[sizeof ( slot.severity )];
+        char status[sizeof ( slot.status )];
+        uint32_t occupied = 0;
+        bool consistent = false;
+        for ( unsigned int attempt = 0; attempt < maximumReadAttempts && !consistent; attempt++ )
+        {
+            const uint32_t version = slot.version.load ( std::memory_order_acquire );
+            if ( ( version & 1 ) != 0 )
+            {
+                boost::this_thread::yield(); // The writer is changing the row right now
+                continue;
+            }
+            occupied = slot.occupied;
+            memcpy ( pvname, slot.pvname, sizeof ( pvname ) );
+            memcpy ( severity, slot.severity, sizeof ( severity ) );
+            memcpy ( status, slot.status, sizeof ( status ) );
+            std::atomic_thread_fence ( std::memory_order_acquire );
+            consistent = slot.version.load ( std::memory_order_relaxed ) == version;
+        }
+        if ( !consistent || occupied == 0 )
+            continue;
+        Row& row = rows[readField ( pvname )];
+        row.severity = readField ( severity );
+        row.status = readField ( status );
+    }
+    return _header->overflow.load ( std::memory_order_relaxed );
+}
+
+bool AlarmSharedTable::available ( const std::string& name ) noexcept
+{
+    try
+    {
+        AlarmSharedTable table ( name, false );
+        return table.writerAlive();
+    }
+    catch ( ... )
+    {
+        return false; // No table or not readable
+    }
+}
@@ -0,0 +1,322 @@
+/**
+ * @file alarmsharedtable.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Table of the active alarms in shared memory
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMSHAREDTABLE_H
+#define ALARMSHAREDTABLE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Table of the active alarms in shared memory
+ *
+ * an-daemon publishes its map of active alarms in a POSIX shared memory segment, so the desktop widgets on the same machine can read it instead of each opening its own connection to the message broker: See SharedTableMessageSource. There is exactly one writer, the daemon, and any number of readers, which never take a lock and cannot delay the writer.
+ *
+ * The segment consists of a header and a fixed number of rows of equal size. Each row carries its own version number and is updated like a seqlock: The writer makes the version odd, changes the row and makes it even again, and a reader that sees an odd version or a different version after copying the row simply copies it again. A global generation number is incremented after every change, so a reader finds out whether anything has changed with a single load. The writer also stores its process ID and refreshes a heartbeat every second, so readers notice when the daemon is gone.
+ *
+ * PV names, severities and status strings longer than the fields of a row are truncated. If more alarms are active than the table has rows, the surplus alarms are only counted in the header.
+ */
+class AlarmSharedTable final
+{
+public:
+    /**
+     * @brief Content of a row
+     */
+    struct Row
+    {
+        /**
+         * @brief Alarm severity, e.g. "MAJOR"
+         */
+        std::string severity;
+        /**
+         * @brief Alarm status, e.g. "HIHI_ALARM"
+         */
+        std::string status;
+    };
+    /**
+     * @brief Number of rows of a table created by an-daemon
+     *
+     * Each row takes 256 bytes, so the segment has 16 MiB, of which only the pages of the rows that have been used occupy memory.
+     */
+    static const uint32_t defaultCapacity = 65536;
+    /**
+     * @brief Age of the heartbeat in seconds after which the writer is considered gone
+     */
+    static const int64_t heartbeatTimeout = 10;
+private:
+    /**
+     * @brief Magic string at the beginning of the segment
+     *
+     * Used to recognize a shared alarm table, the last two characters are the layout version.
+     */
+    static const char segmentMagic[9];
+    /**
+     * @brief Header of the segment
+     *
+     * Padded to a cache line, so the rows start on a cache line of their own.
+     */
+    struct Header
+    {
+        /**
+         * @brief segmentMagic without the terminating zero
+         */
+        char magic[8];
+        /**
+         * @brief Number of rows following the header
+         */
+        uint32_t capacity;
+        /**
+         * @brief Process ID of the writer, 0 after the writer has closed the table
+         */
+        std::atomic<int32_t> writerPid;
+        /**
+         * @brief Incremented after every change of a row
+         */
+        std::atomic<uint64_t> generation;
+        /**
+         * @brief Wall clock time in seconds of the last sign of life of the writer, see Clock::wallTime()
+         */
+        std::atomic<int64_t> heartbeat;
+        /**
+         * @brief Number of rows that have ever been used, the rows behind are empty
+         */
+        std::atomic<uint32_t> used;
+        /**
+         * @brief Number of active alarms that have not found a row
+         */
+        std::atomic<uint32_t> overflow;
+        /**
+         * @brief Padding to 64 bytes
+         */
+        char padding[24];
+    };
+    /**
+     * @brief A row of the segment
+     *
+     * Exactly 256 bytes, the strings are terminated by a zero unless they fill their field completely.
+     */
+    struct Slot
+    {
+        /**
+         * @brief Version of the row, odd while the writer is changing it
+         */
+        std::atomic<uint32_t> version;
+        /**
+         * @brief 1 if the row holds an alarm, 0 if it is free
+         */
+        uint32_t occupied;
+        /**
+         * @brief PV name without the "epics://" prefix
+         */
+        char pvname[184];
+        /**
+         * @brief Alarm severity
+         */
+        char severity[24];
+        /**
+         * @brief Alarm status
+         */
+        char status[40];
+    };
+    /**
+     * @brief Name of the segment
+     */
+    const std::string _name;
+    /**
+     * @brief Flag whether this instance is the writer
+     */
+    const bool _writer;
+    /**
+     * @brief Size of the mapping in bytes
+     */
+    size_t _size;
+    /**
+     * @brief The header at the beginning of the mapping
+     */
+    Header* _header;
+    /**
+     * @brief The rows following the header
+     */
+    Slot* _slots;
+    /**
+     * @brief Rows of the PVs in the table
+     *
+     * Only used by the writer.
+     */
+    std::unordered_map<std::string, uint32_t> _rows;
+    /**
+     * @brief Rows that have become free again
+     *
+     * Only used by the writer, reused before rows that have never been used.
+     */
+    std::vector<uint32_t> _freerows;
+    /**
+     * @brief PVs in alarm that have not found a row
+     *
+     * Only used by the writer.
+     */
+    std::unordered_set<std::string> _overflowed;
+
+    /**
+     * @brief Write a row
+     *
+     * Follows the seqlock protocol described above and increments the generation.
+     * @param index Number of the row
+     * @param pvname PV name, empty to free the row
+     * @param severity Alarm severity
+     * @param status Alarm status
+     * @return Nothing
+     */
+    void writeSlot ( const uint32_t index, const std::string& pvname, const std::string& severity, const std::string& status ) noexcept;
+    /**
+     * @brief Map an existing segment read-only
+     *
+     * @return Nothing
+     * @exception std::runtime_error The segment does not exist or is not a shared alarm table
+     */
+    void attach();
+    /**
+     * @brief Check whether the process of the writer is alive
+     *
+     * @param header Header of the segment
+     * @return true if the writer has not closed the table, its process exists and its heartbeat is recent
+     */
+    static bool writerAlive ( const Header& header ) noexcept;
+public:
+    /**
+     * @brief Constructor
+     *
+     * The writer creates a new segment, replacing a segment left behind by a daemon that has crashed. The readers map the existing segment read-only.
+     * @param name Name of the POSIX shared memory segment, starting with a slash, see shm_open(3)
+     * @param writer true for an-daemon publishing the table, false for a reader
+     * @exception std::runtime_error The segment cannot be created or opened, or another process already publishes a table under this name
+     */
+    AlarmSharedTable ( const std::string& name, const bool writer );
+    /**
+     * @brief Destructor
+     *
+     * The writer marks the table as closed and removes the segment, so the readers know the daemon is gone.
+     */
+    ~AlarmSharedTable();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmSharedTable
+     */
+    AlarmSharedTable ( const AlarmSharedTable& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmSharedTable
+     * @return Nothing (deleted)
+     */
+    AlarmSharedTable& operator= ( const AlarmSharedTable& other ) = delete;
+    /**
+     * @brief Publish an active alarm
+     *
+     * Adds the PV to the table or updates its row. Only to be called by the writer, and not concurrently: AlarmServerConnector calls it under the lock of its map of active alarms.
+     * @param pvname PV name
+     * @param severity Alarm severity
+     * @param status Alarm status
+     * @return Nothing
+     */
+    void publish ( const std::string& pvname, const std::string& severity, const std::string& status );
+    /**
+     * @brief Remove a cleared alarm
+     *
+     * Like publish(), only to be called by the writer.
+     * @param pvname PV name
+     * @return Nothing
+     */
+    void remove ( const std::string& pvname );
+    /**
+     * @brief Show that the writer is alive
+     *
+     * Called by the writer every second.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void heartbeat() noexcept;
+    /**
+     * @brief Generation of the table
+     *
+     * Changes whenever a row is changed, so readers can skip read() if it is the same as at their last call.
+     *
+     * This method cannot throw exceptions.
+     * @return The generation number
+     */
+    uint64_t generation() const noexcept;
+    /**
+     * @brief Check whether the writer is alive
+     *
+     * This method cannot throw exceptions.
+     * @return true if the writer has not closed the table, its process exists and its heartbeat is not older than heartbeatTimeout
+     */
+    bool writerAlive() const noexcept;
+    /**
+     * @brief Copy all alarms
+     *
+     * Each row is copied consistently, without taking a lock. Changes made during the copy may or may not be included, they are covered by the next call as they change the generation.
+     * @param rows Receives the alarms by PV name, previous content is removed
+     * @return Number of active alarms missing from the table because it is full
+     */
+    uint32_t read ( std::map<std::string, Row>& rows ) const;
+    /**
+     * @brief Check whether a live writer publishes a table
+     *
+     * Used to decide whether the desktop widgets read the table or connect to the message broker.
+     *
+     * This method cannot throw exceptions.
+     * @param name Name of the POSIX shared memory segment
+     * @return true if the segment exists and its writer is alive
+     */
+    static bool available ( const std::string& name ) noexcept;
+};
+
+}
+
+#endif // ALARMSHAREDTABLE_H
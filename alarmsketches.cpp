@@ -0,0 +1,203 @@
+/**
+ * @file alarmsketches.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Constant-memory sketches for streaming alarm statistics
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmsketches.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace AlarmNotifications;
+
+const size_t CountMinSketch::depth;
+const size_t CountMinSketch::width;
+const unsigned int HyperLogLog::precision;
+const size_t HyperLogLog::registerCount;
+const uint64_t HdrHistogram::subBucketCount;
+const size_t HdrHistogram::counterCount;
+
+// Position of the highest set bit, value must not be zero
+static unsigned int highestBit ( const uint64_t value )
+{
+    return 63 - static_cast<unsigned int> ( __builtin_clzll ( value ) );
+}
+
+uint64_t AlarmNotifications::sketchHash ( const std::string& text ) noexcept
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for ( auto i = text.begin(); i != text.end(); i++ )
+    {
+        hash ^= static_cast<uint8_t> ( *i );
+        hash *= 1099511628211ULL;
+    }
+    // Finalizer of SplitMix64
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+CountMinSketch::CountMinSketch() noexcept
+{
+    clear();
+}
+
+uint32_t CountMinSketch::add ( const uint64_t hash ) noexcept
+{
+    // The rows use the double hashing scheme by Kirsch and Mitzenmacher, so one hash value is enough
+    const uint64_t h1 = hash & 0xffffffff;
+    const uint64_t h2 = ( hash >> 32 ) | 1;
+    uint32_t* counters[depth];
+    uint32_t minimum = UINT32_MAX;
+    for ( size_t row = 0; row < depth; row++ )
+    {
+        counters[row] = &_counters[row][ ( h1 + row * h2 ) % width];
+        minimum = std::min ( minimum, *counters[row] );
+    }
+    if ( minimum == UINT32_MAX )
+        return minimum;
+    for ( size_t row = 0; row < depth; row++ )
+        if ( *counters[row] == minimum )
+            ( *counters[row] ) ++;
+    _total++;
+    return minimum + 1;
+}
+
+uint32_t CountMinSketch::estimate ( const uint64_t hash ) const noexcept
+{
+    const uint64_t h1 = hash & 0xffffffff;
+    const uint64_t h2 = ( hash >> 32 ) | 1;
+    uint32_t minimum = UINT32_MAX;
+    for ( size_t row = 0; row < depth; row++ )
+        minimum = std::min ( minimum, _counters[row][ ( h1 + row * h2 ) % width] );
+    return minimum;
+}
+
+uint64_t CountMinSketch::getTotal() const noexcept
+{
+    return _total;
+}
+
+void CountMinSketch::clear() noexcept
+{
+    memset ( _counters, 0, sizeof ( _counters ) );
+    _total = 0;
+}
+
+HyperLogLog::HyperLogLog() noexcept
+{
+    clear();
+}
+
+void HyperLogLog::add ( const uint64_t hash ) noexcept
+{
+    const size_t index = static_cast<size_t> ( hash >> ( 64 - precision ) );
+    // The sentinel bit limits the rank if all remaining bits are zero
+    const uint64_t remaining = ( hash << precision ) | ( static_cast<uint64_t> ( 1 ) << ( precision - 1 ) );
+    const uint8_t rank = static_cast<uint8_t> ( 64 - highestBit ( remaining ) );
+    _registers[index] = std::max ( _registers[index], rank );
+}
+
+uint64_t HyperLogLog::estimate() const noexcept
+{
+    const double m = static_cast<double> ( registerCount );
+    double sum = 0;
+    size_t zeros = 0;
+    for ( size_t i = 0; i < registerCount; i++ )
+    {
+        sum += std::ldexp ( 1.0, -static_cast<int> ( _registers[i] ) );
+        if ( _registers[i] == 0 )
+            zeros++;
+    }
+    double estimate = ( 0.7213 / ( 1.0 + 1.079 / m ) ) * m * m / sum;
+    if ( estimate <= 2.5 * m && zeros != 0 )
+        estimate = m * std::log ( m / static_cast<double> ( zeros ) ); // Linear counting is more accurate for small cardinalities
+    return static_cast<uint64_t> ( estimate + 0.5 );
+}
+
+void HyperLogLog::clear() noexcept
+{
+    memset ( _registers, 0, sizeof ( _registers ) );
+}
+
+size_t HdrHistogram::indexOf ( const uint64_t value ) noexcept
+{
+    if ( value < 2 * subBucketCount )
+        return static_cast<size_t> ( value );
+    // Shift the value so that it falls into [subBucketCount, 2 * subBucketCount), subBucketCount is 2^6
+    const unsigned int shift = highestBit ( value ) - 6;
+    return static_cast<size_t> ( shift * subBucketCount + ( value >> shift ) );
+}
+
+uint64_t HdrHistogram::valueOf ( const size_t index ) noexcept
+{
+    if ( index < 2 * subBucketCount )
+        return index;
+    const unsigned int shift = static_cast<unsigned int> ( index / subBucketCount - 1 );
+    return ( index % subBucketCount + subBucketCount ) << shift;
+}
+
+HdrHistogram::HdrHistogram() noexcept
+    : _total ( 0 )
+{
+    memset ( _counters, 0, sizeof ( _counters ) );
+}
+
+void HdrHistogram::record ( const uint64_t value ) noexcept
+{
+    _counters[indexOf ( value )]++;
+    _total++;
+}
+
+uint64_t HdrHistogram::getTotal() const noexcept
+{
+    return _total;
+}
+
+uint64_t HdrHistogram::getValueAtPercentile ( const double percentile ) const noexcept
+{
+    if ( _total == 0 )
+        return 0;
+    const double rank = std::ceil ( std::min ( std::max ( percentile, 0.0 ), 100.0 ) / 100.0 * static_cast<double> ( _total ) );
+    const uint64_t target = std::max ( static_cast<uint64_t> ( rank ), static_cast<uint64_t> ( 1 ) );
+    uint64_t count = 0;
+    for ( size_t i = 0; i < counterCount; i++ )
+    {
+        count += _counters[i];
+        if ( count >= target )
+            return valueOf ( i );
+    }
+    return valueOf ( counterCount - 1 );
+}
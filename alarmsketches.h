@@ -0,0 +1,249 @@
+/**
+ * @file alarmsketches.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Constant-memory sketches for streaming alarm statistics
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMSKETCHES_H
+#define ALARMSKETCHES_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Hash a string for the sketches
+ *
+ * 64 bit FNV-1a followed by a final mixing step, so all bits of the result depend on all bytes of the string. The sketches need well distributed hash values, which the plain FNV-1a hash does not provide in its upper bits for short strings.
+ * @param text The string to be hashed, usually a PV name
+ * @return 64 bit hash value
+ */
+uint64_t sketchHash ( const std::string& text ) noexcept;
+
+/**
+ * @brief Count-Min sketch
+ *
+ * Estimates how often a key has been added in constant memory, independent of the number of distinct keys. Each key is mapped to one counter in each of the depth rows, and the estimate is the smallest of these counters. The estimate is never too low, and it is too high by at most a small fraction of the total number of additions with high probability.
+ *
+ * This implementation uses conservative update: Only the counters that are equal to the current minimum are incremented, which reduces the overestimation considerably.
+ */
+class CountMinSketch final
+{
+public:
+    /**
+     * @brief Number of rows
+     *
+     * The probability of an estimate exceeding the error bound decreases exponentially with the number of rows.
+     */
+    static const size_t depth = 4;
+    /**
+     * @brief Number of counters per row
+     *
+     * The overestimation is at most about 2.7 / width of the total number of additions.
+     */
+    static const size_t width = 2048;
+private:
+    /**
+     * @brief Counters
+     */
+    uint32_t _counters[depth][width];
+    /**
+     * @brief Total number of additions
+     */
+    uint64_t _total;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates an empty sketch.
+     */
+    CountMinSketch() noexcept;
+    /**
+     * @brief Count a key
+     *
+     * @param hash Hash value of the key, see sketchHash()
+     * @return The estimated count of the key after adding it
+     */
+    uint32_t add ( const uint64_t hash ) noexcept;
+    /**
+     * @brief Estimate the count of a key
+     *
+     * @param hash Hash value of the key, see sketchHash()
+     * @return The estimated count, never less than the real count
+     */
+    uint32_t estimate ( const uint64_t hash ) const noexcept;
+    /**
+     * @brief Total number of additions
+     *
+     * @return The number of calls to add() since the last clear()
+     */
+    uint64_t getTotal() const noexcept;
+    /**
+     * @brief Reset all counters to zero
+     *
+     * @return Nothing
+     */
+    void clear() noexcept;
+};
+
+/**
+ * @brief HyperLogLog cardinality estimator
+ *
+ * Estimates the number of distinct keys that have been added in constant memory. The standard error is about 1.04 / sqrt(2^precision), i.e. 1.6 % with the precision used here. Small cardinalities are estimated by linear counting and are exact in practice.
+ */
+class HyperLogLog final
+{
+public:
+    /**
+     * @brief Number of index bits
+     *
+     * The sketch uses 2^precision registers of one byte.
+     */
+    static const unsigned int precision = 12;
+    /**
+     * @brief Number of registers
+     */
+    static const size_t registerCount = static_cast<size_t> ( 1 ) << precision;
+private:
+    /**
+     * @brief Registers
+     *
+     * Each register holds the maximum position of the first set bit among the hash values mapped to it.
+     */
+    uint8_t _registers[registerCount];
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates an empty sketch.
+     */
+    HyperLogLog() noexcept;
+    /**
+     * @brief Add a key
+     *
+     * @param hash Hash value of the key, see sketchHash()
+     * @return Nothing
+     */
+    void add ( const uint64_t hash ) noexcept;
+    /**
+     * @brief Estimate the number of distinct keys
+     *
+     * @return Estimated number of distinct keys added since the last clear()
+     */
+    uint64_t estimate() const noexcept;
+    /**
+     * @brief Forget all keys
+     *
+     * @return Nothing
+     */
+    void clear() noexcept;
+};
+
+/**
+ * @brief High dynamic range histogram
+ *
+ * Records non-negative integer values over the complete 64 bit range with a relative error of less than 1/subBucketCount, in constant memory. Values below 2 * subBucketCount are counted exactly. Larger values are grouped into buckets by their highest set bit, and each bucket is split linearly into subBucketCount sub-buckets. Recording a value takes constant time.
+ */
+class HdrHistogram final
+{
+public:
+    /**
+     * @brief Number of sub-buckets per power of two
+     *
+     * Determines the precision, with 64 sub-buckets the relative error is below 1.6 %.
+     */
+    static const uint64_t subBucketCount = 64;
+    /**
+     * @brief Number of counters
+     *
+     * Enough counters to cover all 64 bit values, the largest one is mapped to 57 * subBucketCount + 2 * subBucketCount - 1.
+     */
+    static const size_t counterCount = 59 * subBucketCount;
+private:
+    /**
+     * @brief Counters
+     */
+    uint64_t _counters[counterCount];
+    /**
+     * @brief Number of recorded values
+     */
+    uint64_t _total;
+    /**
+     * @brief Map a value to its counter
+     *
+     * @param value The value to be recorded
+     * @return Index into _counters
+     */
+    static size_t indexOf ( const uint64_t value ) noexcept;
+    /**
+     * @brief Lowest value mapped to a counter
+     *
+     * Inverse of indexOf().
+     * @param index Index into _counters
+     * @return The lowest value recorded in this counter
+     */
+    static uint64_t valueOf ( const size_t index ) noexcept;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates an empty histogram.
+     */
+    HdrHistogram() noexcept;
+    /**
+     * @brief Record a value
+     *
+     * @param value The value to be recorded
+     * @return Nothing
+     */
+    void record ( const uint64_t value ) noexcept;
+    /**
+     * @brief Number of recorded values
+     *
+     * @return The number of calls to record()
+     */
+    uint64_t getTotal() const noexcept;
+    /**
+     * @brief Value at a percentile
+     *
+     * @param percentile Percentile between 0 and 100, e.g. 50 for the median
+     * @return The lowest value of the sub-bucket containing the percentile, 0 if nothing has been recorded
+     */
+    uint64_t getValueAtPercentile ( const double percentile ) const noexcept;
+};
+
+}
+
+#endif // ALARMSKETCHES_H
@@ -0,0 +1,211 @@
+/**
+ * @file alarmstatesnapshot.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Warm-restart snapshot of the active alarms
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmstatesnapshot.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clock.h"
+
+using namespace AlarmNotifications;
+
+const char AlarmStateSnapshot::fileMagic[9] = "ANSNAP01";
+
+void AlarmStateSnapshot::write ( const std::string& filename, const std::vector<AlarmStatusEntry>& alarms )
+{
+    // Strings longer than the record fields are truncated, so the string block size is calculated with the truncated lengths
+    uint64_t stringBlockSize = 0;
+    for ( auto i = alarms.begin(); i != alarms.end(); i++ )
+    {
+        stringBlockSize += std::min<size_t> ( ( *i ).getPVName().length(), UINT16_MAX );
+        stringBlockSize += std::min<size_t> ( ( *i ).getSeverity().length(), UINT8_MAX );
+        stringBlockSize += std::min<size_t> ( ( *i ).getStatus().length(), UINT8_MAX );
+    }
+    if ( stringBlockSize > UINT32_MAX )
+        throw std::runtime_error ( "Too many alarms to be stored in a snapshot file." );
+    const size_t recordsOffset = sizeof ( FileHeader );
+    const size_t stringsOffset = recordsOffset + alarms.size() * sizeof ( Record );
+    const size_t fileSize = stringsOffset + stringBlockSize;
+
+    // Write into a temporary file first, so a crash never leaves a half-written snapshot behind
+    const std::string tempname = filename + ".tmp";
+    const int fd = open ( tempname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 )
+        throw std::runtime_error ( "Cannot create snapshot file " + tempname + ": " + strerror ( errno ) );
+    if ( ftruncate ( fd, ( off_t ) fileSize ) < 0 )
+    {
+        close ( fd );
+        unlink ( tempname.c_str() );
+        throw std::runtime_error ( "Cannot resize snapshot file " + tempname + ": " + strerror ( errno ) );
+    }
+    void*const mapping = mmap ( nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if ( mapping == MAP_FAILED )
+    {
+        close ( fd );
+        unlink ( tempname.c_str() );
+        throw std::runtime_error ( "Cannot map snapshot file " + tempname + " into memory: " + strerror ( errno ) );
+    }
+    char*const base = static_cast<char*> ( mapping );
+
+    FileHeader header;
+    memcpy ( header.magic, fileMagic, sizeof ( header.magic ) );
+    header.numberOfRecords = alarms.size();
+    header.stringBlockSize = stringBlockSize;
+    header.creationTime = Clock::instance().wallTime();
+    memcpy ( base, &header, sizeof ( header ) );
+
+    uint32_t stringOffset = 0;
+    Record* record = reinterpret_cast<Record*> ( base + recordsOffset );
+    char*const strings = base + stringsOffset;
+    for ( auto i = alarms.begin(); i != alarms.end(); i++, record++ )
+    {
+        Record r;
+        r.triggerTime = ( *i ).getTriggerTime();
+        r.stringOffset = stringOffset;
+        r.pvNameLength = ( uint16_t ) std::min<size_t> ( ( *i ).getPVName().length(), UINT16_MAX );
+        r.severityLength = ( uint8_t ) std::min<size_t> ( ( *i ).getSeverity().length(), UINT8_MAX );
+        r.statusLength = ( uint8_t ) std::min<size_t> ( ( *i ).getStatus().length(), UINT8_MAX );
+        r.flags = 0;
+        if ( ( *i ).getDesktopNotificationSent() )
+            r.flags |= desktopNotificationSentFlag;
+        if ( ( *i ).getEmailNotificationSent() )
+            r.flags |= emailNotificationSentFlag;
+        r.reserved = 0;
+        memcpy ( record, &r, sizeof ( r ) );
+        memcpy ( strings + stringOffset, ( *i ).getPVName().data(), r.pvNameLength );
+        stringOffset += r.pvNameLength;
+        memcpy ( strings + stringOffset, ( *i ).getSeverity().data(), r.severityLength );
+        stringOffset += r.severityLength;
+        memcpy ( strings + stringOffset, ( *i ).getStatus().data(), r.statusLength );
+        stringOffset += r.statusLength;
+    }
+
+    const int syncresult = msync ( mapping, fileSize, MS_SYNC );
+    munmap ( mapping, fileSize );
+    close ( fd );
+    if ( syncresult < 0 )
+    {
+        unlink ( tempname.c_str() );
+        throw std::runtime_error ( "Cannot flush snapshot file " + tempname + " to disk: " + strerror ( errno ) );
+    }
+    if ( rename ( tempname.c_str(), filename.c_str() ) < 0 )
+    {
+        unlink ( tempname.c_str() );
+        throw std::runtime_error ( "Cannot rename snapshot file to " + filename + ": " + strerror ( errno ) );
+    }
+}
+
+std::vector<AlarmStatusEntry> AlarmStateSnapshot::read ( const std::string& filename )
+{
+    int64_t creationTime;
+    return read ( filename, creationTime );
+}
+
+std::vector<AlarmStatusEntry> AlarmStateSnapshot::read ( const std::string& filename, int64_t& creationTime )
+{
+    std::vector<AlarmStatusEntry> alarms;
+    creationTime = 0;
+    const int fd = open ( filename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+    {
+        if ( errno == ENOENT )
+            return alarms; // No snapshot written yet, nothing to restore
+        throw std::runtime_error ( "Cannot open snapshot file " + filename + ": " + strerror ( errno ) );
+    }
+    struct stat filestatus;
+    if ( fstat ( fd, &filestatus ) < 0 )
+    {
+        close ( fd );
+        throw std::runtime_error ( "Cannot determine size of snapshot file " + filename + ": " + strerror ( errno ) );
+    }
+    const size_t fileSize = ( size_t ) filestatus.st_size;
+    if ( fileSize < sizeof ( FileHeader ) )
+    {
+        close ( fd );
+        throw std::runtime_error ( "Snapshot file " + filename + " is truncated." );
+    }
+    void*const mapping = mmap ( nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close ( fd ); // The mapping stays valid after closing the file descriptor
+    if ( mapping == MAP_FAILED )
+        throw std::runtime_error ( "Cannot map snapshot file " + filename + " into memory: " + strerror ( errno ) );
+    const char*const base = static_cast<const char*> ( mapping );
+
+    try
+    {
+        FileHeader header;
+        memcpy ( &header, base, sizeof ( header ) );
+        if ( memcmp ( header.magic, fileMagic, sizeof ( header.magic ) ) != 0 )
+            throw std::runtime_error ( "File " + filename + " is not an alarm state snapshot or has an unsupported format version." );
+        const size_t stringsOffset = sizeof ( FileHeader ) + header.numberOfRecords * sizeof ( Record );
+        if ( header.numberOfRecords > fileSize / sizeof ( Record ) || stringsOffset + header.stringBlockSize != fileSize )
+            throw std::runtime_error ( "Snapshot file " + filename + " is corrupted." );
+        creationTime = header.creationTime;
+
+        alarms.reserve ( header.numberOfRecords );
+        const char*const strings = base + stringsOffset;
+        for ( uint64_t n = 0; n < header.numberOfRecords; n++ )
+        {
+            Record r;
+            memcpy ( &r, base + sizeof ( FileHeader ) + n * sizeof ( Record ), sizeof ( r ) );
+            if ( ( uint64_t ) r.stringOffset + r.pvNameLength + r.severityLength + r.statusLength > header.stringBlockSize )
+                throw std::runtime_error ( "Snapshot file " + filename + " is corrupted." );
+            const char* s = strings + r.stringOffset;
+            const std::string pvname ( s, r.pvNameLength );
+            s += r.pvNameLength;
+            const std::string severity ( s, r.severityLength );
+            s += r.severityLength;
+            const std::string status ( s, r.statusLength );
+            AlarmStatusEntry entry ( pvname, severity, status );
+            entry.setTriggerTime ( ( time_t ) r.triggerTime );
+            entry.setDesktopNotificationSent ( ( r.flags & desktopNotificationSentFlag ) != 0 );
+            entry.setEmailNotificationSent ( ( r.flags & emailNotificationSentFlag ) != 0 );
+            alarms.push_back ( std::move ( entry ) );
+        }
+    }
+    catch ( ... )
+    {
+        munmap ( mapping, fileSize );
+        throw;
+    }
+    munmap ( mapping, fileSize );
+    return alarms;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file alarmstatesnapshot.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Warm-restart snapshot of the active alarms
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMSTATESNAPSHOT_H
+#define ALARMSTATESNAPSHOT_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "alarmstatusentry.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Snapshot file of the active alarms
+ *
+ * The CSS Alarm Server only announces changes of the alarm status, so after a restart the AlarmServerConnector would not know about alarms that are already active. Even worse, as AlarmStatusEntry takes its trigger time on construction, all escalation timeouts would start again and the e-mail notifications would be sent a second time. To avoid this, AlarmServerConnector writes all entries of its map of active alarms to a snapshot file whenever the map has changed and reads it back on startup.
+ *
+ * The snapshot is a compact binary file: A header with a magic string, the format version and the number of entries is followed by one fixed-size record per alarm and a block with all strings. The file is written into a temporary file via mmap() which is then renamed to the final location, so a crash while writing never destroys the previous snapshot. The file is read back via mmap() as well. As the snapshot is only meant to survive restarts on the same machine, the integers are stored in host byte order.
+ *
+ * This class only contains static methods and cannot be instanciated.
+ */
+class AlarmStateSnapshot final
+{
+private:
+    /**
+     * @brief Magic string at the beginning of a snapshot file
+     *
+     * Used to recognize a snapshot file, the last two characters are the format version.
+     */
+    static const char fileMagic[9];
+    /**
+     * @brief File header
+     *
+     * The header is located at the very beginning of the snapshot file and describes its content.
+     */
+    struct FileHeader
+    {
+        /**
+         * @brief Magic string
+         *
+         * Copy of fileMagic without the terminating null character.
+         */
+        char magic[8];
+        /**
+         * @brief Number of alarm records
+         *
+         * The number of Record structures following the header.
+         */
+        uint64_t numberOfRecords;
+        /**
+         * @brief Size of string block
+         *
+         * The size in bytes of the string block following the records.
+         */
+        uint64_t stringBlockSize;
+        /**
+         * @brief Time of snapshot creation
+         *
+         * POSIX timestamp when the snapshot was written.
+         */
+        int64_t creationTime;
+    };
+    /**
+     * @brief Alarm record
+     *
+     * Each active alarm is stored in one record. The strings are located in the string block, the record only contains their offset and length.
+     */
+    struct Record
+    {
+        /**
+         * @brief Trigger time of the alarm
+         *
+         * See AlarmStatusEntry::getTriggerTime().
+         */
+        int64_t triggerTime;
+        /**
+         * @brief Offset of the PV name in the string block
+         *
+         * Severity and status follow directly after the PV name.
+         */
+        uint32_t stringOffset;
+        /**
+         * @brief Length of the PV name
+         *
+         * Number of characters without any terminating null character.
+         */
+        uint16_t pvNameLength;
+        /**
+         * @brief Length of the severity string
+         *
+         * Number of characters without any terminating null character.
+         */
+        uint8_t severityLength;
+        /**
+         * @brief Length of the status string
+         *
+         * Number of characters without any terminating null character.
+         */
+        uint8_t statusLength;
+        /**
+         * @brief Notification flags
+         *
+         * Bit 0 is set if the desktop notification has been sent, bit 1 is set if the e-mail notification has been sent.
+         */
+        uint32_t flags;
+        /**
+         * @brief Padding
+         *
+         * Keeps the records aligned to eight bytes, always zero.
+         */
+        uint32_t reserved;
+    };
+    /**
+     * @brief Flag bit for sent desktop notification
+     *
+     * Used in Record::flags.
+     */
+    static const uint32_t desktopNotificationSentFlag = 1;
+    /**
+     * @brief Flag bit for sent e-mail notification
+     *
+     * Used in Record::flags.
+     */
+    static const uint32_t emailNotificationSentFlag = 2;
+public:
+    /**
+     * @brief Constructor (deleted)
+     *
+     * This class only contains static methods and cannot be instanciated.
+     */
+    AlarmStateSnapshot() = delete;
+    /**
+     * @brief Write snapshot file
+     *
+     * Serializes the given alarms into a temporary file next to the given location via mmap() and renames it to the final location afterwards. Strings that do not fit into the record fields (PV names with more than 65535 characters, severity or status strings with more than 255 characters) are truncated.
+     * @param filename Location of the snapshot file
+     * @param alarms The active alarms to be stored
+     * @return Nothing
+     * @exception std::runtime_error The snapshot file could not be created or written.
+     */
+    static void write ( const std::string& filename, const std::vector<AlarmStatusEntry>& alarms );
+    /**
+     * @brief Read snapshot file
+     *
+     * Maps the snapshot file into memory and recreates the alarms stored in it, including their trigger time and notification flags. If the file does not exist, an empty vector is returned.
+     * @param filename Location of the snapshot file
+     * @return The alarms stored in the snapshot
+     * @exception std::runtime_error The snapshot file could not be read or is corrupted.
+     */
+    static std::vector<AlarmStatusEntry> read ( const std::string& filename );
+    /**
+     * @brief Read snapshot file and its creation time
+     *
+     * Like read ( const std::string& ), but also returns when the snapshot has been written, so an outdated snapshot can be recognized.
+     * @param filename Location of the snapshot file
+     * @param creationTime Receives the wall clock time in seconds the snapshot has been written, see Clock::wallTime(), 0 if the file does not exist
+     * @return The alarms stored in the snapshot
+     * @exception std::runtime_error The snapshot file could not be read or is corrupted.
+     */
+    static std::vector<AlarmStatusEntry> read ( const std::string& filename, int64_t& creationTime );
+};
+
+}
+
+#endif // ALARMSTATESNAPSHOT_H
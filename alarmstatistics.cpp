@@ -0,0 +1,227 @@
+/**
+ * @file alarmstatistics.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Live alarm statistics in constant memory
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmstatistics.h"
+
+#include <algorithm>
+
+#include "clock.h"
+
+using namespace AlarmNotifications;
+
+const size_t AlarmStatistics::candidateCount;
+const size_t AlarmStatistics::hoursKept;
+
+AlarmStatistics::AlarmStatistics()
+    : _currenthour ( static_cast<int64_t> ( Clock::instance().wallTime() / 3600 ) )
+{
+    for ( size_t i = 0; i < 2; i++ )
+        _candidates[i].reserve ( candidateCount );
+    for ( size_t i = 0; i < hoursKept; i++ )
+        _distincthour[i] = -1;
+}
+
+void AlarmStatistics::rotate ( const int64_t hour ) noexcept
+{
+    if ( hour <= _currenthour )
+        return; // Also ignores the wall clock being set back
+    if ( hour == _currenthour + 1 )
+    {
+        std::swap ( _frequency[0], _frequency[1] );
+        _candidates[0].swap ( _candidates[1] );
+    }
+    else
+    {
+        _frequency[1].clear();
+        _candidates[1].clear();
+    }
+    _frequency[0].clear();
+    _candidates[0].clear();
+    _currenthour = hour;
+}
+
+void AlarmStatistics::countDistinct ( const uint64_t hash, const int64_t hour ) noexcept
+{
+    const size_t slot = static_cast<size_t> ( hour % static_cast<int64_t> ( hoursKept ) );
+    if ( _distincthour[slot] != hour )
+    {
+        _distinct[slot].clear();
+        _distincthour[slot] = hour;
+    }
+    _distinct[slot].add ( hash );
+}
+
+size_t AlarmStatistics::validHours ( const int64_t hour ) const noexcept
+{
+    // Without updates for some time, the current hour may already be the previous one or older
+    const int64_t age = hour - _currenthour;
+    return ( age <= 0 ) ? 2 : ( ( age == 1 ) ? 1 : 0 );
+}
+
+size_t AlarmStatistics::histogramIndex ( const AlarmStatusEntry::SeverityLevel severity ) noexcept
+{
+    if ( severity == AlarmStatusEntry::SeverityOK || severity >= AlarmStatusEntry::SeverityUnknown )
+        return 0;
+    return static_cast<size_t> ( ( severity + 1 ) / 2 ); // Each severity directly follows its acknowledged variant
+}
+
+void AlarmStatistics::recordAlarm ( const std::string& pvname, const time_t now ) noexcept
+{
+    const uint64_t hash = sketchHash ( pvname );
+    const int64_t hour = static_cast<int64_t> ( now / 3600 );
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    rotate ( hour );
+    countDistinct ( hash, hour );
+
+    const uint32_t alarms = _frequency[0].add ( hash );
+    std::vector<Candidate>& candidates = _candidates[0];
+    auto weakest = candidates.begin();
+    for ( auto i = candidates.begin(); i != candidates.end(); i++ )
+    {
+        if ( ( *i ).hash == hash && ( *i ).pvname == pvname )
+        {
+            ( *i ).alarms = alarms;
+            return;
+        }
+        if ( ( *i ).alarms < ( *weakest ).alarms )
+            weakest = i;
+    }
+    try
+    {
+        if ( candidates.size() < candidateCount )
+        {
+            Candidate candidate;
+            candidate.pvname = pvname;
+            candidate.hash = hash;
+            candidate.alarms = alarms;
+            candidates.push_back ( candidate ); // Does not reallocate, space has been reserved in the constructor
+        }
+        else if ( alarms > ( *weakest ).alarms )
+        {
+            ( *weakest ).pvname = pvname;
+            ( *weakest ).hash = hash;
+            ( *weakest ).alarms = alarms;
+        }
+    }
+    catch ( ... )
+    {
+        // Only std::bad_alloc when copying the PV name, the candidate is not important enough to give up the noexcept guarantee
+    }
+}
+
+void AlarmStatistics::recordUpdate ( const std::string& pvname, const time_t now ) noexcept
+{
+    const uint64_t hash = sketchHash ( pvname );
+    const int64_t hour = static_cast<int64_t> ( now / 3600 );
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    rotate ( hour );
+    countDistinct ( hash, hour );
+}
+
+void AlarmStatistics::recordClear ( const AlarmStatusEntry::SeverityLevel severity, const uint64_t duration ) noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    _timetoclear[0].record ( duration );
+    const size_t index = histogramIndex ( severity );
+    if ( index != 0 )
+        _timetoclear[index].record ( duration );
+}
+
+std::vector<AlarmStatistics::NoisyPV> AlarmStatistics::getNoisiestPVs ( const size_t count ) const
+{
+    const int64_t hour = static_cast<int64_t> ( Clock::instance().wallTime() / 3600 );
+    std::vector<NoisyPV> result;
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    const size_t hours = validHours ( hour );
+    for ( size_t n = 0; n < hours; n++ )
+        for ( auto i = _candidates[n].begin(); i != _candidates[n].end(); i++ )
+        {
+            bool known = false;
+            for ( auto j = result.begin(); j != result.end() && !known; j++ )
+                known = ( *j ).pvname == ( *i ).pvname;
+            if ( known )
+                continue;
+            NoisyPV entry;
+            entry.pvname = ( *i ).pvname;
+            entry.alarms = 0;
+            for ( size_t m = 0; m < hours; m++ )
+                entry.alarms += _frequency[m].estimate ( ( *i ).hash );
+            result.push_back ( entry );
+        }
+    std::sort ( result.begin(), result.end(), [] ( const NoisyPV & a, const NoisyPV & b )
+    {
+        return a.alarms > b.alarms || ( a.alarms == b.alarms && a.pvname < b.pvname );
+    } );
+    if ( result.size() > count )
+        result.resize ( count );
+    return result;
+}
+
+uint64_t AlarmStatistics::getAlarmFrequency ( const std::string& pvname ) const noexcept
+{
+    const uint64_t hash = sketchHash ( pvname );
+    const int64_t hour = static_cast<int64_t> ( Clock::instance().wallTime() / 3600 );
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    const size_t hours = validHours ( hour );
+    uint64_t alarms = 0;
+    for ( size_t n = 0; n < hours; n++ )
+        alarms += _frequency[n].estimate ( hash );
+    return alarms;
+}
+
+std::vector<uint64_t> AlarmStatistics::getDistinctAlarmingPVs() const
+{
+    const int64_t hour = static_cast<int64_t> ( Clock::instance().wallTime() / 3600 );
+    std::vector<uint64_t> result ( hoursKept, 0 );
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    for ( size_t n = 0; n < hoursKept; n++ )
+    {
+        const int64_t wanted = hour - static_cast<int64_t> ( n );
+        const size_t slot = static_cast<size_t> ( wanted % static_cast<int64_t> ( hoursKept ) );
+        if ( _distincthour[slot] == wanted )
+            result[n] = _distinct[slot].estimate();
+    }
+    return result;
+}
+
+uint64_t AlarmStatistics::getTimeToClear ( const double percentile, const AlarmStatusEntry::SeverityLevel severity ) const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _timetoclear[histogramIndex ( severity )].getValueAtPercentile ( percentile );
+}
+
+uint64_t AlarmStatistics::getClearedAlarms ( const AlarmStatusEntry::SeverityLevel severity ) const noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( _mutex );
+    return _timetoclear[histogramIndex ( severity )].getTotal();
+}
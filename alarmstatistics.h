@@ -0,0 +1,271 @@
+/**
+ * @file alarmstatistics.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Live alarm statistics in constant memory
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMSTATISTICS_H
+#define ALARMSTATISTICS_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alarmsketches.h"
+#include "alarmstatusentry.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Live alarm statistics in constant memory
+ *
+ * Collects statistics about the alarms received by the AlarmServerConnector without keeping any per-PV data, so the memory consumption stays the same no matter how many PVs the alarm server knows:
+ * - A CountMinSketch per hour estimates how often each PV went into alarm. Together with a short list of candidates, the PVs with the highest estimates, it answers which PVs are the noisiest right now.
+ * - A HyperLogLog per hour estimates how many distinct PVs raised or changed an alarm, for the last hoursKept hours.
+ * - HdrHistograms record the time from raising to clearing an alarm, for all alarms and separately per severity.
+ *
+ * All updates take constant time. The class is thread-safe, it has its own mutex, so the AlarmServerConnector can update it outside of its own lock.
+ */
+class AlarmStatistics final
+{
+public:
+    /**
+     * @brief Number of noisy PV candidates per hour
+     *
+     * Upper limit for the number of PVs returned by getNoisiestPVs().
+     */
+    static const size_t candidateCount = 64;
+    /**
+     * @brief Number of hours covered by getDistinctAlarmingPVs()
+     */
+    static const size_t hoursKept = 24;
+    /**
+     * @brief Entry of the list of noisiest PVs
+     */
+    struct NoisyPV
+    {
+        /**
+         * @brief Name of the PV
+         */
+        std::string pvname;
+        /**
+         * @brief Estimated number of alarms in the current and the previous hour
+         */
+        uint64_t alarms;
+    };
+private:
+    /**
+     * @brief Noisy PV candidate
+     *
+     * The hash is kept to avoid hashing the PV name again when the candidates are compared.
+     */
+    struct Candidate
+    {
+        /**
+         * @brief Name of the PV
+         */
+        std::string pvname;
+        /**
+         * @brief Hash value of the PV name, see sketchHash()
+         */
+        uint64_t hash;
+        /**
+         * @brief Estimated number of alarms in the hour
+         */
+        uint32_t alarms;
+    };
+    /**
+     * @brief Mutex to protect all members against concurrent access
+     */
+    mutable boost::mutex _mutex;
+    /**
+     * @brief Hour of the latest update
+     *
+     * Hours since the Unix epoch. The first element of _frequency and _candidates belongs to this hour, the second one to the hour before.
+     */
+    int64_t _currenthour;
+    /**
+     * @brief Alarm frequency per PV
+     *
+     * One sketch for the current and one for the previous hour.
+     */
+    CountMinSketch _frequency[2];
+    /**
+     * @brief PVs with the highest frequency estimates
+     *
+     * At most candidateCount entries for the current and the previous hour.
+     */
+    std::vector<Candidate> _candidates[2];
+    /**
+     * @brief Distinct alarming PVs per hour
+     *
+     * Ring buffer, the sketch for hour h is stored at index h % hoursKept.
+     */
+    HyperLogLog _distinct[hoursKept];
+    /**
+     * @brief Hours of the entries in _distinct
+     *
+     * Used to detect entries that are older than hoursKept hours.
+     */
+    int64_t _distincthour[hoursKept];
+    /**
+     * @brief Time from raising to clearing an alarm in seconds
+     *
+     * The first histogram covers all alarms, the others the alarms by the severity they had when they were cleared, see histogramIndex().
+     */
+    HdrHistogram _timetoclear[5];
+    /**
+     * @brief Start a new hour if necessary
+     *
+     * Moves the data of the current hour to the previous hour and clears the current hour. If more than one hour has passed, the previous hour is cleared as well. The mutex must be locked by the caller.
+     * @param hour Current hour since the Unix epoch
+     * @return Nothing
+     */
+    void rotate ( const int64_t hour ) noexcept;
+    /**
+     * @brief Count a PV as alarming in an hour
+     *
+     * Adds the PV to the HyperLogLog of the hour, which replaces the one of hoursKept hours earlier. The mutex must be locked by the caller.
+     * @param hash Hash value of the PV name, see sketchHash()
+     * @param hour Current hour since the Unix epoch
+     * @return Nothing
+     */
+    void countDistinct ( const uint64_t hash, const int64_t hour ) noexcept;
+    /**
+     * @brief Number of valid hours in _frequency and _candidates
+     *
+     * If there has been no update for some time, the data of _currenthour may already belong to the previous hour or be outdated completely. The mutex must be locked by the caller.
+     * @param hour Current hour since the Unix epoch
+     * @return 2 if both hours are valid, 1 if only the first element is valid (as the previous hour), 0 otherwise
+     */
+    size_t validHours ( const int64_t hour ) const noexcept;
+    /**
+     * @brief Index into _timetoclear
+     *
+     * Acknowledged and unacknowledged alarms of the same severity share a histogram.
+     * @param severity The severity
+     * @return 1 to 4 for MINOR, MAJOR, INVALID and UNDEFINED, 0 for all other values
+     */
+    static size_t histogramIndex ( const AlarmStatusEntry::SeverityLevel severity ) noexcept;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates empty statistics.
+     */
+    AlarmStatistics();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmStatistics
+     */
+    AlarmStatistics ( const AlarmStatistics& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of AlarmStatistics
+     * @return Nothing (deleted)
+     */
+    AlarmStatistics& operator= ( const AlarmStatistics& other ) = delete;
+    /**
+     * @brief Record a new alarm
+     *
+     * Counts the alarm in the frequency sketch and the distinct PVs of the current hour.
+     * @param pvname Name of the PV that went into alarm
+     * @param now Current time
+     * @return Nothing
+     */
+    void recordAlarm ( const std::string& pvname, const time_t now ) noexcept;
+    /**
+     * @brief Record a change of an active alarm
+     *
+     * Counts the PV as alarming in the current hour, but not as new alarm.
+     * @param pvname Name of the PV whose alarm has changed
+     * @param now Current time
+     * @return Nothing
+     */
+    void recordUpdate ( const std::string& pvname, const time_t now ) noexcept;
+    /**
+     * @brief Record a cleared alarm
+     *
+     * @param severity Severity of the alarm before it was cleared
+     * @param duration Time since the alarm was raised in seconds
+     * @return Nothing
+     */
+    void recordClear ( const AlarmStatusEntry::SeverityLevel severity, const uint64_t duration ) noexcept;
+    /**
+     * @brief The noisiest PVs right now
+     *
+     * Returns the PVs with the most alarms in the current and the previous hour, as estimated by the frequency sketches.
+     * @param count Maximum number of PVs to be returned, at most candidateCount PVs are known
+     * @return PVs ordered by their estimated number of alarms, highest first
+     */
+    std::vector<NoisyPV> getNoisiestPVs ( const size_t count ) const;
+    /**
+     * @brief Estimated alarm frequency of a PV
+     *
+     * @param pvname Name of the PV
+     * @return Estimated number of alarms in the current and the previous hour, never less than the real number
+     */
+    uint64_t getAlarmFrequency ( const std::string& pvname ) const noexcept;
+    /**
+     * @brief Distinct alarming PVs per hour
+     *
+     * @return Estimated number of distinct PVs that raised or changed an alarm, the first element is the current hour, the last one hoursKept - 1 hours ago
+     */
+    std::vector<uint64_t> getDistinctAlarmingPVs() const;
+    /**
+     * @brief Time to clear an alarm
+     *
+     * @param percentile Percentile between 0 and 100, e.g. 50 for the median or 99
+     * @param severity Only consider alarms with this severity (acknowledged or not), SeverityUnknown for all alarms
+     * @return Time in seconds, accurate within 1.6 %
+     */
+    uint64_t getTimeToClear ( const double percentile, const AlarmStatusEntry::SeverityLevel severity = AlarmStatusEntry::SeverityUnknown ) const noexcept;
+    /**
+     * @brief Number of cleared alarms
+     *
+     * @param severity Only count alarms with this severity (acknowledged or not), SeverityUnknown for all alarms
+     * @return Number of alarms recorded with recordClear()
+     */
+    uint64_t getClearedAlarms ( const AlarmStatusEntry::SeverityLevel severity = AlarmStatusEntry::SeverityUnknown ) const noexcept;
+};
+
+}
+
+#endif // ALARMSTATISTICS_H
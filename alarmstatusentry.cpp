@@ -33,6 +33,8 @@
 
 #include "alarmstatusentry.h"
 
+#include "clock.h"
+
 using namespace AlarmNotifications;
 
 AlarmStatusEntry::AlarmStatusEntry ( const std::string& pvname, const std::string& severity, const std::string& status ) noexcept
@@ -40,11 +42,15 @@ AlarmStatusEntry::AlarmStatusEntry ( const std::string& pvname, const std::strin
 _pvname ( pvname ),
         _severity ( severity ),
         _status ( status ),
-        _triggertime ( std::time ( nullptr ) ),
+        _triggertime ( Clock::instance().wallTime() ),
         _desktopNotificationSent ( false ),
         _emailNotificationSent ( false )
 {
-
+    _pipelinetimes.eventTime = 0;
+    _pipelinetimes.brokerTime = 0;
+    _pipelinetimes.received = 0;
+    _pipelinetimes.origin = 0;
+    _pipelinetimes.applied = 0;
 }
 
 AlarmStatusEntry::~AlarmStatusEntry() noexcept
@@ -59,7 +65,8 @@ _severity ( other._severity ),
 _status ( other._status ),
 _triggertime ( other._triggertime ),
 _desktopNotificationSent ( other._desktopNotificationSent ),
-_emailNotificationSent ( other._emailNotificationSent )
+_emailNotificationSent ( other._emailNotificationSent ),
+_pipelinetimes ( other._pipelinetimes )
 {
 
 }
@@ -71,7 +78,8 @@ _severity ( std::move ( other._severity ) ),
 _status ( std::move ( other._status ) ),
 _triggertime ( other._triggertime ),
 _desktopNotificationSent ( other._desktopNotificationSent ),
-_emailNotificationSent ( other._emailNotificationSent )
+_emailNotificationSent ( other._emailNotificationSent ),
+_pipelinetimes ( other._pipelinetimes )
 {
 
 }
@@ -86,6 +94,7 @@ AlarmStatusEntry& AlarmStatusEntry::operator= ( const AlarmStatusEntry& other )
         _triggertime = other._triggertime;
         _desktopNotificationSent = other._desktopNotificationSent;
         _emailNotificationSent = other._emailNotificationSent;
+        _pipelinetimes = other._pipelinetimes;
     }
     return *this;
 }
@@ -100,6 +109,7 @@ AlarmStatusEntry& AlarmStatusEntry::operator= ( AlarmStatusEntry&& other ) noexc
         _triggertime = other._triggertime;
         _desktopNotificationSent = other._desktopNotificationSent;
         _emailNotificationSent = other._emailNotificationSent;
+        _pipelinetimes = other._pipelinetimes;
     }
     return *this;
 }
@@ -146,13 +156,32 @@ void AlarmStatusEntry::setTriggerTime ( const time_t triggertime ) noexcept
 
 void AlarmStatusEntry::update ( const AlarmStatusEntry& newdata ) noexcept
 {
-    if ( _triggertime < newdata._triggertime )
+    // The trigger time only has a resolution of one second, so prefer the reception time if both messages have one
+    const bool newer = ( _pipelinetimes.received != 0 && newdata._pipelinetimes.received != 0 )
+                       ? _pipelinetimes.received < newdata._pipelinetimes.received
+                       : _triggertime < newdata._triggertime;
+    if ( newer )
     {
         _severity = newdata._severity;
         _status = newdata._status;
     }
 }
 
+const AlarmStatusEntry::PipelineTimes& AlarmStatusEntry::getPipelineTimes() const noexcept
+{
+    return _pipelinetimes;
+}
+
+void AlarmStatusEntry::setPipelineTimes ( const AlarmStatusEntry::PipelineTimes& pipelinetimes ) noexcept
+{
+    _pipelinetimes = pipelinetimes;
+}
+
+void AlarmStatusEntry::setAppliedTime ( const int64_t applied ) noexcept
+{
+    _pipelinetimes.applied = applied;
+}
+
 bool AlarmStatusEntry::getDesktopNotificationSent() const noexcept
 {
     return _desktopNotificationSent;
@@ -173,6 +202,49 @@ void AlarmStatusEntry::setEmailNotificationSent ( const bool emailNotificationSe
     _emailNotificationSent = emailNotificationSent;
 }
 
+AlarmStatusEntry::SeverityLevel AlarmStatusEntry::getSeverityLevel() const noexcept
+{
+    return severityLevelFromString ( _severity );
+}
+
+AlarmStatusEntry::SeverityLevel AlarmStatusEntry::severityLevelFromString ( const std::string& severity ) noexcept
+{
+    for ( int level = SeverityOK; level < SeverityUnknown; level++ )
+    {
+        if ( severity == severityLevelToString ( static_cast<SeverityLevel> ( level ) ) )
+            return static_cast<SeverityLevel> ( level );
+    }
+    return SeverityUnknown;
+}
+
+const char* AlarmStatusEntry::severityLevelToString ( const AlarmStatusEntry::SeverityLevel level ) noexcept
+{
+    switch ( level )
+    {
+    case SeverityOK:
+        return "OK";
+    case SeverityMinorAck:
+        return "MINOR_ACK";
+    case SeverityMinor:
+        return "MINOR";
+    case SeverityMajorAck:
+        return "MAJOR_ACK";
+    case SeverityMajor:
+        return "MAJOR";
+    case SeverityInvalidAck:
+        return "INVALID_ACK";
+    case SeverityInvalid:
+        return "INVALID";
+    case SeverityUndefinedAck:
+        return "UNDEFINED_ACK";
+    case SeverityUndefined:
+        return "UNDEFINED";
+    case SeverityUnknown:
+    default:
+        return "UNKNOWN";
+    }
+}
+
 std::ostream& AlarmNotifications::operator<< ( std::ostream& os, const AlarmNotifications::AlarmStatusEntry& ase )
 {
     os << "PV: " << ase.getPVName() << "  Severity: " << ase.getSeverity() << "  Status: " << ase.getStatus() << "  Time: " << ase.getTriggerTime();
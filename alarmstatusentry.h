@@ -36,6 +36,7 @@
 
 #include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
 
+#include <cstdint>
 #include <ctime>
 #include <ostream>
 #include <string>
@@ -50,6 +51,38 @@ namespace AlarmNotifications
  */
 class AlarmStatusEntry final
 {
+public:
+    /**
+     * @brief Severity levels of the CSS Alarm Server
+     *
+     * Numeric representation of the severity strings sent by the CSS Alarm Server. The levels are ordered by their urgency, so an unacknowledged alarm is always greater than the acknowledged alarm of the same EPICS severity. Used wherever severities are stored in binary form, e.g. by AlarmJournal.
+     */
+    enum SeverityLevel
+    {
+        SeverityOK = 0, ///< No alarm
+        SeverityMinorAck = 1, ///< Acknowledged minor alarm
+        SeverityMinor = 2, ///< Minor alarm
+        SeverityMajorAck = 3, ///< Acknowledged major alarm
+        SeverityMajor = 4, ///< Major alarm
+        SeverityInvalidAck = 5, ///< Acknowledged invalid alarm
+        SeverityInvalid = 6, ///< Invalid alarm
+        SeverityUndefinedAck = 7, ///< Acknowledged undefined alarm
+        SeverityUndefined = 8, ///< Undefined alarm
+        SeverityUnknown = 9 ///< Severity string not known to this application
+    };
+    /**
+     * @brief Timestamps of an alarm on its way through the application
+     *
+     * Wall clock times are given in nanoseconds since the Unix epoch, monotonic times in nanoseconds of CLOCK_MONOTONIC (see Metrics::now()). A value of 0 means unknown. Monotonic times are only meaningful within the same run, so entries restored from a snapshot have none.
+     */
+    struct PipelineTimes
+    {
+        int64_t eventTime; ///< Wall clock time of the event according to the alarm server (EVENTTIME)
+        int64_t brokerTime; ///< Wall clock time the message broker accepted the message (JMS timestamp)
+        int64_t received; ///< Monotonic time CMSClient received the message
+        int64_t origin; ///< Monotonic time corresponding to eventTime, or brokerTime if the event time is unknown, but never later than received; the start of the end-to-end latency
+        int64_t applied; ///< Monotonic time the alarm was inserted into the map of active alarms
+    };
 private:
     /**
      * @brief Name of the PV
@@ -87,6 +120,12 @@ private:
      * Indicator to show id an e-mail has already been sent out to avoid double messaging.
      */
     bool _emailNotificationSent;
+    /**
+     * @brief Timestamps of the pipeline stages
+     *
+     * Filled in by CMSClient and AlarmServerConnector, used to measure the latency from the alarm event to the notification.
+     */
+    PipelineTimes _pipelinetimes;
 
 public:
     /**
@@ -197,11 +236,34 @@ public:
     /**
      * @brief Update severity and status data
      * 
-     * The severity and status values are copied from the other instance of AlarmStatusEntry, all other values are left untouched.
+     * The severity and status values are copied from the other instance of AlarmStatusEntry, all other values are left untouched. Nothing is copied if the other instance is not newer, according to the reception time in the PipelineTimes if both instances have one, otherwise according to the trigger time.
      * @param newdata Another instance of AlarmStatusEntry
      * @return Nothing
      */
     void update ( const AlarmStatusEntry& newdata ) noexcept;
+    /**
+     * @brief Query the pipeline timestamps
+     *
+     * Timestamps of the stages this alarm has passed, used for latency measurements.
+     * @return The timestamps, unknown ones are 0
+     */
+    const PipelineTimes& getPipelineTimes() const noexcept;
+    /**
+     * @brief Change the pipeline timestamps
+     *
+     * Used by CMSClient to store the timestamps of the message.
+     * @param pipelinetimes The new timestamps
+     * @return Nothing
+     */
+    void setPipelineTimes ( const PipelineTimes& pipelinetimes ) noexcept;
+    /**
+     * @brief Record the time the alarm has been applied
+     *
+     * Used by AlarmServerConnector when the alarm is inserted into the map of active alarms.
+     * @param applied Monotonic time in nanoseconds
+     * @return Nothing
+     */
+    void setAppliedTime ( const int64_t applied ) noexcept;
     /**
      * @brief Query desktop notification flag
      * 
@@ -232,6 +294,29 @@ public:
      * @return Nothing
      */
     void setEmailNotificationSent ( const bool emailNotificationSent ) noexcept;
+    /**
+     * @brief Query the severity level
+     *
+     * The severity string converted into the numeric SeverityLevel by severityLevelFromString().
+     * @return Severity level of this entry
+     */
+    SeverityLevel getSeverityLevel() const noexcept;
+    /**
+     * @brief Convert severity string to severity level
+     *
+     * Translates a severity string as sent by the CSS Alarm Server, e.g. "MAJOR_ACK", into the corresponding SeverityLevel. Unknown strings result in SeverityUnknown.
+     * @param severity Severity string from the CSS Alarm Server
+     * @return Corresponding severity level
+     */
+    static SeverityLevel severityLevelFromString ( const std::string& severity ) noexcept;
+    /**
+     * @brief Convert severity level to severity string
+     *
+     * Inverse of severityLevelFromString(). For SeverityUnknown, the string "UNKNOWN" is returned.
+     * @param level Severity level
+     * @return Read-only C string with the severity as written by the CSS Alarm Server
+     */
+    static const char* severityLevelToString ( const SeverityLevel level ) noexcept;
 };
 
 /**
@@ -0,0 +1,64 @@
+/**
+ * @file alarmtransition.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief State transition of a single PV
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmtransition.h"
+
+#include <cstdio>
+#include <time.h>
+
+using namespace AlarmNotifications;
+
+std::ostream& AlarmNotifications::operator<< ( std::ostream& os, const AlarmNotifications::AlarmTransition& transition )
+{
+    const time_t seconds = static_cast<time_t> ( transition.wallTime / 1000000000 );
+    tm local;
+    localtime_r ( &seconds, &local );
+    char timestamp[40];
+    const size_t length = strftime ( timestamp, sizeof ( timestamp ), "%Y-%m-%d %H:%M:%S", &local );
+    snprintf ( timestamp + length, sizeof ( timestamp ) - length, ".%03d", static_cast<int> ( ( transition.wallTime % 1000000000 ) / 1000000 ) );
+    const char* type = "";
+    switch ( transition.type )
+    {
+    case AlarmTransition::Raised:
+        type = "RAISED ";
+        break;
+    case AlarmTransition::Updated:
+        type = "UPDATED";
+        break;
+    case AlarmTransition::Cleared:
+        type = "CLEARED";
+        break;
+    }
+    os << timestamp << "  " << type << "  " << transition.pvname << "  Severity: " << AlarmStatusEntry::severityLevelToString ( transition.severity ) << "  Status: " << transition.status;
+    return os;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file alarmtransition.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief State transition of a single PV
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMTRANSITION_H
+#define ALARMTRANSITION_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "alarmstatusentry.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Applied state transition of a PV
+ *
+ * Whenever AlarmServerConnector changes its map of active alarms, the change is described by an instance of this structure and handed to the AlarmJournal. It is a pure data container.
+ */
+struct AlarmTransition
+{
+    /**
+     * @brief Kind of transition
+     *
+     * Describes how the map of active alarms has been changed.
+     */
+    enum TransitionType
+    {
+        Raised = 1, ///< The PV has been inserted into the map of active alarms
+        Updated = 2, ///< Severity or status of an active alarm have changed
+        Cleared = 3 ///< The PV has been removed from the map of active alarms
+    };
+    /**
+     * @brief Kind of transition
+     *
+     * See TransitionType.
+     */
+    TransitionType type;
+    /**
+     * @brief Name of the PV
+     *
+     * As in AlarmStatusEntry::getPVName().
+     */
+    std::string pvname;
+    /**
+     * @brief New severity of the PV
+     *
+     * The severity received from the CSS Alarm Server that caused the transition.
+     */
+    AlarmStatusEntry::SeverityLevel severity;
+    /**
+     * @brief New status of the PV
+     *
+     * As in AlarmStatusEntry::getStatus().
+     */
+    std::string status;
+    /**
+     * @brief Time of the transition
+     *
+     * Nanoseconds on the monotonic clock (CLOCK_MONOTONIC) when the transition was applied. The monotonic clock is not affected by changes of the system time, so the order of the transitions is always preserved.
+     */
+    int64_t monotonicTime;
+    /**
+     * @brief Wall clock time of the transition
+     *
+     * Nanoseconds since the Unix epoch when the transition was applied. The AlarmJournal does not store this value, it is calculated from monotonicTime and the clock offsets stored in the segment when the transitions are read back.
+     */
+    int64_t wallTime;
+};
+
+/**
+ * @brief Stream output operator for AlarmTransition
+ *
+ * Print an instance of AlarmTransition with its wall clock time in local time to any output stream, e.g. by the tools that print the alarm history.
+ * @param os Standard output stream
+ * @param transition An instance of AlarmTransition
+ * @return The supplied output stream
+ */
+std::ostream& operator<< ( std::ostream& os, const AlarmNotifications::AlarmTransition& transition );
+
+}
+
+#endif // ALARMTRANSITION_H
@@ -0,0 +1,202 @@
+/**
+ * @file alarmwireencoding.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Compact binary encoding of alarm changes for the change feed
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "alarmwireencoding.h"
+
+#include <stdexcept>
+
+#include "binaryencoding.h"
+
+using namespace AlarmNotifications;
+
+AlarmWireEncoder::AlarmWireEncoder()
+    : _lasttime ( 0 ),
+      _count ( 0 )
+{
+}
+
+uint64_t AlarmWireEncoder::dictionaryID ( const std::string& text )
+{
+    auto entry = _dictionary.find ( text );
+    if ( entry != _dictionary.end() )
+        return ( *entry ).second;
+    const uint64_t id = _dictionary.size();
+    _dictionary.insert ( std::make_pair ( text, id ) );
+    _payload.push_back ( static_cast<char> ( dictionaryRecord ) );
+    appendVarint ( _payload, id );
+    appendVarint ( _payload, text.length() );
+    _payload.append ( text );
+    return id;
+}
+
+void AlarmWireEncoder::add ( const AlarmTransition& transition )
+{
+    const uint64_t pvid = dictionaryID ( transition.pvname );
+    const uint64_t statusid = dictionaryID ( transition.status );
+    _payload.push_back ( static_cast<char> ( transitionRecord ) );
+    appendSignedVarint ( _payload, transition.wallTime - _lasttime );
+    _lasttime = transition.wallTime;
+    appendVarint ( _payload, pvid );
+    _payload.push_back ( static_cast<char> ( transition.type ) );
+    _payload.push_back ( static_cast<char> ( transition.severity ) );
+    appendVarint ( _payload, statusid );
+    _count++;
+}
+
+void AlarmWireEncoder::finishSnapshot ( std::string& buffer, const int64_t epoch, const uint64_t sequence )
+{
+    std::string header ( 1, static_cast<char> ( snapshotFrame ) );
+    appendVarint ( header, static_cast<uint64_t> ( epoch ) );
+    appendVarint ( header, sequence );
+    appendVarint ( header, _count );
+    appendVarint ( buffer, header.length() + _payload.length() );
+    buffer.append ( header );
+    buffer.append ( _payload );
+    _payload.clear();
+    _count = 0;
+}
+
+void AlarmWireEncoder::finishChanges ( std::string& buffer, const uint64_t firstSequence )
+{
+    std::string header ( 1, static_cast<char> ( changesFrame ) );
+    appendVarint ( header, firstSequence );
+    appendVarint ( header, _count );
+    appendVarint ( buffer, header.length() + _payload.length() );
+    buffer.append ( header );
+    buffer.append ( _payload );
+    _payload.clear();
+    _count = 0;
+}
+
+void AlarmWireEncoder::appendIdle ( std::string& buffer, const int64_t epoch, const uint64_t sequence )
+{
+    std::string payload ( 1, static_cast<char> ( idleFrame ) );
+    appendVarint ( payload, static_cast<uint64_t> ( epoch ) );
+    appendVarint ( payload, sequence );
+    appendVarint ( buffer, payload.length() );
+    buffer.append ( payload );
+}
+
+AlarmWireDecoder::AlarmWireDecoder()
+    : _lasttime ( 0 )
+{
+}
+
+bool AlarmWireDecoder::decode ( const char*& position, const char*const end, AlarmWireDecoder::Frame& frame )
+{
+    const char* start = position;
+    uint64_t length = 0;
+    if ( !readVarint ( start, end, length ) )
+    {
+        if ( end - position >= 10 )
+            throw std::runtime_error ( "Invalid frame length in the binary change feed." );
+        return false;
+    }
+    if ( length > static_cast<uint64_t> ( end - start ) )
+        return false;
+    decodePayload ( start, start + length, frame );
+    position = start + length;
+    return true;
+}
+
+void AlarmWireDecoder::decodePayload ( const char* position, const char*const end, AlarmWireDecoder::Frame& frame )
+{
+    if ( position >= end )
+        throw std::runtime_error ( "Empty frame in the binary change feed." );
+    frame.type = static_cast<AlarmWireEncoder::FrameType> ( *position++ );
+    frame.epoch = 0;
+    frame.sequence = 0;
+    frame.transitions.clear();
+    uint64_t epoch = 0;
+    uint64_t count = 0;
+    bool valid = false;
+    switch ( frame.type )
+    {
+    case AlarmWireEncoder::snapshotFrame:
+        valid = readVarint ( position, end, epoch ) && readVarint ( position, end, frame.sequence ) && readVarint ( position, end, count );
+        break;
+    case AlarmWireEncoder::changesFrame:
+        valid = readVarint ( position, end, frame.sequence ) && readVarint ( position, end, count );
+        break;
+    case AlarmWireEncoder::idleFrame:
+        valid = readVarint ( position, end, epoch ) && readVarint ( position, end, frame.sequence );
+        break;
+    }
+    if ( !valid )
+        throw std::runtime_error ( "Invalid frame header in the binary change feed." );
+    frame.epoch = static_cast<int64_t> ( epoch );
+    while ( valid && position < end )
+    {
+        const uint8_t record = static_cast<uint8_t> ( *position++ );
+        if ( record == AlarmWireEncoder::dictionaryRecord )
+        {
+            uint64_t id = 0;
+            uint64_t length = 0;
+            valid = readVarint ( position, end, id ) && readVarint ( position, end, length )
+                    && id == _dictionary.size() && length <= static_cast<uint64_t> ( end - position );
+            if ( valid )
+            {
+                _dictionary.push_back ( std::string ( position, static_cast<size_t> ( length ) ) );
+                position += length;
+            }
+        }
+        else if ( record == AlarmWireEncoder::transitionRecord )
+        {
+            int64_t delta = 0;
+            uint64_t pvid = 0;
+            uint64_t statusid = 0;
+            valid = readSignedVarint ( position, end, delta ) && readVarint ( position, end, pvid ) && end - position >= 2;
+            if ( !valid )
+                break;
+            const uint8_t type = static_cast<uint8_t> ( *position++ );
+            const uint8_t severity = static_cast<uint8_t> ( *position++ );
+            valid = readVarint ( position, end, statusid ) && pvid < _dictionary.size() && statusid < _dictionary.size()
+                    && type >= AlarmTransition::Raised && type <= AlarmTransition::Cleared && severity <= AlarmStatusEntry::SeverityUnknown;
+            if ( !valid )
+                break;
+            _lasttime += delta;
+            AlarmTransition transition;
+            transition.type = static_cast<AlarmTransition::TransitionType> ( type );
+            transition.pvname = _dictionary[pvid];
+            transition.severity = static_cast<AlarmStatusEntry::SeverityLevel> ( severity );
+            transition.status = _dictionary[statusid];
+            transition.monotonicTime = 0;
+            transition.wallTime = _lasttime;
+            frame.transitions.push_back ( std::move ( transition ) );
+        }
+        else
+            valid = false;
+    }
+    if ( !valid || frame.transitions.size() != count )
+        throw std::runtime_error ( "Invalid record in the binary change feed." );
+}
@@ -0,0 +1,230 @@
+/**
+ * @file alarmwireencoding.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Compact binary encoding of alarm changes for the change feed
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef ALARMWIREENCODING_H
+#define ALARMWIREENCODING_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "alarmtransition.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Compact binary encoding of alarm changes
+ *
+ * Used by AlarmChangeFeed for clients that subscribe with the BINARY option, e.g. control-room displays that must keep up with an alarm storm. A session is a sequence of frames, each consisting of the length of its payload as a variable-length integer (see appendVarint()) followed by the payload. The payload starts with the frame type:
+ *
+ * - snapshotFrame: epoch, sequence number and number of transitions as varints, followed by the records of the active alarms
+ * - changesFrame: sequence number of the first change and number of transitions as varints, followed by the records of the changes, which have consecutive sequence numbers
+ * - idleFrame: epoch and sequence number as varints
+ *
+ * A transition record is the byte transitionRecord, the difference of its wall clock time in nanoseconds to the previous transition record of the session as signed varint, the dictionary ID of the PV name as varint, the type and the severity as one byte each and the dictionary ID of the status as varint. Like in the AlarmJournal, PV names and status strings are sent only once per session in a dictionary record preceding the first transition record using them: The byte dictionaryRecord, the new ID, the length of the string and the string itself. IDs are assigned from 0 upwards in the order of their first use.
+ *
+ * A typical change thus takes about ten bytes instead of the sixty of a text line.
+ */
+class AlarmWireEncoder final
+{
+public:
+    /**
+     * @brief Frame types
+     */
+    enum FrameType
+    {
+        snapshotFrame = 'S', ///< All active alarms
+        changesFrame = 'C', ///< A batch of consecutive changes
+        idleFrame = 'I' ///< Nothing has changed for a while
+    };
+    /**
+     * @brief Record types within a frame
+     */
+    enum RecordType
+    {
+        dictionaryRecord = 1, ///< Assigns an ID to a PV name or status string
+        transitionRecord = 2 ///< An alarm transition
+    };
+private:
+    /**
+     * @brief Dictionary of the session
+     *
+     * Maps PV names and status strings to the IDs the client already knows.
+     */
+    std::unordered_map<std::string, uint64_t> _dictionary;
+    /**
+     * @brief Wall clock time of the previous transition record of the session
+     */
+    int64_t _lasttime;
+    /**
+     * @brief Payload of the current frame
+     */
+    std::string _payload;
+    /**
+     * @brief Number of transition records in the current frame
+     */
+    uint64_t _count;
+
+    /**
+     * @brief Look up or assign the dictionary ID of a string
+     *
+     * A new ID is announced with a dictionary record in the current frame.
+     * @param text PV name or status string
+     * @return The ID
+     */
+    uint64_t dictionaryID ( const std::string& text );
+public:
+    /**
+     * @brief Constructor
+     *
+     * Starts a new session with an empty dictionary.
+     */
+    AlarmWireEncoder();
+    /**
+     * @brief Add a transition to the current frame
+     *
+     * @param transition The transition
+     * @return Nothing
+     */
+    void add ( const AlarmTransition& transition );
+    /**
+     * @brief Finish a snapshot frame
+     *
+     * Appends the frame with all transitions added since the previous frame to the buffer.
+     * @param buffer Buffer the frame is appended to
+     * @param epoch Epoch of the AlarmChangeFeed
+     * @param sequence Sequence number of the snapshot
+     * @return Nothing
+     */
+    void finishSnapshot ( std::string& buffer, const int64_t epoch, const uint64_t sequence );
+    /**
+     * @brief Finish a changes frame
+     *
+     * Appends the frame with all transitions added since the previous frame to the buffer.
+     * @param buffer Buffer the frame is appended to
+     * @param firstSequence Sequence number of the first transition added
+     * @return Nothing
+     */
+    void finishChanges ( std::string& buffer, const uint64_t firstSequence );
+    /**
+     * @brief Append an idle frame
+     *
+     * @param buffer Buffer the frame is appended to
+     * @param epoch Epoch of the AlarmChangeFeed
+     * @param sequence Sequence number of the newest change
+     * @return Nothing
+     */
+    void appendIdle ( std::string& buffer, const int64_t epoch, const uint64_t sequence );
+};
+
+/**
+ * @brief Decoder for the encoding of AlarmWireEncoder
+ *
+ * For C++ clients of the change feed. Keeps the dictionary and time of a session, so one instance has to be used for all frames received on one connection, in order.
+ */
+class AlarmWireDecoder final
+{
+public:
+    /**
+     * @brief A decoded frame
+     */
+    struct Frame
+    {
+        /**
+         * @brief Frame type
+         */
+        AlarmWireEncoder::FrameType type;
+        /**
+         * @brief Epoch, only set for snapshot and idle frames
+         */
+        int64_t epoch;
+        /**
+         * @brief Sequence number
+         *
+         * Of the snapshot, of the first change or of the newest change for an idle frame.
+         */
+        uint64_t sequence;
+        /**
+         * @brief The transitions of the frame
+         *
+         * The monotonic time is not transmitted and set to 0.
+         */
+        std::vector<AlarmTransition> transitions;
+    };
+private:
+    /**
+     * @brief Dictionary of the session, indexed by ID
+     */
+    std::vector<std::string> _dictionary;
+    /**
+     * @brief Wall clock time of the previous transition record of the session
+     */
+    int64_t _lasttime;
+
+    /**
+     * @brief Decode the payload of a frame
+     *
+     * @param position Beginning of the payload
+     * @param end End of the payload
+     * @param frame Receives the frame
+     * @return Nothing
+     * @exception std::runtime_error The payload is malformed
+     */
+    void decodePayload ( const char* position, const char*const end, Frame& frame );
+public:
+    /**
+     * @brief Constructor
+     *
+     * Starts a new session with an empty dictionary.
+     */
+    AlarmWireDecoder();
+    /**
+     * @brief Decode the next frame
+     *
+     * @param position Read position, advanced behind the frame if it is complete
+     * @param end End of the data received so far
+     * @param frame Receives the frame
+     * @return false if the data ends within the frame, the read position is left unchanged then
+     * @exception std::runtime_error The frame is malformed
+     */
+    bool decode ( const char*& position, const char*const end, Frame& frame );
+};
+
+}
+
+#endif // ALARMWIREENCODING_H
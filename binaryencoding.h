@@ -0,0 +1,139 @@
+/**
+ * @file binaryencoding.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Helpers for the compact binary file formats
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef BINARYENCODING_H
+#define BINARYENCODING_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <string>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Append unsigned variable-length integer
+ *
+ * Appends the value to the buffer in the LEB128 encoding: Every byte carries seven bits of the value, starting with the least significant ones, and the most significant bit of a byte is set if another byte follows. Small values, which are by far the most common ones in the binary formats of AlarmNotifications, therefore only need a single byte.
+ * @param buffer Buffer the encoded value is appended to
+ * @param value The value to be encoded
+ * @return Nothing
+ */
+inline void appendVarint ( std::string& buffer, uint64_t value )
+{
+    while ( value >= 0x80 )
+    {
+        buffer.push_back ( static_cast<char> ( ( value & 0x7f ) | 0x80 ) );
+        value >>= 7;
+    }
+    buffer.push_back ( static_cast<char> ( value ) );
+}
+
+/**
+ * @brief Append signed variable-length integer
+ *
+ * The value is zigzag-encoded first, so small negative values are also encoded into few bytes, and then appended by appendVarint().
+ * @param buffer Buffer the encoded value is appended to
+ * @param value The value to be encoded
+ * @return Nothing
+ */
+inline void appendSignedVarint ( std::string& buffer, const int64_t value )
+{
+    appendVarint ( buffer, ( static_cast<uint64_t> ( value ) << 1 ) ^ static_cast<uint64_t> ( value >> 63 ) );
+}
+
+/**
+ * @brief Read unsigned variable-length integer
+ *
+ * Decodes a value written by appendVarint() and advances the read position behind it.
+ * @param position Read position, advanced on success
+ * @param end End of the readable memory
+ * @param value The decoded value
+ * @return False if the memory ends within the value or the value does not fit into 64 bits
+ */
+inline bool readVarint ( const char*& position, const char*const end, uint64_t& value ) noexcept
+{
+    value = 0;
+    for ( unsigned int shift = 0; shift < 64; shift += 7 )
+    {
+        if ( position >= end )
+            return false;
+        const uint8_t byte = static_cast<uint8_t> ( *position++ );
+        value |= static_cast<uint64_t> ( byte & 0x7f ) << shift;
+        if ( ( byte & 0x80 ) == 0 )
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Read signed variable-length integer
+ *
+ * Decodes a value written by appendSignedVarint() and advances the read position behind it.
+ * @param position Read position, advanced on success
+ * @param end End of the readable memory
+ * @param value The decoded value
+ * @return False if the memory ends within the value or the value does not fit into 64 bits
+ */
+inline bool readSignedVarint ( const char*& position, const char*const end, int64_t& value ) noexcept
+{
+    uint64_t raw = 0;
+    if ( !readVarint ( position, end, raw ) )
+        return false;
+    value = static_cast<int64_t> ( raw >> 1 ) ^ -static_cast<int64_t> ( raw & 1 );
+    return true;
+}
+
+/**
+ * @brief Checksum of a memory area
+ *
+ * Calculates the 32 bit FNV-1a hash of the given memory area. It is used to detect damaged or incompletely written data in the binary files, not to protect against deliberate manipulation.
+ * @param data Beginning of the memory area
+ * @param length Size of the memory area in bytes
+ * @return The checksum
+ */
+inline uint32_t checksumFNV1a ( const char* data, const size_t length ) noexcept
+{
+    uint32_t hash = 2166136261u;
+    for ( size_t i = 0; i < length; i++ )
+    {
+        hash ^= static_cast<uint8_t> ( data[i] );
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+}
+
+#endif // BINARYENCODING_H
@@ -0,0 +1,167 @@
+/**
+ * @file clock.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Source of time for AlarmNotifications, replaceable by a simulated clock
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "clock.h"
+
+#include <atomic>
+
+#include <time.h>
+
+using namespace AlarmNotifications;
+
+const unsigned int SimulatedClock::settleTimeout;
+
+// The installed clock, a null pointer selects the SystemClock
+static std::atomic<Clock*> installedClock ( nullptr );
+
+// Set if the thread has been woken by a SimulatedClock and has not called sleepFor() again since
+static __thread bool wokenBySimulatedClock = false;
+
+time_t Clock::wallTime() const noexcept
+{
+    return static_cast<time_t> ( wallNow() / 1000000000 );
+}
+
+Clock& Clock::instance() noexcept
+{
+    static SystemClock systemClock;
+    Clock*const clock = installedClock.load ( std::memory_order_acquire );
+    return clock != nullptr ? *clock : systemClock;
+}
+
+void Clock::setInstance ( Clock* clock ) noexcept
+{
+    installedClock.store ( clock, std::memory_order_release );
+}
+
+int64_t SystemClock::monotonicNow() const noexcept
+{
+    timespec now;
+    clock_gettime ( CLOCK_MONOTONIC, &now );
+    return static_cast<int64_t> ( now.tv_sec ) * 1000000000 + now.tv_nsec;
+}
+
+int64_t SystemClock::wallNow() const noexcept
+{
+    timespec now;
+    clock_gettime ( CLOCK_REALTIME, &now );
+    return static_cast<int64_t> ( now.tv_sec ) * 1000000000 + now.tv_nsec;
+}
+
+void SystemClock::sleepFor ( const int64_t nanoseconds )
+{
+    boost::this_thread::sleep ( boost::posix_time::microseconds ( nanoseconds / 1000 ) );
+}
+
+SimulatedClock::SimulatedClock ( const int64_t wallTime )
+    : _monotonic ( 1000000000 ),
+      _wall ( wallTime ),
+      _waking ( 0 )
+{
+}
+
+int64_t SimulatedClock::monotonicNow() const noexcept
+{
+    return _monotonic.load ( std::memory_order_acquire );
+}
+
+int64_t SimulatedClock::wallNow() const noexcept
+{
+    return _wall.load ( std::memory_order_acquire );
+}
+
+void SimulatedClock::sleepFor ( const int64_t nanoseconds )
+{
+    boost::unique_lock<boost::mutex> concurrencylock ( _mutex );
+    if ( wokenBySimulatedClock )
+    {
+        // Back from the work after the last wake-up
+        wokenBySimulatedClock = false;
+        if ( _waking > 0 )
+            _waking--;
+    }
+    const int64_t deadline = _monotonic + ( nanoseconds > 0 ? nanoseconds : 0 );
+    const std::multiset<int64_t>::iterator entry = _deadlines.insert ( deadline );
+    _settled.notify_all();
+    try
+    {
+        while ( _monotonic < deadline )
+            _advanced.wait ( concurrencylock );
+    }
+    catch ( boost::thread_interrupted& )
+    {
+        _deadlines.erase ( entry );
+        _settled.notify_all();
+        throw;
+    }
+    _deadlines.erase ( entry );
+    _waking++;
+    wokenBySimulatedClock = true;
+    _settled.notify_all();
+}
+
+void SimulatedClock::settle ( boost::unique_lock<boost::mutex>& lock )
+{
+    const boost::system_time timeout = boost::get_system_time() + boost::posix_time::milliseconds ( settleTimeout );
+    while ( _waking > 0 || ( !_deadlines.empty() && *_deadlines.begin() <= _monotonic ) )
+    {
+        if ( !_settled.timed_wait ( lock, timeout ) )
+        {
+            _waking = 0; // The woken threads have left their loops
+            break;
+        }
+    }
+}
+
+void SimulatedClock::advance ( const int64_t nanoseconds )
+{
+    boost::unique_lock<boost::mutex> concurrencylock ( _mutex );
+    const int64_t target = _monotonic + ( nanoseconds > 0 ? nanoseconds : 0 );
+    settle ( concurrencylock );
+    while ( _monotonic < target )
+    {
+        const std::multiset<int64_t>::const_iterator deadline = _deadlines.upper_bound ( _monotonic );
+        const int64_t next = ( deadline == _deadlines.end() || *deadline > target ) ? target : *deadline;
+        _wall.store ( _wall.load ( std::memory_order_relaxed ) + next - _monotonic.load ( std::memory_order_relaxed ), std::memory_order_release );
+        _monotonic.store ( next, std::memory_order_release );
+        _advanced.notify_all();
+        settle ( concurrencylock );
+    }
+}
+
+void SimulatedClock::waitForSleepers ( const size_t count )
+{
+    boost::unique_lock<boost::mutex> concurrencylock ( _mutex );
+    while ( _deadlines.size() < count )
+        _settled.wait ( concurrencylock );
+}
@@ -0,0 +1,258 @@
+/**
+ * @file clock.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Source of time for AlarmNotifications, replaceable by a simulated clock
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <set>
+
+#include <boost/thread.hpp>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Source of time
+ *
+ * The notification timeouts of AlarmServerConnector are minutes long, so testing them against the real clock takes minutes as well. Therefore AlarmServerConnector, AlarmStatusEntry, AlarmStatistics and the watcher threads do not read the system clock or sleep directly, but ask the clock returned by instance(). In production this is a SystemClock, tests and simulations install a SimulatedClock with setInstance() and advance it as fast as they like.
+ *
+ * The latency measurements of Metrics always use the real monotonic clock, as they are about the time the computer needs to process an alarm.
+ */
+class Clock
+{
+public:
+    /**
+     * @brief Destructor
+     */
+    virtual ~Clock() {}
+    /**
+     * @brief Read the monotonic clock
+     *
+     * This method cannot throw exceptions.
+     * @return Nanoseconds on a clock that never jumps
+     */
+    virtual int64_t monotonicNow() const noexcept = 0;
+    /**
+     * @brief Read the wall clock
+     *
+     * This method cannot throw exceptions.
+     * @return Nanoseconds since the Unix epoch
+     */
+    virtual int64_t wallNow() const noexcept = 0;
+    /**
+     * @brief Sleep
+     *
+     * Blocks the calling thread until the monotonic clock has advanced by the given time. This is an interruption point of boost::thread, so a thread sleeping here can be woken up with boost::thread::interrupt(), which throws boost::thread_interrupted in the thread.
+     * @param nanoseconds Time to sleep
+     * @return Nothing
+     * @exception boost::thread_interrupted The thread has been interrupted
+     */
+    virtual void sleepFor ( const int64_t nanoseconds ) = 0;
+    /**
+     * @brief Read the wall clock in seconds
+     *
+     * Replacement for std::time().
+     *
+     * This method cannot throw exceptions.
+     * @return Seconds since the Unix epoch
+     */
+    time_t wallTime() const noexcept;
+    /**
+     * @brief Clock used by AlarmNotifications
+     *
+     * A SystemClock unless another clock has been installed with setInstance().
+     *
+     * This method cannot throw exceptions.
+     * @return The current clock
+     */
+    static Clock& instance() noexcept;
+    /**
+     * @brief Install a clock
+     *
+     * Has to be called before the first AlarmServerConnector is created and the clock must live longer than every object using it.
+     *
+     * This method cannot throw exceptions.
+     * @param clock The clock to be used from now on, a null pointer restores the SystemClock
+     * @return Nothing
+     */
+    static void setInstance ( Clock* clock ) noexcept;
+};
+
+/**
+ * @brief The clocks of the operating system
+ *
+ * Reads CLOCK_MONOTONIC and CLOCK_REALTIME.
+ */
+class SystemClock final : public Clock
+{
+public:
+    /**
+     * @brief Read CLOCK_MONOTONIC
+     * @return Nanoseconds on CLOCK_MONOTONIC
+     */
+    virtual int64_t monotonicNow() const noexcept;
+    /**
+     * @brief Read CLOCK_REALTIME
+     * @return Nanoseconds since the Unix epoch
+     */
+    virtual int64_t wallNow() const noexcept;
+    /**
+     * @brief Sleep
+     *
+     * Uses boost::this_thread::sleep().
+     * @param nanoseconds Time to sleep
+     * @return Nothing
+     * @exception boost::thread_interrupted The thread has been interrupted
+     */
+    virtual void sleepFor ( const int64_t nanoseconds );
+};
+
+/**
+ * @brief Clock for tests and simulations
+ *
+ * Time only passes when advance() is called, and it passes instantly. Threads sleeping in sleepFor() are woken up when their time has come, in the order of their deadlines: advance() moves the clock from one deadline to the next and waits until the threads woken up have done their work and gone back to sleep before it moves on. A test can therefore simulate a whole day with all notification timeouts of AlarmServerConnector, whose watcher threads wake up once per second, within seconds of real time, and the watchers see every second of it.
+ *
+ * A woken thread that does not go back to sleep within settleTimeout milliseconds of real time is assumed to have finished, so a thread leaving its loop does not block advance() forever. The timeout is generous, as the work after a wake-up can take long, e.g. preparing a notification for a million alarms.
+ */
+class SimulatedClock final : public Clock
+{
+private:
+    /**
+     * @brief Maximum time to wait for woken threads
+     *
+     * Milliseconds of real time advance() waits for the woken threads to go back to sleep.
+     */
+    static const unsigned int settleTimeout = 60000;
+    /**
+     * @brief Mutex protecting all members
+     *
+     * Except for reading _monotonic and _wall, so the many threads asking for the time in a benchmark do not wait for each other.
+     */
+    mutable boost::mutex _mutex;
+    /**
+     * @brief Signalled when the clock advances
+     *
+     * Sleeping threads wait on this condition.
+     */
+    boost::condition_variable _advanced;
+    /**
+     * @brief Signalled when a thread falls asleep or wakes up
+     *
+     * advance() and waitForSleepers() wait on this condition.
+     */
+    boost::condition_variable _settled;
+    /**
+     * @brief Current monotonic time
+     *
+     * Nanoseconds, only changed under _mutex.
+     */
+    std::atomic<int64_t> _monotonic;
+    /**
+     * @brief Current wall clock time
+     *
+     * Nanoseconds since the Unix epoch, only changed under _mutex.
+     */
+    std::atomic<int64_t> _wall;
+    /**
+     * @brief Deadlines of the sleeping threads
+     *
+     * Monotonic time each sleeping thread waits for, protected by _mutex.
+     */
+    std::multiset<int64_t> _deadlines;
+    /**
+     * @brief Number of running threads woken by the clock
+     *
+     * Threads whose deadline has passed and which have not called sleepFor() again yet, protected by _mutex.
+     */
+    unsigned int _waking;
+
+    /**
+     * @brief Wait until the woken threads are asleep again
+     *
+     * Waits until no sleeping thread has a deadline that has passed and all woken threads have called sleepFor() again, but not longer than settleTimeout.
+     * @param lock The lock of _mutex held by the caller
+     * @return Nothing
+     */
+    void settle ( boost::unique_lock<boost::mutex>& lock );
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param wallTime Initial wall clock time, nanoseconds since the Unix epoch
+     */
+    explicit SimulatedClock ( const int64_t wallTime );
+    /**
+     * @brief Current simulated monotonic time
+     *
+     * Starts at one second, so it is never zero.
+     * @return Nanoseconds
+     */
+    virtual int64_t monotonicNow() const noexcept;
+    /**
+     * @brief Current simulated wall clock time
+     * @return Nanoseconds since the Unix epoch
+     */
+    virtual int64_t wallNow() const noexcept;
+    /**
+     * @brief Sleep until advance() has moved the clock far enough
+     * @param nanoseconds Time to sleep
+     * @return Nothing
+     * @exception boost::thread_interrupted The thread has been interrupted
+     */
+    virtual void sleepFor ( const int64_t nanoseconds );
+    /**
+     * @brief Let time pass
+     *
+     * Moves the clock forward to each deadline of a sleeping thread within the given time, wakes the thread and waits until it has gone back to sleep, until the given time has passed. Must not be called by a thread sleeping on this clock.
+     * @param nanoseconds Time to pass
+     * @return Nothing
+     */
+    void advance ( const int64_t nanoseconds );
+    /**
+     * @brief Wait for threads to fall asleep
+     *
+     * Used by tests to wait until all threads of the objects under test have reached their loops before the clock is advanced.
+     * @param count Number of sleeping threads to wait for
+     * @return Nothing
+     */
+    void waitForSleepers ( const size_t count );
+};
+
+}
+
+#endif // CLOCK_H
@@ -33,158 +33,120 @@
 
 #include "cmsclient.h"
 
+#include <algorithm>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 #include <stdexcept>
 
-#include <activemq/library/ActiveMQCPP.h>
-#include <cms/Connection.h>
-#include <cms/ConnectionFactory.h>
-#include <cms/Destination.h>
-#include <cms/MapMessage.h>
-#include <cms/MessageConsumer.h>
-#include <cms/Session.h>
-
-#include "alarmconfiguration.h"
+#include "activemqmessagesource.h"
 #include "alarmserverconnector.h"
+#include "alarmservermessage.h"
+#include "clock.h"
+#include "metrics.h"
+#include "tracepoints.h"
 
 using namespace AlarmNotifications;
 
-CMSClient::CMSClient ( AlarmServerConnector& asc )
+CMSClient::CMSClient ( AlarmServerConnector& asc, std::unique_ptr<MessageSource> source, std::unique_ptr<MessageCapture> capture )
     : _asc ( asc ),
-      _connection ( nullptr ),
-      _session ( nullptr ),
-      _topicServer ( nullptr ),
-      _consumerServer ( nullptr )
+      _source ( std::move ( source ) ),
+      _capture ( std::move ( capture ) )
 {
-    try
-    {
-        activemq::library::ActiveMQCPP::initializeLibrary(); // If you don't do this, all calls to ActiveMQ will segfault...
-    }
-    catch ( std::runtime_error& ex )
-    {
-        std::cerr << "Runtime error while initializing ActiveMQCPP library!" << std::endl;
-        std::cerr << ex.what() << std::endl;
-        throw;
-    }
-    try
-    {
-        cms::ConnectionFactory* factory = cms::ConnectionFactory::createCMSConnectionFactory ( AlarmConfiguration::instance().getActiveMQURI() );
-        _connection = factory->createConnection (
-                          AlarmConfiguration::instance().getActiveMQUsername(),
-                          AlarmConfiguration::instance().getActiveMQPassword()
-                      );
-    }
-    catch ( cms::CMSException& ex )
-    {
-        std::cerr << "Cannot create CMS connection!" << std::endl;
-        std::cerr << ex.getMessage() << std::endl;
-        ex.printStackTrace();
-        _connection = nullptr;
-        throw;
-    }
-    _connection->start();
-    _connection->setExceptionListener ( this );
-    try
-    {
-        //Taken one-to-one from the documentation...
-        _session = _connection->createSession ( cms::Session::AUTO_ACKNOWLEDGE );
-        _topicServer = _session->createTopic ( AlarmConfiguration::instance().getActiveMQTopicName() );
-        _consumerServer = _session->createConsumer ( _topicServer );
-        _consumerServer->setMessageListener ( this );
-    }
-    catch ( cms::CMSException& ex )
+    if ( !_source )
+        _source.reset ( new ActiveMQMessageSource() );
+    _source->start ( [this] ( const AlarmServerMessage & message, const int64_t received )
     {
-        std::cerr << "Cannot create CMS session/topic!" << std::endl;
-        std::cerr << ex.getMessage() << std::endl;
-        ex.printStackTrace();
-        if ( _session != nullptr )
-            _session->close();
-        _connection->close(); // Clean things up...
-        delete _consumerServer;
-        delete _topicServer;
-        delete _session;
-        delete _connection;
-        _consumerServer = nullptr;
-        _topicServer = nullptr;
-        _session = nullptr;
-        _connection = nullptr;
-        throw; //... and escalate the exception
-    }
+        receive ( message, received );
+    } );
 }
 
 CMSClient::~CMSClient()
 {
-    // According to the documentation, this calls may result in an excpetion.
-    // As destructors are noexcept in C++11 unless explicitly stated otherwise, this is
-    // a very bad idea and will instantly crash the program.
-    // To avoid this, all the clean-up commands are but in a try-catch block that throws away
-    // any exception (theres no handling that could be done)
-    // And to stop one error from stopping the rest of the cleanup, each command got its own
-    // try-catch block.
-    try
-    {
-        if ( _session != nullptr )
-            _session->close();
-    }
-    catch ( ... ) {}
-    try
-    {
-        if ( _connection != nullptr )
-            _connection->close();
-    }
-    catch ( ... ) {}
-    try
-    {
-        delete _consumerServer;
-    }
-    catch ( ... ) {}
-    try
+    _source->stop();
+}
+
+void CMSClient::receive ( const AlarmServerMessage& message, const int64_t received ) noexcept
+{
+    AN_TRACE1 ( message__receive, received );
+    Metrics::increment ( Metrics::MessagesReceived );
+    if ( _capture )
+        _capture->append ( message, received );
+    processMessage ( message, received );
+}
+
+void CMSClient::inject ( const AlarmServerMessage& message ) noexcept
+{
+    receive ( message, Metrics::now() );
+}
+
+void CMSClient::processMessage ( const AlarmServerMessage& message, const int64_t received ) noexcept
+{
+    // The Alarm Server sends frequent "IDLE" messages to show that it's still there...
+    if ( message.text != "STATE" )
     {
-        delete _topicServer;
+        Metrics::increment ( Metrics::MessagesFiltered );
+        AN_TRACE3 ( message__done, "", received, 1 );
+        return; // ...but we don't have to forward them.
     }
-    catch ( ... ) {}
-    try
+    if ( message.name.empty() || message.severity.empty() || message.status.empty() )
     {
-        delete _session;
+        Metrics::increment ( Metrics::MessagesFiltered );
+        AN_TRACE3 ( message__done, "", received, 1 );
+        return; // Make sure all required keys are present
     }
-    catch ( ... ) {}
-    try
+    // The alarm server uses the pseudo-procotol denomination "epics://" in front of the PV names, so we strip it
+    const std::string name = message.name.compare ( 0, 8, "epics://" ) == 0 ? message.name.substr ( 8 ) : message.name;
+    AlarmStatusEntry ase (
+        name,
+        message.severity,
+        message.status
+    );
+
+    // Collect the timestamps of the message for the latency measurements
+    const int64_t receivedWallTime = Clock::instance().wallNow();
+    AlarmStatusEntry::PipelineTimes times;
+    times.eventTime = message.eventTime.empty() ? 0 : parseEventTime ( message.eventTime );
+    times.brokerTime = message.brokerTime;
+    times.received = received;
+    times.applied = 0;
+    int64_t originWallTime = receivedWallTime;
+    if ( times.eventTime != 0 )
     {
-        delete _connection;
+        Metrics::observe ( Metrics::EventToReceiveLatency, receivedWallTime - times.eventTime );
+        originWallTime = std::min ( originWallTime, times.eventTime );
     }
-    catch ( ... ) {}
-    try
+    if ( times.brokerTime != 0 )
     {
-        activemq::library::ActiveMQCPP::shutdownLibrary(); // Final close down
+        Metrics::observe ( Metrics::BrokerToReceiveLatency, receivedWallTime - times.brokerTime );
+        if ( times.eventTime == 0 )
+            originWallTime = std::min ( originWallTime, times.brokerTime );
     }
-    catch ( ... ) {}
-}
+    times.origin = received - ( receivedWallTime - originWallTime ); // Wall clock offset moved to the monotonic clock
+    ase.setPipelineTimes ( times );
 
-void CMSClient::onMessage ( const cms::Message* message ) noexcept
-{
-    const cms::MapMessage*const mapmessage = dynamic_cast<const cms::MapMessage*> ( message );
-    // There are four message types in CMS, but the CSS Alarm Server uses MapMessage only
-    // If message is not a MapMessage, dynamic_cast will return a nullptr...
-    if ( mapmessage == nullptr )
-        return; // ... and we throw the message away
-    if ( !mapmessage->itemExists ( "TEXT" ) )
-        return;
-    // The Alarm Server sends frequent "IDLE" messages to show that it's still there...
-    if ( mapmessage->getString ( "TEXT" ) != "STATE" )
-        return; // ...but we don't have to forward them.
-    if ( !mapmessage->itemExists ( "NAME" ) || !mapmessage->itemExists ( "SEVERITY" ) || !mapmessage->itemExists ( "STATUS" ) )
-        return; // Make sure all required keys are present
-    std::string rawname = mapmessage->getString ( "NAME" ); // The alarm server uses the pseudo-procotol denomination "epics://" in
-    const std::string name = rawname.replace ( rawname.find ( "epics://" ), 8, "" ); // front of the PV names, so we strip it
-    const AlarmStatusEntry ase (
-        name,
-        mapmessage->getString ( "SEVERITY" ),
-        mapmessage->getString ( "STATUS" )
-    );
     _asc.notifyStatusChange ( ase ); // This message passed filtering, so it's relevant and forwarded to the AlarmServerConnector
+    Metrics::observe ( Metrics::IngestApplyLatency, Metrics::now() - received );
+    AN_TRACE3 ( message__done, name.c_str(), received, 0 );
 }
 
-void CMSClient::onException ( const cms::CMSException& ex ) noexcept
+int64_t CMSClient::parseEventTime ( const std::string& eventtime ) noexcept
 {
-    ex.printStackTrace();
+    tm local;
+    memset ( &local, 0, sizeof ( local ) );
+    const char*const fraction = strptime ( eventtime.c_str(), "%Y-%m-%d %H:%M:%S", &local );
+    if ( fraction == nullptr )
+        return 0;
+    local.tm_isdst = -1; // Let mktime() determine whether daylight saving time applies
+    const time_t seconds = mktime ( &local );
+    if ( seconds == static_cast<time_t> ( -1 ) )
+        return 0;
+    int64_t nanoseconds = 0;
+    if ( *fraction == '.' )
+    {
+        int64_t scale = 100000000;
+        for ( const char* digit = fraction + 1; *digit >= '0' && *digit <= '9' && scale > 0; digit++, scale /= 10 )
+            nanoseconds += ( *digit - '0' ) * scale;
+    }
+    return static_cast<int64_t> ( seconds ) * 1000000000 + nanoseconds;
 }
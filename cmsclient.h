@@ -36,24 +36,13 @@
 
 #include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
 
-#include <cms/CMSException.h>
-#include <cms/ExceptionListener.h>
-#include <cms/MessageListener.h>
+#include <cstdint>
+#include <memory>
+#include <string>
 
-/**
- * 
- * @brief C++ Messaging Service
- * 
- * This namespace is owned by the Apache ActiveMQ C++ library, it is included here just to do some forward declarations.
- */
-namespace cms
-{
-// Forward declarations
-class Connection;
-class Destination;
-class MessageConsumer;
-class Session;
-}
+#include "alarmservermessage.h"
+#include "messagecapture.h"
+#include "messagesource.h"
 
 namespace AlarmNotifications
 {
@@ -61,13 +50,11 @@ namespace AlarmNotifications
 class AlarmServerConnector; // Forward declaration
 
 /**
- * @brief C++ Messaging Service client
- *
- * This class encapsulates the C++ API of the Apache ActiveMQ library. Apache ActiceMQ is an implementation of the Java Messaging Service standard used by the CSS (Control System Studio) Alarm Server. The activemq-cpp library's API is therefore called C++ Messaging Service (CMS).
+ * @brief Client of the CSS Alarm Server
  *
- * This class connects to the Apache ActiveMQ message broker, subscribes to the topic of the CSS alarm server and receives all the messages there. The messages are then parsed, filtered and the relevant ones forwarded to AlarmServerConnector.
+ * Receives the messages of the CSS Alarm Server from a MessageSource, usually the ActiveMQMessageSource connected to the message broker the alarm server publishes to. The messages are then filtered and the relevant ones forwarded to AlarmServerConnector.
  */
-class CMSClient : public cms::MessageListener, public cms::ExceptionListener
+class CMSClient final
 {
 private:
     /**
@@ -77,60 +64,60 @@ private:
      */
     AlarmServerConnector& _asc;
     /**
-     * @brief CMS connection
-     *
-     * Connection to the C++ Messaging Service
-     */
-    cms::Connection* _connection;
-    /**
-     * @brief CMS session
+     * @brief Source of the messages
      *
-     * Session on the C++ Messaging Service
+     * Set by the constructor, stopped by the destructor.
      */
-    cms::Session* _session;
+    std::unique_ptr<MessageSource> _source;
     /**
-     * @brief CMS topic
+     * @brief Capture of the received messages
      *
-     * Topic on the message broker, i.e. "name" of the "chatroom" where the CSS Alarm Server publishes its messages.
+     * Set by the constructor. Null pointer if the messages are not captured.
      */
-    cms::Destination* _topicServer;
+    std::unique_ptr<MessageCapture> _capture;
+
     /**
-     * @brief CMS receiver
+     * @brief Receive a message from the source
      *
-     * Class to receive and parse the messages received from the ActiveMQ message broker
+     * Counts the message, adds it to the capture if enabled and passes it to processMessage().
+     * @param message Content of the message
+     * @param received Monotonic time the message has been received, see Metrics::now()
+     * @return Nothing
      */
-    cms::MessageConsumer* _consumerServer;
-
+    void receive ( const AlarmServerMessage& message, const int64_t received ) noexcept;
     /**
-     * @brief Message listener
+     * @brief Parse the event time sent by the alarm server
      *
-     * This method will be called by the ActiveMQ library if a message is received from the message broker.
-     * @param message CMS message object
-     * @return Nothing
+     * The CSS Alarm Server sends the time of the alarm event in the EVENTTIME field as "YYYY-MM-DD HH:MM:SS.mmm" in its local time zone, which is assumed to be the same as the one of this computer.
+     * @param eventtime The content of the EVENTTIME field
+     * @return Nanoseconds since the Unix epoch, 0 if the string cannot be parsed
      */
-    virtual void onMessage ( const cms::Message* message ) noexcept;
+    static int64_t parseEventTime ( const std::string& eventtime ) noexcept;
     /**
-     * @brief Exception listener
+     * @brief Filter and forward a message
      *
-     * This method will be called by the ActiveMQ library if an exception occurs in the messaging system
-     * @param ex The CMS exception
+     * Common part of receive() and inject(): Throws away all messages except complete "STATE" messages, strips the "epics://" prefix from the PV name, collects the timestamps for the latency measurements and forwards the alarm to AlarmServerConnector.
+     * @param message Content of the message
+     * @param received Monotonic time the message has been received, see Metrics::now()
      * @return Nothing
      */
-    virtual void onException ( const cms::CMSException& ex ) noexcept;
+    void processMessage ( const AlarmServerMessage& message, const int64_t received ) noexcept;
 public:
     /**
      * @brief Constructor
      *
-     * Creates the necessary objects and connects to the Apache ActiveMQ message broker.
+     * Starts the delivery of the messages of the source.
      * @param asc Reference to the AlarmServerConnector instance that should be notified when a relevant message arrives.
+     * @param source Source of the messages. If it is a null pointer, an ActiveMQMessageSource is created which connects to the Apache ActiveMQ message broker.
+     * @param capture Capture all received messages to this MessageCapture, may be a null pointer to disable the capture
      * @exception cms::CMSException Something went wrong within Apache ActiveMQ
      * @exception std::runtime_error Initialization error
      */
-    CMSClient ( AlarmServerConnector& asc );
+    CMSClient ( AlarmServerConnector& asc, std::unique_ptr<MessageSource> source, std::unique_ptr<MessageCapture> capture );
     /**
      * @brief Destructor
      * 
-     * Closes the connection to the message broker and cleans everything up.
+     * Stops the delivery of the messages and destroys the source. The capture is closed afterwards, so it contains every message that has been processed.
      */
     ~CMSClient();
     /**
@@ -163,6 +150,16 @@ public:
      * @return Nothing (deleted)
      */
     CMSClient& operator= ( CMSClient&& other ) = delete;
+    /**
+     * @brief Inject a message
+     *
+     * Processes a message synchronously as if it had been received from the source, including filtering and metrics. Used to feed single messages into the application in the calling thread. Can be called from any thread, also while the source delivers messages.
+     *
+     * This method cannot throw exceptions.
+     * @param message Content of the message
+     * @return Nothing
+     */
+    void inject ( const AlarmServerMessage& message ) noexcept;
 };
 
 }
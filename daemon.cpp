@@ -37,7 +37,9 @@
 #include <iostream>
 #include <QtCore/QDateTime>
 
+#include "alarmconfiguration.h"
 #include "exceptionhandler.h"
+#include "metrics.h"
 
 using namespace AlarmNotifications;
 
@@ -72,6 +74,30 @@ Daemon::Daemon()
     hsigusr2 = signal ( SIGUSR2, &signalReceiver );
     hsigterm = signal ( SIGTERM, &signalReceiver );
     std::cout << QDateTime::currentDateTime().toString ( QString::fromUtf8 ( "dd. MMM yyyy hh:mm:ss" ) ).toStdString() << ": Starting AlarmNotifications daemon..." << std::endl;
+    const std::string metricsEndpoint = AlarmConfiguration::instance().getMetricsEndpoint();
+    if ( !metricsEndpoint.empty() )
+    {
+        try
+        {
+            _metricsserver.reset ( new LocalSocketServer ( metricsEndpoint, &Metrics::serveScrape ) );
+        }
+        catch ( std::exception& e )
+        {
+            ExceptionHandler ( e, "opening the metrics endpoint." ); // The daemon works without it
+        }
+    }
+    const std::string controlSocket = AlarmConfiguration::instance().getControlSocket();
+    if ( !controlSocket.empty() )
+    {
+        try
+        {
+            _control.reset ( new DaemonControl ( controlSocket, _asc ) );
+        }
+        catch ( std::exception& e )
+        {
+            ExceptionHandler ( e, "opening the control socket." ); // The daemon works without it
+        }
+    }
 }
 
 Daemon::~Daemon()
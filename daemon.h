@@ -36,7 +36,11 @@
 
 #include <signal.h>
 
+#include <memory>
+
 #include "alarmserverconnector.h"
+#include "daemoncontrol.h"
+#include "localsocketserver.h"
 
 namespace AlarmNotifications
 {
@@ -105,6 +109,18 @@ private:
      * This is the central instance of the AlarmServerConnector that administrates the connection to BEAST and sends out all the Notifications as configured.
      */
     AlarmServerConnector _asc;
+    /**
+     * @brief Metrics endpoint
+     *
+     * Serves the Metrics of the daemon on the socket configured in the AlarmConfiguration, or a null pointer if no endpoint is configured. Declared after _asc, so it is shut down before the AlarmServerConnector.
+     */
+    std::unique_ptr<LocalSocketServer> _metricsserver;
+    /**
+     * @brief Control socket
+     *
+     * Answers queries and commands on the socket configured in the AlarmConfiguration, or a null pointer if no control socket is configured. Declared after _asc, as it queries the AlarmServerConnector.
+     */
+    std::unique_ptr<DaemonControl> _control;
 
     /**
      * @brief POSIX signal handler
@@ -0,0 +1,243 @@
+/**
+ * @file daemoncontrol.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Control socket of the AlarmNotifications daemon
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "daemoncontrol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fnmatch.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alarmconfiguration.h"
+#include "exceptionhandler.h"
+#include "metrics.h"
+
+using namespace AlarmNotifications;
+
+// Maximum length of a command line
+static const size_t maximumCommandLength = 4096;
+
+// Number of PVs listed by get-stats
+static const size_t noisyPVsReported = 10;
+
+// Separators referenced by the scatter-gather list, which needs stable addresses
+static const char fieldSeparator = '\t';
+static const char lineSeparator = '\n';
+
+// Rejects TCP ports, the control socket must be protected by the file permissions
+static const std::string& checkSocketPath ( const std::string& path )
+{
+    if ( path.empty() || path[0] != '/' )
+        throw std::runtime_error ( "The control socket " + path + " must be given as absolute path of a Unix domain socket." );
+    return path;
+}
+
+// Memory area for the scatter-gather list
+static iovec makeVector ( const void* data, const size_t length ) noexcept
+{
+    iovec vector;
+    vector.iov_base = const_cast<void*> ( data ); // sendmsg() does not write to it
+    vector.iov_len = length;
+    return vector;
+}
+
+DaemonControl::DaemonControl ( const std::string& path, AlarmServerConnector& asc )
+    : _asc ( asc ),
+      _server ( checkSocketPath ( path ), [this] ( int fd )
+{
+    serve ( fd );
+} )
+{
+    if ( chmod ( path.c_str(), S_IRUSR | S_IWUSR ) != 0 ) // reload-config is not for everyone
+        throw std::runtime_error ( "Cannot restrict access to the control socket " + path + ": " + strerror ( errno ) );
+}
+
+void DaemonControl::serve ( const int fd ) noexcept
+{
+    try
+    {
+        std::string received;
+        char buffer[1024];
+        while ( true )
+        {
+            const size_t end = received.find ( '\n' );
+            if ( end != std::string::npos )
+            {
+                std::string command = received.substr ( 0, end );
+                received.erase ( 0, end + 1 );
+                if ( !command.empty() && command[command.length() - 1] == '\r' )
+                    command.erase ( command.length() - 1 );
+                execute ( fd, command );
+                continue;
+            }
+            if ( received.length() > maximumCommandLength )
+                throw std::runtime_error ( "Command on the control socket is too long." );
+            const ssize_t length = recv ( fd, buffer, sizeof ( buffer ), 0 );
+            if ( length <= 0 )
+                return; // Closed by the client or timeout
+            received.append ( buffer, static_cast<size_t> ( length ) );
+        }
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "answering a command on the control socket." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "answering a command on the control socket." );
+    }
+}
+
+void DaemonControl::execute ( const int fd, const std::string& command )
+{
+    std::vector<iovec> reply;
+    if ( command == "list-active" )
+        sendAlarms ( fd, "" );
+    else if ( command.compare ( 0, 17, "query-by-pattern " ) == 0 && command.length() > 17 )
+        sendAlarms ( fd, command.substr ( 17 ) );
+    else if ( command == "get-stats" )
+        sendStatistics ( fd );
+    else if ( command == "reload-config" )
+    {
+        AlarmConfiguration::instance().ReReadConfiguration();
+        static const std::string answer ( "OK\t0\n" );
+        reply.push_back ( makeVector ( answer.data(), answer.length() ) );
+        writeAll ( fd, reply );
+    }
+    else
+    {
+        static const std::string answer ( "ERROR\tExpected list-active, query-by-pattern PATTERN, get-stats or reload-config\n" );
+        reply.push_back ( makeVector ( answer.data(), answer.length() ) );
+        writeAll ( fd, reply );
+    }
+}
+
+void DaemonControl::sendAlarms ( const int fd, const std::string& pattern )
+{
+    // Only the copy is taken under the lock, everything else works on the copy
+    const std::vector<AlarmStatusEntry> alarms = _asc.getActiveAlarms();
+    std::vector<const AlarmStatusEntry*> selected;
+    selected.reserve ( alarms.size() );
+    for ( auto i = alarms.begin(); i != alarms.end(); i++ )
+        if ( pattern.empty() || fnmatch ( pattern.c_str(), ( *i ).getPVName().c_str(), 0 ) == 0 )
+            selected.push_back ( & ( *i ) );
+    // The trigger times are the only fields that have to be formatted, all other fields are written from the entries
+    std::string times;
+    std::vector<size_t> timeOffsets;
+    timeOffsets.reserve ( selected.size() + 1 );
+    for ( auto i = selected.begin(); i != selected.end(); i++ )
+    {
+        timeOffsets.push_back ( times.length() );
+        times.append ( std::to_string ( static_cast<long long> ( ( *i )->getTriggerTime() ) ) );
+    }
+    timeOffsets.push_back ( times.length() );
+    const std::string header ( "OK\t" + std::to_string ( static_cast<unsigned long long> ( selected.size() ) ) + "\n" );
+    std::vector<iovec> reply;
+    reply.reserve ( 1 + 8 * selected.size() );
+    reply.push_back ( makeVector ( header.data(), header.length() ) );
+    for ( size_t i = 0; i < selected.size(); i++ )
+    {
+        const AlarmStatusEntry& alarm = *selected[i];
+        reply.push_back ( makeVector ( alarm.getPVName().data(), alarm.getPVName().length() ) );
+        reply.push_back ( makeVector ( &fieldSeparator, 1 ) );
+        reply.push_back ( makeVector ( alarm.getSeverity().data(), alarm.getSeverity().length() ) );
+        reply.push_back ( makeVector ( &fieldSeparator, 1 ) );
+        reply.push_back ( makeVector ( alarm.getStatus().data(), alarm.getStatus().length() ) );
+        reply.push_back ( makeVector ( &fieldSeparator, 1 ) );
+        reply.push_back ( makeVector ( times.data() + timeOffsets[i], timeOffsets[i + 1] - timeOffsets[i] ) );
+        reply.push_back ( makeVector ( &lineSeparator, 1 ) );
+    }
+    writeAll ( fd, reply );
+}
+
+void DaemonControl::sendStatistics ( const int fd )
+{
+    const AlarmStatistics& statistics = _asc.getStatistics();
+    std::vector<std::pair<std::string, std::string> > values;
+    values.push_back ( std::make_pair ( "active_alarms", std::to_string ( static_cast<unsigned long long> ( _asc.getNumberOfAlarms() ) ) ) );
+    values.push_back ( std::make_pair ( "messages_received", std::to_string ( static_cast<unsigned long long> ( Metrics::total ( Metrics::MessagesReceived ) ) ) ) );
+    values.push_back ( std::make_pair ( "messages_filtered", std::to_string ( static_cast<unsigned long long> ( Metrics::total ( Metrics::MessagesFiltered ) ) ) ) );
+    values.push_back ( std::make_pair ( "messages_deduplicated", std::to_string ( static_cast<unsigned long long> ( Metrics::total ( Metrics::MessagesDeduplicated ) ) ) ) );
+    values.push_back ( std::make_pair ( "messages_skipped", std::to_string ( static_cast<unsigned long long> ( Metrics::total ( Metrics::MessagesSkipped ) ) ) ) );
+    values.push_back ( std::make_pair ( "messages_applied", std::to_string ( static_cast<unsigned long long> ( Metrics::total ( Metrics::MessagesApplied ) ) ) ) );
+    values.push_back ( std::make_pair ( "cleared_alarms", std::to_string ( static_cast<unsigned long long> ( statistics.getClearedAlarms() ) ) ) );
+    values.push_back ( std::make_pair ( "time_to_clear_p50_seconds", std::to_string ( static_cast<unsigned long long> ( statistics.getTimeToClear ( 50 ) ) ) ) );
+    values.push_back ( std::make_pair ( "time_to_clear_p99_seconds", std::to_string ( static_cast<unsigned long long> ( statistics.getTimeToClear ( 99 ) ) ) ) );
+    const std::vector<uint64_t> distinct = statistics.getDistinctAlarmingPVs();
+    if ( !distinct.empty() )
+        values.push_back ( std::make_pair ( "distinct_alarming_pvs_this_hour", std::to_string ( static_cast<unsigned long long> ( distinct.front() ) ) ) );
+    const std::vector<AlarmStatistics::NoisyPV> noisy = statistics.getNoisiestPVs ( noisyPVsReported );
+    for ( auto i = noisy.begin(); i != noisy.end(); i++ )
+        values.push_back ( std::make_pair ( "noisy_pv\t" + ( *i ).pvname, std::to_string ( static_cast<unsigned long long> ( ( *i ).alarms ) ) ) );
+    std::ostringstream text;
+    text << "OK\t" << values.size() << "\n";
+    for ( auto i = values.begin(); i != values.end(); i++ )
+        text << ( *i ).first << "\t" << ( *i ).second << "\n";
+    const std::string answer = text.str();
+    std::vector<iovec> reply ( 1, makeVector ( answer.data(), answer.length() ) );
+    writeAll ( fd, reply );
+}
+
+void DaemonControl::writeAll ( const int fd, std::vector<iovec>& vectors )
+{
+    size_t first = 0;
+    while ( first < vectors.size() )
+    {
+        msghdr message;
+        memset ( &message, 0, sizeof ( message ) );
+        message.msg_iov = &vectors[first];
+        message.msg_iovlen = std::min<size_t> ( vectors.size() - first, IOV_MAX );
+        // A client that has disconnected must not kill the daemon with SIGPIPE
+        const ssize_t result = sendmsg ( fd, &message, MSG_NOSIGNAL );
+        if ( result < 0 && errno == EINTR )
+            continue;
+        if ( result <= 0 )
+            throw std::runtime_error ( std::string ( "Cannot write to the control socket: " ) + strerror ( errno ) );
+        // Skip the areas written completely and shorten the first one written partially
+        size_t written = static_cast<size_t> ( result );
+        while ( first < vectors.size() && written >= vectors[first].iov_len )
+            written -= vectors[first++].iov_len;
+        if ( written > 0 )
+        {
+            vectors[first].iov_base = static_cast<char*> ( vectors[first].iov_base ) + written;
+            vectors[first].iov_len -= written;
+        }
+    }
+}
@@ -0,0 +1,149 @@
+/**
+ * @file daemoncontrol.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Control socket of the AlarmNotifications daemon
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef DAEMONCONTROL_H
+#define DAEMONCONTROL_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "alarmserverconnector.h"
+#include "localsocketserver.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Control socket of the AlarmNotifications daemon
+ *
+ * Answers queries and commands on a Unix domain socket that is only accessible to the user running an-daemon. The client sends one command per line:
+ *
+ * - list-active: All active alarms
+ * - query-by-pattern PATTERN: The active alarms whose PV name matches the shell wildcard pattern, e.g. "HV:*"
+ * - get-stats: Counters and statistics as name and value, the noisiest PVs as "noisy_pv <PV name> <alarms>"
+ * - reload-config: Reread the configuration file
+ *
+ * Each reply starts with the line "OK <count>", followed by count lines with tab-separated fields, or is the single line "ERROR <message>". An active alarm is listed as "<PV name> <severity> <status> <trigger time>", the trigger time in seconds since the Unix epoch.
+ *
+ * The alarms are copied by AlarmServerConnector::getActiveAlarms() under its lock, which is released before the reply is written. The reply is then written with sendmsg() directly from the copied entries, so neither formatting nor a slow client delays the reception of alarm messages. Connections are served one after the other in the thread of the LocalSocketServer.
+ */
+class DaemonControl final
+{
+private:
+    /**
+     * @brief The connector whose alarms are queried
+     */
+    AlarmServerConnector& _asc;
+    /**
+     * @brief Server accepting the connections
+     */
+    LocalSocketServer _server;
+
+    /**
+     * @brief Serve a connection
+     *
+     * Handler of the LocalSocketServer. Answers commands until the client closes the connection or does not send a command within LocalSocketServer::connectionTimeout seconds.
+     * @param fd The accepted connection
+     * @return Nothing
+     */
+    void serve ( const int fd ) noexcept;
+    /**
+     * @brief Answer a single command
+     *
+     * @param fd The connection
+     * @param command The command line without line feed
+     * @return Nothing
+     * @exception std::runtime_error The client has disconnected
+     */
+    void execute ( const int fd, const std::string& command );
+    /**
+     * @brief Send active alarms
+     *
+     * @param fd The connection
+     * @param pattern Shell wildcard pattern for the PV names, empty for all alarms
+     * @return Nothing
+     * @exception std::runtime_error The client has disconnected
+     */
+    void sendAlarms ( const int fd, const std::string& pattern );
+    /**
+     * @brief Send counters and statistics
+     *
+     * @param fd The connection
+     * @return Nothing
+     * @exception std::runtime_error The client has disconnected
+     */
+    void sendStatistics ( const int fd );
+    /**
+     * @brief Write a scatter-gather list completely
+     *
+     * Calls sendmsg() with MSG_NOSIGNAL as often as necessary, at most IOV_MAX elements at a time, so a client disconnecting early does not raise SIGPIPE.
+     * @param fd The connection
+     * @param vectors Memory areas to be written in this order, changed by this method
+     * @return Nothing
+     * @exception std::runtime_error The client has disconnected or not accepted the data within LocalSocketServer::connectionTimeout seconds
+     */
+    static void writeAll ( const int fd, std::vector<iovec>& vectors );
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates the socket and restricts it to the user running the daemon.
+     * @param path Absolute path of the Unix domain socket
+     * @param asc The connector whose alarms are queried, must outlive this instance
+     * @exception std::runtime_error The path is not absolute or the socket cannot be created
+     */
+    DaemonControl ( const std::string& path, AlarmServerConnector& asc );
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of DaemonControl
+     */
+    DaemonControl ( const DaemonControl& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of DaemonControl
+     * @return Nothing (deleted)
+     */
+    DaemonControl& operator= ( const DaemonControl& other ) = delete;
+};
+
+}
+
+#endif // DAEMONCONTROL_H
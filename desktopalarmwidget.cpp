@@ -34,6 +34,9 @@
 #include "desktopalarmwidget.h"
 
 #include <limits>
+#include <string>
+
+#include <unistd.h>
 
 #include <QApplication>
 #include <QIcon>
@@ -44,6 +47,8 @@
 #include "alarmconfiguration.h"
 #include "alarmserverconnector.h"
 #include "beedo.h"
+#include "exceptionhandler.h"
+#include "metrics.h"
 #include "oldgcccompat.h"
 
 using namespace AlarmNotifications;
@@ -58,12 +63,26 @@ DesktopAlarmWidget::DesktopAlarmWidget ( const bool activateBeedo )
         Beedo::instance(); // Initialize Beedo instance from main thread
     _asc = new AlarmServerConnector ( true, _activateBeedo );
     _iconThread = QtConcurrent::run ( this, &DesktopAlarmWidget::observeAlarmStatus );
+    const std::string metricsDirectory = AlarmConfiguration::instance().getDesktopMetricsDirectory();
+    if ( !metricsDirectory.empty() )
+    {
+        try
+        {
+            // The configuration is shared by all users, so each one gets its own socket
+            _metricsserver.reset ( new LocalSocketServer ( metricsDirectory + "/an-desktop-" + std::to_string ( static_cast<unsigned long long> ( getuid() ) ) + ".sock", &Metrics::serveScrape ) );
+        }
+        catch ( std::exception& e )
+        {
+            ExceptionHandler ( e, "opening the metrics endpoint of the desktop widget." ); // The widget works without it
+        }
+    }
     connect ( this, SIGNAL ( alarmStatusChanged() ), this, SLOT ( changeTrayIcon() ) );
     connect ( this, SIGNAL ( notificationSwitchChanged ( bool ) ), this, SLOT ( notificationSwitchChange ( bool ) ) );
 }
 
 DesktopAlarmWidget::~DesktopAlarmWidget()
 {
+    _metricsserver.reset();
     _run = false;
     _iconThread.waitForFinished();
     delete _asc; // Do not need to check for nullptr, deleting nullptr is always safe in C++
@@ -90,7 +109,7 @@ DesktopAlarmWidget::DesktopAlarmWidgetStatus DesktopAlarmWidget::getStatus() con
 
 void DesktopAlarmWidget::toggleNotifications()
 {
-    boost::lock_guard<boost::mutex> concurrency_lock ( _ascmutex );
+    InstrumentedMutex::ScopedLock concurrency_lock ( _ascmutex, Metrics::ToggleNotificationsLockWait, Metrics::ToggleNotificationsLockHold );
     if ( _asc == nullptr )
     {
         _asc = new AlarmServerConnector ( true, _activateBeedo );
@@ -133,7 +152,7 @@ void DesktopAlarmWidget::showStatusMessage ( )
     QString messagetitle = QString::fromUtf8 ( "Alarm notifications desktop widget" );
     unsigned short messagetype; // 0 = info, 1 = warning, 2 = critical
     {
-        boost::lock_guard<boost::mutex> concurrency_lock ( _ascmutex );
+        InstrumentedMutex::ScopedLock concurrency_lock ( _ascmutex, Metrics::ShowStatusMessageLockWait, Metrics::ShowStatusMessageLockHold );
         if ( _asc == nullptr )
         {
             messagetype = 1;
@@ -189,7 +208,7 @@ void DesktopAlarmWidget::observeAlarmStatus()
     while ( _run )
     {
         {
-            boost::lock_guard<boost::mutex> concurrency_lock ( _ascmutex );
+            InstrumentedMutex::ScopedLock concurrency_lock ( _ascmutex, Metrics::ObserveAlarmStatusLockWait, Metrics::ObserveAlarmStatusLockHold );
             if ( _asc != nullptr )
             {
                 if ( _alarmActive && _asc->getNumberOfAlarms() == 0 )
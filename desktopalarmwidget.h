@@ -39,6 +39,11 @@
 #include <QSystemTrayIcon>
 #include <QWidget>
 
+#include <memory>
+
+#include "instrumentedmutex.h"
+#include "localsocketserver.h"
+
 #ifndef DESKTOPALARMWIDGET_H
 #define DESKTOPALARMWIDGET_H
 
@@ -124,8 +129,16 @@ private:
      * @brief Protect access to the _asc pointer
      *
      * Because the _asc pointer will be changed and set to nullptr in this multi-threaded class, a mutex must be used to protect access to the _asc pointer.
+     *
+     * Each method locking it records its wait and hold times in its own Metrics histograms, so stalls of the GUI thread show up in the metrics.
+     */
+    InstrumentedMutex _ascmutex;
+    /**
+     * @brief Metrics endpoint
+     *
+     * Serves the Metrics of this widget, including the lock profile of _ascmutex, on a Unix domain socket in the directory configured in the AlarmConfiguration, or a null pointer if no directory is configured.
      */
-    boost::mutex _ascmutex;
+    std::unique_ptr<LocalSocketServer> _metricsserver;
 
     /**
      * @brief Abstract context menu method
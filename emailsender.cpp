@@ -38,9 +38,11 @@
 #include <string>
 
 #include "alarmconfiguration.h"
+#include "metrics.h"
 #include "mimemessage.h"
 #include "mimetext.h"
 #include "smtpclient.h"
+#include "stormdetector.h"
 
 using namespace AlarmNotifications;
 
@@ -50,19 +52,27 @@ EMailSender& EMailSender::instance() noexcept
     return global_instance;
 }
 
-void EMailSender::sendAlarmNotification ( const std::vector< AlarmStatusEntry > alarms ) noexcept
+bool EMailSender::sendAlarmNotification ( const std::vector< AlarmStatusEntry > alarms, const bool summarise ) noexcept
 {
+    const int64_t started = Metrics::now();
     try {
-        instance().sendAlarmNotification_internal ( std::move ( alarms ) );
+        instance().sendAlarmNotification_internal ( std::move ( alarms ), summarise );
+        Metrics::increment ( Metrics::EMailNotificationsSent );
+        Metrics::observe ( Metrics::SMTPLatency, Metrics::now() - started );
+        return true;
     }
     catch ( std::exception& e )
     {
+        Metrics::increment ( Metrics::EMailNotificationsFailed );
         std::cerr << "Exception in e-mail sending procedure: " << e.what() << std::endl;
     }
     catch ( ... )
     {
+        Metrics::increment ( Metrics::EMailNotificationsFailed );
         std::cerr << "Unknown error in e-mail sending procedure: " << std::endl;
     }
+    Metrics::observe ( Metrics::SMTPLatency, Metrics::now() - started );
+    return false;
 }
 
 EMailSender::EMailSender()
@@ -75,7 +85,7 @@ EMailSender::~EMailSender()
 
 }
 
-void EMailSender::sendAlarmNotification_internal ( const std::vector< AlarmStatusEntry > alarms )
+void EMailSender::sendAlarmNotification_internal ( const std::vector< AlarmStatusEntry > alarms, const bool summarise )
 {
     SmtpClient smtp (
         QString::fromUtf8 ( AlarmConfiguration::instance().getEMailNotificationServerName().c_str() ),
@@ -97,7 +107,7 @@ void EMailSender::sendAlarmNotification_internal ( const std::vector< AlarmStatu
     MimeText text;
     text.setEncoding(MimePart::QuotedPrintable);
     text.setCharset(QString::fromUtf8("utf8"));
-    text.setText ( composeMessageText ( alarms ) );
+    text.setText ( composeMessageText ( alarms, summarise ) );
     email.addPart ( &text );
 
     std::cout << "Sending alarm notification by e-mail!" << std::endl;
@@ -120,13 +130,21 @@ void EMailSender::sendAlarmNotification_internal ( const std::vector< AlarmStatu
     smtp.quit();
 }
 
-QString EMailSender::composeMessageText ( const std::vector< AlarmStatusEntry >& alarms )
+QString EMailSender::composeMessageText ( const std::vector< AlarmStatusEntry >& alarms, const bool summarise )
 {
     QString text;
-    text += QString::fromUtf8 ( "Hello,\n\nthe following PV(s) triggered an alarm:\n\n" );
-    for ( auto i = alarms.begin(); i != alarms.end(); i++ )
+    if ( summarise )
     {
-        text+= QString::fromUtf8 ( ( *i ).getPVName().c_str() ) + QString::fromUtf8 ( "\n" );
+        text += QString::fromUtf8 ( "Hello,\n\n" );
+        text += QString::fromUtf8 ( StormDetector::summarise ( alarms ).c_str() ); // Lists the areas, not the PVs
+    }
+    else
+    {
+        text += QString::fromUtf8 ( "Hello,\n\nthe following PV(s) triggered an alarm:\n\n" );
+        for ( auto i = alarms.begin(); i != alarms.end(); i++ )
+        {
+            text+= QString::fromUtf8 ( ( *i ).getPVName().c_str() ) + QString::fromUtf8 ( "\n" );
+        }
     }
     text += QString::fromUtf8 ( "\nPlease remember to acknowledge the alarms if you go solving the problem.\n\n\nYour Alarm Notification Service\n" );
     return text;
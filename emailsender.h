@@ -68,17 +68,19 @@ private:
      *
      * This method is invoked by sendAlarmNotification() and does the actual work. It reads the necessary configuration parameters, creates a connection to the SMTP server, assembles the e-mail message and sends it.
      * @param alarms Alarms to be listed in the e-mail
+     * @param summarise true to summarise the alarms by area instead of listing them
      * @return Nothing
      */
-    void sendAlarmNotification_internal ( const std::vector< AlarmStatusEntry > alarms );
+    void sendAlarmNotification_internal ( const std::vector< AlarmStatusEntry > alarms, const bool summarise );
     /**
      * @brief Compose message text
      *
-     * This method creates the text to be put into the body of the alarm notification e-mail.
+     * This method creates the text to be put into the body of the alarm notification e-mail. During an alarm storm, the PV names are replaced by the number of alarms per area, see StormDetector::summarise().
      * @param alarms Alarm to be listed in the e-mail
+     * @param summarise true to summarise the alarms by area instead of listing them
      * @return Message body text as QString
      */
-    QString composeMessageText ( const std::vector< AlarmStatusEntry >& alarms );
+    QString composeMessageText ( const std::vector< AlarmStatusEntry >& alarms, const bool summarise );
 public:
     /**
      * @brief Get singleton instance
@@ -128,9 +130,10 @@ public:
      *
      * This static method gets a reference to the global instance of EMailSender and invokes sendAlarmNotification_internal() to send an e-mail to tell the staff about the alarms.
      * @param alarms Alarms to be listed in the e-mail
-     * @return Nothing
+     * @param summarise true during an alarm storm, to summarise the alarms by area instead of listing them
+     * @return True if the e-mail has been accepted by the SMTP server
      */
-    static void sendAlarmNotification ( const std::vector<AlarmStatusEntry> alarms ) noexcept;
+    static bool sendAlarmNotification ( const std::vector<AlarmStatusEntry> alarms, const bool summarise ) noexcept;
 };
 
 }
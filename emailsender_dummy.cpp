@@ -40,9 +40,11 @@
 
 using namespace AlarmNotifications;
 
-void EMailSender::sendAlarmNotification ( const std::vector< AlarmStatusEntry > alarms ) noexcept
+bool EMailSender::sendAlarmNotification ( const std::vector< AlarmStatusEntry > alarms, const bool summarise ) noexcept
 {
     ( void ) alarms;
+    ( void ) summarise;
+    return false; // Nothing has been sent
 }
 
 #endif
@@ -38,6 +38,8 @@
 
 #include "alarmconfiguration.h"
 #include "exceptionhandler.h"
+#include "metrics.h"
+#include "tracepoints.h"
 
 using namespace AlarmNotifications;
 
@@ -61,38 +63,55 @@ FlashLight::~FlashLight()
         closeSerialInterface();
 }
 
-void FlashLight::switchOn() noexcept
+bool FlashLight::switchOn() noexcept
 {
-    try{
+    const int64_t started = Metrics::now();
+    try {
         FlashLight::instance().switchInternal ( true );
+        Metrics::increment ( Metrics::FlashLightSwitches );
+        Metrics::observe ( Metrics::FlashLightLatency, Metrics::now() - started );
+        return true;
     }
     catch ( std::exception& e )
     {
+        Metrics::increment ( Metrics::FlashLightFailures );
         ExceptionHandler ( e, "switching on the flash light." );
     }
     catch ( ... )
     {
+        Metrics::increment ( Metrics::FlashLightFailures );
         ExceptionHandler ( "switching on the flash light." );
     }
+    Metrics::observe ( Metrics::FlashLightLatency, Metrics::now() - started );
+    return false;
 }
 
-void FlashLight::switchOff() noexcept
+bool FlashLight::switchOff() noexcept
 {
+    const int64_t started = Metrics::now();
     try {
         FlashLight::instance().switchInternal ( false );
+        Metrics::increment ( Metrics::FlashLightSwitches );
+        Metrics::observe ( Metrics::FlashLightLatency, Metrics::now() - started );
+        return true;
     }
     catch ( std::exception& e )
     {
+        Metrics::increment ( Metrics::FlashLightFailures );
         ExceptionHandler ( e, "switching off the flash light." );
     }
     catch ( ... )
     {
+        Metrics::increment ( Metrics::FlashLightFailures );
         ExceptionHandler ( "switching off the flash light." );
     }
+    Metrics::observe ( Metrics::FlashLightLatency, Metrics::now() - started );
+    return false;
 }
 
 void FlashLight::switchInternal ( const bool lightSwitch )
 {
+    AN_TRACE1 ( flashlight__switch, lightSwitch ? 1 : 0 );
     const deviceCommand command = createCommand ( lightSwitch );
     boost::lock_guard<boost::mutex> concurrencylock ( _serialLineMutex );
 
@@ -100,6 +119,7 @@ void FlashLight::switchInternal ( const bool lightSwitch )
     configureSerialInterface();
     writeSerialInteface ( command );
     closeSerialInterface();
+    AN_TRACE1 ( flashlight__switched, lightSwitch ? 1 : 0 ); // Not reached if the relais could not be switched
 }
 
 FlashLight::deviceCommand FlashLight::createCommand ( const bool lightSwitch )
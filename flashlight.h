@@ -169,18 +169,18 @@ public:
      * This will order the USB relais to switch on the alarm light.
      *
      * This method cannot throw exceptions.
-     * @return Nothing
+     * @return True if the command has been sent to the relais, false if an error occured
      */
-    static void switchOn() noexcept;
+    static bool switchOn() noexcept;
     /**
      * @brief Switch off red alarm flash light
      *
      * This will order the USB relais to switch off the alarm light.
      *
      * This method cannot throw exceptions.
-     * @return Nothing
+     * @return True if the command has been sent to the relais, false if an error occured
      */
-    static void switchOff() noexcept;
+    static bool switchOff() noexcept;
     /**
      * @brief Copy constructor (deleted)
      *
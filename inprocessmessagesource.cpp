@@ -0,0 +1,176 @@
+/**
+ * @file inprocessmessagesource.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Lock-free in-process queue of alarm server messages
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "inprocessmessagesource.h"
+
+#include <stdexcept>
+#include <utility>
+#include <unistd.h>
+
+#include "exceptionhandler.h"
+#include "metrics.h"
+
+using namespace AlarmNotifications;
+
+InProcessMessageSource::InProcessMessageSource ( const size_t capacity )
+    : _cells(),
+      _mask ( capacity - 1 ),
+      _enqueuePosition ( 0 ),
+      _dequeuePosition ( 0 ),
+      _pushed ( 0 ),
+      _delivered ( 0 ),
+      _run ( false )
+{
+    if ( capacity < 2 || ( capacity & ( capacity - 1 ) ) != 0 )
+        throw std::invalid_argument ( "The capacity of the in-process message queue must be a power of two!" );
+    _cells.reset ( new Cell[capacity] );
+    for ( size_t i = 0; i < capacity; i++ )
+        _cells[i].sequence.store ( i, std::memory_order_relaxed );
+}
+
+InProcessMessageSource::~InProcessMessageSource()
+{
+    stop();
+}
+
+void InProcessMessageSource::start ( const MessageSource::Receiver& receiver )
+{
+    if ( _run )
+        throw std::runtime_error ( "The in-process message source has already been started!" );
+    _receiver = receiver;
+    _run = true;
+    _deliveryThread = boost::thread ( &InProcessMessageSource::deliver, this );
+}
+
+void InProcessMessageSource::stop() noexcept
+{
+    _run = false;
+    if ( _deliveryThread.joinable() )
+        _deliveryThread.join();
+}
+
+bool InProcessMessageSource::tryPush ( const AlarmServerMessage& message ) noexcept
+{
+    size_t position = _enqueuePosition.load ( std::memory_order_relaxed );
+    Cell* cell;
+    for ( ;; )
+    {
+        cell = &_cells[position & _mask];
+        const size_t sequence = cell->sequence.load ( std::memory_order_acquire );
+        const intptr_t difference = static_cast<intptr_t> ( sequence ) - static_cast<intptr_t> ( position );
+        if ( difference == 0 )
+        {
+            // The cell is free, try to claim it
+            if ( _enqueuePosition.compare_exchange_weak ( position, position + 1, std::memory_order_relaxed ) )
+                break;
+            // Another producer was faster, position has been reloaded by compare_exchange_weak()
+        }
+        else if ( difference < 0 )
+            return false; // The consumer has not freed the cell yet: The queue is full
+        else
+            position = _enqueuePosition.load ( std::memory_order_relaxed ); // Another producer has claimed the cell
+    }
+    try
+    {
+        cell->message = message;
+    }
+    catch ( std::exception& e )
+    {
+        // Out of memory while copying the strings: The cell must be published anyway, otherwise the queue is stuck
+        cell->message = AlarmServerMessage();
+        ExceptionHandler ( e, "copying a message into the in-process message queue." );
+    }
+    cell->sequence.store ( position + 1, std::memory_order_release );
+    _pushed.fetch_add ( 1, std::memory_order_release );
+    return true;
+}
+
+bool InProcessMessageSource::push ( const AlarmServerMessage& message ) noexcept
+{
+    unsigned int attempts = 0;
+    while ( !tryPush ( message ) )
+    {
+        if ( !_run )
+            return false;
+        if ( ++attempts < 64 )
+            continue;
+        boost::this_thread::yield();
+    }
+    return true;
+}
+
+bool InProcessMessageSource::tryPop ( AlarmServerMessage& message ) noexcept
+{
+    const size_t position = _dequeuePosition.load ( std::memory_order_relaxed );
+    Cell& cell = _cells[position & _mask];
+    const size_t sequence = cell.sequence.load ( std::memory_order_acquire );
+    if ( sequence != position + 1 )
+        return false; // Not filled yet
+    // Only the delivery thread dequeues, so no compare-and-swap is necessary. Swapping avoids copying the strings.
+    message = AlarmServerMessage();
+    std::swap ( message, cell.message );
+    _dequeuePosition.store ( position + 1, std::memory_order_relaxed );
+    // Free the cell for the producers of the next round
+    cell.sequence.store ( position + _mask + 1, std::memory_order_release );
+    return true;
+}
+
+void InProcessMessageSource::deliver() noexcept
+{
+    AlarmServerMessage message;
+    unsigned int idle = 0;
+    while ( _run )
+    {
+        if ( !tryPop ( message ) )
+        {
+            idle++;
+            if ( idle < 256 )
+                continue;
+            else if ( idle < 512 )
+                boost::this_thread::yield();
+            else
+                usleep ( 100 );
+            continue;
+        }
+        idle = 0;
+        _receiver ( message, Metrics::now() );
+        _delivered.fetch_add ( 1, std::memory_order_release );
+    }
+}
+
+void InProcessMessageSource::waitUntilDelivered() const noexcept
+{
+    const uint64_t target = _pushed.load ( std::memory_order_acquire );
+    while ( _run && _delivered.load ( std::memory_order_acquire ) < target )
+        usleep ( 100 );
+}
@@ -0,0 +1,251 @@
+/**
+ * @file inprocessmessagesource.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Lock-free in-process queue of alarm server messages
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef INPROCESSMESSAGESOURCE_H
+#define INPROCESSMESSAGESOURCE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <boost/thread.hpp>
+
+#include "messagesource.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Messages handed over within the process
+ *
+ * This class replaces the Apache ActiveMQ message broker for tests and benchmarks: Any number of threads push AlarmServerMessage instances into a bounded lock-free queue, a single delivery thread pops them and passes them to the receiver, just like the ActiveMQ library delivers the messages of the broker from its own thread. This way, AlarmServerConnector can be driven deterministically and as fast as possible without a broker, its network latency and its serialization.
+ *
+ * The queue is the bounded multi-producer queue of Dmitry Vyukov: Each cell carries a sequence number that tells producers and the consumer whether the cell is free or filled for their current position, so a push costs one compare-and-swap on the enqueue position and no lock is taken. The enqueue and dequeue positions are on separate cache lines so producers and the consumer do not invalidate each other's line on every message.
+ */
+class InProcessMessageSource final : public MessageSource
+{
+private:
+    /**
+     * @brief Cell of the queue
+     */
+    struct Cell
+    {
+        /**
+         * @brief Sequence number of the cell
+         *
+         * Equal to the enqueue position if the cell is free, equal to the position plus one if it holds a message for the consumer.
+         */
+        std::atomic<size_t> sequence;
+        /**
+         * @brief The message stored in this cell
+         */
+        AlarmServerMessage message;
+    };
+    /**
+     * @brief Size of a cache line
+     *
+     * Used to pad the positions of the queue.
+     */
+    static const size_t cacheLineSize = 64;
+
+    /**
+     * @brief Cells of the queue
+     *
+     * Allocated by the constructor.
+     */
+    std::unique_ptr<Cell[]> _cells;
+    /**
+     * @brief Mask to turn a position into a cell index
+     *
+     * The capacity is a power of two, so this is the capacity minus one.
+     */
+    const size_t _mask;
+    /**
+     * @brief Padding
+     *
+     * Keeps _enqueuePosition off the cache line of the members above.
+     */
+    char _padding0[cacheLineSize];
+    /**
+     * @brief Next position to write to
+     *
+     * Shared by all producers.
+     */
+    std::atomic<size_t> _enqueuePosition;
+    /**
+     * @brief Padding
+     *
+     * Keeps _enqueuePosition and _dequeuePosition on separate cache lines.
+     */
+    char _padding1[cacheLineSize - sizeof ( std::atomic<size_t> )];
+    /**
+     * @brief Next position to read from
+     *
+     * Only used by the delivery thread.
+     */
+    std::atomic<size_t> _dequeuePosition;
+    /**
+     * @brief Padding
+     *
+     * Keeps _dequeuePosition off the cache line of the members below.
+     */
+    char _padding2[cacheLineSize - sizeof ( std::atomic<size_t> )];
+    /**
+     * @brief Number of messages pushed successfully
+     *
+     * Compared to _delivered by waitUntilDelivered().
+     */
+    std::atomic<uint64_t> _pushed;
+    /**
+     * @brief Number of messages passed to the receiver
+     *
+     * Incremented by the delivery thread after the receiver has returned.
+     */
+    std::atomic<uint64_t> _delivered;
+    /**
+     * @brief Message callback
+     *
+     * Set by start().
+     */
+    MessageSource::Receiver _receiver;
+    /**
+     * @brief Run flag
+     *
+     * The delivery thread runs as long as this flag is true. Reset by stop().
+     */
+    bool _run;
+    /**
+     * @brief Delivery thread
+     *
+     * Runs deliver(), started by start().
+     */
+    boost::thread _deliveryThread;
+
+    /**
+     * @brief Take the next message from the queue
+     *
+     * May only be called by the delivery thread.
+     * @param message Receives the message
+     * @return true if a message was taken, false if the queue is empty
+     */
+    bool tryPop ( AlarmServerMessage& message ) noexcept;
+    /**
+     * @brief Delivery loop
+     *
+     * Runs in _deliveryThread: Pops the messages and passes them to the receiver. If the queue is empty, the thread spins for a short while, then yields and finally sleeps for 100 µs between polls, so an idle source costs next to no CPU time while a busy one never sleeps.
+     * @return Nothing
+     */
+    void deliver() noexcept;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Allocates the queue.
+     * @param capacity Maximum number of messages waiting for delivery, must be a power of two
+     * @exception std::invalid_argument The capacity is not a power of two
+     */
+    explicit InProcessMessageSource ( const size_t capacity = 65536 );
+    /**
+     * @brief Destructor
+     * 
+     * Stops the delivery thread. Messages still in the queue are discarded.
+     */
+    virtual ~InProcessMessageSource();
+    /**
+     * @brief Copy constructor (deleted)
+     * 
+     * This class cannot be copied.
+     * @param other Another instance of InProcessMessageSource
+     */
+    InProcessMessageSource ( const InProcessMessageSource& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     * 
+     * This class cannot be copied.
+     * @param other Another instance of InProcessMessageSource
+     * @return Nothing (deleted)
+     */
+    InProcessMessageSource& operator= ( const InProcessMessageSource& other ) = delete;
+    /**
+     * @brief Start the delivery
+     *
+     * Spawns the delivery thread. Messages pushed before are delivered as well.
+     * @param receiver The callback
+     * @return Nothing
+     * @exception std::runtime_error The delivery has already been started
+     */
+    virtual void start ( const MessageSource::Receiver& receiver );
+    /**
+     * @brief Stop the delivery
+     *
+     * Waits for the delivery thread to finish the current message and to exit. Can be called more than once.
+     * @return Nothing
+     */
+    virtual void stop() noexcept;
+    /**
+     * @brief Queue a message without waiting
+     *
+     * Can be called from any number of threads at the same time.
+     *
+     * This method cannot throw exceptions.
+     * @param message The message
+     * @return true if the message has been queued, false if the queue is full
+     */
+    bool tryPush ( const AlarmServerMessage& message ) noexcept;
+    /**
+     * @brief Queue a message
+     *
+     * Like tryPush(), but waits for a free cell if the queue is full.
+     *
+     * This method cannot throw exceptions.
+     * @param message The message
+     * @return true if the message has been queued, false if the delivery has been stopped while waiting
+     */
+    bool push ( const AlarmServerMessage& message ) noexcept;
+    /**
+     * @brief Wait for the queue to drain
+     *
+     * Returns when all messages pushed before the call have been passed to the receiver and the receiver has returned, or when the delivery is not running.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void waitUntilDelivered() const noexcept;
+};
+
+}
+
+#endif // INPROCESSMESSAGESOURCE_H
@@ -0,0 +1,69 @@
+/**
+ * @file instrumentedmutex.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Mutex recording wait and hold times per call site
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "instrumentedmutex.h"
+
+using namespace AlarmNotifications;
+
+InstrumentedMutex::InstrumentedMutex()
+{
+}
+
+void InstrumentedMutex::recordSection ( const Metrics::Histogram holdHistogram, const int64_t started ) noexcept
+{
+    Metrics::observe ( holdHistogram, Metrics::now() - started );
+}
+
+InstrumentedMutex::ScopedLock::ScopedLock ( InstrumentedMutex& mutex, const Metrics::Histogram waitHistogram, const Metrics::Histogram holdHistogram )
+    : _mutex ( mutex ),
+      _holdhistogram ( holdHistogram ),
+      _acquired ( 0 )
+{
+    if ( _mutex._mutex.try_lock() )
+    {
+        // Uncontended, no need to read the clock before locking
+        _acquired = Metrics::now();
+        Metrics::observe ( waitHistogram, 0 );
+        return;
+    }
+    const int64_t requested = Metrics::now();
+    _mutex._mutex.lock();
+    _acquired = Metrics::now();
+    Metrics::observe ( waitHistogram, _acquired - requested );
+}
+
+InstrumentedMutex::ScopedLock::~ScopedLock()
+{
+    Metrics::observe ( _holdhistogram, Metrics::now() - _acquired );
+    _mutex._mutex.unlock();
+}
@@ -0,0 +1,149 @@
+/**
+ * @file instrumentedmutex.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Mutex recording wait and hold times per call site
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef INSTRUMENTEDMUTEX_H
+#define INSTRUMENTEDMUTEX_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+
+#include <boost/thread.hpp>
+
+#include "metrics.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Mutex with contention profiling
+ *
+ * A boost::mutex that is locked through ScopedLock, which records how long the caller had to wait for the lock and how long it held it. Both times go into Metrics histograms chosen by the call site, so the metrics show which code path keeps the others waiting.
+ *
+ * The overhead is two reads of the monotonic clock per lock and two relaxed atomic increments per histogram, so the mutex is suitable for the hot path.
+ */
+class InstrumentedMutex final
+{
+public:
+    /**
+     * @brief Scoped lock with measurements
+     *
+     * Locks the mutex in the constructor and unlocks it in the destructor, like boost::lock_guard. The wait time is recorded after the lock has been acquired, the hold time before it is released.
+     */
+    class ScopedLock final
+    {
+    private:
+        /**
+         * @brief The locked mutex
+         */
+        InstrumentedMutex& _mutex;
+        /**
+         * @brief Histogram for the hold time
+         */
+        const Metrics::Histogram _holdhistogram;
+        /**
+         * @brief Monotonic time the lock has been acquired
+         */
+        int64_t _acquired;
+
+    public:
+        /**
+         * @brief Constructor
+         *
+         * Waits for the mutex and locks it. If the mutex is free, the clock is only read once.
+         * @param mutex The mutex to be locked
+         * @param waitHistogram Histogram of the call site for the time waited for the lock
+         * @param holdHistogram Histogram of the call site for the time the lock is held
+         */
+        ScopedLock ( InstrumentedMutex& mutex, const Metrics::Histogram waitHistogram, const Metrics::Histogram holdHistogram );
+        /**
+         * @brief Destructor
+         *
+         * Unlocks the mutex.
+         */
+        ~ScopedLock();
+        /**
+         * @brief Copy constructor (deleted)
+         *
+         * A lock cannot be copied.
+         */
+        ScopedLock ( const ScopedLock& other ) = delete;
+        /**
+         * @brief Copy assignment (deleted)
+         *
+         * A lock cannot be copied.
+         * @return Nothing
+         */
+        ScopedLock& operator= ( const ScopedLock& other ) = delete;
+    };
+
+private:
+    /**
+     * @brief The actual mutex
+     */
+    boost::mutex _mutex;
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates an unlocked mutex.
+     */
+    InstrumentedMutex();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * A mutex cannot be copied.
+     */
+    InstrumentedMutex ( const InstrumentedMutex& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * A mutex cannot be copied.
+     * @return Nothing
+     */
+    InstrumentedMutex& operator= ( const InstrumentedMutex& other ) = delete;
+    /**
+     * @brief Record time spent under a lock held by the caller
+     *
+     * For methods that only run while their caller holds the lock, e.g. AlarmServerConnector::prepareDesktopNotification(), so their share of the caller's hold time is visible.
+     * @param holdHistogram Histogram of the method
+     * @param started Monotonic time the method has started, see Metrics::now()
+     * @return Nothing
+     */
+    static void recordSection ( const Metrics::Histogram holdHistogram, const int64_t started ) noexcept;
+};
+
+}
+
+#endif // INSTRUMENTEDMUTEX_H
@@ -0,0 +1,78 @@
+/**
+ * @file jsonencoding.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Helpers for the JSON output of the tools and the dashboard
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef JSONENCODING_H
+#define JSONENCODING_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdio>
+#include <string>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Quote a string for JSON
+ *
+ * Used by AlarmEventStream for the dashboard and by AlarmBenchmark for its results. Double quotes and backslashes are escaped by a backslash, the other control characters by their \\u code.
+ * @param text The string
+ * @return The string in double quotes with special characters escaped
+ */
+inline std::string quoteJSON ( const std::string& text )
+{
+    std::string quoted ( "\"" );
+    for ( auto i = text.begin(); i != text.end(); i++ )
+    {
+        const unsigned char character = static_cast<unsigned char> ( *i );
+        if ( character == '"' || character == '\\' )
+        {
+            quoted.push_back ( '\\' );
+            quoted.push_back ( *i );
+        }
+        else if ( character < 0x20 )
+        {
+            char escaped[8];
+            snprintf ( escaped, sizeof ( escaped ), "\\u%04x", character );
+            quoted.append ( escaped );
+        }
+        else
+            quoted.push_back ( *i );
+    }
+    quoted.push_back ( '"' );
+    return quoted;
+}
+
+}
+
+#endif // JSONENCODING_H
@@ -0,0 +1,154 @@
+/**
+ * @file localsocketserver.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Server for local connections on a Unix domain or loopback TCP socket
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "localsocketserver.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+const unsigned int LocalSocketServer::connectionTimeout;
+
+LocalSocketServer::LocalSocketServer ( const std::string& endpoint, const LocalSocketServer::Handler& handler )
+    : _endpoint ( endpoint ),
+      _handler ( handler ),
+      _fd ( -1 ),
+      _run ( true )
+{
+    if ( _endpoint.empty() )
+        throw std::runtime_error ( "No socket path or port given." );
+    if ( _endpoint[0] == '/' )
+    {
+        sockaddr_un address;
+        memset ( &address, 0, sizeof ( address ) );
+        address.sun_family = AF_UNIX;
+        if ( _endpoint.length() >= sizeof ( address.sun_path ) )
+            throw std::runtime_error ( "Socket path " + _endpoint + " is too long." );
+        strncpy ( address.sun_path, _endpoint.c_str(), sizeof ( address.sun_path ) - 1 );
+        _fd = socket ( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        if ( _fd < 0 )
+            throw std::runtime_error ( std::string ( "Cannot create socket: " ) + strerror ( errno ) );
+        unlink ( _endpoint.c_str() ); // Socket file of a previous run
+        if ( bind ( _fd, reinterpret_cast<sockaddr*> ( &address ), sizeof ( address ) ) < 0 )
+        {
+            const int error = errno;
+            close ( _fd );
+            throw std::runtime_error ( "Cannot bind socket to " + _endpoint + ": " + strerror ( error ) );
+        }
+    }
+    else
+    {
+        char* end = nullptr;
+        const long port = strtol ( _endpoint.c_str(), &end, 10 );
+        if ( *end != '\0' || port <= 0 || port > 65535 )
+            throw std::runtime_error ( "Invalid socket path or port " + _endpoint + "." );
+        sockaddr_in address;
+        memset ( &address, 0, sizeof ( address ) );
+        address.sin_family = AF_INET;
+        address.sin_port = htons ( static_cast<uint16_t> ( port ) );
+        address.sin_addr.s_addr = htonl ( INADDR_LOOPBACK ); // Never reachable from the network
+        _fd = socket ( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        if ( _fd < 0 )
+            throw std::runtime_error ( std::string ( "Cannot create socket: " ) + strerror ( errno ) );
+        const int reuse = 1;
+        setsockopt ( _fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof ( reuse ) );
+        if ( bind ( _fd, reinterpret_cast<sockaddr*> ( &address ), sizeof ( address ) ) < 0 )
+        {
+            const int error = errno;
+            close ( _fd );
+            throw std::runtime_error ( "Cannot bind socket to port " + _endpoint + ": " + strerror ( error ) );
+        }
+    }
+    if ( listen ( _fd, 16 ) < 0 )
+    {
+        const int error = errno;
+        close ( _fd );
+        throw std::runtime_error ( "Cannot listen on " + _endpoint + ": " + strerror ( error ) );
+    }
+    _serverthread = boost::thread ( boost::bind ( &LocalSocketServer::acceptConnections, this ) );
+}
+
+LocalSocketServer::~LocalSocketServer()
+{
+    _run = false;
+    _serverthread.join();
+    close ( _fd );
+    if ( _endpoint[0] == '/' )
+        unlink ( _endpoint.c_str() );
+}
+
+void LocalSocketServer::acceptConnections()
+{
+    while ( _run )
+    {
+        pollfd listening;
+        listening.fd = _fd;
+        listening.events = POLLIN;
+        listening.revents = 0;
+        if ( poll ( &listening, 1, 500 ) <= 0 )
+            continue; // Timeout to check _run, or interrupted by a signal
+        const int connection = accept4 ( _fd, nullptr, nullptr, SOCK_CLOEXEC );
+        if ( connection < 0 )
+            continue;
+        timeval timeout;
+        timeout.tv_sec = connectionTimeout;
+        timeout.tv_usec = 0;
+        setsockopt ( connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof ( timeout ) );
+        setsockopt ( connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof ( timeout ) );
+        try
+        {
+            _handler ( connection );
+        }
+        catch ( std::exception& e )
+        {
+            ExceptionHandler ( e, "answering a request on " + _endpoint + "." );
+        }
+        catch ( ... )
+        {
+            ExceptionHandler ( "answering a request on " + _endpoint + "." );
+        }
+        close ( connection );
+    }
+}
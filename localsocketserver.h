@@ -0,0 +1,136 @@
+/**
+ * @file localsocketserver.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Server for local connections on a Unix domain or loopback TCP socket
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef LOCALSOCKETSERVER_H
+#define LOCALSOCKETSERVER_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <functional>
+#include <string>
+
+#include <boost/thread.hpp>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Server for local connections
+ *
+ * Accepts connections on a Unix domain socket or on a TCP port bound to the loopback interface, so the daemon can offer interfaces to monitoring tools and other local programs without being reachable from the network.
+ *
+ * A background thread waits for connections and passes each one to the handler, one after the other. The handler runs in this thread, so it should finish quickly. Sending and receiving on the connection time out after a few seconds, so a stuck client cannot block the server. The connection is closed after the handler returns.
+ */
+class LocalSocketServer final
+{
+public:
+    /**
+     * @brief Connection handler
+     *
+     * Called with the file descriptor of an accepted connection.
+     */
+    typedef std::function<void ( int ) > Handler;
+    /**
+     * @brief Timeout for sending and receiving
+     *
+     * In seconds, applied to each accepted connection.
+     */
+    static const unsigned int connectionTimeout = 5;
+private:
+    /**
+     * @brief The endpoint as given to the constructor
+     */
+    const std::string _endpoint;
+    /**
+     * @brief Handler for accepted connections
+     */
+    const Handler _handler;
+    /**
+     * @brief Listening socket
+     */
+    int _fd;
+    /**
+     * @brief Run flag
+     *
+     * The server thread stops when this flag is set to false.
+     */
+    bool _run;
+    /**
+     * @brief Server thread
+     *
+     * Runs acceptConnections().
+     */
+    boost::thread _serverthread;
+    /**
+     * @brief Wait for connections
+     *
+     * Polls the listening socket twice per second until _run is set to false, and passes each accepted connection to _handler.
+     * @return Nothing
+     */
+    void acceptConnections();
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates the listening socket and starts the server thread. A Unix domain socket file left over from a previous run is replaced.
+     * @param endpoint Either the absolute path of a Unix domain socket, starting with '/', or a TCP port number to listen on at 127.0.0.1
+     * @param handler Called for each accepted connection
+     * @exception std::runtime_error The socket cannot be created, e.g. because the port is in use.
+     */
+    LocalSocketServer ( const std::string& endpoint, const Handler& handler );
+    /**
+     * @brief Destructor
+     *
+     * Stops the server thread and closes the socket. A Unix domain socket file is removed.
+     */
+    ~LocalSocketServer();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of LocalSocketServer
+     */
+    LocalSocketServer ( const LocalSocketServer& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of LocalSocketServer
+     * @return Nothing (deleted)
+     */
+    LocalSocketServer& operator= ( const LocalSocketServer& other ) = delete;
+};
+
+}
+
+#endif // LOCALSOCKETSERVER_H
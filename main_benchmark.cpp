@@ -0,0 +1,190 @@
+/**
+ * @file main_benchmark.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Main file of an-benchmark, the benchmark of the alarm pipeline
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "alarmbenchmark.h"
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+// Measures in a child process, so the memory freed by a previous measurement does not hide the growth of the next one
+static std::string measureInChildProcess ( const size_t pvCount, const std::string& label )
+{
+    int pipefds[2];
+    if ( pipe ( pipefds ) < 0 )
+        throw std::runtime_error ( std::string ( "Cannot create pipe: " ) + strerror ( errno ) );
+    const pid_t child = fork();
+    if ( child < 0 )
+        throw std::runtime_error ( std::string ( "Cannot fork: " ) + strerror ( errno ) );
+    if ( child == 0 )
+    {
+        close ( pipefds[0] );
+        int status = 0;
+        try
+        {
+            const std::string line = AlarmBenchmark::toJSON ( AlarmBenchmark::measurePipeline ( pvCount ), label );
+            if ( write ( pipefds[1], line.data(), line.size() ) != static_cast<ssize_t> ( line.size() ) )
+                status = 1;
+        }
+        catch ( std::exception& e )
+        {
+            ExceptionHandler ( e, "measuring the alarm pipeline." );
+            status = 1;
+        }
+        close ( pipefds[1] );
+        _exit ( status );
+    }
+    close ( pipefds[1] );
+    std::string line;
+    char buffer[512];
+    ssize_t length;
+    while ( ( length = read ( pipefds[0], buffer, sizeof ( buffer ) ) ) != 0 )
+    {
+        if ( length > 0 )
+            line.append ( buffer, static_cast<size_t> ( length ) );
+        else if ( errno != EINTR )
+            break;
+    }
+    close ( pipefds[0] );
+    int status = 0;
+    waitpid ( child, &status, 0 );
+    if ( !WIFEXITED ( status ) || WEXITSTATUS ( status ) != 0 || line.empty() )
+        throw std::runtime_error ( "The measurement with " + std::to_string ( static_cast<unsigned long long> ( pvCount ) ) + " PVs has failed." );
+    return line;
+}
+
+// Default number of PVs of the scaling measurement
+static const size_t scalingPVs = 10000;
+
+// Largest number of threads of the scaling measurement, starting with 1 and doubling
+static const unsigned int scalingMaximumThreads = 16;
+
+static void printUsage ( const char*const program )
+{
+    std::cerr << "Usage: " << program << " [--pvs N]... [--scaling SHARDS] [--label TEXT] [--output FILE]" << std::endl;
+    std::cerr << "  Measures the alarm pipeline with N PVs in alarm, default 1000, 10000, 100000 and 1000000" << std::endl;
+    std::cerr << "  With --scaling, measures instead 1 to " << scalingMaximumThreads << " threads applying messages for the first N PVs, default " << scalingPVs << ", with 1 and with SHARDS shards" << std::endl;
+    std::cerr << "  Prints one JSON object per line, or appends them to FILE. TEXT, e.g. the version, is included in every object." << std::endl;
+}
+
+int main ( int argc, char** argv )
+{
+    std::vector<size_t> populations;
+    std::string label;
+    std::string output;
+    unsigned int scalingShards = 0;
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string option ( argv[i] );
+        if ( i + 1 >= argc )
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+        const char*const value = argv[++i];
+        if ( option == "--pvs" && atol ( value ) > 0 )
+            populations.push_back ( static_cast<size_t> ( atol ( value ) ) );
+        else if ( option == "--scaling" && atol ( value ) > 0 )
+            scalingShards = static_cast<unsigned int> ( atol ( value ) );
+        else if ( option == "--label" )
+            label = value;
+        else if ( option == "--output" )
+            output = value;
+        else
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+    }
+    if ( populations.empty() && scalingShards == 0 )
+    {
+        populations.push_back ( 1000 );
+        populations.push_back ( 10000 );
+        populations.push_back ( 100000 );
+        populations.push_back ( 1000000 );
+    }
+    try
+    {
+        std::ofstream file;
+        if ( !output.empty() )
+        {
+            file.open ( output.c_str(), std::ios::out | std::ios::app );
+            if ( !file )
+                throw std::runtime_error ( "Cannot open output file " + output );
+        }
+        std::ostream& results = output.empty() ? std::cout : file;
+        AlarmBenchmark::isolateConfiguration();
+        if ( scalingShards != 0 )
+        {
+            // Memory is not measured, so all measurements run in this process
+            const size_t pvCount = populations.empty() ? scalingPVs : populations.front();
+            std::vector<unsigned int> shardCounts ( 1, 1 );
+            if ( scalingShards != 1 )
+                shardCounts.push_back ( scalingShards );
+            for ( auto shards = shardCounts.begin(); shards != shardCounts.end(); shards++ )
+            {
+                for ( unsigned int threads = 1; threads <= scalingMaximumThreads; threads *= 2 )
+                {
+                    std::cerr << "Measuring " << threads << " thread(s) with " << *shards << " shard(s)..." << std::endl;
+                    results << AlarmBenchmark::toJSON ( AlarmBenchmark::measureScaling ( pvCount, threads, *shards ), label ) << std::endl;
+                }
+            }
+            return 0;
+        }
+        for ( auto i = populations.begin(); i != populations.end(); i++ )
+        {
+            std::cerr << "Measuring " << *i << " PVs..." << std::endl;
+            results << measureInChildProcess ( *i, label ) << std::endl;
+        }
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "running the benchmark.", true );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "running the benchmark.", true );
+    }
+    return 0;
+}
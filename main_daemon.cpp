@@ -31,12 +31,69 @@
  *
  **/
 
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "alarmbenchmark.h"
+#include "alarmloadgenerator.h"
 #include "daemon.h"
+#include "exceptionhandler.h"
 
 using namespace AlarmNotifications;
 
-int main()
+static void printBenchUsage ( const char*const program )
+{
+  std::cerr << "Usage: " << program << " --bench [--duration SECONDS] [MODEL OPTIONS]" << std::endl;
+  std::cerr << "  Feeds SECONDS (default 3600) of a synthetic workload as fast as possible into the alarm pipeline of this program, without message broker, e-mail server or flash light" << std::endl;
+  AlarmLoadModel::printOptions ( std::cerr );
+}
+
+// Capacity check of the machine: Measures the pipeline instead of running the daemon
+static int runBenchmark ( int argc, char** argv )
+{
+  AlarmLoadModel model;
+  double durationSeconds = 3600;
+  for ( int i = 2; i < argc; i++ )
+  {
+    const std::string option ( argv[i] );
+    if ( i + 1 >= argc )
+    {
+      printBenchUsage ( argv[0] );
+      return 1;
+    }
+    const char*const value = argv[++i];
+    if ( option == "--duration" && atof ( value ) > 0 )
+      durationSeconds = atof ( value );
+    else if ( !model.setOption ( option, value ) )
+    {
+      printBenchUsage ( argv[0] );
+      return 1;
+    }
+  }
+  try
+  {
+    AlarmBenchmark::isolateConfiguration();
+    const AlarmBenchmark::WorkloadResult result = AlarmBenchmark::measureWorkload ( model, static_cast<int64_t> ( durationSeconds * 1e9 ) );
+    std::cout << result.messages << " messages in " << result.seconds << " s: " << static_cast<uint64_t> ( result.messagesPerSecond ) << " messages/s" << std::endl;
+    std::cout << "Apply latency: p50 " << result.p50Microseconds << " us, p99 " << result.p99Microseconds << " us, p99.9 " << result.p999Microseconds << " us" << std::endl;
+    std::cout << "Resident memory growth: " << result.memoryGrowth / 1024 << " KiB with " << result.activeAlarms << " active alarms" << std::endl;
+  }
+  catch ( std::exception& e )
+  {
+    ExceptionHandler ( e, "running the benchmark.", true );
+  }
+  catch ( ... )
+  {
+    ExceptionHandler ( "running the benchmark.", true );
+  }
+  return 0;
+}
+
+int main ( int argc, char** argv )
 {
+  if ( argc > 1 && std::string ( argv[1] ) == "--bench" )
+    return runBenchmark ( argc, argv );
   Daemon::instance().run();
   return 0;
 }
@@ -0,0 +1,108 @@
+/**
+ * @file main_history.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Entrance point for the alarm history query tool
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "alarmconfiguration.h"
+#include "alarmhistorystore.h"
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+static void printUsage ( const char*const program )
+{
+    std::cerr << "Usage: " << program << " [--directory DIR] [--from TIME] [--to TIME] [--pv PATTERN] [--severity SEVERITY]..." << std::endl;
+    std::cerr << "  TIME is given as \"YYYY-MM-DD HH:MM:SS\" in local time, default is the last seven days" << std::endl;
+    std::cerr << "  PATTERN is a shell wildcard pattern for the PV name, default is \"*\"" << std::endl;
+    std::cerr << "  SEVERITY can be given multiple times, e.g. MAJOR or MINOR_ACK, default is all severities" << std::endl;
+}
+
+int main ( int argc, char** argv )
+{
+    std::string directory = AlarmConfiguration::instance().getHistoryDirectory();
+    int64_t to = static_cast<int64_t> ( std::time ( nullptr ) ) * 1000000000;
+    int64_t from = to - static_cast<int64_t> ( 7 * 86400 ) * 1000000000;
+    std::string pvpattern ( "*" );
+    uint32_t severityMask = 0;
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string option ( argv[i] );
+        if ( i + 1 >= argc )
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+        const char*const value = argv[++i];
+        if ( option == "--directory" )
+            directory = value;
+        else if ( option == "--from" && AlarmHistoryStore::parseTime ( value, from ) )
+            continue;
+        else if ( option == "--to" && AlarmHistoryStore::parseTime ( value, to ) )
+            continue;
+        else if ( option == "--pv" )
+            pvpattern = value;
+        else if ( option == "--severity" && AlarmStatusEntry::severityLevelFromString ( value ) != AlarmStatusEntry::SeverityUnknown )
+            severityMask |= 1u << AlarmStatusEntry::severityLevelFromString ( value );
+        else
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+    }
+    if ( directory.empty() )
+    {
+        printUsage ( argv[0] );
+        std::cerr << "No history directory given and none configured in " << AlarmConfiguration::instance().getConfigFileLocation() << std::endl;
+        return 1;
+    }
+    if ( severityMask == 0 )
+        severityMask = ~0u;
+    try
+    {
+        const std::vector<AlarmTransition> history = AlarmHistoryStore::query ( directory, from, to, pvpattern, severityMask );
+        for ( auto i = history.begin(); i != history.end(); i++ )
+            std::cout << *i << std::endl;
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "querying the alarm history.", true );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "querying the alarm history.", true );
+    }
+    return 0;
+}
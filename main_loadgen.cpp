@@ -0,0 +1,222 @@
+/**
+ * @file main_loadgen.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Main file of the synthetic load generator an-loadgen
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+#include <activemq/library/ActiveMQCPP.h>
+#include <cms/Connection.h>
+#include <cms/ConnectionFactory.h>
+#include <cms/DeliveryMode.h>
+#include <cms/Destination.h>
+#include <cms/MapMessage.h>
+#include <cms/MessageProducer.h>
+#include <cms/Session.h>
+
+#include "alarmconfiguration.h"
+#include "alarmloadgenerator.h"
+#include "alarmserverconnector.h"
+#include "exceptionhandler.h"
+#include "inprocessmessagesource.h"
+#include "metrics.h"
+
+using namespace AlarmNotifications;
+
+static void printUsage ( const char*const program )
+{
+    std::cerr << "Usage: " << program << " [--target inject|broker] [--duration SECONDS] [--speed FACTOR] [--print-metrics] [MODEL OPTIONS]" << std::endl;
+    std::cerr << "  inject: Feeds the messages through an in-process queue into an AlarmServerConnector without notifications (default)" << std::endl;
+    std::cerr << "  broker: Publishes the messages to the topic of the message broker configured in " << AlarmConfiguration::instance().getConfigFileLocation() << std::endl;
+    std::cerr << "  The simulation covers SECONDS (default 3600) of simulated time, replayed FACTOR times faster than real time (default 1, 0 = as fast as possible)" << std::endl;
+    AlarmLoadModel::printOptions ( std::cerr );
+}
+
+// Sleeps until the given time of the monotonic clock
+static void sleepUntil ( const int64_t monotonicTime )
+{
+    timespec until;
+    until.tv_sec = static_cast<time_t> ( monotonicTime / 1000000000 );
+    until.tv_nsec = static_cast<long> ( monotonicTime % 1000000000 );
+    while ( clock_nanosleep ( CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr ) != 0 )
+        ; // Interrupted by a signal
+}
+
+// Generates the messages, passes them to the sink and prints how many have been sent
+template<class Sink> static void runLoad ( AlarmLoadGenerator& generator, const int64_t duration, const double speed, Sink sink )
+{
+    uint64_t state = 0, idle = 0, config = 0;
+    const int64_t started = Metrics::now();
+    AlarmServerMessage message;
+    int64_t time = generator.next ( message );
+    while ( time <= duration )
+    {
+        if ( speed > 0 )
+            sleepUntil ( started + static_cast<int64_t> ( static_cast<double> ( time ) / speed ) );
+        sink ( message );
+        if ( message.text == "STATE" )
+            state++;
+        else if ( message.text == "IDLE" )
+            idle++;
+        else
+            config++;
+        time = generator.next ( message );
+    }
+    const double elapsed = static_cast<double> ( Metrics::now() - started ) * 1e-9;
+    const uint64_t total = state + idle + config;
+    std::cout << total << " messages (" << state << " STATE, " << idle << " IDLE, " << config << " CONFIG) in " << elapsed << " s, "
+              << static_cast<double> ( total ) / elapsed << " messages/s" << std::endl;
+    std::cout << generator.getActiveAlarms() << " PVs in alarm at the end of the simulation" << std::endl;
+}
+
+// Publishes the messages to the configured topic of the message broker
+static void publishToBroker ( AlarmLoadGenerator& generator, const int64_t duration, const double speed )
+{
+    activemq::library::ActiveMQCPP::initializeLibrary();
+    {
+        char hostname[256] = "localhost";
+        gethostname ( hostname, sizeof ( hostname ) - 1 );
+        std::unique_ptr<cms::ConnectionFactory> factory ( cms::ConnectionFactory::createCMSConnectionFactory ( AlarmConfiguration::instance().getActiveMQURI() ) );
+        std::unique_ptr<cms::Connection> connection ( factory->createConnection (
+                    AlarmConfiguration::instance().getActiveMQUsername(),
+                    AlarmConfiguration::instance().getActiveMQPassword()
+                ) );
+        connection->start();
+        std::unique_ptr<cms::Session> session ( connection->createSession ( cms::Session::AUTO_ACKNOWLEDGE ) );
+        std::unique_ptr<cms::Topic> topic ( session->createTopic ( AlarmConfiguration::instance().getActiveMQTopicName() ) );
+        std::unique_ptr<cms::MessageProducer> producer ( session->createProducer ( topic.get() ) );
+        producer->setDeliveryMode ( cms::DeliveryMode::NON_PERSISTENT ); // Like the alarm server
+        runLoad ( generator, duration, speed, [&] ( const AlarmServerMessage & message )
+        {
+            std::unique_ptr<cms::MapMessage> mapmessage ( session->createMapMessage() );
+            mapmessage->setString ( "TEXT", message.text );
+            mapmessage->setString ( "APPLICATION", "AlarmServer" );
+            mapmessage->setString ( "HOST", hostname );
+            if ( !message.name.empty() )
+                mapmessage->setString ( "NAME", message.name );
+            if ( !message.severity.empty() )
+            {
+                mapmessage->setString ( "SEVERITY", message.severity );
+                mapmessage->setString ( "CURRENT_SEVERITY", message.severity );
+            }
+            if ( !message.status.empty() )
+            {
+                mapmessage->setString ( "STATUS", message.status );
+                mapmessage->setString ( "CURRENT_STATUS", message.status );
+            }
+            if ( !message.eventTime.empty() )
+                mapmessage->setString ( "EVENTTIME", message.eventTime );
+            producer->send ( mapmessage.get() );
+        } );
+        producer->close();
+        session->close();
+        connection->close();
+    }
+    activemq::library::ActiveMQCPP::shutdownLibrary();
+}
+
+// Feeds the messages directly into an AlarmServerConnector without a message broker
+static void injectIntoConnector ( AlarmLoadGenerator& generator, const int64_t duration, const double speed )
+{
+    AlarmConfiguration::instance().setDesktopNotificationTimeout ( 0 ); // Only in memory, the configuration file is not written
+    InProcessMessageSource* source = new InProcessMessageSource();
+    AlarmServerConnector asc ( true, false, std::unique_ptr<MessageSource> ( source ) ); // Takes ownership of the source
+    runLoad ( generator, duration, speed, [source] ( const AlarmServerMessage & message )
+    {
+        source->push ( message );
+    } );
+    source->waitUntilDelivered();
+    std::cout << asc.getNumberOfAlarms() << " active alarms in AlarmServerConnector" << std::endl;
+}
+
+int main ( int argc, char** argv )
+{
+    AlarmLoadModel model;
+    std::string target ( "inject" );
+    double durationSeconds = 3600;
+    double speed = 1;
+    bool printMetrics = false;
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string option ( argv[i] );
+        if ( option == "--print-metrics" )
+        {
+            printMetrics = true;
+            continue;
+        }
+        if ( i + 1 >= argc )
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+        const char*const value = argv[++i];
+        const double number = atof ( value );
+        if ( option == "--target" && ( std::string ( value ) == "inject" || std::string ( value ) == "broker" ) )
+            target = value;
+        else if ( option == "--duration" && number > 0 )
+            durationSeconds = number;
+        else if ( option == "--speed" && number >= 0 )
+            speed = number;
+        else if ( !model.setOption ( option, value ) )
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+    }
+    try
+    {
+        timespec wallclock;
+        clock_gettime ( CLOCK_REALTIME, &wallclock );
+        AlarmLoadGenerator generator ( model, static_cast<int64_t> ( wallclock.tv_sec ) * 1000000000 + wallclock.tv_nsec );
+        const int64_t duration = static_cast<int64_t> ( durationSeconds * 1e9 );
+        if ( target == "broker" )
+            publishToBroker ( generator, duration, speed );
+        else
+            injectIntoConnector ( generator, duration, speed );
+        if ( printMetrics )
+            std::cout << std::endl << Metrics::scrape();
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "generating the alarm load.", true );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "generating the alarm load.", true );
+    }
+    return 0;
+}
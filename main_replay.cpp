@@ -0,0 +1,162 @@
+/**
+ * @file main_replay.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Main file of an-replay, which replays a message capture
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alarmconfiguration.h"
+#include "alarmhistorystore.h"
+#include "alarmserverconnector.h"
+#include "exceptionhandler.h"
+#include "inprocessmessagesource.h"
+#include "messagecapture.h"
+#include "metrics.h"
+
+using namespace AlarmNotifications;
+
+static void printUsage ( const char*const program )
+{
+    std::cerr << "Usage: " << program << " [--speed FACTOR] [--from TIME] [--to TIME] [--print-metrics] FILE" << std::endl;
+    std::cerr << "  Feeds the messages of the capture FILE through an in-process queue into an AlarmServerConnector without notifications" << std::endl;
+    std::cerr << "  FACTOR: Replay FACTOR times faster than recorded (default 1, 0 = as fast as possible)" << std::endl;
+    std::cerr << "  TIME is given as \"YYYY-MM-DD HH:MM:SS\" in local time. Messages before --from are fed as fast as possible to rebuild the alarm state, replay ends at --to" << std::endl;
+}
+
+// Sleeps until the given time of the monotonic clock
+static void sleepUntil ( const int64_t monotonicTime )
+{
+    timespec until;
+    until.tv_sec = static_cast<time_t> ( monotonicTime / 1000000000 );
+    until.tv_nsec = static_cast<long> ( monotonicTime % 1000000000 );
+    while ( clock_nanosleep ( CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr ) != 0 )
+        ; // Interrupted by a signal
+}
+
+int main ( int argc, char** argv )
+{
+    std::string filename;
+    double speed = 1;
+    int64_t from = 0;
+    int64_t to = std::numeric_limits<int64_t>::max();
+    bool printMetrics = false;
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string option ( argv[i] );
+        if ( option == "--print-metrics" )
+        {
+            printMetrics = true;
+            continue;
+        }
+        if ( option.compare ( 0, 2, "--" ) != 0 && filename.empty() )
+        {
+            filename = option;
+            continue;
+        }
+        if ( i + 1 >= argc )
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+        const char*const value = argv[++i];
+        if ( option == "--speed" && atof ( value ) >= 0 )
+            speed = atof ( value );
+        else if ( option == "--from" && AlarmHistoryStore::parseTime ( value, from ) )
+            continue;
+        else if ( option == "--to" && AlarmHistoryStore::parseTime ( value, to ) )
+            continue;
+        else
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+    }
+    if ( filename.empty() )
+    {
+        printUsage ( argv[0] );
+        return 1;
+    }
+    try
+    {
+        std::vector<MessageCapture::CapturedMessage> messages;
+        MessageCapture::read ( filename, messages );
+        std::cout << messages.size() << " messages read from " << filename << std::endl;
+
+        AlarmConfiguration::instance().setDesktopNotificationTimeout ( 0 ); // Only in memory, the configuration file is not written
+        InProcessMessageSource* source = new InProcessMessageSource();
+        AlarmServerConnector asc ( true, false, std::unique_ptr<MessageSource> ( source ) ); // Takes ownership of the source
+        uint64_t replayed = 0;
+        int64_t started = Metrics::now();
+        int64_t firstReceived = 0;
+        bool paced = false;
+        for ( auto i = messages.begin(); i != messages.end() && ( *i ).receivedWallTime <= to; i++ )
+        {
+            if ( ( *i ).receivedWallTime >= from && !paced )
+            {
+                // Start of the paced part: Everything before has only been fed to rebuild the alarm state
+                source->waitUntilDelivered();
+                started = Metrics::now();
+                firstReceived = ( *i ).received;
+                replayed = 0;
+                paced = true;
+            }
+            if ( paced && speed > 0 )
+                sleepUntil ( started + static_cast<int64_t> ( static_cast<double> ( ( *i ).received - firstReceived ) / speed ) );
+            AlarmServerMessage message = ( *i ).message;
+            // The timestamps of the recording would show up as hours or days of latency, so the replay is measured from its own reception
+            message.eventTime.clear();
+            message.brokerTime = 0;
+            source->push ( message );
+            replayed++;
+        }
+        source->waitUntilDelivered();
+        const double elapsed = static_cast<double> ( Metrics::now() - started ) * 1e-9;
+        std::cout << replayed << " messages replayed in " << elapsed << " s, " << static_cast<double> ( replayed ) / elapsed << " messages/s" << std::endl;
+        std::cout << asc.getNumberOfAlarms() << " active alarms in AlarmServerConnector" << std::endl;
+        if ( printMetrics )
+            std::cout << std::endl << Metrics::scrape();
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "replaying the message capture.", true );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "replaying the message capture.", true );
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file main_stats.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Entrance point for the alarm statistics tool
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alarmconfiguration.h"
+#include "alarmhistoryanalysis.h"
+#include "alarmhistorystore.h"
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+static void printUsage ( const char*const program )
+{
+    std::cerr << "Usage: " << program << " [--directory DIR] [--from TIME] [--to TIME] [--top N] [--sort alarms|time|flaps] [--flap-window SECONDS] [--threads N]" << std::endl;
+    std::cerr << "  TIME is given as \"YYYY-MM-DD HH:MM:SS\" in local time, default is the last 30 days" << std::endl;
+    std::cerr << "  Prints the N PVs (default 20) with the most alarms, the longest time in alarm or the most flaps" << std::endl;
+    std::cerr << "  An alarm raised within the flap window (default 60 seconds) after the previous one was cleared counts as flap" << std::endl;
+}
+
+// Formats a duration in nanoseconds as days, hours, minutes and seconds
+static std::string formatDuration ( const int64_t duration )
+{
+    const long long seconds = static_cast<long long> ( duration / 1000000000 );
+    char text[64];
+    snprintf ( text, sizeof ( text ), "%lldd %02lld:%02lld:%02lld", seconds / 86400, ( seconds / 3600 ) % 24, ( seconds / 60 ) % 60, seconds % 60 );
+    return std::string ( text );
+}
+
+int main ( int argc, char** argv )
+{
+    std::string directory = AlarmConfiguration::instance().getHistoryDirectory();
+    int64_t to = static_cast<int64_t> ( std::time ( nullptr ) ) * 1000000000;
+    int64_t from = to - static_cast<int64_t> ( 30 * 86400 ) * 1000000000;
+    unsigned long top = 20;
+    std::string sort ( "alarms" );
+    int64_t flapWindow = static_cast<int64_t> ( 60 ) * 1000000000;
+    unsigned int threads = std::max ( boost::thread::hardware_concurrency(), 1u );
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string option ( argv[i] );
+        if ( i + 1 >= argc )
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+        const char*const value = argv[++i];
+        if ( option == "--directory" )
+            directory = value;
+        else if ( option == "--from" && AlarmHistoryStore::parseTime ( value, from ) )
+            continue;
+        else if ( option == "--to" && AlarmHistoryStore::parseTime ( value, to ) )
+            continue;
+        else if ( option == "--top" && atol ( value ) > 0 )
+            top = static_cast<unsigned long> ( atol ( value ) );
+        else if ( option == "--sort" && ( std::string ( value ) == "alarms" || std::string ( value ) == "time" || std::string ( value ) == "flaps" ) )
+            sort = value;
+        else if ( option == "--flap-window" && atol ( value ) >= 0 )
+            flapWindow = static_cast<int64_t> ( atol ( value ) ) * 1000000000;
+        else if ( option == "--threads" && atoi ( value ) > 0 )
+            threads = static_cast<unsigned int> ( atoi ( value ) );
+        else
+        {
+            printUsage ( argv[0] );
+            return 1;
+        }
+    }
+    if ( directory.empty() )
+    {
+        printUsage ( argv[0] );
+        std::cerr << "No history directory given and none configured in " << AlarmConfiguration::instance().getConfigFileLocation() << std::endl;
+        return 1;
+    }
+    if ( to <= from )
+    {
+        std::cerr << "The end of the time range must be after its beginning." << std::endl;
+        return 1;
+    }
+    try
+    {
+        std::vector<PVStatistics> statistics = AlarmHistoryAnalysis::analyse ( directory, from, to, flapWindow, threads );
+        std::sort ( statistics.begin(), statistics.end(), [&sort] ( const PVStatistics & a, const PVStatistics & b )
+        {
+            if ( sort == "time" && a.timeInAlarm != b.timeInAlarm )
+                return a.timeInAlarm > b.timeInAlarm;
+            if ( sort == "flaps" && a.flaps != b.flaps )
+                return a.flaps > b.flaps;
+            if ( a.alarms != b.alarms )
+                return a.alarms > b.alarms;
+            return a.pvname < b.pvname;
+        } );
+
+        uint64_t alarms = 0;
+        uint64_t flaps = 0;
+        int64_t timeInAlarm = 0;
+        for ( auto i = statistics.begin(); i != statistics.end(); i++ )
+        {
+            alarms += ( *i ).alarms;
+            flaps += ( *i ).flaps;
+            timeInAlarm += ( *i ).timeInAlarm;
+        }
+        const double days = static_cast<double> ( to - from ) / 86400e9;
+        std::cout << statistics.size() << " PVs with " << alarms << " alarms and " << flaps << " flaps, total time in alarm " << formatDuration ( timeInAlarm ) << std::endl << std::endl;
+        printf ( "%5s %9s %7s %9s %15s %-13s %s\n", "Rank", "Alarms", "Flaps", "Flaps/day", "Time in alarm", "Worst", "PV" );
+        for ( unsigned long rank = 0; rank < top && rank < statistics.size(); rank++ )
+        {
+            const PVStatistics& entry = statistics[rank];
+            printf ( "%5lu %9llu %7llu %9.2f %15s %-13s %s\n",
+                     rank + 1,
+                     static_cast<unsigned long long> ( entry.alarms ),
+                     static_cast<unsigned long long> ( entry.flaps ),
+                     static_cast<double> ( entry.flaps ) / days,
+                     formatDuration ( entry.timeInAlarm ).c_str(),
+                     AlarmStatusEntry::severityLevelToString ( entry.worstSeverity ),
+                     entry.pvname.c_str() );
+        }
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "analysing the alarm history.", true );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "analysing the alarm history.", true );
+    }
+    return 0;
+}
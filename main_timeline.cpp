@@ -0,0 +1,69 @@
+/**
+ * @file main_timeline.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Entrance point for the alarm journal timeline viewer
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "alarmconfiguration.h"
+#include "alarmjournal.h"
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+int main ( int argc, char** argv )
+{
+    // The journal directory can be given on the command line, e.g. to look at a copy of the journal on another machine
+    const std::string directory = ( argc > 1 ) ? std::string ( argv[1] ) : AlarmConfiguration::instance().getJournalDirectory();
+    if ( directory.empty() )
+    {
+        std::cerr << "Usage: " << argv[0] << " [journal directory]" << std::endl;
+        std::cerr << "No journal directory given and none configured in " << AlarmConfiguration::instance().getConfigFileLocation() << std::endl;
+        return 1;
+    }
+    try
+    {
+        const std::vector<AlarmTransition> timeline = AlarmJournal::readTimeline ( directory );
+        for ( auto i = timeline.begin(); i != timeline.end(); i++ )
+            std::cout << *i << std::endl;
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "reading the alarm journal.", true );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "reading the alarm journal.", true );
+    }
+    return 0;
+}
@@ -0,0 +1,319 @@
+/**
+ * @file messagecapture.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Recording of the received alarm server messages for later replay
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "messagecapture.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binaryencoding.h"
+#include "exceptionhandler.h"
+
+using namespace AlarmNotifications;
+
+const char MessageCapture::fileMagic[9] = "ANCAPT01";
+const unsigned int MessageCapture::writeInterval;
+
+// Size of the batch header: marker byte, 32 bit payload length and 32 bit checksum
+static const size_t batchHeaderSize = 9;
+
+MessageCapture::MessageCapture ( const std::string& directory )
+    : _run ( true ),
+      _fd ( -1 ),
+      _wallclockbase ( 0 ),
+      _monotonicclockbase ( 0 ),
+      _lasttimestamp ( 0 )
+{
+    timespec wallclock;
+    timespec monotonic;
+    clock_gettime ( CLOCK_REALTIME, &wallclock );
+    clock_gettime ( CLOCK_MONOTONIC, &monotonic );
+    const time_t seconds = wallclock.tv_sec;
+    tm local;
+    localtime_r ( &seconds, &local );
+    char name[64];
+    snprintf ( name, sizeof ( name ), "capture-%04d%02d%02d-%02d%02d%02d-%d.anc",
+               local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec, static_cast<int> ( getpid() ) );
+    const std::string filename = directory + "/" + name;
+    _fd = open ( filename.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644 );
+    if ( _fd < 0 )
+        throw std::runtime_error ( "Cannot create capture file " + filename + ": " + strerror ( errno ) );
+    FileHeader header;
+    memcpy ( header.magic, fileMagic, sizeof ( header.magic ) );
+    header.wallClockBase = static_cast<int64_t> ( wallclock.tv_sec ) * 1000000000 + wallclock.tv_nsec;
+    header.monotonicClockBase = static_cast<int64_t> ( monotonic.tv_sec ) * 1000000000 + monotonic.tv_nsec;
+    if ( ::write ( _fd, &header, sizeof ( header ) ) != sizeof ( header ) )
+    {
+        const std::string error ( strerror ( errno ) );
+        close ( _fd );
+        unlink ( filename.c_str() );
+        throw std::runtime_error ( "Cannot write header of capture file " + filename + ": " + error );
+    }
+    _wallclockbase = header.wallClockBase;
+    _monotonicclockbase = header.monotonicClockBase;
+    _lasttimestamp = header.monotonicClockBase;
+    // The thread is started last, so it never sees a partially constructed capture
+    _writerthread = boost::thread ( boost::bind ( &MessageCapture::startWriter, this ) );
+}
+
+MessageCapture::~MessageCapture()
+{
+    {
+        boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+        _run = false;
+    }
+    _pendingcondition.notify_all();
+    _writerthread.join();
+    if ( _fd >= 0 )
+        close ( _fd );
+}
+
+void MessageCapture::append ( const AlarmServerMessage& message, const int64_t received ) noexcept
+{
+    try
+    {
+        PendingMessage pending;
+        pending.message = message;
+        pending.received = received;
+        boost::lock_guard<boost::mutex> concurrencylock ( _pendingmutex );
+        _pending.push_back ( std::move ( pending ) );
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "queueing a message for the capture file." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "queueing a message for the capture file." );
+    }
+}
+
+void MessageCapture::startWriter()
+{
+    bool run = true;
+    std::vector<PendingMessage> messages;
+    while ( run )
+    {
+        {
+            boost::unique_lock<boost::mutex> concurrencylock ( _pendingmutex );
+            if ( _run )
+                _pendingcondition.timed_wait ( concurrencylock, boost::posix_time::milliseconds ( writeInterval ) );
+            messages.swap ( _pending );
+            run = _run;
+        }
+        write ( messages );
+        messages.clear(); // Keeps the capacity, so the next swap hands an already allocated vector to append()
+    }
+}
+
+void MessageCapture::write ( const std::vector<PendingMessage>& messages ) noexcept
+{
+    if ( messages.empty() || _fd < 0 )
+        return;
+    try
+    {
+        std::string batch ( batchHeaderSize, '\0' ); // Header is filled in after the payload is complete
+        for ( auto i = messages.begin(); i != messages.end(); i++ )
+        {
+            const AlarmServerMessage& message = ( *i ).message;
+            const uint64_t textid = dictionaryID ( batch, message.text );
+            const uint64_t nameid = dictionaryID ( batch, message.name );
+            const uint64_t severityid = dictionaryID ( batch, message.severity );
+            const uint64_t statusid = dictionaryID ( batch, message.status );
+            const uint64_t eventtimeid = dictionaryID ( batch, message.eventTime );
+            // Messages are appended from the threads of the message source in the order of reception, but stay on the safe side
+            const int64_t delta = std::max<int64_t> ( ( *i ).received - _lasttimestamp, 0 );
+            _lasttimestamp += delta;
+            batch.push_back ( static_cast<char> ( message.brokerTime != 0 ? brokerTimeMessageRecord : messageRecord ) );
+            appendVarint ( batch, static_cast<uint64_t> ( delta ) );
+            appendVarint ( batch, textid );
+            appendVarint ( batch, nameid );
+            appendVarint ( batch, severityid );
+            appendVarint ( batch, statusid );
+            appendVarint ( batch, eventtimeid );
+            if ( message.brokerTime != 0 )
+                appendSignedVarint ( batch, message.brokerTime - ( _wallclockbase + ( _lasttimestamp - _monotonicclockbase ) ) );
+        }
+        const uint32_t payloadLength = static_cast<uint32_t> ( batch.size() - batchHeaderSize );
+        const uint32_t checksum = checksumFNV1a ( batch.data() + batchHeaderSize, payloadLength );
+        batch[0] = static_cast<char> ( batchMarker );
+        memcpy ( &batch[1], &payloadLength, sizeof ( payloadLength ) );
+        memcpy ( &batch[5], &checksum, sizeof ( checksum ) );
+
+        size_t written = 0;
+        while ( written < batch.size() )
+        {
+            const ssize_t result = ::write ( _fd, batch.data() + written, batch.size() - written );
+            if ( result < 0 && errno == EINTR )
+                continue;
+            if ( result < 0 )
+                throw std::runtime_error ( std::string ( "Cannot write to capture file: " ) + strerror ( errno ) );
+            written += static_cast<size_t> ( result );
+        }
+    }
+    catch ( std::exception& e )
+    {
+        // The dictionary may now contain IDs that never made it to disk, so the file must not be continued
+        close ( _fd );
+        _fd = -1;
+        ExceptionHandler ( e, "writing to the capture file." );
+    }
+    catch ( ... )
+    {
+        close ( _fd );
+        _fd = -1;
+        ExceptionHandler ( "writing to the capture file." );
+    }
+}
+
+uint64_t MessageCapture::dictionaryID ( std::string& batch, const std::string& text )
+{
+    auto entry = _dictionary.find ( text );
+    if ( entry != _dictionary.end() )
+        return ( *entry ).second;
+    const uint64_t id = _dictionary.size();
+    _dictionary.insert ( std::make_pair ( text, id ) );
+    batch.push_back ( static_cast<char> ( dictionaryRecord ) );
+    appendVarint ( batch, id );
+    appendVarint ( batch, text.length() );
+    batch.append ( text );
+    return id;
+}
+
+void MessageCapture::read ( const std::string& filename, std::vector<CapturedMessage>& messages )
+{
+    const int fd = open ( filename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        throw std::runtime_error ( "Cannot open capture file " + filename + ": " + strerror ( errno ) );
+    struct stat filestatus;
+    if ( fstat ( fd, &filestatus ) < 0 )
+    {
+        close ( fd );
+        throw std::runtime_error ( "Cannot determine size of capture file " + filename + ": " + strerror ( errno ) );
+    }
+    const size_t fileSize = static_cast<size_t> ( filestatus.st_size );
+    if ( fileSize < sizeof ( FileHeader ) )
+    {
+        close ( fd );
+        throw std::runtime_error ( "File " + filename + " is too short to be a capture file." );
+    }
+    void*const mapping = mmap ( nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close ( fd ); // The mapping stays valid after closing the file descriptor
+    if ( mapping == MAP_FAILED )
+        throw std::runtime_error ( "Cannot map capture file " + filename + " into memory: " + strerror ( errno ) );
+    const char*const base = static_cast<const char*> ( mapping );
+    const char*const end = base + fileSize;
+
+    FileHeader header;
+    memcpy ( &header, base, sizeof ( header ) );
+    if ( memcmp ( header.magic, fileMagic, sizeof ( header.magic ) ) != 0 )
+    {
+        munmap ( mapping, fileSize );
+        throw std::runtime_error ( "File " + filename + " is not a capture file or has an unsupported format version." );
+    }
+
+    std::vector<std::string> dictionary;
+    int64_t timestamp = header.monotonicClockBase;
+    const char* batch = base + sizeof ( header );
+    while ( batch + batchHeaderSize <= end && static_cast<uint8_t> ( *batch ) == batchMarker )
+    {
+        uint32_t payloadLength = 0;
+        uint32_t checksum = 0;
+        memcpy ( &payloadLength, batch + 1, sizeof ( payloadLength ) );
+        memcpy ( &checksum, batch + 5, sizeof ( checksum ) );
+        const char* position = batch + batchHeaderSize;
+        if ( payloadLength > static_cast<size_t> ( end - position ) || checksumFNV1a ( position, payloadLength ) != checksum )
+            break; // Incomplete batch written while the daemon was killed
+        const char*const batchEnd = position + payloadLength;
+        bool valid = true;
+        while ( valid && position < batchEnd )
+        {
+            const uint8_t recordType = static_cast<uint8_t> ( *position++ );
+            if ( recordType == dictionaryRecord )
+            {
+                uint64_t id = 0;
+                uint64_t length = 0;
+                valid = readVarint ( position, batchEnd, id ) && readVarint ( position, batchEnd, length )
+                        && id == dictionary.size() && length <= static_cast<uint64_t> ( batchEnd - position );
+                if ( valid )
+                {
+                    dictionary.push_back ( std::string ( position, length ) );
+                    position += length;
+                }
+            }
+            else if ( recordType == messageRecord || recordType == brokerTimeMessageRecord )
+            {
+                uint64_t delta = 0;
+                uint64_t ids[5];
+                valid = readVarint ( position, batchEnd, delta );
+                for ( unsigned int j = 0; valid && j < 5; j++ )
+                    valid = readVarint ( position, batchEnd, ids[j] ) && ids[j] < dictionary.size();
+                int64_t brokerOffset = 0;
+                if ( valid && recordType == brokerTimeMessageRecord )
+                    valid = readSignedVarint ( position, batchEnd, brokerOffset );
+                if ( valid )
+                {
+                    timestamp += static_cast<int64_t> ( delta );
+                    CapturedMessage captured;
+                    captured.message.text = dictionary[ids[0]];
+                    captured.message.name = dictionary[ids[1]];
+                    captured.message.severity = dictionary[ids[2]];
+                    captured.message.status = dictionary[ids[3]];
+                    captured.message.eventTime = dictionary[ids[4]];
+                    captured.received = timestamp;
+                    captured.receivedWallTime = header.wallClockBase + ( timestamp - header.monotonicClockBase );
+                    if ( recordType == brokerTimeMessageRecord )
+                        captured.message.brokerTime = captured.receivedWallTime + brokerOffset;
+                    messages.push_back ( std::move ( captured ) );
+                }
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+        if ( !valid )
+            break; // A batch with a valid checksum but invalid content cannot be trusted, and neither can anything behind it
+        batch = batchEnd;
+    }
+    munmap ( mapping, fileSize );
+}
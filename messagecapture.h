@@ -0,0 +1,317 @@
+/**
+ * @file messagecapture.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Recording of the received alarm server messages for later replay
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef MESSAGECAPTURE_H
+#define MESSAGECAPTURE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alarmservermessage.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Recording of all received alarm server messages
+ *
+ * The journal and the history only contain the changes of the alarm status, which is not enough to reproduce the load AlarmNotifications had to cope with during an incident. If enabled, CMSClient therefore hands every message it receives, including the ones it filters, to append() together with its receive timestamp, and this class writes them to a capture file. an-replay feeds such a file back through CMSClient and AlarmServerConnector at the original or an accelerated speed.
+ *
+ * Like AlarmJournal, append() only queues the message and a background thread writes all queued messages every writeInterval milliseconds in a single batch, so capturing does not slow down the reception. The file begins with a header containing the wall clock and the monotonic clock at the time it was created, followed by the batches. Every batch carries its length and a checksum, so a batch that was only partially written when the daemon was killed is recognized and ignored by the reader. The strings of the messages (text, PV name, severity, status and event time) are replaced by numeric IDs from a dictionary, as the same few strings occur over and over again, and the receive timestamps are stored as the difference to the previous message. A typical message therefore needs about a dozen bytes.
+ */
+class MessageCapture
+{
+public:
+    /**
+     * @brief A message read from a capture file
+     */
+    struct CapturedMessage
+    {
+        /**
+         * @brief The message as received
+         */
+        AlarmServerMessage message;
+        /**
+         * @brief Monotonic time of the reception
+         *
+         * Nanoseconds on CLOCK_MONOTONIC of the capturing process, only meaningful relative to the other messages of the same file.
+         */
+        int64_t received;
+        /**
+         * @brief Wall clock time of the reception
+         *
+         * Nanoseconds since the Unix epoch, calculated from received and the clock values in the file header.
+         */
+        int64_t receivedWallTime;
+    };
+private:
+    /**
+     * @brief Interval of the writes
+     *
+     * Time in milliseconds the background thread waits between two batches.
+     */
+    static const unsigned int writeInterval = 100;
+    /**
+     * @brief Magic string at the beginning of a capture file
+     *
+     * Used to recognize a capture file, the last two characters are the format version.
+     */
+    static const char fileMagic[9];
+    /**
+     * @brief Marker byte at the beginning of a batch
+     *
+     * Used to detect garbage at the end of a file.
+     */
+    static const uint8_t batchMarker = 0xc3;
+    /**
+     * @brief Record type for dictionary entries
+     *
+     * A dictionary record is followed by the numeric ID, the string length and the string itself.
+     */
+    static const uint8_t dictionaryRecord = 1;
+    /**
+     * @brief Record type for messages
+     *
+     * A message record is followed by the time difference to the previous message and the IDs of the text, the PV name, the severity, the status and the event time.
+     */
+    static const uint8_t messageRecord = 2;
+    /**
+     * @brief Record type for messages with timestamp of the broker
+     *
+     * Like messageRecord, followed by the difference between the timestamp of the message broker and the wall clock time of the reception.
+     */
+    static const uint8_t brokerTimeMessageRecord = 3;
+    /**
+     * @brief Capture file header
+     *
+     * The header is located at the very beginning of the capture file.
+     */
+    struct FileHeader
+    {
+        /**
+         * @brief Magic string
+         *
+         * Copy of fileMagic without the terminating null character.
+         */
+        char magic[8];
+        /**
+         * @brief Wall clock when the file was created
+         *
+         * Nanoseconds since the Unix epoch.
+         */
+        int64_t wallClockBase;
+        /**
+         * @brief Monotonic clock when the file was created
+         *
+         * Nanoseconds on CLOCK_MONOTONIC, taken at the same time as wallClockBase.
+         */
+        int64_t monotonicClockBase;
+    };
+    /**
+     * @brief A message waiting to be written
+     */
+    struct PendingMessage
+    {
+        /**
+         * @brief The message
+         */
+        AlarmServerMessage message;
+        /**
+         * @brief Monotonic time of the reception
+         */
+        int64_t received;
+    };
+    /**
+     * @brief Queue of messages waiting for the next batch
+     *
+     * Filled by append(), emptied by the background thread. Protected by _pendingmutex.
+     */
+    std::vector<PendingMessage> _pending;
+    /**
+     * @brief Mutex to protect _pending
+     *
+     * Only held for the time needed to add a message or to swap the whole queue.
+     */
+    boost::mutex _pendingmutex;
+    /**
+     * @brief Wake-up condition of the background thread
+     *
+     * Used to wake up the background thread early when the capture is closed.
+     */
+    boost::condition_variable _pendingcondition;
+    /**
+     * @brief Background thread abortion flag
+     *
+     * The destructor will set this flag to false, so the background thread will exit its loop. Protected by _pendingmutex.
+     */
+    bool _run;
+    /**
+     * @brief File descriptor of the capture file
+     *
+     * Only used by the background thread after construction. -1 after a write error, which ends the capture.
+     */
+    int _fd;
+    /**
+     * @brief Wall clock base of the file
+     *
+     * Copy of FileHeader::wallClockBase. Only used by the background thread.
+     */
+    int64_t _wallclockbase;
+    /**
+     * @brief Monotonic clock base of the file
+     *
+     * Copy of FileHeader::monotonicClockBase. Only used by the background thread.
+     */
+    int64_t _monotonicclockbase;
+    /**
+     * @brief Timestamp of the last message record
+     *
+     * The next record only stores the difference to it. Only used by the background thread.
+     */
+    int64_t _lasttimestamp;
+    /**
+     * @brief Dictionary of the file
+     *
+     * Maps the strings of the messages to their IDs. Only used by the background thread.
+     */
+    std::unordered_map<std::string, uint64_t> _dictionary;
+    /**
+     * @brief Writer thread
+     *
+     * This thread object will run the startWriter() method.
+     */
+    boost::thread _writerthread;
+
+    /**
+     * @brief Writer loop
+     *
+     * Swaps the queue of pending messages every writeInterval milliseconds and passes the messages to write(). Loops until _run is set to false and writes the remaining messages afterwards.
+     * @return Nothing
+     */
+    void startWriter();
+    /**
+     * @brief Write a batch of messages
+     *
+     * Encodes the messages into a single batch and appends it to the capture file. After an error, the file is closed and the capture ends.
+     *
+     * This method cannot throw exceptions, errors are forwarded to the global ExceptionHandler().
+     * @param messages The messages to be written
+     * @return Nothing
+     */
+    void write ( const std::vector<PendingMessage>& messages ) noexcept;
+    /**
+     * @brief Look up or create a dictionary ID
+     *
+     * If the string is not yet in the dictionary, a new ID is assigned and a dictionary record is appended to the batch.
+     * @param batch The batch being encoded
+     * @param text A string of a message
+     * @return ID of the string
+     */
+    uint64_t dictionaryID ( std::string& batch, const std::string& text );
+public:
+    /**
+     * @brief Constructor
+     *
+     * Creates the capture file capture-YYYYMMDD-HHMMSS-PID.anc in the given directory, writes the header and starts the writer thread.
+     * @param directory Capture directory, must exist and be writable
+     * @exception std::runtime_error The capture file cannot be created.
+     */
+    explicit MessageCapture ( const std::string& directory );
+    /**
+     * @brief Destructor
+     *
+     * Stops the writer thread after all queued messages have been written and closes the file.
+     */
+    ~MessageCapture();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of MessageCapture
+     */
+    MessageCapture ( const MessageCapture& other ) = delete;
+    /**
+     * @brief Move constructor (C++11, deleted)
+     *
+     * This class cannot be moved.
+     * @param other Another instance of MessageCapture
+     */
+    MessageCapture ( MessageCapture&& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of MessageCapture
+     * @return Nothing (deleted)
+     */
+    MessageCapture& operator= ( const MessageCapture& other ) = delete;
+    /**
+     * @brief Move assignment (C++11, deleted)
+     *
+     * This class cannot be moved.
+     * @param other Another instance of MessageCapture
+     * @return Nothing (deleted)
+     */
+    MessageCapture& operator= ( MessageCapture&& other ) = delete;
+    /**
+     * @brief Add a message to the capture
+     *
+     * The message is queued and written by the background thread. This method only locks a mutex for a very short time and never touches the disk, so it can be called from the message reception path.
+     *
+     * This method cannot throw exceptions. If the message cannot be queued, the error is forwarded to the global ExceptionHandler() and the message is missing from the capture.
+     * @param message The message as received
+     * @param received Monotonic time of the reception, see Metrics::now()
+     * @return Nothing
+     */
+    void append ( const AlarmServerMessage& message, const int64_t received ) noexcept;
+    /**
+     * @brief Read a capture file
+     *
+     * Maps the capture file into memory and decodes all complete batches. Decoding stops at the first incomplete or damaged batch, which usually is the last batch of a file written while the daemon was killed.
+     * @param filename Path of the capture file
+     * @param messages The decoded messages are appended to this vector in the order of their reception
+     * @return Nothing
+     * @exception std::runtime_error The file cannot be read or is not a capture file.
+     */
+    static void read ( const std::string& filename, std::vector<CapturedMessage>& messages );
+};
+
+}
+
+#endif // MESSAGECAPTURE_H
@@ -0,0 +1,88 @@
+/**
+ * @file messagesource.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Abstract source of alarm server messages
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef MESSAGESOURCE_H
+#define MESSAGESOURCE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <functional>
+
+#include "alarmservermessage.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Source of alarm server messages
+ *
+ * Delivers the messages of the CSS Alarm Server to CMSClient. In production this is ActiveMQMessageSource, which receives them from the message broker. InProcessMessageSource delivers messages handed over within the process instead, so AlarmServerConnector can be driven by tests and benchmarks without a message broker.
+ */
+class MessageSource
+{
+public:
+    /**
+     * @brief Message callback
+     *
+     * Called with each message and the monotonic time it has been received (see Metrics::now()). Calls for one source never overlap.
+     */
+    typedef std::function<void ( const AlarmServerMessage&, const int64_t ) > Receiver;
+    /**
+     * @brief Destructor
+     *
+     * Derived classes stop the delivery before they are destroyed.
+     */
+    virtual ~MessageSource() {}
+    /**
+     * @brief Start the delivery
+     *
+     * The receiver is called for every message from now on, usually from a thread of the source.
+     * @param receiver The callback
+     * @return Nothing
+     */
+    virtual void start ( const Receiver& receiver ) = 0;
+    /**
+     * @brief Stop the delivery
+     *
+     * After this method returns, the receiver is not running and will not be called anymore.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    virtual void stop() noexcept = 0;
+};
+
+}
+
+#endif // MESSAGESOURCE_H
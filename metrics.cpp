@@ -0,0 +1,362 @@
+/**
+ * @file metrics.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Low-overhead runtime metrics of the alarm pipeline
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "metrics.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <sys/socket.h>
+#include <time.h>
+
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+using namespace AlarmNotifications;
+
+const size_t Metrics::bucketCount;
+
+namespace
+{
+
+// Counters of one thread, only written by this thread
+struct ThreadBlock
+{
+    std::atomic<uint64_t> counters[Metrics::counterCount];
+    std::atomic<uint64_t> buckets[Metrics::histogramCount][Metrics::bucketCount];
+    std::atomic<uint64_t> sums[Metrics::histogramCount]; // Nanoseconds
+
+    ThreadBlock()
+    {
+        for ( size_t i = 0; i < Metrics::counterCount; i++ )
+            counters[i] = 0;
+        for ( size_t i = 0; i < Metrics::histogramCount; i++ )
+        {
+            for ( size_t j = 0; j < Metrics::bucketCount; j++ )
+                buckets[i][j] = 0;
+            sums[i] = 0;
+        }
+    }
+
+    void addTo ( ThreadBlock& total ) const
+    {
+        for ( size_t i = 0; i < Metrics::counterCount; i++ )
+            total.counters[i] += counters[i].load ( std::memory_order_relaxed );
+        for ( size_t i = 0; i < Metrics::histogramCount; i++ )
+        {
+            for ( size_t j = 0; j < Metrics::bucketCount; j++ )
+                total.buckets[i][j] += buckets[i][j].load ( std::memory_order_relaxed );
+            total.sums[i] += sums[i].load ( std::memory_order_relaxed );
+        }
+    }
+};
+
+struct Registry
+{
+    boost::mutex threadsmutex; // Protects threads and retired
+    std::vector<ThreadBlock*> threads;
+    ThreadBlock retired; // Sum of the blocks of all terminated threads
+    boost::mutex gaugemutex; // Protects gauges and nextgaugeid
+    std::map<unsigned int, Metrics::GaugeProvider> gauges;
+    unsigned int nextgaugeid;
+
+    Registry() : nextgaugeid ( 0 ) {}
+};
+
+// Never destroyed, threads may still record metrics while the static objects are destroyed at exit
+Registry& registry()
+{
+    static Registry*const global_instance = new Registry();
+    return *global_instance;
+}
+
+// Cache of the block of the current thread, faster than looking it up in the thread_specific_ptr each time
+__thread ThreadBlock* threadBlock = nullptr;
+
+// Called by Boost.Thread when a thread that has a block terminates
+void releaseThreadBlock ( ThreadBlock* block )
+{
+    {
+        boost::lock_guard<boost::mutex> concurrencylock ( registry().threadsmutex );
+        block->addTo ( registry().retired );
+        std::vector<ThreadBlock*>& threads = registry().threads;
+        for ( auto i = threads.begin(); i != threads.end(); i++ )
+            if ( *i == block )
+            {
+                threads.erase ( i );
+                break;
+            }
+    }
+    threadBlock = nullptr;
+    delete block;
+}
+
+ThreadBlock& localBlock() noexcept
+{
+    if ( threadBlock != nullptr )
+        return *threadBlock;
+    static boost::thread_specific_ptr<ThreadBlock>*const owner = new boost::thread_specific_ptr<ThreadBlock> ( &releaseThreadBlock );
+    try
+    {
+        ThreadBlock* block = new ThreadBlock();
+        {
+            boost::lock_guard<boost::mutex> concurrencylock ( registry().threadsmutex );
+            registry().threads.push_back ( block );
+        }
+        owner->reset ( block );
+        threadBlock = block;
+        return *block;
+    }
+    catch ( ... )
+    {
+        // Out of memory: Record into a shared block, the atomics keep the values correct
+        static ThreadBlock*const fallback = new ThreadBlock();
+        return *fallback;
+    }
+}
+
+const char*const counterNames[Metrics::counterCount][2] =
+{
+    { "an_messages_received_total", "Messages received from the message broker" },
+    { "an_messages_filtered_total", "Messages discarded because they do not describe an alarm state" },
+    { "an_messages_deduplicated_total", "Messages dropped because they repeat the severity and status of the active alarm of their PV" },
+    { "an_messages_skipped_total", "Messages clearing PVs that are not in alarm, dropped without taking the lock of the alarm map" },
+    { "an_messages_applied_total", "Messages that changed the map of active alarms" },
+    { "an_desktop_notifications_total", "Desktop notifications shown" },
+    { "an_email_notifications_total", "Notification e-mails sent successfully" },
+    { "an_email_notification_failures_total", "Notification e-mails that could not be sent" },
+    { "an_flashlight_switches_total", "Successful commands to the flash light relais" },
+    { "an_flashlight_failures_total", "Failed commands to the flash light relais" }
+};
+
+// Name, labels and help text, the help text is taken from the first histogram with the same name
+const char*const histogramNames[Metrics::histogramCount][3] =
+{
+    { "an_ingest_apply_latency_seconds", "", "Time from receiving a message to applying it to the map of active alarms" },
+    { "an_smtp_latency_seconds", "", "Time to send a notification e-mail" },
+    { "an_flashlight_latency_seconds", "", "Time to switch the flash light relais" },
+    { "an_receive_latency_seconds", "source=\"event\",", "Time from the event or the broker timestamp to receiving the message" },
+    { "an_receive_latency_seconds", "source=\"broker\",", "" },
+    { "an_notification_stage_latency_seconds", "channel=\"flashlight\",stage=\"apply_to_schedule\",", "Time spent in each stage of the notification pipeline" },
+    { "an_notification_stage_latency_seconds", "channel=\"flashlight\",stage=\"schedule_to_dispatch\",", "" },
+    { "an_notification_stage_latency_seconds", "channel=\"flashlight\",stage=\"dispatch_to_delivered\",", "" },
+    { "an_notification_end_to_end_latency_seconds", "channel=\"flashlight\",", "Time from the alarm event to the delivered notification" },
+    { "an_notification_stage_latency_seconds", "channel=\"desktop\",stage=\"apply_to_schedule\",", "" },
+    { "an_notification_stage_latency_seconds", "channel=\"desktop\",stage=\"schedule_to_dispatch\",", "" },
+    { "an_notification_stage_latency_seconds", "channel=\"desktop\",stage=\"dispatch_to_delivered\",", "" },
+    { "an_notification_end_to_end_latency_seconds", "channel=\"desktop\",", "" },
+    { "an_notification_stage_latency_seconds", "channel=\"email\",stage=\"apply_to_schedule\",", "" },
+    { "an_notification_stage_latency_seconds", "channel=\"email\",stage=\"schedule_to_dispatch\",", "" },
+    { "an_notification_stage_latency_seconds", "channel=\"email\",stage=\"dispatch_to_delivered\",", "" },
+    { "an_notification_end_to_end_latency_seconds", "channel=\"email\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"notifyStatusChange\",", "Time spent waiting for a lock, by mutex and call site" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"notifyStatusChange\",", "Time a lock has been held, by mutex and call site" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"checkStatusMap\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"checkStatusMap\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"prepareDesktopNotification\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"prepareEMailNotification\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"switchFlashLightOn\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"switchFlashLightOn\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"writeSnapshot\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"writeSnapshot\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"restoreSnapshot\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"restoreSnapshot\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"writeGauges\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"writeGauges\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"snapshotForLocalClients\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"snapshotForLocalClients\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"getActiveAlarms\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"getActiveAlarms\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"statusmap\",site=\"startDebounceTimer\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"statusmap\",site=\"startDebounceTimer\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"asc\",site=\"toggleNotifications\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"asc\",site=\"toggleNotifications\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"asc\",site=\"showStatusMessage\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"asc\",site=\"showStatusMessage\",", "" },
+    { "an_lock_wait_seconds", "mutex=\"asc\",site=\"observeAlarmStatus\",", "" },
+    { "an_lock_hold_seconds", "mutex=\"asc\",site=\"observeAlarmStatus\",", "" }
+};
+
+}
+
+int64_t Metrics::now() noexcept
+{
+    timespec monotonic;
+    clock_gettime ( CLOCK_MONOTONIC, &monotonic );
+    return static_cast<int64_t> ( monotonic.tv_sec ) * 1000000000 + monotonic.tv_nsec;
+}
+
+void Metrics::increment ( const Metrics::Counter counter, const uint64_t amount ) noexcept
+{
+    localBlock().counters[counter].fetch_add ( amount, std::memory_order_relaxed );
+}
+
+void Metrics::observe ( const Metrics::Histogram histogram, const int64_t nanoseconds ) noexcept
+{
+    const uint64_t value = ( nanoseconds > 0 ) ? static_cast<uint64_t> ( nanoseconds ) : 0;
+    // Bucket n holds the values up to 2^n microseconds
+    const uint64_t microseconds = ( value + 999 ) / 1000;
+    size_t bucket = ( microseconds <= 1 ) ? 0 : static_cast<size_t> ( 64 - __builtin_clzll ( microseconds - 1 ) );
+    if ( bucket >= bucketCount )
+        bucket = bucketCount - 1;
+    ThreadBlock& block = localBlock();
+    block.buckets[histogram][bucket].fetch_add ( 1, std::memory_order_relaxed );
+    block.sums[histogram].fetch_add ( value, std::memory_order_relaxed );
+}
+
+uint64_t Metrics::total ( const Metrics::Counter counter )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( registry().threadsmutex );
+    uint64_t value = registry().retired.counters[counter].load ( std::memory_order_relaxed );
+    for ( auto i = registry().threads.begin(); i != registry().threads.end(); i++ )
+        value += ( *i )->counters[counter].load ( std::memory_order_relaxed );
+    return value;
+}
+
+unsigned int Metrics::addGaugeProvider ( const Metrics::GaugeProvider& provider )
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( registry().gaugemutex );
+    const unsigned int id = registry().nextgaugeid++;
+    registry().gauges.insert ( std::make_pair ( id, provider ) );
+    return id;
+}
+
+void Metrics::removeGaugeProvider ( const unsigned int id ) noexcept
+{
+    boost::lock_guard<boost::mutex> concurrencylock ( registry().gaugemutex );
+    registry().gauges.erase ( id );
+}
+
+std::string Metrics::scrape()
+{
+    ThreadBlock total;
+    {
+        boost::lock_guard<boost::mutex> concurrencylock ( registry().threadsmutex );
+        registry().retired.addTo ( total );
+        for ( auto i = registry().threads.begin(); i != registry().threads.end(); i++ )
+            ( *i )->addTo ( total );
+    }
+
+    std::ostringstream text;
+    for ( size_t i = 0; i < counterCount; i++ )
+    {
+        text << "# HELP " << counterNames[i][0] << " " << counterNames[i][1] << "\n";
+        text << "# TYPE " << counterNames[i][0] << " counter\n";
+        text << counterNames[i][0] << " " << total.counters[i].load() << "\n";
+    }
+    for ( size_t i = 0; i < histogramCount; i++ )
+    {
+        const std::string name ( histogramNames[i][0] );
+        bool written = false;
+        for ( size_t k = 0; k < i && !written; k++ )
+            written = name == histogramNames[k][0];
+        if ( written )
+            continue; // Already written together with the first histogram of this name
+        text << "# HELP " << name << " " << histogramNames[i][2] << "\n";
+        text << "# TYPE " << name << " histogram\n";
+        // All histograms with the same name have to be written in one group
+        for ( size_t k = i; k < histogramCount; k++ )
+        {
+            if ( name != histogramNames[k][0] )
+                continue;
+            const std::string labels ( histogramNames[k][1] ); // Empty or ending with a comma
+            const std::string plainLabels = labels.empty() ? labels : "{" + labels.substr ( 0, labels.length() - 1 ) + "}";
+            uint64_t count = 0;
+            for ( size_t j = 0; j < bucketCount; j++ )
+            {
+                count += total.buckets[k][j].load();
+                char bound[32];
+                if ( j + 1 < bucketCount )
+                    snprintf ( bound, sizeof ( bound ), "%.9g", static_cast<double> ( static_cast<uint64_t> ( 1 ) << j ) * 1e-6 );
+                else
+                    snprintf ( bound, sizeof ( bound ), "+Inf" );
+                text << name << "_bucket{" << labels << "le=\"" << bound << "\"} " << count << "\n";
+            }
+            char sum[32];
+            snprintf ( sum, sizeof ( sum ), "%.9f", static_cast<double> ( total.sums[k].load() ) * 1e-9 );
+            text << name << "_sum" << plainLabels << " " << sum << "\n";
+            text << name << "_count" << plainLabels << " " << count << "\n";
+        }
+    }
+    {
+        boost::lock_guard<boost::mutex> concurrencylock ( registry().gaugemutex );
+        for ( auto i = registry().gauges.begin(); i != registry().gauges.end(); i++ )
+            ( *i ).second ( text );
+    }
+    return text.str();
+}
+
+void Metrics::serveScrape ( const int fd ) noexcept
+{
+    try
+    {
+        // Read the request header, its content does not matter
+        std::string request;
+        char buffer[1024];
+        while ( request.find ( "\r\n\r\n" ) == std::string::npos && request.find ( "\n\n" ) == std::string::npos && request.size() < 8192 )
+        {
+            const ssize_t result = recv ( fd, buffer, sizeof ( buffer ), 0 );
+            if ( result < 0 && errno == EINTR )
+                continue;
+            if ( result <= 0 )
+                break;
+            request.append ( buffer, static_cast<size_t> ( result ) );
+        }
+        const std::string body = scrape();
+        std::ostringstream response;
+        response << "HTTP/1.0 200 OK\r\n"
+                 << "Content-Type: text/plain; version=0.0.4\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        const std::string data = response.str();
+        size_t written = 0;
+        while ( written < data.size() )
+        {
+            const ssize_t result = send ( fd, data.data() + written, data.size() - written, MSG_NOSIGNAL );
+            if ( result < 0 && errno == EINTR )
+                continue;
+            if ( result <= 0 )
+                break; // The client has gone away, nothing to do
+            written += static_cast<size_t> ( result );
+        }
+    }
+    catch ( ... )
+    {
+        // Only std::bad_alloc, the client will see the connection being closed
+    }
+}
@@ -0,0 +1,213 @@
+/**
+ * @file metrics.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Low-overhead runtime metrics of the alarm pipeline
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Runtime metrics of the alarm pipeline
+ *
+ * Collects counters and latency histograms from all parts of the application and renders them in the Prometheus text exposition format.
+ *
+ * Each thread records into its own block of counters, allocated on its first use. Recording a value therefore never touches a cache line shared with another thread and never waits for a lock, it only increments a relaxed atomic. The blocks of all threads are added up only when the metrics are scraped. When a thread terminates, its block is folded into a block of retired threads, so short-lived threads like the e-mail senders do not accumulate memory.
+ *
+ * Values that describe a current state rather than events, e.g. the number of active alarms, are provided by gauge callbacks that are invoked during the scrape.
+ *
+ * All methods are static and thread-safe.
+ */
+class Metrics final
+{
+public:
+    /**
+     * @brief Event counters
+     */
+    enum Counter
+    {
+        MessagesReceived = 0, ///< Messages received from the message broker
+        MessagesFiltered, ///< Messages discarded, e.g. IDLE messages of the alarm server
+        MessagesDeduplicated, ///< Messages dropped because they repeat the active alarm state of their PV
+        MessagesSkipped, ///< Messages clearing PVs that are not in alarm, dropped without taking the lock
+        MessagesApplied, ///< Messages that changed the map of active alarms
+        DesktopNotificationsSent, ///< Desktop notifications shown
+        EMailNotificationsSent, ///< Notification e-mails sent successfully
+        EMailNotificationsFailed, ///< Notification e-mails that could not be sent
+        FlashLightSwitches, ///< Successful commands to the flash light relais
+        FlashLightFailures, ///< Failed commands to the flash light relais
+        counterCount ///< Number of counters, not a counter itself
+    };
+    /**
+     * @brief Latency histograms
+     */
+    enum Histogram
+    {
+        IngestApplyLatency = 0, ///< From receiving a message to applying it to the map of active alarms
+        SMTPLatency, ///< Sending a notification e-mail
+        FlashLightLatency, ///< Switching the flash light relais
+        EventToReceiveLatency, ///< From the event time given by the alarm server to receiving the message
+        BrokerToReceiveLatency, ///< From the message broker accepting the message to receiving it
+        FlashLightApplyToSchedule, ///< From applying the alarm to deciding to switch on the flash light
+        FlashLightScheduleToDispatch, ///< From deciding to switch on the flash light to sending the command
+        FlashLightDispatchToDelivered, ///< From sending the command to the flash light relais to its completion
+        FlashLightEndToEnd, ///< From the alarm event to the flash light being switched on
+        DesktopApplyToSchedule, ///< From applying the alarm to selecting it for a desktop notification
+        DesktopScheduleToDispatch, ///< From selecting the alarm to starting the desktop notification
+        DesktopDispatchToDelivered, ///< From starting the desktop notification to it being shown
+        DesktopEndToEnd, ///< From the alarm event to the desktop notification being shown
+        EMailApplyToSchedule, ///< From applying the alarm to selecting it for an e-mail notification
+        EMailScheduleToDispatch, ///< From selecting the alarm to starting to send the e-mail
+        EMailDispatchToDelivered, ///< From starting to send the e-mail to the SMTP server accepting it
+        EMailEndToEnd, ///< From the alarm event to the SMTP server accepting the e-mail
+        NotifyStatusChangeLockWait, ///< Waiting for the lock in AlarmServerConnector::notifyStatusChange()
+        NotifyStatusChangeLockHold, ///< Holding the lock in AlarmServerConnector::notifyStatusChange()
+        CheckStatusMapLockWait, ///< Waiting for the lock in AlarmServerConnector::checkStatusMap()
+        CheckStatusMapLockHold, ///< Holding the lock in AlarmServerConnector::checkStatusMap()
+        PrepareDesktopNotificationLockHold, ///< Holding the lock in AlarmServerConnector::prepareDesktopNotification(), part of the hold time of checkStatusMap()
+        PrepareEMailNotificationLockHold, ///< Holding the lock in AlarmServerConnector::prepareEMailNotification(), part of the hold time of checkStatusMap()
+        SwitchFlashLightOnLockWait, ///< Waiting for the lock in AlarmServerConnector::switchFlashLightOn()
+        SwitchFlashLightOnLockHold, ///< Holding the lock in AlarmServerConnector::switchFlashLightOn()
+        WriteSnapshotLockWait, ///< Waiting for the lock in AlarmServerConnector::writeSnapshot()
+        WriteSnapshotLockHold, ///< Holding the lock in AlarmServerConnector::writeSnapshot()
+        RestoreSnapshotLockWait, ///< Unused since AlarmServerConnector::restoreSnapshot() runs before any message is received, kept so the exported histograms do not change
+        RestoreSnapshotLockHold, ///< Filling the shards in AlarmServerConnector::restoreSnapshot()
+        WriteGaugesLockWait, ///< Waiting for the lock in AlarmServerConnector::writeGauges()
+        WriteGaugesLockHold, ///< Holding the lock in AlarmServerConnector::writeGauges()
+        LocalClientSnapshotLockWait, ///< Waiting for the lock in AlarmServerConnector::snapshotForLocalClients()
+        LocalClientSnapshotLockHold, ///< Holding the lock in AlarmServerConnector::snapshotForLocalClients()
+        GetActiveAlarmsLockWait, ///< Waiting for the lock in AlarmServerConnector::getActiveAlarms()
+        GetActiveAlarmsLockHold, ///< Holding the lock in AlarmServerConnector::getActiveAlarms()
+        DebounceTimerLockWait, ///< Waiting for the lock in AlarmServerConnector::startDebounceTimer()
+        DebounceTimerLockHold, ///< Holding the lock in AlarmServerConnector::startDebounceTimer()
+        ToggleNotificationsLockWait, ///< Waiting for the lock in DesktopAlarmWidget::toggleNotifications()
+        ToggleNotificationsLockHold, ///< Holding the lock in DesktopAlarmWidget::toggleNotifications()
+        ShowStatusMessageLockWait, ///< Waiting for the lock in DesktopAlarmWidget::showStatusMessage()
+        ShowStatusMessageLockHold, ///< Holding the lock in DesktopAlarmWidget::showStatusMessage()
+        ObserveAlarmStatusLockWait, ///< Waiting for the lock in DesktopAlarmWidget::observeAlarmStatus()
+        ObserveAlarmStatusLockHold, ///< Holding the lock in DesktopAlarmWidget::observeAlarmStatus()
+        histogramCount ///< Number of histograms, not a histogram itself
+    };
+    /**
+     * @brief Number of histogram buckets
+     *
+     * The upper bound of bucket n is 2^n microseconds, the last bucket collects everything above 2^(bucketCount - 2) microseconds, i.e. about 72 minutes. The range covers the notification timeouts, which are part of the end-to-end latencies.
+     */
+    static const size_t bucketCount = 34;
+    /**
+     * @brief Callback providing gauges
+     *
+     * Called during a scrape to write complete metric lines in the Prometheus text format into the stream.
+     */
+    typedef std::function<void ( std::ostream& ) > GaugeProvider;
+    /**
+     * @brief Constructor (deleted)
+     *
+     * This class only has static methods.
+     */
+    Metrics() = delete;
+    /**
+     * @brief Current monotonic time
+     *
+     * Timestamps for latency measurements. This method cannot throw exceptions.
+     * @return Nanoseconds of CLOCK_MONOTONIC
+     */
+    static int64_t now() noexcept;
+    /**
+     * @brief Count events
+     *
+     * @param counter The counter to be incremented
+     * @param amount Number of events
+     * @return Nothing
+     */
+    static void increment ( const Counter counter, const uint64_t amount = 1 ) noexcept;
+    /**
+     * @brief Record a latency
+     *
+     * @param histogram The histogram the latency belongs to
+     * @param nanoseconds The measured latency, negative values are counted as zero
+     * @return Nothing
+     */
+    static void observe ( const Histogram histogram, const int64_t nanoseconds ) noexcept;
+    /**
+     * @brief Current value of a counter
+     *
+     * Adds up the counter of all threads, without the histograms.
+     * @param counter The counter
+     * @return Number of events counted since the start of the program
+     */
+    static uint64_t total ( const Counter counter );
+    /**
+     * @brief Register gauge callback
+     *
+     * The callback is invoked on each scrape until it is removed with removeGaugeProvider(). It must not call any other method of this class.
+     * @param provider The callback
+     * @return ID to be passed to removeGaugeProvider()
+     */
+    static unsigned int addGaugeProvider ( const GaugeProvider& provider );
+    /**
+     * @brief Remove gauge callback
+     *
+     * After this method returns, the callback is not running and will not be invoked anymore.
+     * @param id ID returned by addGaugeProvider()
+     * @return Nothing
+     */
+    static void removeGaugeProvider ( const unsigned int id ) noexcept;
+    /**
+     * @brief Render all metrics
+     *
+     * Adds up the blocks of all threads and invokes the gauge callbacks.
+     * @return All metrics in the Prometheus text exposition format
+     */
+    static std::string scrape();
+    /**
+     * @brief Answer a scrape request
+     *
+     * Reads an HTTP request from a connected socket and answers it with the result of scrape(). Every request is answered with the metrics, whatever its path. Meant to be used as handler of a LocalSocketServer.
+     * @param fd The connected socket, not closed by this method
+     * @return Nothing
+     */
+    static void serveScrape ( const int fd ) noexcept;
+};
+
+}
+
+#endif // METRICS_H
@@ -0,0 +1,179 @@
+/**
+ * @file sharedtablemessagesource.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Alarms read from the shared alarm table of an-daemon
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "sharedtablemessagesource.h"
+
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "activemqmessagesource.h"
+#include "exceptionhandler.h"
+#include "metrics.h"
+
+using namespace AlarmNotifications;
+
+const unsigned int SharedTableMessageSource::pollInterval;
+
+SharedTableMessageSource::SharedTableMessageSource ( const std::string& name )
+    : _name ( name ),
+      _table ( new AlarmSharedTable ( name, false ) ),
+      _generation ( 0 ),
+      _writerlost ( 0 ),
+      _run ( false )
+{
+}
+
+SharedTableMessageSource::~SharedTableMessageSource()
+{
+    stop();
+}
+
+void SharedTableMessageSource::start ( const MessageSource::Receiver& receiver )
+{
+    if ( _run )
+        throw std::runtime_error ( "The shared table message source has already been started!" );
+    _receiver = receiver;
+    _generation = std::numeric_limits<uint64_t>::max(); // Deliver all alarms on the first check
+    _run = true;
+    _pollThread = boost::thread ( &SharedTableMessageSource::poll, this );
+}
+
+void SharedTableMessageSource::stop() noexcept
+{
+    _run = false;
+    if ( _pollThread.joinable() )
+    {
+        _pollThread.interrupt();
+        _pollThread.join();
+    }
+    if ( _fallback )
+        _fallback->stop();
+}
+
+void SharedTableMessageSource::poll() noexcept
+{
+    try
+    {
+        while ( _run )
+        {
+            if ( !_table->writerAlive() && !reattach() )
+            {
+                if ( _writerlost == 0 )
+                    _writerlost = Metrics::now();
+                if ( Metrics::now() - _writerlost < AlarmSharedTable::heartbeatTimeout * 1000000000 )
+                {
+                    // Give a restarting daemon the time to publish a new table
+                    boost::this_thread::sleep ( boost::posix_time::milliseconds ( pollInterval ) );
+                    continue;
+                }
+                std::cerr << "an-daemon does not publish the shared alarm table " << _name << " anymore, connecting to the message broker." << std::endl;
+                _fallback.reset ( new ActiveMQMessageSource() );
+                _fallback->start ( _receiver );
+                return;
+            }
+            _writerlost = 0;
+            const uint64_t generation = _table->generation();
+            if ( generation != _generation )
+            {
+                _generation = generation;
+                deliverChanges();
+            }
+            boost::this_thread::sleep ( boost::posix_time::milliseconds ( pollInterval ) );
+        }
+    }
+    catch ( boost::thread_interrupted& )
+    {
+        // stop() has been called
+    }
+    catch ( std::exception& e )
+    {
+        ExceptionHandler ( e, "reading the shared alarm table." );
+    }
+    catch ( ... )
+    {
+        ExceptionHandler ( "reading the shared alarm table." );
+    }
+}
+
+void SharedTableMessageSource::deliverChanges()
+{
+    std::map<std::string, AlarmSharedTable::Row> current;
+    _table->read ( current );
+    AlarmServerMessage message;
+    message.text = "STATE";
+    // Both maps are sorted by PV name, so a single pass finds all differences
+    auto delivered = _delivered.begin();
+    auto row = current.begin();
+    while ( delivered != _delivered.end() || row != current.end() )
+    {
+        if ( row == current.end() || ( delivered != _delivered.end() && ( *delivered ).first < ( *row ).first ) )
+        {
+            message.name = ( *delivered ).first;
+            message.severity = "OK";
+            message.status = "NO_ALARM";
+            _receiver ( message, Metrics::now() );
+            delivered++;
+            continue;
+        }
+        const bool known = delivered != _delivered.end() && ( *delivered ).first == ( *row ).first;
+        if ( !known || ( *delivered ).second.severity != ( *row ).second.severity || ( *delivered ).second.status != ( *row ).second.status )
+        {
+            message.name = ( *row ).first;
+            message.severity = ( *row ).second.severity;
+            message.status = ( *row ).second.status;
+            _receiver ( message, Metrics::now() );
+        }
+        if ( known )
+            delivered++;
+        row++;
+    }
+    _delivered.swap ( current );
+}
+
+bool SharedTableMessageSource::reattach() noexcept
+{
+    try
+    {
+        std::unique_ptr<AlarmSharedTable> table ( new AlarmSharedTable ( _name, false ) );
+        if ( !table->writerAlive() )
+            return false;
+        _table = std::move ( table );
+        _generation = std::numeric_limits<uint64_t>::max(); // Compare with the new table in any case
+        return true;
+    }
+    catch ( ... )
+    {
+        return false; // No daemon has published a new table yet
+    }
+}
@@ -0,0 +1,186 @@
+/**
+ * @file sharedtablemessagesource.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Alarms read from the shared alarm table of an-daemon
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef SHAREDTABLEMESSAGESOURCE_H
+#define SHAREDTABLEMESSAGESOURCE_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <boost/thread.hpp>
+
+#include "alarmsharedtable.h"
+#include "messagesource.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Alarms read from the shared alarm table of an-daemon
+ *
+ * Used by the desktop widgets if an-daemon runs on the same machine: Instead of opening a connection to the message broker for every widget, they read the AlarmSharedTable published by the daemon. A thread checks the generation of the table every pollInterval milliseconds and, if it has changed, compares the table with the alarms delivered so far. For each raised, changed or cleared alarm, it passes a STATE message to the receiver, so AlarmServerConnector handles them like the messages of the alarm server.
+ *
+ * If the daemon stops, the source waits for a new daemon to publish the table under the same name, e.g. after an upgrade. If there is none within AlarmSharedTable::heartbeatTimeout seconds, it continues with an ActiveMQMessageSource of its own for the rest of its lifetime.
+ */
+class SharedTableMessageSource final : public MessageSource
+{
+private:
+    /**
+     * @brief Interval of the checks
+     *
+     * Time in milliseconds the polling thread waits between two looks at the generation of the table.
+     */
+    static const unsigned int pollInterval = 100;
+    /**
+     * @brief Name of the shared memory segment
+     */
+    const std::string _name;
+    /**
+     * @brief The table published by an-daemon
+     */
+    std::unique_ptr<AlarmSharedTable> _table;
+    /**
+     * @brief Alarms delivered to the receiver so far
+     *
+     * Only used by the polling thread.
+     */
+    std::map<std::string, AlarmSharedTable::Row> _delivered;
+    /**
+     * @brief Generation of the table at the last comparison
+     */
+    uint64_t _generation;
+    /**
+     * @brief Time the writer has been found gone
+     *
+     * Monotonic time in nanoseconds (see Metrics::now()), 0 as long as the writer is alive.
+     */
+    int64_t _writerlost;
+    /**
+     * @brief The callback passed to start()
+     */
+    MessageSource::Receiver _receiver;
+    /**
+     * @brief Connection to the message broker
+     *
+     * A null pointer as long as an-daemon publishes the table. Created by the polling thread when the daemon is gone.
+     */
+    std::unique_ptr<MessageSource> _fallback;
+    /**
+     * @brief Polling thread abortion flag
+     */
+    bool _run;
+    /**
+     * @brief Polling thread
+     *
+     * Runs poll().
+     */
+    boost::thread _pollThread;
+
+    /**
+     * @brief Check the table periodically
+     *
+     * Calls deliverChanges() whenever the generation of the table has changed, until _run is false or the daemon has been gone for AlarmSharedTable::heartbeatTimeout seconds.
+     * @return Nothing
+     */
+    void poll() noexcept;
+    /**
+     * @brief Pass the changes of the table to the receiver
+     *
+     * Compares the table with _delivered and passes a STATE message to the receiver for every difference, with severity "OK" for alarms that have been cleared.
+     * @return Nothing
+     */
+    void deliverChanges();
+    /**
+     * @brief Open the table again
+     *
+     * Called when the writer of the current table is gone, a restarted daemon publishes a new segment under the same name.
+     *
+     * This method cannot throw exceptions.
+     * @return true if a table with a live writer has been found
+     */
+    bool reattach() noexcept;
+public:
+    /**
+     * @brief Constructor
+     *
+     * Maps the table, use AlarmSharedTable::available() to find out whether a daemon publishes it.
+     * @param name Name of the POSIX shared memory segment
+     * @exception std::runtime_error The table cannot be opened
+     */
+    explicit SharedTableMessageSource ( const std::string& name );
+    /**
+     * @brief Destructor
+     *
+     * Stops the polling thread and the connection to the message broker, if any.
+     */
+    virtual ~SharedTableMessageSource();
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of SharedTableMessageSource
+     */
+    SharedTableMessageSource ( const SharedTableMessageSource& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of SharedTableMessageSource
+     * @return Nothing (deleted)
+     */
+    SharedTableMessageSource& operator= ( const SharedTableMessageSource& other ) = delete;
+    /**
+     * @brief Start the delivery
+     *
+     * Starts the polling thread, the first check delivers all alarms currently in the table.
+     * @param receiver The callback
+     * @return Nothing
+     * @exception std::runtime_error The source has already been started
+     */
+    virtual void start ( const MessageSource::Receiver& receiver );
+    /**
+     * @brief Stop the delivery
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    virtual void stop() noexcept;
+};
+
+}
+
+#endif // SHAREDTABLEMESSAGESOURCE_H
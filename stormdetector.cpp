@@ -0,0 +1,129 @@
+/**
+ * @file stormdetector.cpp
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Detection of alarm storms
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#include "stormdetector.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+using namespace AlarmNotifications;
+
+const unsigned int StormDetector::notificationInterval;
+const size_t StormDetector::summaryAreas;
+
+// Weight of the latest interval in the moving average, the rate reaches the threshold within three seconds of a storm at twice its rate
+static const double smoothingFactor = 0.3;
+
+StormDetector::StormDetector ( const unsigned int threshold ) noexcept
+    : _threshold ( threshold ),
+      _changes ( 0 ),
+      _counted ( 0 ),
+      _lastupdate ( 0 ),
+      _rate ( 0.0 ),
+      _storm ( false )
+{
+}
+
+void StormDetector::record() noexcept
+{
+    _changes.fetch_add ( 1, std::memory_order_relaxed );
+}
+
+bool StormDetector::update ( const int64_t now ) noexcept
+{
+    const uint64_t changes = _changes.load ( std::memory_order_relaxed );
+    if ( _lastupdate == 0 || now <= _lastupdate )
+    {
+        _counted = changes;
+        _lastupdate = now;
+        return false;
+    }
+    const double interval = static_cast<double> ( now - _lastupdate ) / 1e9;
+    const double latest = static_cast<double> ( changes - _counted ) / interval;
+    const double rate = smoothingFactor * latest + ( 1.0 - smoothingFactor ) * _rate.load ( std::memory_order_relaxed );
+    _counted = changes;
+    _lastupdate = now;
+    _rate.store ( rate, std::memory_order_relaxed );
+    if ( _threshold == 0.0 )
+        return false; // Storm detection disabled
+    const bool storm = _storm.load ( std::memory_order_relaxed );
+    if ( !storm && rate > _threshold )
+    {
+        _storm.store ( true, std::memory_order_relaxed );
+        return true;
+    }
+    if ( storm && rate < _threshold / 2.0 )
+    {
+        _storm.store ( false, std::memory_order_relaxed );
+        return true;
+    }
+    return false;
+}
+
+bool StormDetector::inStorm() const noexcept
+{
+    return _storm.load ( std::memory_order_relaxed );
+}
+
+double StormDetector::getRate() const noexcept
+{
+    return _rate.load ( std::memory_order_relaxed );
+}
+
+std::string StormDetector::areaOf ( const std::string& pvname )
+{
+    return pvname.substr ( 0, pvname.find ( ':' ) );
+}
+
+std::string StormDetector::summarise ( const std::vector<AlarmStatusEntry>& alarms )
+{
+    std::map<std::string, size_t> areas;
+    for ( auto i = alarms.begin(); i != alarms.end(); i++ )
+        areas[areaOf ( ( *i ).getPVName() )]++;
+    std::vector<std::pair<size_t, std::string>> sorted;
+    sorted.reserve ( areas.size() );
+    for ( auto i = areas.begin(); i != areas.end(); i++ )
+        sorted.push_back ( std::make_pair ( ( *i ).second, ( *i ).first ) );
+    // Most alarms first, areas with the same number in alphabetical order
+    std::sort ( sorted.begin(), sorted.end(), [] ( const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b )
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    } );
+    std::string text = "Alarm storm, " + std::to_string ( alarms.size() ) + ( alarms.size() == 1 ? " PV" : " PVs" ) + " in alarm:\n";
+    for ( size_t i = 0; i < sorted.size() && i < summaryAreas; i++ )
+        text += sorted[i].second + ": " + std::to_string ( sorted[i].first ) + ( sorted[i].first == 1 ? " PV" : " PVs" ) + " in alarm\n";
+    if ( sorted.size() > summaryAreas )
+        text += "... and " + std::to_string ( sorted.size() - summaryAreas ) + " more areas\n";
+    return text;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file stormdetector.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Detection of alarm storms
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef STORMDETECTOR_H
+#define STORMDETECTOR_H
+
+#include "oldgcccompat.h" // Compatibilty macros for GCC < 4.7
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "alarmstatusentry.h"
+
+namespace AlarmNotifications
+{
+
+/**
+ * @brief Detection of alarm storms
+ *
+ * When an IOC reboots or a power supply trips, hundreds of PVs change their alarm state within a second. Listing all of them in a desktop notification and sending a new notification every second helps nobody, so AlarmServerConnector counts every change applied to its map of active alarms here and asks once per second whether a storm is going on.
+ *
+ * The rate of changes is estimated by an exponentially weighted moving average over the one-second intervals, which rises within a few seconds of a storm but ignores a single burst of a few changes. Storm mode is entered when the rate exceeds the threshold and left when it has fallen below half of it, so the mode does not flap at the threshold.
+ */
+class StormDetector final
+{
+public:
+    /**
+     * @brief Minimum time in seconds between two notifications during a storm
+     */
+    static const unsigned int notificationInterval = 30;
+    /**
+     * @brief Maximum number of areas listed by summarise()
+     */
+    static const size_t summaryAreas = 10;
+private:
+    /**
+     * @brief Rate of changes per second that starts storm mode, 0 if storm detection is disabled
+     */
+    const double _threshold;
+    /**
+     * @brief Number of changes recorded since the start
+     */
+    std::atomic<uint64_t> _changes;
+    /**
+     * @brief Value of _changes at the last call of update()
+     */
+    uint64_t _counted;
+    /**
+     * @brief Monotonic time of the last call of update() in nanoseconds, 0 before the first call
+     */
+    int64_t _lastupdate;
+    /**
+     * @brief Estimated rate of changes per second
+     */
+    std::atomic<double> _rate;
+    /**
+     * @brief Storm mode flag
+     */
+    std::atomic<bool> _storm;
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param threshold Rate of changes per second that starts storm mode, 0 to disable storm detection
+     */
+    explicit StormDetector ( const unsigned int threshold ) noexcept;
+    /**
+     * @brief Copy constructor (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of StormDetector
+     */
+    StormDetector ( const StormDetector& other ) = delete;
+    /**
+     * @brief Copy assignment (deleted)
+     *
+     * This class cannot be copied.
+     * @param other Another instance of StormDetector
+     * @return Nothing (deleted)
+     */
+    StormDetector& operator= ( const StormDetector& other ) = delete;
+    /**
+     * @brief Count a change of the map of active alarms
+     *
+     * Only increments an atomic counter, so it can be called for every message without a lock.
+     *
+     * This method cannot throw exceptions.
+     * @return Nothing
+     */
+    void record() noexcept;
+    /**
+     * @brief Update the estimated rate and the storm mode
+     *
+     * To be called about once per second from a single thread, the watcher thread of AlarmServerConnector.
+     *
+     * This method cannot throw exceptions.
+     * @param now Current monotonic time in nanoseconds, see Clock::monotonicNow()
+     * @return true if storm mode has been entered or left by this call
+     */
+    bool update ( const int64_t now ) noexcept;
+    /**
+     * @brief Check whether a storm is going on
+     *
+     * This method cannot throw exceptions.
+     * @return true in storm mode
+     */
+    bool inStorm() const noexcept;
+    /**
+     * @brief Estimated rate of changes
+     *
+     * This method cannot throw exceptions.
+     * @return Changes per second, averaged as described above
+     */
+    double getRate() const noexcept;
+    /**
+     * @brief Area of a PV
+     *
+     * The area is the part of the PV name before the first colon, e.g. "HV" for "HV:CH12:Voltage". A PV name without a colon is an area of its own.
+     * @param pvname PV name
+     * @return Name of the area
+     */
+    static std::string areaOf ( const std::string& pvname );
+    /**
+     * @brief Summarise alarms by area
+     *
+     * Used instead of the list of PV names during a storm. The areas with the most alarms come first, e.g. "HV: 214 PVs in alarm", and only summaryAreas of them are listed.
+     * @param alarms Alarms to be summarised
+     * @return Text of the notification
+     */
+    static std::string summarise ( const std::vector<AlarmStatusEntry>& alarms );
+};
+
+}
+
+#endif // STORMDETECTOR_H
@@ -0,0 +1,80 @@
+/**
+ * @file tracepoints.h
+ *
+ * @author Tobias Triffterer
+ *
+ * @brief Static tracepoints for tracing the alarm path of a running daemon
+ *
+ * @version 1.0.0
+ *
+ * AlarmNotifications - Laboratory and desktop notification framework to
+ * be used with EPICS and Control System Studio
+ *
+ * Copyright © 2014 by Tobias Triffterer <tobias@ep1.ruhr-uni-bochum.de>
+ * for Institut für Experimentalphysik I der Ruhr-Universität Bochum
+ * (http://ep1.ruhr-uni-bochum.de)
+ *
+ * The latest source code is here: https://github.com/ttrubep1/AlarmNotifications
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+/*
+ * The probes are USDT probes as used by SystemTap, bpftrace and perf. Each of them compiles into a single
+ * nop instruction and a note in the ELF file, so they do not cost anything unless a tracer attaches to
+ * them. The provider is "alarmnotifications", times are in nanoseconds of CLOCK_MONOTONIC as returned by
+ * Metrics::now(), which is the same clock as nsecs in bpftrace. The time a probe fires is never passed as
+ * an argument, as reading the clock would cost something even without a tracer; use nsecs instead.
+ * Strings are passed as const char*.
+ *
+ * Probes (arguments in order):
+ *  message__receive       received
+ *  message__done          pvname ("" if filtered), received, filtered (0/1)
+ *  alarm__apply           pvname, transition type (AlarmTransition::TransitionType), severity level, received
+ *  deadline__expired      channel ("flashlight", "desktop", "email"), trigger time of the oldest alarm (Unix time)
+ *  notification__dispatch channel, number of alarms, scheduled
+ *  flashlight__switch     on (0/1)
+ *  flashlight__switched   on (0/1)
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define AN_TRACE1(name, a1) DTRACE_PROBE1(alarmnotifications, name, a1)
+#define AN_TRACE2(name, a1, a2) DTRACE_PROBE2(alarmnotifications, name, a1, a2)
+#define AN_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(alarmnotifications, name, a1, a2, a3)
+#define AN_TRACE4(name, a1, a2, a3, a4) DTRACE_PROBE4(alarmnotifications, name, a1, a2, a3, a4)
+#else // Without sys/sdt.h (package systemtap-sdt-dev or systemtap-sdt-devel) the tracepoints are compiled out
+/**
+ * @brief Fire a static tracepoint with one argument
+ **/
+#define AN_TRACE1(name, a1) do {} while ( 0 )
+/**
+ * @brief Fire a static tracepoint with two arguments
+ **/
+#define AN_TRACE2(name, a1, a2) do {} while ( 0 )
+/**
+ * @brief Fire a static tracepoint with three arguments
+ **/
+#define AN_TRACE3(name, a1, a2, a3) do {} while ( 0 )
+/**
+ * @brief Fire a static tracepoint with four arguments
+ **/
+#define AN_TRACE4(name, a1, a2, a3, a4) do {} while ( 0 )
+#endif
+
+#endif // TRACEPOINTS_H